@@ -38,15 +38,34 @@
 bool
 addressport_equals(address_t addr1, address_t addr2)
 {
-    return addr1.port == addr2.port && !strcmp(addr1.ip, addr2.ip);
+    return addr1.port == addr2.port && address_equals(addr1, addr2);
 }
 
 bool
 address_equals(address_t addr1, address_t addr2)
 {
+    // Compare the binary representations when both are available
+    if (addr1.rawlen && addr2.rawlen)
+        return addr1.rawlen == addr2.rawlen
+               && !memcmp(addr1.raw, addr2.raw, addr1.rawlen);
+
     return !strcmp(addr1.ip, addr2.ip);
 }
 
+void
+address_parse_raw(address_t *addr)
+{
+    if (inet_pton(AF_INET, addr->ip, addr->raw) == 1) {
+        addr->rawlen = 4;
+#ifdef USE_IPV6
+    } else if (inet_pton(AF_INET6, addr->ip, addr->raw) == 1) {
+        addr->rawlen = 16;
+#endif
+    } else {
+        addr->rawlen = 0;
+    }
+}
+
 bool
 address_is_local(address_t addr)
 {
@@ -116,6 +135,7 @@ address_from_str(const char *ipport)
     if (sscanf(scanipport, "%[^:]:%d", address, &port) == 2) {
         strncpy(ret.ip, address, strlen(address));
         ret.port = port;
+        address_parse_raw(&ret);
     }
 
     return ret;
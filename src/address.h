@@ -59,6 +59,10 @@ struct address {
     char ip[ADDRESSLEN];
     //! Port
     uint16_t port;
+    //! Binary IP address in network byte order (for fast comparisons)
+    uint8_t raw[16];
+    //! Binary address length: 4 for IPv4, 16 for IPv6, 0 when not parsed
+    uint8_t rawlen;
 };
 
 /**
@@ -81,6 +85,19 @@ addressport_equals(address_t addr1, address_t addr2);
 bool
 address_equals(address_t addr1, address_t addr2);
 
+/**
+ * @brief Fill the binary representation of an address
+ *
+ * Parse the string IP of the given address into its binary form so
+ * comparisons can be done with integer compares instead of strcmp.
+ * Addresses decoded from network headers copy the binary form directly
+ * and don't require this function.
+ *
+ * @param addr Address structure to be updated
+ */
+void
+address_parse_raw(address_t *addr);
+
 /**
  * @brief Check if a given IP address belongs to a local device
  *
@@ -34,9 +34,20 @@
 #include <netdb.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#endif
 #include "capture.h"
 #ifdef USE_EEP
 #include "capture_eep.h"
+#include "capture_link.h"
 #endif
 #ifdef WITH_GNUTLS
 #include "capture_gnutls.h"
@@ -44,6 +55,9 @@
 #ifdef WITH_OPENSSL
 #include "capture_openssl.h"
 #endif
+#include "capture_ring.h"
+#include "capture_index.h"
+#include "perf.h"
 #include "sip.h"
 #include "rtp.h"
 #include "setting.h"
@@ -53,6 +67,14 @@
 capture_config_t capture_cfg =
 { 0 };
 
+#if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
+// TLS decryption queue helpers (@see capture_tls_enqueue)
+static int
+capture_tls_enqueue(packet_t *packet, struct tcphdr *tcp);
+static void
+capture_tls_stop();
+#endif
+
 void
 capture_init(size_t limit, bool rtp_capture, bool rotate)
 {
@@ -62,6 +84,14 @@ capture_init(size_t limit, bool rtp_capture, bool rotate)
     capture_cfg.paused = 0;
     capture_cfg.sources = vector_create(1, 1);
 
+    // Create the packet and frame object pools
+    packet_pool_init();
+
+    // Warm the pools up to the expected stored packet working set
+    // (@see capture.warmup, expected messages per dialog)
+    if (setting_get_intvalue(SETTING_CAPTURE_WARMUP) > 0 && limit > 0)
+        packet_pool_reserve(limit * setting_get_intvalue(SETTING_CAPTURE_WARMUP));
+
     // Fixme
     if (setting_has_value(SETTING_CAPTURE_STORAGE, "none")) {
         capture_cfg.storage = CAPTURE_STORAGE_NONE;
@@ -91,9 +121,20 @@ capture_init(size_t limit, bool rtp_capture, bool rotate)
 void
 capture_deinit()
 {
+#ifdef USE_EEP
+    // Disconnect any daemon/frontend link
+    capture_serve_deinit();
+    capture_attach_deinit();
+#endif
+
     // Close pcap handler
     capture_close();
 
+#if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
+    // Drain and stop the TLS decryption thread
+    capture_tls_stop();
+#endif
+
     // Deallocate vectors
     vector_set_destroyer(capture_cfg.sources, vector_generic_destroyer);
     vector_destroy(capture_cfg.sources);
@@ -105,48 +146,102 @@ capture_deinit()
 int
 capture_online(const char *dev, const char *outfile)
 {
-    capture_info_t *capinfo;
+    capture_info_t *capinfo = NULL;
+    int handles = 1;
+    int i;
 
     //! Error string
     char errbuf[PCAP_ERRBUF_SIZE];
 
-    // Create a new structure to handle this capture source
-    if (!(capinfo = sng_malloc(sizeof(capture_info_t)))) {
-        fprintf(stderr, "Can't allocate memory for capture data!\n");
-        return 1;
-    }
+#ifdef PACKET_FANOUT
+    // Open multiple fanout handles on this device to spread its flows
+    // across as many capture threads
+    if (setting_get_intvalue(SETTING_CAPTURE_FANOUT) > 1)
+        handles = setting_get_intvalue(SETTING_CAPTURE_FANOUT);
+#endif
 
-    // Try to find capture device information
-    if (pcap_lookupnet(dev, &capinfo->net, &capinfo->mask, errbuf) == -1) {
-        capinfo->net = 0;
-        capinfo->mask = 0;
-    }
+    for (i = 0; i < handles; i++) {
+        // Create a new structure to handle this capture source
+        if (!(capinfo = sng_malloc(sizeof(capture_info_t)))) {
+            fprintf(stderr, "Can't allocate memory for capture data!\n");
+            return 1;
+        }
 
-    // Open capture device
-    capinfo->handle = pcap_open_live(dev, MAXIMUM_SNAPLEN, 1, 1000, errbuf);
-    if (capinfo->handle == NULL) {
-        fprintf(stderr, "Couldn't open device %s: %s\n", dev, errbuf);
-        return 2;
-    }
+        // Try to find capture device information
+        if (pcap_lookupnet(dev, &capinfo->net, &capinfo->mask, errbuf) == -1) {
+            capinfo->net = 0;
+            capinfo->mask = 0;
+        }
 
-    // Store capture device
-    capinfo->device = dev;
+        // Create the capture handle
+        capinfo->handle = pcap_create(dev, errbuf);
+        if (capinfo->handle == NULL) {
+            fprintf(stderr, "Couldn't open device %s: %s\n", dev, errbuf);
+            return 2;
+        }
 
-    // Get datalink to parse packets correctly
-    capinfo->link = pcap_datalink(capinfo->handle);
+        // Snaplen and kernel buffer size are tunable for high rate captures
+        pcap_set_snaplen(capinfo->handle, setting_get_intvalue(SETTING_CAPTURE_SNAPLEN));
+        pcap_set_promisc(capinfo->handle, 1);
+        pcap_set_timeout(capinfo->handle, 1000);
+        pcap_set_buffer_size(capinfo->handle, setting_get_intvalue(SETTING_CAPTURE_BUFSIZE) * 1024 * 1024);
+
+        // Immediate mode trades batching for latency. When disabled, libpcap
+        // uses the TPACKET_V3 block ring on Linux, delivering packets in
+        // batches instead of waking the reader up once per packet
+        pcap_set_immediate_mode(capinfo->handle, setting_enabled(SETTING_CAPTURE_IMMEDIATE));
+
+#ifdef PCAP_TSTAMP_HOST
+        // Optional timestamp source (see pcap-tstamp manpage for values)
+        const char *tstamp = setting_get_value(SETTING_CAPTURE_TSTAMP);
+        if (tstamp && strlen(tstamp)) {
+            int tstamp_type = pcap_tstamp_type_name_to_val(tstamp);
+            if (tstamp_type >= 0)
+                pcap_set_tstamp_type(capinfo->handle, tstamp_type);
+        }
+#endif
 
-    // Check linktypes sngrep knowns before start parsing packets
-    if ((capinfo->link_hl = datalink_size(capinfo->link)) == -1) {
-        fprintf(stderr, "Unable to handle linktype %d\n", capinfo->link);
-        return 3;
-    }
+        // Activate the capture with the configured settings
+        if (pcap_activate(capinfo->handle) < 0) {
+            fprintf(stderr, "Couldn't activate capture on %s: %s\n", dev,
+                    pcap_geterr(capinfo->handle));
+            return 2;
+        }
 
-    // Create Vectors for IP and TCP reassembly
-    capinfo->tcp_reasm = vector_create(0, 10);
-    capinfo->ip_reasm = vector_create(0, 10);
+#ifdef PACKET_FANOUT
+        // Join all handles of this device in a fanout group, so the
+        // kernel hashes each flow to a single handle and its thread
+        if (handles > 1) {
+            int fanout = (getpid() & 0xffff) | (PACKET_FANOUT_HASH << 16);
+            if (setsockopt(pcap_get_selectable_fd(capinfo->handle), SOL_PACKET, PACKET_FANOUT,
+                           &fanout, sizeof(fanout)) < 0) {
+                fprintf(stderr, "Couldn't join fanout group on %s: %s\n",
+                        dev, strerror(errno));
+                return 2;
+            }
+        }
+#endif
 
-    // Add this capture information as packet source
-    vector_append(capture_cfg.sources, capinfo);
+        // Store capture device
+        capinfo->device = dev;
+
+        // Get datalink to parse packets correctly
+        capinfo->link = pcap_datalink(capinfo->handle);
+
+        // Check linktypes sngrep knowns before start parsing packets
+        if ((capinfo->link_hl = datalink_size(capinfo->link)) == -1) {
+            fprintf(stderr, "Unable to handle linktype %d\n", capinfo->link);
+            return 3;
+        }
+
+        // Create structures for IP and TCP reassembly
+        capinfo->tcp_reasm = htable_create(CAPTURE_TCP_REASM_BUCKETS);
+        capinfo->ip_reasm = vector_create(0, 10);
+        capinfo->ip_reasm_idx = htable_create(CAPTURE_IP_REASM_BUCKETS);
+
+        // Add this capture information as packet source
+        vector_append(capture_cfg.sources, capinfo);
+    }
 
     // If requested store packets in a dump file
     if (outfile && !capture_cfg.pd) {
@@ -155,6 +250,9 @@ capture_online(const char *dev, const char *outfile)
                     pcap_geterr(capinfo->handle));
             return 2;
         }
+        // Keep the path and open time for dump rotation
+        capture_cfg.dumpfile = outfile;
+        capture_cfg.dump_opened = time(NULL);
     }
 
     return 0;
@@ -195,6 +293,9 @@ capture_offline(const char *infile, const char *outfile)
             fprintf(stderr, "Failed to reopen tty while using stdin for capture.");
             return 1;
         }
+    } else {
+        // Map the file into memory to parse its frames in place
+        capture_mmap_file(capinfo);
     }
 
     // Get datalink to parse packets correctly
@@ -206,9 +307,10 @@ capture_offline(const char *infile, const char *outfile)
         return 3;
     }
 
-    // Create Vectors for IP and TCP reassembly
-    capinfo->tcp_reasm = vector_create(0, 10);
+    // Create structures for IP and TCP reassembly
+    capinfo->tcp_reasm = htable_create(CAPTURE_TCP_REASM_BUCKETS);
     capinfo->ip_reasm = vector_create(0, 10);
+    capinfo->ip_reasm_idx = htable_create(CAPTURE_IP_REASM_BUCKETS);
 
     // Add this capture information as packet source
     vector_append(capture_cfg.sources, capinfo);
@@ -220,16 +322,277 @@ capture_offline(const char *infile, const char *outfile)
                     pcap_geterr(capinfo->handle));
             return 2;
         }
+        // Keep the path and open time for dump rotation
+        capture_cfg.dumpfile = outfile;
+        capture_cfg.dump_opened = time(NULL);
+    }
+
+    return 0;
+}
+
+void
+capture_mmap_file(capture_info_t *capinfo)
+{
+    struct stat st;
+    u_char *data;
+    uint32_t magic;
+    int fd;
+
+    // Open the capture file for mapping
+    if ((fd = open(capinfo->infile, O_RDONLY)) == -1)
+        return;
+
+    // Only regular files big enough to hold the file header can be mapped
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)
+            || st.st_size < (off_t) sizeof(struct pcap_file_header)) {
+        close(fd);
+        return;
+    }
+
+    // Map the whole file, the mapping survives closing the descriptor
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return;
+
+    // Only native byte order libpcap files can be parsed in place,
+    // pcapng or byte swapped files keep being read through libpcap
+    magic = ((struct pcap_file_header *) data)->magic;
+    if (magic != CAPTURE_PCAP_MAGIC_USEC && magic != CAPTURE_PCAP_MAGIC_NSEC) {
+        munmap(data, st.st_size);
+        return;
+    }
+
+    capinfo->mmap_data = data;
+    capinfo->mmap_size = st.st_size;
+}
+
+void
+capture_mmap_loop(capture_info_t *capinfo, pcap_handler callback)
+{
+    // Mapped capture file contents
+    u_char *data = capinfo->mmap_data;
+    // Position of the next frame record
+    size_t pos = sizeof(struct pcap_file_header);
+    // Frame record header in the mapped file
+    struct pcap_record_header *record;
+    // Frame header for the parsing callbacks
+    struct pcap_pkthdr header;
+    // File timestamps are in nanoseconds resolution
+    bool nsec = ((struct pcap_file_header *) data)->magic == CAPTURE_PCAP_MAGIC_NSEC;
+
+    // A valid sidecar index replays only the interesting frames
+    if (capture_index_replay(capinfo, callback))
+        return;
+
+    // Loading start time, for progress and ETA reporting
+    gettimeofday(&capinfo->load_start, NULL);
+
+    while (capinfo->running && pos + sizeof(struct pcap_record_header) <= capinfo->mmap_size) {
+        record = (struct pcap_record_header *) (data + pos);
+        pos += sizeof(struct pcap_record_header);
+
+        // Ignore truncated last record
+        if (record->caplen > capinfo->mmap_size - pos)
+            break;
+
+        // Fill the frame header as libpcap would have done
+        header.ts.tv_sec = record->ts_sec;
+        header.ts.tv_usec = (nsec) ? record->ts_usec / 1000 : record->ts_usec;
+        header.caplen = record->caplen;
+        header.len = record->len;
+
+        // Apply the capture BPF filter (pcap_loop does it internally),
+        // skipping all link-layer decoding for rejected frames
+        if (capture_cfg.filter
+                && pcap_offline_filter(&capture_cfg.fp, &header, data + pos) == 0) {
+            capinfo->mmap_skipped++;
+            pos += record->caplen;
+            capinfo->mmap_pos = pos;
+            continue;
+        }
+
+        callback((u_char *) capinfo, &header, data + pos);
+        pos += record->caplen;
+
+        // Update read position for progress reporting
+        capinfo->mmap_pos = pos;
+    }
+
+    // Remember complete reads, only then a sidecar index may be written
+    capinfo->mmap_eof = (pos + sizeof(struct pcap_record_header) > capinfo->mmap_size);
+}
+
+#if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
+
+//! Capacity of the TLS decryption queue
+#define CAPTURE_TLS_JOBS 512
+
+//! One TLS segment pending decryption
+struct capture_tls_job {
+    //! Prepared packet owning the encrypted payload
+    packet_t *packet;
+    //! TCP header copy, needed by the connection state machine
+    struct tcphdr tcp;
+};
+
+/**
+ * @brief Queue feeding the TLS decryption thread
+ *
+ * TLS record decryption (and especially the RSA private key decrypt
+ * of a ClientKeyExchange) is too expensive to run inline in the
+ * capture thread. Segments are handed to a single decryption thread,
+ * which trivially preserves per connection ordering, and fed back
+ * into the storage path once decrypted.
+ */
+static struct {
+    //! Circular job queue
+    struct capture_tls_job jobs[CAPTURE_TLS_JOBS];
+    //! Next job slot to be filled
+    size_t head;
+    //! Next job to be decrypted
+    size_t tail;
+    //! The decryption thread has been started
+    bool running;
+    //! No more jobs will be queued
+    bool done;
+    //! Queue lock
+    pthread_mutex_t lock;
+    //! Signaled when jobs are queued or done is set
+    pthread_cond_t ready;
+    //! Signaled when a job slot is freed
+    pthread_cond_t freed;
+    //! Decryption thread
+    pthread_t thread;
+} tls_queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready = PTHREAD_COND_INITIALIZER,
+    .freed = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * @brief Thread decrypting queued TLS segments
+ */
+static void
+capture_tls_thread(void *info)
+{
+    struct capture_tls_job job;
+    sip_parsed_t parsed;
+    uint64_t ptime;
+
+    pthread_mutex_lock(&tls_queue.lock);
+    for (;;) {
+        if (tls_queue.tail < tls_queue.head) {
+            job = tls_queue.jobs[tls_queue.tail % CAPTURE_TLS_JOBS];
+            tls_queue.tail++;
+            pthread_cond_signal(&tls_queue.freed);
+            pthread_mutex_unlock(&tls_queue.lock);
+
+            // Decrypt the segment, replacing the packet payload
+            tls_process_segment(job.packet, &job.tcp);
+            // Decrypted payloads can carry websocket frames too
+            capture_ws_check_packet(job.packet);
+            // Feed the result back into the storage path
+            ptime = perf_timer_start();
+            sip_parse_packet(job.packet, &parsed);
+            perf_timer_record(PERF_TIMER_PARSE, ptime);
+            capture_packet_commit(job.packet, &parsed);
+
+            pthread_mutex_lock(&tls_queue.lock);
+        } else if (tls_queue.done) {
+            break;
+        } else {
+            pthread_cond_wait(&tls_queue.ready, &tls_queue.lock);
+        }
+    }
+    pthread_mutex_unlock(&tls_queue.lock);
+}
+
+/**
+ * @brief Queue a TLS segment for asynchronous decryption
+ *
+ * Blocks while the queue is full, so a decryption backlog slows the
+ * capture thread down instead of growing without bound.
+ *
+ * @return 0 if the packet is now owned by the decryption thread
+ */
+static int
+capture_tls_enqueue(packet_t *packet, struct tcphdr *tcp)
+{
+    pthread_mutex_lock(&tls_queue.lock);
+
+    // Start the decryption thread on first use
+    if (!tls_queue.running) {
+        if (pthread_create(&tls_queue.thread, NULL, (void *) capture_tls_thread, NULL) != 0) {
+            pthread_mutex_unlock(&tls_queue.lock);
+            return 1;
+        }
+        tls_queue.running = true;
     }
 
+    // Wait for a free job slot
+    while (tls_queue.head - tls_queue.tail == CAPTURE_TLS_JOBS)
+        pthread_cond_wait(&tls_queue.freed, &tls_queue.lock);
+
+    tls_queue.jobs[tls_queue.head % CAPTURE_TLS_JOBS].packet = packet;
+    tls_queue.jobs[tls_queue.head % CAPTURE_TLS_JOBS].tcp = *tcp;
+    tls_queue.head++;
+    pthread_cond_signal(&tls_queue.ready);
+    pthread_mutex_unlock(&tls_queue.lock);
     return 0;
 }
 
+/**
+ * @brief Drain the queue and stop the decryption thread
+ */
+static void
+capture_tls_stop()
+{
+    pthread_mutex_lock(&tls_queue.lock);
+    if (!tls_queue.running) {
+        pthread_mutex_unlock(&tls_queue.lock);
+        return;
+    }
+    tls_queue.done = true;
+    pthread_cond_signal(&tls_queue.ready);
+    pthread_mutex_unlock(&tls_queue.lock);
+
+    pthread_join(tls_queue.thread, NULL);
+    tls_queue.running = false;
+    tls_queue.done = false;
+}
+
+#endif /* WITH_GNUTLS || WITH_OPENSSL */
+
 void
 parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packet)
 {
     // Capture info
     capture_info_t *capinfo = (capture_info_t *) info;
+    // Captured packet info
+    packet_t *pkt;
+    // Pre-parsed SIP information
+    sip_parsed_t parsed;
+    // Parse latency measurement
+    uint64_t ptime;
+
+    // Handle transport and reassembly of the captured frame
+    if (!(pkt = capture_packet_prepare(capinfo, header, packet)))
+        return;
+
+    // Parse the SIP payload before taking the shared lock, so capture
+    // threads of different sources run the expensive parsing in parallel
+    ptime = perf_timer_start();
+    sip_parse_packet(pkt, &parsed);
+    perf_timer_record(PERF_TIMER_PARSE, ptime);
+
+    // Store the packet under the capture lock
+    capture_packet_commit(pkt, &parsed);
+}
+
+packet_t *
+capture_packet_prepare(capture_info_t *capinfo, const struct pcap_pkthdr *header, const u_char *packet)
+{
     // UDP header data
     struct udphdr *udp;
     // UDP header size
@@ -238,8 +601,10 @@ parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packe
     struct tcphdr *tcp;
     // TCP header size
     uint16_t tcp_off;
-    // Packet data
-    u_char data[MAX_CAPTURE_LEN];
+    // Local copy of the packet data
+    u_char copy[MAX_CAPTURE_LEN];
+    // Parsed frame contents
+    u_char *data = (u_char *) packet;
     // Packet payload data
     u_char *payload = NULL;
     // Whole packet size
@@ -249,28 +614,42 @@ parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packe
     // Captured packet info
     packet_t *pkt;
 
+    // Count every frame entering the pipeline
+    perf_count(PERF_CAPTURED);
+
     // Ignore packets while capture is paused
-    if (capture_paused())
-        return;
+    if (capture_paused()) {
+        perf_count(PERF_DROPPED);
+        return NULL;
+    }
 
     // Check if we have reached capture limit
     if (capture_cfg.limit && sip_calls_count() >= capture_cfg.limit) {
         // If capture rotation is disabled, just skip this packet
         if (!capture_cfg.rotate) {
-            return;
+            perf_count(PERF_DROPPED);
+            return NULL;
         }
     }
 
     // Check maximum capture length
-    if (header->caplen > MAX_CAPTURE_LEN)
-        return;
+    if (header->caplen > MAX_CAPTURE_LEN) {
+        perf_count(PERF_DROPPED);
+        return NULL;
+    }
 
-    // Copy packet payload
-    memcpy(data, packet, header->caplen);
+    // Frames living in the mapped capture file are parsed in place, so
+    // their file offsets stay recoverable (@see capture_index_write),
+    // anything else is copied out of the libpcap owned buffer
+    if (!(capinfo->mmap_data && packet >= capinfo->mmap_data
+            && packet < capinfo->mmap_data + capinfo->mmap_size)) {
+        memcpy(copy, packet, header->caplen);
+        data = copy;
+    }
 
     // Check if we have a complete IP packet
-    if (!(pkt = capture_packet_reasm_ip(capinfo, header, data, &size_payload, &size_capture)))
-        return;
+    if (!(pkt = capture_packet_reasm_ip(capinfo, header, &data, &size_payload, &size_capture)))
+        return NULL;
 
     // Only interested in UDP packets
     if (pkt->proto == IPPROTO_UDP) {
@@ -318,41 +697,57 @@ parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packe
         packet_set_payload(pkt, payload, size_payload);
 
         // Create a structure for this captured packet
-        if (!(pkt = capture_packet_reasm_tcp(capinfo, pkt, tcp, payload, size_payload)))
-            return;
+        PROF_TIMER_START(rtime);
+        pkt = capture_packet_reasm_tcp(capinfo, pkt, tcp, payload, size_payload);
+        PROF_TIMER_RECORD(PERF_TIMER_REASM_TCP, rtime);
+        if (!pkt)
+            return NULL;
 
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
-        // Check if packet is TLS
-        if (capture_cfg.keyfile) {
-            tls_process_segment(pkt, tcp);
-        }
+        // Hand TLS segments to the decryption thread; the packet is
+        // fed back into the storage path once decrypted
+        if (capture_cfg.keyfile && capture_tls_enqueue(pkt, tcp) == 0)
+            return NULL;
 #endif
 
         // Check if packet is WS or WSS
         capture_ws_check_packet(pkt);
     } else {
         // Not handled protocol
+        perf_count(PERF_DROPPED);
         packet_destroy(pkt);
-        return;
+        return NULL;
     }
 
+    return pkt;
+}
+
+void
+capture_packet_commit(packet_t *pkt, struct sip_parsed *parsed)
+{
+    // Storage latency measurement, including the lock wait
+    uint64_t stime = perf_timer_start();
+
     // Avoid parsing from multiples sources.
     // Avoid parsing while screen in being redrawn
     capture_lock();
     // Check if we can handle this packet
-    if (capture_packet_parse(pkt) == 0) {
+    if (capture_packet_store(pkt, parsed) == 0) {
 #ifdef USE_EEP
         // Send this packet through eep
         capture_eep_send(pkt);
+        // Forward this packet to attached frontends
+        capture_serve_send(pkt);
 #endif
         // Store this packets in output file
-        dump_packet(capture_cfg.pd, pkt);
+        capture_dump_packet(pkt);
         // If storage is disabled, delete frames payload
         if (capture_cfg.storage == 0) {
             packet_free_frames(pkt);
         }
         // Allow Interface refresh and user input actions
         capture_unlock();
+        perf_timer_record(PERF_TIMER_STORE, stime);
         return;
     }
 
@@ -360,11 +755,101 @@ parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packe
     packet_destroy(pkt);
     // Allow Interface refresh and user input actions
     capture_unlock();
+    perf_timer_record(PERF_TIMER_STORE, stime);
+}
+
+void
+enqueue_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packet)
+{
+    capture_info_t *capinfo = (capture_info_t *) info;
+
+    // Copy the raw frame and return to the kernel as soon as possible
+    capture_ring_push(capinfo->ring, header, packet);
+}
+
+/**
+ * @brief Add a frame to a packet, in place when data comes from a mapped file
+ *
+ * Frames living inside the mapped capture file are referenced without
+ * copying their contents (@see capture_mmap_file), anything else gets
+ * its own copy as usual.
+ */
+static frame_t *
+capture_add_frame(capture_info_t *capinfo, packet_t *pkt,
+                  const struct pcap_pkthdr *header, const u_char *packet)
+{
+    if (capinfo->mmap_data && packet >= capinfo->mmap_data
+            && packet < capinfo->mmap_data + capinfo->mmap_size)
+        return packet_add_frame_mapped(pkt, header, packet);
+    return packet_add_frame(pkt, header, packet);
+}
+
+/**
+ * @brief Build the reassembly hash table key of a fragmented datagram
+ *
+ * The key identifies a pending datagram by its source and destination
+ * address and its IP identification field.
+ */
+static void
+capture_ip_reasm_key(address_t src, address_t dst, uint32_t ip_id, char *key, size_t len)
+{
+    snprintf(key, len, "%s-%s-%u", src.ip, dst.ip, ip_id);
+}
+
+/**
+ * @brief Datagram waiting for its remaining IP fragments
+ *
+ * Entries are hashed by address and IP id for the per fragment lookup
+ * and kept in arrival order in the pending vector, so stale datagrams
+ * can be expired without walking the whole table.
+ */
+struct capture_ip_datagram {
+    //! Packet aggregating the fragments received so far
+    packet_t *packet;
+    //! Capture time of the first fragment, to expire stale entries
+    struct timeval ts;
+    //! Datagram key in the reassembly hash table
+    char key[CAPTURE_IP_REASM_KEYLEN];
+};
+
+/**
+ * @brief Remove a pending datagram from the reassembly structures
+ *
+ * The aggregated packet is not destroyed: it is either being returned
+ * to the caller or has been destroyed by the caller already.
+ */
+static void
+capture_ip_datagram_destroy(capture_info_t *capinfo, struct capture_ip_datagram *datagram)
+{
+    htable_remove(capinfo->ip_reasm_idx, datagram->key);
+    vector_remove(capinfo->ip_reasm, datagram);
+    sng_free(datagram);
+}
+
+/**
+ * @brief Expire datagrams whose fragments stopped arriving
+ *
+ * Pending datagrams are stored in arrival order, so only the head of
+ * the vector needs to be checked against the capture time.
+ */
+static void
+capture_ip_reasm_expire(capture_info_t *capinfo, struct timeval now)
+{
+    struct capture_ip_datagram *datagram;
+
+    while ((datagram = vector_first(capinfo->ip_reasm))) {
+        if (now.tv_sec - datagram->ts.tv_sec <= CAPTURE_IP_REASM_TIMEOUT)
+            break;
+        packet_destroy(datagram->packet);
+        capture_ip_datagram_destroy(capinfo, datagram);
+    }
 }
 
 packet_t *
-capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *header, u_char *packet, uint32_t *size, uint32_t *caplen)
+capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *header, u_char **packet_ref, uint32_t *size, uint32_t *caplen)
 {
+    // Contents of the current frame
+    u_char *packet = *packet_ref;
     // IP header data
     struct ip *ip4;
 #ifdef USE_IPV6
@@ -393,6 +878,10 @@ capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *heade
     address_t dst = { };
     //! Common interator for vectors
     vector_iter_t it;
+    //! Pending reassembly entry for this datagram
+    struct capture_ip_datagram *datagram;
+    //! Key of this datagram in the reassembly table
+    char reasmkey[CAPTURE_IP_REASM_KEYLEN];
     //! Packet containers
     packet_t *pkt;
     //! Storage for IP frame
@@ -461,6 +950,9 @@ capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *heade
 
             inet_ntop(AF_INET, &ip4->ip_src, src.ip, sizeof(src.ip));
             inet_ntop(AF_INET, &ip4->ip_dst, dst.ip, sizeof(dst.ip));
+            memcpy(src.raw, &ip4->ip_src, 4);
+            memcpy(dst.raw, &ip4->ip_dst, 4);
+            src.rawlen = dst.rawlen = 4;
             break;
 #ifdef USE_IPV6
         case 6:
@@ -476,6 +968,9 @@ capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *heade
 
             inet_ntop(AF_INET6, &ip6->ip6_src, src.ip, sizeof(src.ip));
             inet_ntop(AF_INET6, &ip6->ip6_dst, dst.ip, sizeof(dst.ip));
+            memcpy(src.raw, &ip6->ip6_src, 16);
+            memcpy(dst.raw, &ip6->ip6_dst, 16);
+            src.rawlen = dst.rawlen = 16;
             break;
 #endif
         default:
@@ -492,28 +987,37 @@ capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *heade
     if (ip_frag == 0) {
         // Just create a new packet with given network data
         pkt = packet_create(ip_ver, ip_proto, src, dst, ip_id);
-        packet_add_frame(pkt, header, packet);
+        capture_add_frame(capinfo, pkt, header, packet);
         return pkt;
     }
 
-    // Look for another packet with same id in IP reassembly vector
-    it = vector_iterator(capinfo->ip_reasm);
-    while ((pkt = vector_iterator_next(&it))) {
-        if (addressport_equals(pkt->src, src)
-                && addressport_equals(pkt->dst, dst)
-                && pkt->ip_id == ip_id) {
-            break;
-        }
-    }
+    // Datagrams that never completed stop consuming memory here
+    capture_ip_reasm_expire(capinfo, header->ts);
+
+    // Look for another packet with same id in IP reassembly table
+    capture_ip_reasm_key(src, dst, ip_id, reasmkey, sizeof(reasmkey));
+    datagram = htable_find(capinfo->ip_reasm_idx, reasmkey);
 
     // If we already have this packet stored, append this frames to existing one
-    if (pkt) {
-        packet_add_frame(pkt, header, packet);
+    if (datagram) {
+        pkt = datagram->packet;
+        capture_add_frame(capinfo, pkt, header, packet);
     } else {
+        // Evict the oldest pending datagram when the table is full
+        if (vector_count(capinfo->ip_reasm) == CAPTURE_IP_REASM_MAX) {
+            datagram = vector_first(capinfo->ip_reasm);
+            packet_destroy(datagram->packet);
+            capture_ip_datagram_destroy(capinfo, datagram);
+        }
         // Add To the possible reassembly list
         pkt = packet_create(ip_ver, ip_proto, src, dst, ip_id);
-        packet_add_frame(pkt, header, packet);
-        vector_append(capinfo->ip_reasm, pkt);
+        capture_add_frame(capinfo, pkt, header, packet);
+        datagram = sng_malloc(sizeof(struct capture_ip_datagram));
+        datagram->packet = pkt;
+        datagram->ts = header->ts;
+        memcpy(datagram->key, reasmkey, sizeof(datagram->key));
+        htable_insert(capinfo->ip_reasm_idx, datagram->key, datagram);
+        vector_append(capinfo->ip_reasm, datagram);
     }
 
     // Add this IP content length to the total captured of the packet
@@ -541,6 +1045,12 @@ capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *heade
         if (len_data > MAX_CAPTURE_LEN)
             return NULL;
 
+        // Assemble into the scratch buffer, the current frame may live
+        // in the read only mapped capture file
+        if (!capinfo->reasm_buf)
+            capinfo->reasm_buf = sng_malloc(MAX_CAPTURE_LEN);
+        packet = capinfo->reasm_buf;
+
         // Initialize memory for the assembly packet
         memset(packet, 0, link_hl + ip_hl + len_data);
 
@@ -552,104 +1062,306 @@ capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *heade
                    frame->data + link_hl + frame_ip->ip_hl * 4,
                    ntohs(frame_ip->ip_len) - frame_ip->ip_hl * 4);
         }
+        *packet_ref = packet;
 
         *caplen = link_hl + ip_hl + len_data;
         *size = len_data;
 
         // Return the assembled IP packet
-        vector_remove(capinfo->ip_reasm, pkt);
+        capture_ip_datagram_destroy(capinfo, datagram);
         return pkt;
     }
 
     return NULL;
 }
 
-packet_t *
-capture_packet_reasm_tcp(capture_info_t *capinfo, packet_t *packet, struct tcphdr *tcp, u_char *payload, int size_payload) {
-
-    vector_iter_t it = vector_iterator(capinfo->tcp_reasm);
-    packet_t *pkt;
-    u_char *new_payload;
-    u_char full_payload[MAX_CAPTURE_LEN + 1];
+/**
+ * @brief Build the reassembly hash table key of a TCP stream
+ *
+ * The key identifies a pending stream by its source and destination
+ * address and port tuple.
+ */
+static void
+capture_tcp_reasm_key(packet_t *packet, char *key, size_t len)
+{
+    snprintf(key, len, "%s:%u-%s:%u",
+             packet->src.ip, packet->src.port,
+             packet->dst.ip, packet->dst.port);
+}
 
-    //! Assembled
-    if ((int32_t) size_payload <= 0)
-        return packet;
+//! Out of order segment waiting for its sequence gap to be filled
+struct capture_tcp_segment {
+    //! Absolute sequence number of the first byte
+    uint32_t seq;
+    //! Number of payload bytes
+    int len;
+    //! Copy of the segment payload
+    u_char *data;
+};
 
-    while ((pkt = vector_iterator_next(&it))) {
-        if (addressport_equals(pkt->src, packet->src) &&
-                addressport_equals(pkt->dst, packet->dst)) {
-            break;
-        }
-    }
+/**
+ * @brief TCP flow pending reassembly
+ *
+ * Holds the aggregated packet with the in-order assembled payload,
+ * the next expected sequence number and a buffer of out of order
+ * segments waiting for their gap to be filled. Per flow memory is
+ * bounded by MAX_CAPTURE_LEN for both the assembled payload and the
+ * buffered segments.
+ */
+struct capture_tcp_flow {
+    //! Aggregated packet holding frames and the assembled payload
+    packet_t *packet;
+    //! Sequence number of the first assembled byte
+    uint32_t start_seq;
+    //! Sequence number following the last assembled byte
+    uint32_t next_seq;
+    //! Out of order segments (struct capture_tcp_segment)
+    vector_t *pending;
+    //! Bytes buffered in out of order segments
+    int pending_bytes;
+    //! Flow key in the reassembly hash table
+    char key[CAPTURE_TCP_REASM_KEYLEN];
+};
 
-    // If we already have this packet stored
-    if (pkt) {
-        frame_t *frame;
-        // Append this frames to the original packet
-        vector_iter_t frames = vector_iterator(packet->frames);
-        while ((frame = vector_iterator_next(&frames)))
-            packet_add_frame(pkt, frame->header, frame->data);
-        // Destroy current packet as its frames belong to the stored packet
-        packet_destroy(packet);
-    } else {
-        // First time this packet has been seen
-        pkt = packet;
-        // Add To the possible reassembly list
-        vector_append(capinfo->tcp_reasm, packet);
-    }
+/**
+ * @brief Vector destroyer for buffered out of order segments
+ */
+static void
+capture_tcp_segment_destroyer(void *item)
+{
+    struct capture_tcp_segment *segment = (struct capture_tcp_segment *) item;
+    sng_free(segment->data);
+    sng_free(segment);
+}
 
-    // Store firt tcp sequence
-    if (pkt->tcp_seq == 0) {
-        pkt->tcp_seq = ntohl(tcp->th_seq);
-    }
+/**
+ * @brief Remove a flow from the reassembly table and deallocate it
+ *
+ * The aggregated packet is not destroyed: it is either being returned
+ * to the caller or has been destroyed already.
+ */
+static void
+capture_tcp_flow_destroy(capture_info_t *capinfo, struct capture_tcp_flow *flow)
+{
+    htable_remove(capinfo->tcp_reasm, flow->key);
+    vector_destroy(flow->pending);
+    sng_free(flow);
+}
 
-    // If the first frame of this packet
-    if (vector_count(pkt->frames) == 1) {
-        // Set initial payload
-        packet_set_payload(pkt, payload, size_payload);
-    } else {
-        // Check payload length. Dont handle too big payload packets
-        if (pkt->payload_len + size_payload > MAX_CAPTURE_LEN) {
-            packet_destroy(pkt);
-            vector_remove(capinfo->tcp_reasm, pkt);
-            return NULL;
-        }
-        new_payload = sng_malloc(pkt->payload_len + size_payload);
-        if (pkt->tcp_seq < ntohl(tcp->th_seq)) {
-            // Append payload to the existing
-            pkt->tcp_seq =  ntohl(tcp->th_seq);
-            memcpy(new_payload, pkt->payload, pkt->payload_len);
-            memcpy(new_payload + pkt->payload_len, payload, size_payload);
-        } else {
-            // Prepend payload to the existing
-            memcpy(new_payload, payload, size_payload);
-            memcpy(new_payload + size_payload, pkt->payload, pkt->payload_len);
-        }
-        packet_set_payload(pkt, new_payload, pkt->payload_len + size_payload);
-        sng_free(new_payload);
-    }
+/**
+ * @brief Append bytes after the assembled flow payload
+ *
+ * @return 0 on success, 1 when the flow would exceed its memory bound
+ */
+static int
+capture_tcp_flow_append(struct capture_tcp_flow *flow, u_char *payload, int len)
+{
+    packet_t *pkt = flow->packet;
+    u_char *new_payload;
 
-    // Store full payload content
-    memset(full_payload, 0, MAX_CAPTURE_LEN);
-    memcpy(full_payload, pkt->payload, pkt->payload_len);
+    if (pkt->payload_len + len > MAX_CAPTURE_LEN)
+        return 1;
 
-    // This packet is ready to be parsed
-    int original_size = pkt->payload_len;
-    int valid = sip_validate_packet(pkt);
-    if (valid == VALIDATE_COMPLETE_SIP) {
-        // Full SIP packet!
-        vector_remove(capinfo->tcp_reasm, pkt);
-        return pkt;
-    } else if (valid == VALIDATE_MULTIPLE_SIP) {
-        vector_remove(capinfo->tcp_reasm, pkt);
+    new_payload = sng_malloc(pkt->payload_len + len + 1);
+    memcpy(new_payload, pkt->payload, pkt->payload_len);
+    memcpy(new_payload + pkt->payload_len, payload, len);
+    packet_take_payload(pkt, new_payload, pkt->payload_len + len);
 
-        // We have a full SIP Packet, but do not remove everything from the reasm queue
+    flow->next_seq += len;
+    return 0;
+}
+
+/**
+ * @brief Prepend bytes before the assembled flow payload
+ *
+ * @return 0 on success, 1 when the flow would exceed its memory bound
+ */
+static int
+capture_tcp_flow_prepend(struct capture_tcp_flow *flow, u_char *payload, int len)
+{
+    packet_t *pkt = flow->packet;
+    u_char *new_payload;
+
+    if (pkt->payload_len + len > MAX_CAPTURE_LEN)
+        return 1;
+
+    new_payload = sng_malloc(pkt->payload_len + len + 1);
+    memcpy(new_payload, payload, len);
+    memcpy(new_payload + len, pkt->payload, pkt->payload_len);
+    packet_take_payload(pkt, new_payload, pkt->payload_len + len);
+
+    flow->start_seq -= len;
+    return 0;
+}
+
+/**
+ * @brief Try to merge a segment into the assembled flow payload
+ *
+ * The segment is merged when it touches the assembled region on
+ * either side; already assembled bytes (retransmissions) contribute
+ * nothing. Segments leaving a sequence gap are kept buffered.
+ *
+ * @return 0 merged or duplicate, 1 when the flow would exceed its
+ *         memory bound, 2 when the segment leaves a gap
+ */
+static int
+capture_tcp_flow_merge(struct capture_tcp_flow *flow, uint32_t seq, u_char *data, int len)
+{
+    int32_t head, tail;
+
+    // Nothing assembled yet, anchor the flow at this segment
+    if (flow->packet->payload_len == 0) {
+        flow->start_seq = flow->next_seq = seq;
+        return capture_tcp_flow_append(flow, data, len);
+    }
+
+    // Bytes before and after the assembled region
+    head = (int32_t) (flow->start_seq - seq);
+    tail = (int32_t) (seq + len - flow->next_seq);
+
+    if (head > 0) {
+        // Segment not reaching the assembled region yet
+        if (head > len)
+            return 2;
+        if (capture_tcp_flow_prepend(flow, data, head))
+            return 1;
+    }
+    if (tail > 0) {
+        // Segment past the assembled region
+        if (tail > len)
+            return 2;
+        if (capture_tcp_flow_append(flow, data + len - tail, tail))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Apply buffered segments that the assembled payload caught up with
+ *
+ * @return 0 on success, 1 when the flow would exceed its memory bound
+ */
+static int
+capture_tcp_flow_drain(struct capture_tcp_flow *flow)
+{
+    struct capture_tcp_segment *segment;
+    int applied = 1;
+    int i, merged;
+
+    while (applied) {
+        applied = 0;
+        for (i = 0; i < vector_count(flow->pending); i++) {
+            segment = vector_item(flow->pending, i);
+            merged = capture_tcp_flow_merge(flow, segment->seq, segment->data, segment->len);
+            // Still a gap between this segment and the assembled payload
+            if (merged == 2)
+                continue;
+            if (merged == 1)
+                return 1;
+            flow->pending_bytes -= segment->len;
+            vector_remove(flow->pending, segment);
+            applied = 1;
+            break;
+        }
+    }
+    return 0;
+}
+
+packet_t *
+capture_packet_reasm_tcp(capture_info_t *capinfo, packet_t *packet, struct tcphdr *tcp, u_char *payload, int size_payload) {
+
+    char streamkey[CAPTURE_TCP_REASM_KEYLEN];
+    struct capture_tcp_flow *flow;
+    struct capture_tcp_segment *segment;
+    uint32_t seq = ntohl(tcp->th_seq);
+    packet_t *pkt;
+    u_char full_payload[MAX_CAPTURE_LEN + 1];
+
+    //! Assembled
+    if ((int32_t) size_payload <= 0)
+        return packet;
+
+    // Look for a flow of the same stream in the reassembly table
+    capture_tcp_reasm_key(packet, streamkey, sizeof(streamkey));
+    flow = htable_find(capinfo->tcp_reasm, streamkey);
+
+    if (flow) {
+        frame_t *frame;
+        // Append this frames to the flow packet
+        vector_iter_t frames = vector_iterator(packet->frames);
+        while ((frame = vector_iterator_next(&frames)))
+            capture_add_frame(capinfo, flow->packet, frame->header, frame->data);
+        // Destroy current packet as its frames belong to the flow packet
+        packet_destroy(packet);
+    } else {
+        // First segment of this flow
+        flow = sng_malloc(sizeof(struct capture_tcp_flow));
+        flow->packet = packet;
+        flow->pending = vector_create(4, 4);
+        vector_set_destroyer(flow->pending, capture_tcp_segment_destroyer);
+        memcpy(flow->key, streamkey, sizeof(flow->key));
+        htable_insert(capinfo->tcp_reasm, flow->key, flow);
+        // The assembled payload starts empty
+        packet_set_payload(packet, NULL, 0);
+    }
+    pkt = flow->packet;
+
+    // Merge this segment into the assembled payload
+    switch (capture_tcp_flow_merge(flow, seq, payload, size_payload)) {
+        case 2:
+            // Out of order segment, buffer it until the gap is filled
+            if (flow->pending_bytes + size_payload > MAX_CAPTURE_LEN) {
+                capture_tcp_flow_destroy(capinfo, flow);
+                packet_destroy(pkt);
+                return NULL;
+            }
+            segment = sng_malloc(sizeof(struct capture_tcp_segment));
+            segment->seq = seq;
+            segment->len = size_payload;
+            segment->data = sng_malloc(size_payload);
+            memcpy(segment->data, payload, size_payload);
+            vector_append(flow->pending, segment);
+            flow->pending_bytes += size_payload;
+            // Wait for the missing bytes
+            return NULL;
+        case 1:
+            // Flow too big to handle
+            capture_tcp_flow_destroy(capinfo, flow);
+            packet_destroy(pkt);
+            return NULL;
+        default:
+            // Apply any buffered segment this one unblocked
+            if (capture_tcp_flow_drain(flow)) {
+                capture_tcp_flow_destroy(capinfo, flow);
+                packet_destroy(pkt);
+                return NULL;
+            }
+            break;
+    }
+
+    // Store full payload content
+    memset(full_payload, 0, MAX_CAPTURE_LEN);
+    memcpy(full_payload, pkt->payload, pkt->payload_len);
+
+    // This packet is ready to be parsed
+    int original_size = pkt->payload_len;
+    int valid = sip_validate_packet(pkt);
+    if (valid == VALIDATE_COMPLETE_SIP) {
+        // Full SIP packet!
+        capture_tcp_flow_destroy(capinfo, flow);
+        return pkt;
+    } else if (valid == VALIDATE_MULTIPLE_SIP) {
+        // We have a full SIP Packet, but keep the rest of the stream
+        // (and any buffered segments) in a continuation flow
         packet_t *cont = packet_clone(pkt);
         int pldiff = original_size - pkt->payload_len;
         if (pldiff > 0 && pldiff < MAX_CAPTURE_LEN) {
             packet_set_payload(cont, full_payload + pkt->payload_len, pldiff);
-            vector_append(capinfo->tcp_reasm, cont);
+            flow->packet = cont;
+            flow->start_seq += pkt->payload_len;
+        } else {
+            packet_destroy(cont);
+            capture_tcp_flow_destroy(capinfo, flow);
         }
 
         // Return the full initial packet
@@ -657,7 +1369,7 @@ capture_packet_reasm_tcp(capture_info_t *capinfo, packet_t *packet, struct tcphd
     } else if (valid == VALIDATE_NOT_SIP) {
         // Not a SIP packet, store until PSH flag
         if (tcp->th_flags & TH_PUSH) {
-            vector_remove(capinfo->tcp_reasm, pkt);
+            capture_tcp_flow_destroy(capinfo, flow);
             return pkt;
         }
     }
@@ -666,6 +1378,41 @@ capture_packet_reasm_tcp(capture_info_t *capinfo, packet_t *packet, struct tcphd
     return NULL;
 }
 
+//! Entries of the per connection websocket state table
+#define CAPTURE_WS_CONNS 256
+
+//! Websocket framing state of a connection
+struct capture_ws_conn {
+    //! Connection key (same format as the TCP reassembly key)
+    char key[CAPTURE_TCP_REASM_KEYLEN];
+    //! A valid websocket text frame was already seen
+    bool active;
+    //! Frame payload bytes expected in following segments
+    uint32_t remainder;
+    //! The pending frame payload is masked
+    u_char mask;
+    //! Masking key of the pending frame
+    u_char mask_key[4];
+    //! Key offset to unmask the next continuation byte
+    uint32_t mask_off;
+};
+
+//! Websocket connection states, direct mapped by connection key
+static struct capture_ws_conn ws_conns[CAPTURE_WS_CONNS];
+
+/**
+ * @brief Get the websocket state slot of a packet connection
+ *
+ * The table is direct mapped: the returned slot only holds the state
+ * of this connection when its key matches.
+ */
+static struct capture_ws_conn *
+capture_ws_conn_slot(packet_t *packet, char *key)
+{
+    capture_tcp_reasm_key(packet, key, CAPTURE_TCP_REASM_KEYLEN);
+    return &ws_conns[htable_hash(key) % CAPTURE_WS_CONNS];
+}
+
 int
 capture_ws_check_packet(packet_t *packet)
 {
@@ -674,9 +1421,13 @@ capture_ws_check_packet(packet_t *packet)
     u_char ws_opcode;
     u_char ws_mask;
     uint8_t ws_len;
-    u_char ws_mask_key[4];
+    uint64_t ws_flen;
+    u_char ws_mask_key[4] = { 0 };
     u_char *payload, *newpayload;
-    uint32_t size_payload;
+    uint32_t size_payload, flen;
+    struct capture_ws_conn *conn;
+    char connkey[CAPTURE_TCP_REASM_KEYLEN];
+    bool known;
     int i;
 
     /**
@@ -709,6 +1460,32 @@ capture_ws_check_packet(packet_t *packet)
     if (size_payload == 0)
         return 0;
 
+    // Get the framing state of this connection
+    conn = capture_ws_conn_slot(packet, connkey);
+    known = (strcmp(conn->key, connkey) == 0);
+
+    // Forward the remainder of a frame spanning several segments
+    // without looking for a header it does not carry
+    if (known && conn->remainder > 0) {
+        flen = (size_payload < conn->remainder) ? size_payload : conn->remainder;
+        newpayload = sng_malloc(flen + 1);
+        memcpy(newpayload, payload, flen);
+        if (conn->mask) {
+            for (i = 0; i < (int) flen; i++)
+                newpayload[i] = newpayload[i] ^ conn->mask_key[(conn->mask_off + i) % 4];
+        }
+        conn->mask_off = (conn->mask_off + flen) % 4;
+        conn->remainder -= flen;
+        packet_take_payload(packet, newpayload, flen);
+
+        if (packet->type == PACKET_SIP_TLS) {
+            packet_set_type(packet, PACKET_SIP_WSS);
+        } else {
+            packet_set_type(packet, PACKET_SIP_WS);
+        }
+        return 1;
+    }
+
     // Flags && Opcode
     ws_fin = (*payload & WH_FIN) >> 4;
     ws_opcode = *payload & WH_OPCODE;
@@ -723,21 +1500,36 @@ capture_ws_check_packet(packet_t *packet)
     ws_len = (*(payload + ws_off) & WH_LEN);
     ws_off++;
 
-    // Skip Payload len
+    // Read Payload len
+    ws_flen = ws_len;
     switch (ws_len) {
             // Extended
         case 126:
+            if (ws_off + 2 > (int) size_payload)
+                return 0;
+            ws_flen = ((uint64_t) payload[ws_off] << 8) | payload[ws_off + 1];
             ws_off += 2;
             break;
         case 127:
+            if (ws_off + 8 > (int) size_payload)
+                return 0;
+            ws_flen = 0;
+            for (i = 0; i < 8; i++)
+                ws_flen = (ws_flen << 8) | payload[ws_off + i];
             ws_off += 8;
             break;
         default:
-            return 0;
+            // Short frames are only accepted once the connection is
+            // known to carry websocket frames
+            if (!known || !conn->active)
+                return 0;
+            break;
     }
 
     // Get Masking key if mask is enabled
     if (ws_mask) {
+        if (ws_off + 4 > (int) size_payload)
+            return 0;
         memcpy(ws_mask_key, (payload + ws_off), 4);
         ws_off += 4;
     }
@@ -747,17 +1539,26 @@ capture_ws_check_packet(packet_t *packet)
     if ((int32_t) size_payload <= 0)
         return 0;
 
-    newpayload = sng_malloc(size_payload);
-    memcpy(newpayload, payload + ws_off, size_payload);
+    // Forward only the current frame payload
+    flen = (ws_flen && ws_flen < size_payload) ? (uint32_t) ws_flen : size_payload;
+
+    // Remember this connection framing for the following segments
+    memcpy(conn->key, connkey, sizeof(conn->key));
+    conn->active = true;
+    conn->mask = ws_mask;
+    memcpy(conn->mask_key, ws_mask_key, sizeof(conn->mask_key));
+    conn->remainder = (ws_flen > flen) ? ws_flen - flen : 0;
+    conn->mask_off = flen % 4;
+
+    newpayload = sng_malloc(flen + 1);
+    memcpy(newpayload, payload + ws_off, flen);
     // If mask is enabled, unmask the payload
     if (ws_mask) {
-        for (i = 0; i < size_payload; i++)
+        for (i = 0; i < (int) flen; i++)
             newpayload[i] = newpayload[i] ^ ws_mask_key[i % 4];
     }
-    // Set new packet payload into the packet
-    packet_set_payload(packet, newpayload, size_payload);
-    // Free the new payload
-    sng_free(newpayload);
+    // The packet owns the unmasked buffer, no second copy needed
+    packet_take_payload(packet, newpayload, flen);
 
     if (packet->type == PACKET_SIP_TLS) {
         packet_set_type(packet, PACKET_SIP_WSS);
@@ -770,22 +1571,62 @@ capture_ws_check_packet(packet_t *packet)
 
 int
 capture_packet_parse(packet_t *packet)
+{
+    // Pre-parsed SIP information
+    sip_parsed_t parsed;
+
+    // Parse the packet payload without touching the calls storage
+    uint64_t ptime = perf_timer_start();
+    sip_parse_packet(packet, &parsed);
+    perf_timer_record(PERF_TIMER_PARSE, ptime);
+
+    // Store the parsed results
+    return capture_packet_store(packet, &parsed);
+}
+
+int
+capture_packet_store(packet_t *packet, struct sip_parsed *parsed)
 {
     // Media structure for RTP packets
     rtp_stream_t *stream;
 
     // We're only interested in packets with payload
     if (packet_payloadlen(packet)) {
-        // Parse this header and payload
-        if (sip_check_packet(packet)) {
+        // Count packets that parsed as SIP
+        if (parsed->msg)
+            perf_count(PERF_PARSED);
+
+        // Store the pre-parsed message into the calls list
+        sip_msg_t *stored = NULL;
+        if (parsed->msg) {
+            PROF_TIMER_START(sstime);
+            stored = sip_store_packet(packet, parsed);
+            PROF_TIMER_RECORD(PERF_TIMER_SIP_STORE, sstime);
+        }
+        if (stored) {
+            perf_count(PERF_MATCHED);
+            // Stream the stored message to registered exporters
+            if (capture_cfg.msg_cb)
+                capture_cfg.msg_cb(stored);
+            // Let the UI know there is new data to display
+            if (capture_cfg.change_cb)
+                capture_cfg.change_cb();
             return 0;
         }
 
         // Check if this packet belongs to a RTP stream
-        if ((stream = rtp_check_packet(packet))) {
+        PROF_TIMER_START(rtptime);
+        stream = rtp_check_packet(packet);
+        PROF_TIMER_RECORD(PERF_TIMER_RTP_CHECK, rtptime);
+        if (stream) {
             // We have an RTP packet!
             packet_set_type(packet, PACKET_RTP);
-            // Store this pacekt if capture rtp is enabled
+            // Let the UI know there is new data to display
+            if (capture_cfg.change_cb)
+                capture_cfg.change_cb();
+            // Stream counters and timestamps are already updated at this
+            // point, so only keep the packet content when rtp capture is
+            // enabled; otherwise it is released right after this function
             if (capture_cfg.rtp_capture) {
                 call_add_rtp_packet(stream_get_call(stream), packet);
                 return 0;
@@ -795,6 +1636,18 @@ capture_packet_parse(packet_t *packet)
     return 1;
 }
 
+void
+capture_set_change_callback(void (*cb)(void))
+{
+    capture_cfg.change_cb = cb;
+}
+
+void
+capture_set_msg_callback(void (*cb)(struct sip_msg *))
+{
+    capture_cfg.msg_cb = cb;
+}
+
 void
 capture_close()
 {
@@ -804,28 +1657,330 @@ capture_close()
     if (vector_count(capture_cfg.sources) == 0)
         return;
 
-    // Close dump file
-    if (capture_cfg.pd) {
-        dump_close(capture_cfg.pd);
+    // Stop the merge thread before its sources are unmapped
+    vector_iter_t it = vector_iterator(capture_cfg.sources);
+    if (capture_cfg.merge_running) {
+        while ((capinfo = vector_iterator_next(&it)))
+            if (capinfo->merged)
+                capinfo->running = false;
+        pthread_join(capture_cfg.merge_t, NULL);
+        capture_cfg.merge_running = false;
+        vector_iterator_reset(&it);
     }
 
     // Stop all captures
-    vector_iter_t it = vector_iterator(capture_cfg.sources);
     while ((capinfo = vector_iterator_next(&it))) {
         //Close PCAP file
         if (capinfo->handle) {
             if (capinfo->running) {
-                /* We must cancel the thread here instead of joining because, according to pcap_breakloop man page,
-                 * you can only break pcap_loop from within the same thread.
-                 * @see: https://www.tcpdump.org/manpages/pcap_breakloop.3pcap.html
-                 */
-                pcap_breakloop(capinfo->handle);
-                pthread_cancel(capinfo->capture_t);
-                pthread_join(capinfo->capture_t, NULL);
+                if (capinfo->mmap_data) {
+                    // The mapped reader checks the running flag on every
+                    // record, no need to cancel the thread as with pcap_loop
+                    capinfo->running = false;
+                    pthread_join(capinfo->capture_t, NULL);
+                } else {
+                    /* We must cancel the thread here instead of joining because, according to pcap_breakloop man page,
+                     * you can only break pcap_loop from within the same thread.
+                     * @see: https://www.tcpdump.org/manpages/pcap_breakloop.3pcap.html
+                     */
+                    pcap_breakloop(capinfo->handle);
+                    pthread_cancel(capinfo->capture_t);
+                    pthread_join(capinfo->capture_t, NULL);
+                    capinfo->running = false;
+                }
+            }
+        }
+        // Wait for the parser thread to drain pending frames
+        if (capinfo->ring) {
+            pthread_join(capinfo->parser_t, NULL);
+            capture_ring_destroy(capinfo->ring);
+            capinfo->ring = NULL;
+        }
+        // Release the mapped capture file
+        if (capinfo->mmap_data) {
+            munmap(capinfo->mmap_data, capinfo->mmap_size);
+            capinfo->mmap_data = NULL;
+        }
+    }
+
+    // Stop the writer thread once no more frames can be queued
+    if (capture_cfg.dump_ring) {
+        capture_cfg.dumper_running = false;
+        pthread_join(capture_cfg.dumper_t, NULL);
+        capture_ring_destroy(capture_cfg.dump_ring);
+        capture_cfg.dump_ring = NULL;
+    }
+
+    // Close dump file
+    if (capture_cfg.pd) {
+        dump_close(capture_cfg.pd);
+    }
+
+}
+
+//! Parsing state of a worker pool slot
+enum capture_parse_slot_state {
+    SLOT_EMPTY = 0,
+    SLOT_READY,
+    SLOT_PARSING,
+    SLOT_PARSED
+};
+
+//! Worker pool slot, holding one packet pending parsing or storage
+struct capture_parse_slot {
+    //! Current state of this slot
+    enum capture_parse_slot_state state;
+    //! Prepared packet (@see capture_packet_prepare)
+    packet_t *packet;
+    //! Pre-parsed SIP information (@see sip_parse_packet)
+    sip_parsed_t parsed;
+};
+
+/**
+ * @brief Worker pool parsing a mapped capture file
+ *
+ * The reader thread prepares packets in capture order and queues them
+ * in a circular slot array. Worker threads claim slots and run the
+ * expensive SIP payload parsing in parallel, and a storage thread
+ * stores the results strictly in queue order, so dialogs end up in the
+ * same order a single threaded load would produce.
+ */
+struct capture_parse_pool {
+    //! Slots of the ordered parsing queue
+    struct capture_parse_slot *slots;
+    //! Next slot to be filled by the reader thread
+    size_t head;
+    //! Next slot to be claimed by a worker thread
+    size_t claim;
+    //! Next slot to be stored by the storage thread
+    size_t tail;
+    //! Reader has no more packets to queue
+    bool done;
+    //! Protects all pool members
+    pthread_mutex_t lock;
+    //! Signalled when slots become ready to parse (workers wait here)
+    pthread_cond_t ready;
+    //! Signalled when slots become parsed (storage thread waits here)
+    pthread_cond_t parsed;
+    //! Signalled when slots become free again (reader waits here)
+    pthread_cond_t freed;
+    //! Worker threads running sip_parse_packet
+    pthread_t *workers;
+    //! Number of worker threads
+    int nworkers;
+    //! Thread storing parsed packets in capture order
+    pthread_t store_t;
+    //! Capture source this pool belongs to
+    capture_info_t *capinfo;
+};
+
+/**
+ * @brief Worker thread parsing queued packets
+ */
+static void
+capture_parse_worker_thread(void *info)
+{
+    struct capture_parse_pool *pool = (struct capture_parse_pool *) info;
+    size_t first, count, i;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        if (pool->claim < pool->head) {
+            // Claim a batch of queued packets, amortizing the lock cost
+            first = pool->claim;
+            count = pool->head - pool->claim;
+            if (count > CAPTURE_PARSE_BATCH)
+                count = CAPTURE_PARSE_BATCH;
+            for (i = 0; i < count; i++)
+                pool->slots[(first + i) % CAPTURE_PARSE_SLOTS].state = SLOT_PARSING;
+            pool->claim += count;
+            pthread_mutex_unlock(&pool->lock);
+
+            // Run the expensive SIP payload parsing
+            for (i = 0; i < count; i++) {
+                struct capture_parse_slot *slot = &pool->slots[(first + i) % CAPTURE_PARSE_SLOTS];
+                uint64_t ptime = perf_timer_start();
+                sip_parse_packet(slot->packet, &slot->parsed);
+                perf_timer_record(PERF_TIMER_PARSE, ptime);
             }
+
+            pthread_mutex_lock(&pool->lock);
+            for (i = 0; i < count; i++)
+                pool->slots[(first + i) % CAPTURE_PARSE_SLOTS].state = SLOT_PARSED;
+            pthread_cond_signal(&pool->parsed);
+        } else if (pool->done) {
+            break;
+        } else {
+            pthread_cond_wait(&pool->ready, &pool->lock);
         }
     }
+    pthread_mutex_unlock(&pool->lock);
+}
 
+/**
+ * @brief Thread storing parsed packets in capture order
+ */
+static void
+capture_parse_store_thread(void *info)
+{
+    struct capture_parse_pool *pool = (struct capture_parse_pool *) info;
+    size_t first, count, i;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        // Gather the run of contiguous parsed slots at the queue tail
+        first = pool->tail;
+        count = 0;
+        while (pool->tail + count < pool->claim
+                && pool->slots[(first + count) % CAPTURE_PARSE_SLOTS].state == SLOT_PARSED)
+            count++;
+
+        if (count > 0) {
+            pthread_mutex_unlock(&pool->lock);
+            // Store in capture order, keeping dialogs timestamp sorted
+            for (i = 0; i < count; i++) {
+                struct capture_parse_slot *slot = &pool->slots[(first + i) % CAPTURE_PARSE_SLOTS];
+                capture_packet_commit(slot->packet, &slot->parsed);
+            }
+            pthread_mutex_lock(&pool->lock);
+            for (i = 0; i < count; i++)
+                pool->slots[(first + i) % CAPTURE_PARSE_SLOTS].state = SLOT_EMPTY;
+            pool->tail += count;
+            pthread_cond_signal(&pool->freed);
+        } else if (pool->done && pool->tail == pool->head) {
+            break;
+        } else {
+            pthread_cond_wait(&pool->parsed, &pool->lock);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Queue a prepared packet in the parsing worker pool
+ */
+static void
+capture_parse_pool_push(struct capture_parse_pool *pool, packet_t *pkt)
+{
+    struct capture_parse_slot *slot;
+
+    pthread_mutex_lock(&pool->lock);
+    // Wait for a free slot, the storage thread drains them in order
+    while (pool->head - pool->tail == CAPTURE_PARSE_SLOTS && pool->capinfo->running)
+        pthread_cond_wait(&pool->freed, &pool->lock);
+
+    // Capture is being closed, drop this packet
+    if (pool->head - pool->tail == CAPTURE_PARSE_SLOTS) {
+        pthread_mutex_unlock(&pool->lock);
+        packet_destroy(pkt);
+        return;
+    }
+
+    slot = &pool->slots[pool->head % CAPTURE_PARSE_SLOTS];
+    slot->packet = pkt;
+    slot->state = SLOT_READY;
+    pool->head++;
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Create the parsing worker pool of a mapped capture file
+ *
+ * @return the created pool, NULL when capture.workers is disabled
+ */
+static struct capture_parse_pool *
+capture_parse_pool_start(capture_info_t *capinfo)
+{
+    struct capture_parse_pool *pool;
+    int workers, i;
+
+    // Number of parsing threads for mapped capture files
+    if ((workers = setting_get_intvalue(SETTING_CAPTURE_WORKERS)) <= 0)
+        return NULL;
+
+    if (!(pool = sng_malloc(sizeof(struct capture_parse_pool))))
+        return NULL;
+
+    // Slots hold pre-parsed payload copies, too big for sng_malloc
+    if (!(pool->slots = malloc(CAPTURE_PARSE_SLOTS * sizeof(struct capture_parse_slot)))) {
+        sng_free(pool);
+        return NULL;
+    }
+    memset(pool->slots, 0, CAPTURE_PARSE_SLOTS * sizeof(struct capture_parse_slot));
+
+    pool->capinfo = capinfo;
+    pool->nworkers = workers;
+    pool->workers = sng_malloc(workers * sizeof(pthread_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->ready, NULL);
+    pthread_cond_init(&pool->parsed, NULL);
+    pthread_cond_init(&pool->freed, NULL);
+
+    // Storage thread keeps the capture order of parsed packets
+    if (pthread_create(&pool->store_t, NULL, (void *) capture_parse_store_thread, pool)) {
+        sng_free(pool->workers);
+        free(pool->slots);
+        sng_free(pool);
+        return NULL;
+    }
+
+    // Worker threads parse queued packets in parallel
+    for (i = 0; i < workers; i++) {
+        if (pthread_create(&pool->workers[i], NULL, (void *) capture_parse_worker_thread, pool)) {
+            pool->nworkers = i;
+            break;
+        }
+    }
+
+    return pool;
+}
+
+/**
+ * @brief Drain the parsing worker pool and deallocate it
+ */
+static void
+capture_parse_pool_stop(capture_info_t *capinfo)
+{
+    struct capture_parse_pool *pool = capinfo->pool;
+    int i;
+
+    // Let the threads drain the remaining queued packets
+    pthread_mutex_lock(&pool->lock);
+    pool->done = true;
+    pthread_cond_broadcast(&pool->ready);
+    pthread_cond_broadcast(&pool->parsed);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->nworkers; i++)
+        pthread_join(pool->workers[i], NULL);
+    pthread_join(pool->store_t, NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->ready);
+    pthread_cond_destroy(&pool->parsed);
+    pthread_cond_destroy(&pool->freed);
+    sng_free(pool->workers);
+    free(pool->slots);
+    sng_free(pool);
+    capinfo->pool = NULL;
+}
+
+/**
+ * @brief Queue a prepared packet into the parsing worker pool
+ *
+ * Used as callback of capture_mmap_loop in worker mode. Transport
+ * handling and reassembly are stateful, so they run here in capture
+ * order and only the SIP payload parsing is handed to the workers.
+ */
+static void
+distribute_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packet)
+{
+    capture_info_t *capinfo = (capture_info_t *) info;
+    packet_t *pkt;
+
+    if ((pkt = capture_packet_prepare(capinfo, header, packet)))
+        capture_parse_pool_push(capinfo->pool, pkt);
 }
 
 int
@@ -835,16 +1990,61 @@ capture_launch_thread(capture_info_t *capinfo)
     pthread_attr_t attr;
     pthread_attr_init(&attr);
 
-    // Start all captures threads
+    // Write dump file from a dedicated thread, flushing in batches
+    if (capture_cfg.pd) {
+        // Rotated segments are compressed by short lived gzip children
+        if (setting_enabled(SETTING_DUMP_GZIP))
+            signal(SIGCHLD, SIG_IGN);
+        if (!(capture_cfg.dump_ring = capture_ring_create()))
+            return 1;
+        capture_cfg.dumper_running = true;
+        if (pthread_create(&capture_cfg.dumper_t, &attr, (void *) capture_dumper_thread, NULL)) {
+            return 1;
+        }
+    }
+
+    // Count mapped offline sources, read together when more than one
+    int offline = 0;
     vector_iter_t it = vector_iterator(capture_cfg.sources);
+    while ((capinfo = vector_iterator_next(&it))) {
+        if (capinfo->mmap_data)
+            offline++;
+    }
+
+    // Start all captures threads
+    vector_iterator_reset(&it);
     while ((capinfo = vector_iterator_next(&it))) {
         // Mark capture as running
         capinfo->running = true;
+        // Rotated file sets are read by a single merge thread keeping
+        // global timestamp order (@see capture_merge_thread)
+        if (offline > 1 && capinfo->mmap_data
+                && !setting_enabled(SETTING_CAPTURE_PIPELINE)) {
+            capinfo->merged = true;
+            continue;
+        }
+        // In pipeline mode, frames are enqueued by the capture thread
+        // and parsed by a dedicated parser thread
+        if (setting_enabled(SETTING_CAPTURE_PIPELINE)) {
+            if (!(capinfo->ring = capture_ring_create()))
+                return 1;
+            if (pthread_create(&capinfo->parser_t, &attr, (void *) capture_parser_thread, capinfo)) {
+                return 1;
+            }
+        }
         if (pthread_create(&capinfo->capture_t, &attr, (void *) capture_thread, capinfo)) {
             return 1;
         }
     }
 
+    // Launch the merge thread reading all merged sources
+    if (offline > 1 && !setting_enabled(SETTING_CAPTURE_PIPELINE)) {
+        capture_cfg.merge_running = true;
+        if (pthread_create(&capture_cfg.merge_t, &attr, (void *) capture_merge_thread, NULL)) {
+            return 1;
+        }
+    }
+
     pthread_attr_destroy(&attr);
     return 0;
 }
@@ -855,10 +2055,151 @@ capture_thread(void *info)
     capture_info_t *capinfo = (capture_info_t *) info;
 
     // Parse available packets
-    pcap_loop(capinfo->handle, -1, parse_packet, (u_char *) capinfo);
+    if (capinfo->mmap_data) {
+        if (!capinfo->ring && (capinfo->pool = capture_parse_pool_start(capinfo))) {
+            // Mapped offline capture: parse frames with the worker pool
+            capture_mmap_loop(capinfo, distribute_packet);
+            capture_parse_pool_stop(capinfo);
+        } else {
+            // Mapped offline capture: read frames from the mapping in place
+            capture_mmap_loop(capinfo, (capinfo->ring) ? enqueue_packet : parse_packet);
+        }
+    } else if (capinfo->ring) {
+        // Pipeline mode: only enqueue raw frames, never block on parsing
+        pcap_loop(capinfo->handle, -1, enqueue_packet, (u_char *) capinfo);
+    } else {
+        pcap_loop(capinfo->handle, -1, parse_packet, (u_char *) capinfo);
+    }
+
+    // Index the interesting frames for the next load of this file
+    if (capinfo->mmap_data && !capinfo->ring)
+        capture_index_write(capinfo);
+
     capinfo->running = false;
 }
 
+void
+capture_merge_thread(void *none)
+{
+    capture_info_t *capinfo, *next;
+    struct pcap_record_header *record, *candidate;
+    struct pcap_pkthdr header;
+    pcap_handler callback;
+    struct capture_parse_pool *pool = NULL;
+    vector_iter_t it = vector_iterator(capture_cfg.sources);
+    uint32_t usec, next_usec = 0;
+    bool nsec;
+
+    // Start every merged cursor after its file header
+    while ((capinfo = vector_iterator_next(&it))) {
+        if (!capinfo->merged)
+            continue;
+        capinfo->mmap_pos = sizeof(struct pcap_file_header);
+        gettimeofday(&capinfo->load_start, NULL);
+        // Merged frames share one ordered worker pool, owned by the
+        // first merged source (sidecar indexes cannot be replayed in
+        // timestamp order, so they are not used here)
+        if (!pool)
+            pool = capture_parse_pool_start(capinfo);
+        capinfo->pool = pool;
+    }
+    callback = (pool) ? distribute_packet : parse_packet;
+
+    for (;;) {
+        // Pick the source holding the earliest pending frame
+        next = NULL;
+        vector_iterator_reset(&it);
+        while ((capinfo = vector_iterator_next(&it))) {
+            if (!capinfo->merged || !capinfo->running)
+                continue;
+            if (capinfo->mmap_pos + sizeof(struct pcap_record_header) > capinfo->mmap_size)
+                continue;
+            candidate = (struct pcap_record_header *) (capinfo->mmap_data + capinfo->mmap_pos);
+            // Ignore truncated last record
+            if (candidate->caplen > capinfo->mmap_size - capinfo->mmap_pos
+                    - sizeof(struct pcap_record_header)) {
+                capinfo->mmap_pos = capinfo->mmap_size;
+                continue;
+            }
+            nsec = ((struct pcap_file_header *) capinfo->mmap_data)->magic == CAPTURE_PCAP_MAGIC_NSEC;
+            usec = (nsec) ? candidate->ts_usec / 1000 : candidate->ts_usec;
+            if (!next || candidate->ts_sec < record->ts_sec
+                    || (candidate->ts_sec == record->ts_sec && usec < next_usec)) {
+                next = capinfo;
+                record = candidate;
+                next_usec = usec;
+            }
+        }
+
+        // All merged sources have been read
+        if (!next)
+            break;
+
+        // Fill the frame header as libpcap would have done
+        header.ts.tv_sec = record->ts_sec;
+        header.ts.tv_usec = next_usec;
+        header.caplen = record->caplen;
+        header.len = record->len;
+        next->mmap_pos += sizeof(struct pcap_record_header);
+
+        // Apply the capture BPF filter (pcap_loop does it internally),
+        // skipping all link-layer decoding for rejected frames
+        if (capture_cfg.filter
+                && pcap_offline_filter(&capture_cfg.fp, &header, next->mmap_data + next->mmap_pos) == 0) {
+            next->mmap_skipped++;
+        } else {
+            callback((u_char *) next, &header, next->mmap_data + next->mmap_pos);
+        }
+
+        // Update read position for progress reporting
+        next->mmap_pos += record->caplen;
+    }
+
+    // Wait for the shared pool to store every queued packet
+    if (pool) {
+        vector_iterator_reset(&it);
+        while ((capinfo = vector_iterator_next(&it)))
+            if (capinfo->merged && capinfo->pool == pool && capinfo != pool->capinfo)
+                capinfo->pool = NULL;
+        capture_parse_pool_stop(pool->capinfo);
+    }
+
+    // Index the interesting frames for the next load of each file
+    vector_iterator_reset(&it);
+    while ((capinfo = vector_iterator_next(&it))) {
+        if (!capinfo->merged)
+            continue;
+        capinfo->mmap_eof = (capinfo->mmap_pos + sizeof(struct pcap_record_header) > capinfo->mmap_size);
+        capture_index_write(capinfo);
+        capinfo->running = false;
+    }
+}
+
+void
+capture_parser_thread(void *info)
+{
+    capture_info_t *capinfo = (capture_info_t *) info;
+    capture_frame_t *frame;
+
+    for (;;) {
+        if ((frame = capture_ring_read(capinfo->ring))) {
+            // Parse the frame as the pcap callback would have done
+            parse_packet((u_char *) capinfo, &frame->header, frame->data);
+            capture_ring_commit(capinfo->ring);
+        } else if (!capinfo->running) {
+            // Capture has ended and all frames have been parsed
+            break;
+        } else {
+            // Wait for the capture thread to publish more frames
+            usleep(50);
+        }
+    }
+
+    // Index the interesting frames for the next load of this file
+    if (capinfo->mmap_data)
+        capture_index_write(capinfo);
+}
+
 int
 capture_is_online()
 {
@@ -884,7 +2225,7 @@ capture_is_running()
 }
 
 int
-capture_set_bpf_filter(const char *filter)
+capture_apply_bpf_filter(const char *filter)
 {
     vector_iter_t it = vector_iterator(capture_cfg.sources);
     capture_info_t *capinfo;
@@ -901,6 +2242,16 @@ capture_set_bpf_filter(const char *filter)
 
     }
 
+    return 0;
+}
+
+int
+capture_set_bpf_filter(const char *filter)
+{
+    // Check the filter compiles and set it in all sources
+    if (capture_apply_bpf_filter(filter) != 0)
+        return 1;
+
     // Store valid capture filter
     capture_cfg.filter = filter;
 
@@ -979,6 +2330,41 @@ capture_status_desc()
     }
 }
 
+int
+capture_progress(int *eta, uint64_t *skipped)
+{
+    capture_info_t *capinfo;
+    size_t loaded = 0, total = 0;
+    struct timeval now, start = { 0 };
+    int elapsed;
+
+    // Aggregate progress of all mapped files still being loaded
+    *skipped = 0;
+    vector_iter_t it = vector_iterator(capture_cfg.sources);
+    while ((capinfo = vector_iterator_next(&it))) {
+        if (!capinfo->mmap_data || !capinfo->running)
+            continue;
+        loaded += capinfo->mmap_pos;
+        total += capinfo->mmap_size;
+        *skipped += capinfo->mmap_skipped;
+        if (!start.tv_sec)
+            start = capinfo->load_start;
+    }
+
+    // No mapped capture file is being loaded
+    if (total == 0)
+        return -1;
+
+    // Estimate remaining seconds from the load rate so far
+    *eta = -1;
+    gettimeofday(&now, NULL);
+    elapsed = now.tv_sec - start.tv_sec;
+    if (elapsed > 0 && loaded > 0)
+        *eta = (int) ((total - loaded) * elapsed / loaded);
+
+    return (int) (loaded * 100 / total);
+}
+
 const char*
 capture_input_file()
 {
@@ -1034,6 +2420,28 @@ capture_sources_count()
     return vector_count(capture_cfg.sources);
 }
 
+void
+capture_kernel_stats(uint64_t *recv, uint64_t *drop)
+{
+    capture_info_t *capinfo;
+    struct pcap_stat ps;
+
+    *recv = 0;
+    *drop = 0;
+
+    vector_iter_t it = vector_iterator(capture_cfg.sources);
+    while ((capinfo = vector_iterator_next(&it))) {
+        // Kernel counters are only available on live captures
+        if (!capinfo->infile && pcap_stats(capinfo->handle, &ps) == 0) {
+            *recv += ps.ps_recv;
+            *drop += ps.ps_drop + ps.ps_ifdrop;
+        }
+        // Account frames dropped because the queue was full
+        if (capinfo->ring)
+            *drop += capture_ring_dropped(capinfo->ring);
+    }
+}
+
 char *
 capture_last_error()
 {
@@ -1153,7 +2561,148 @@ dump_packet(pcap_dumper_t *pd, const packet_t *packet)
     while ((frame = vector_iterator_next(&it))) {
         pcap_dump((u_char*) pd, frame->header, frame->data);
     }
-    pcap_dump_flush(pd);
+}
+
+void
+capture_dump_packet(packet_t *packet)
+{
+    frame_t *frame;
+
+    // No dump file requested
+    if (!capture_cfg.pd)
+        return;
+
+    // Without a writer thread, write the packet inline
+    if (!capture_cfg.dump_ring) {
+        dump_packet(capture_cfg.pd, packet);
+        return;
+    }
+
+    // Queue packet frames for the writer thread. Frames that don't fit
+    // because the disk can't keep up are counted as dropped by the ring
+    int online = capture_is_online();
+    vector_iter_t it = vector_iterator(packet->frames);
+    while ((frame = vector_iterator_next(&it))) {
+        // When reading from a file there is no kernel buffer to starve,
+        // so wait for queue space instead of dropping frames
+        while (!online && capture_ring_full(capture_cfg.dump_ring))
+            usleep(100);
+        capture_ring_push(capture_cfg.dump_ring, frame->header, frame->data);
+    }
+}
+
+/**
+ * @brief Check if the current dump segment must be rotated
+ *
+ * @return true when the segment exceeds the configured size or age
+ */
+static bool
+capture_dump_rotate_check()
+{
+    int size = setting_get_intvalue(SETTING_DUMP_ROTATESIZE);
+    int age = setting_get_intvalue(SETTING_DUMP_ROTATEAGE);
+
+    if (!capture_cfg.pd || !capture_cfg.dumpfile)
+        return false;
+
+    if (size > 0 && capture_cfg.dump_bytes >= (uint64_t) size * 1024 * 1024)
+        return true;
+
+    if (age > 0 && time(NULL) - capture_cfg.dump_opened >= age)
+        return true;
+
+    return false;
+}
+
+/**
+ * @brief Close the current dump segment and open a fresh one
+ *
+ * The closed segment is renamed to <dumpfile>.<n>, optionally handed
+ * to a gzip child, and segments beyond the retention limit are
+ * deleted. Runs on the writer thread, so the capture callback keeps
+ * queueing frames into the ring while files are swapped.
+ */
+static void
+capture_dump_rotate()
+{
+    char segment[1024];
+    int keep = setting_get_intvalue(SETTING_DUMP_KEEP);
+
+    // Close and rename the current segment
+    pcap_dump_close(capture_cfg.pd);
+    capture_cfg.pd = NULL;
+    sprintf(segment, "%s.%d", capture_cfg.dumpfile, ++capture_cfg.dump_rotated);
+    if (rename(capture_cfg.dumpfile, segment) == 0
+            && setting_enabled(SETTING_DUMP_GZIP)) {
+        // Compress the closed segment in the background
+        // (SIGCHLD is ignored, so the child won't linger as a zombie)
+        if (fork() == 0) {
+            execlp("gzip", "gzip", "-f", segment, (char *) NULL);
+            _exit(1);
+        }
+    }
+
+    // Drop segments beyond the retention limit
+    if (keep > 0 && capture_cfg.dump_rotated > keep) {
+        sprintf(segment, "%s.%d", capture_cfg.dumpfile, capture_cfg.dump_rotated - keep);
+        if (unlink(segment) == -1) {
+            // The segment may have been compressed already
+            strcat(segment, ".gz");
+            unlink(segment);
+        }
+    }
+
+    // Start the next segment
+    capture_cfg.pd = dump_open(capture_cfg.dumpfile);
+    capture_cfg.dump_opened = time(NULL);
+    capture_cfg.dump_bytes = 0;
+}
+
+void
+capture_dumper_thread(void *none)
+{
+    capture_frame_t *frame;
+    int batched = 0;
+
+    for (;;) {
+        if ((frame = capture_ring_read(capture_cfg.dump_ring))) {
+            if (capture_cfg.pd) {
+                pcap_dump((u_char *) capture_cfg.pd, &frame->header, frame->data);
+                // Account the frame and its record header for rotation
+                capture_cfg.dump_bytes += frame->header.caplen + 16;
+            }
+            capture_ring_commit(capture_cfg.dump_ring);
+            // Flush to disk once enough frames have been batched
+            if (++batched == CAPTURE_DUMP_BATCH) {
+                if (capture_cfg.pd)
+                    pcap_dump_flush(capture_cfg.pd);
+                batched = 0;
+                if (capture_dump_rotate_check())
+                    capture_dump_rotate();
+            }
+        } else if (!capture_cfg.dumper_running) {
+            // Capture has ended and all queued frames have been written
+            break;
+        } else {
+            // Queue drained: push batched frames to disk and wait
+            if (batched) {
+                if (capture_cfg.pd)
+                    pcap_dump_flush(capture_cfg.pd);
+                batched = 0;
+            }
+            if (capture_dump_rotate_check())
+                capture_dump_rotate();
+            usleep(500);
+        }
+    }
+}
+
+uint64_t
+capture_dump_dropped()
+{
+    if (!capture_cfg.dump_ring)
+        return 0;
+    return capture_cfg.dump_ring->dropped;
 }
 
 void
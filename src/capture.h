@@ -37,6 +37,7 @@
 #include <pcap.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
 #include "address.h"
 
@@ -81,12 +82,51 @@
 #include <stdbool.h>
 #include "packet.h"
 #include "vector.h"
+#include "hash.h"
 
 //! Max allowed packet assembled size
 #define MAX_CAPTURE_LEN 20480
 //! Max allowed packet length
 #define MAXIMUM_SNAPLEN 262144
 
+//! Buckets of the TCP reassembly streams hash table
+#define CAPTURE_TCP_REASM_BUCKETS 1024
+//! Number of dumped frames between output file flushes
+#define CAPTURE_DUMP_BATCH 512
+//! Max length of a TCP reassembly stream key (two address:port tuples)
+#define CAPTURE_TCP_REASM_KEYLEN (ADDRESSLEN * 2 + 16)
+
+//! Buckets of the IP fragment reassembly hash table
+#define CAPTURE_IP_REASM_BUCKETS 256
+//! Max length of an IP reassembly key (two addresses and the IP id)
+#define CAPTURE_IP_REASM_KEYLEN (ADDRESSLEN * 2 + 16)
+//! Max datagrams pending IP reassembly before the oldest is evicted
+#define CAPTURE_IP_REASM_MAX 128
+//! Seconds a datagram may wait for its missing fragments
+#define CAPTURE_IP_REASM_TIMEOUT 30
+
+//! Slots of the ordered parsing queue in offline worker mode
+#define CAPTURE_PARSE_SLOTS 256
+//! Max queued packets claimed by a parsing worker at once
+#define CAPTURE_PARSE_BATCH 8
+
+//! Capture file magic in microseconds resolution (native byte order)
+#define CAPTURE_PCAP_MAGIC_USEC 0xa1b2c3d4
+//! Capture file magic in nanoseconds resolution (native byte order)
+#define CAPTURE_PCAP_MAGIC_NSEC 0xa1b23c4d
+
+//! Frame record header of a capture file (@see capture_mmap_loop)
+struct pcap_record_header {
+    //! Timestamp seconds
+    uint32_t ts_sec;
+    //! Timestamp microseconds (or nanoseconds with nanosecond magic)
+    uint32_t ts_usec;
+    //! Number of octets stored in the file
+    uint32_t caplen;
+    //! Original frame length
+    uint32_t len;
+};
+
 //! Define VLAN 802.1Q Ethernet type
 #ifndef ETHERTYPE_8021Q
 #define ETHERTYPE_8021Q 0x8100
@@ -119,6 +159,10 @@ enum capture_storage {
 typedef struct capture_config capture_config_t;
 //; Shorter declaration of capture_info structure
 typedef struct capture_info capture_info_t;
+//! Forward declaration of pre-parsed SIP information (@see sip.h)
+struct sip_parsed;
+//! Forward declaration of SIP message structure (@see sip_msg.h)
+struct sip_msg;
 
 /**
  * @brief Capture common configuration
@@ -146,8 +190,30 @@ struct capture_config {
     struct bpf_program fp;
     //! libpcap dump file handler
     pcap_dumper_t *pd;
+    //! Path of the dump file, kept for rotation
+    const char *dumpfile;
+    //! Time the current dump segment was opened
+    time_t dump_opened;
+    //! Bytes written to the current dump segment
+    uint64_t dump_bytes;
+    //! Segments closed by dump rotation so far
+    int dump_rotated;
+    //! Queue of frames pending to be written to the dump file
+    struct capture_ring *dump_ring;
+    //! Dump file writer thread
+    pthread_t dumper_t;
+    //! Flag to determine if the writer thread is running
+    bool dumper_running;
+    //! Thread merging several mapped files in timestamp order
+    pthread_t merge_t;
+    //! Flag to determine if the merge thread is running
+    bool merge_running;
     //! Capture sources
     vector_t *sources;
+    //! Callback to notify the UI that stored data has changed
+    void (*change_cb)(void);
+    //! Callback invoked for every stored SIP message (@see pipe.h)
+    void (*msg_cb)(struct sip_msg *);
     //! Capture Lock. Avoid parsing and handling data at the same time
     pthread_mutex_t lock;
 };
@@ -173,14 +239,38 @@ struct capture_info
     bpf_u_int32 net;
     //! Input file in Offline capture
     const char *infile;
+    //! Memory mapped contents of the input file (NULL when not mapped)
+    u_char *mmap_data;
+    //! Memory mapped contents size
+    size_t mmap_size;
+    //! Read position in the mapped file, for progress reporting
+    size_t mmap_pos;
+    //! The mapped file was sequentially read to its last record
+    bool mmap_eof;
+    //! The mapped file is read by the timestamp merge thread
+    bool merged;
+    //! Frames rejected by the BPF pre-filter, skipping all decoding
+    uint64_t mmap_skipped;
+    //! Time the mapped file reading started, for ETA estimation
+    struct timeval load_start;
+    //! Worker pool parsing the mapped file (@see capture_parse_pool_start)
+    struct capture_parse_pool *pool;
     //! Capture device in Online mode
     const char *device;
-    //! Packets pending IP reassembly
+    //! Datagrams pending IP reassembly, in arrival order
     vector_t *ip_reasm;
-    //! Packets pending TCP reassembly
-    vector_t *tcp_reasm;
+    //! Datagrams pending IP reassembly, indexed by address and IP id
+    htable_t *ip_reasm_idx;
+    //! Scratch buffer for assembled IP fragments (@see capture_packet_reasm_ip)
+    u_char *reasm_buf;
+    //! Streams pending TCP reassembly, indexed by address tuple
+    htable_t *tcp_reasm;
     //! Capture thread for online capturing
     pthread_t capture_t;
+    //! Captured frames queue in pipeline mode (@see capture_ring.h)
+    struct capture_ring *ring;
+    //! Parser thread draining the frames queue in pipeline mode
+    pthread_t parser_t;
 };
 
 /**
@@ -234,6 +324,38 @@ capture_offline(const char *infile, const char *outfile);
 void
 parse_packet(u_char *capinfo, const struct pcap_pkthdr *header, const u_char *packet);
 
+/**
+ * @brief Map the offline capture file into memory
+ *
+ * Only regular files in native byte order libpcap format are mapped;
+ * anything else (stdin, pcapng, byte swapped files) keeps being read
+ * through pcap_loop. When the file is mapped, frames are parsed in
+ * place and their contents point into the mapping, so the file bytes
+ * are never copied (@see packet_add_frame_mapped).
+ */
+void
+capture_mmap_file(capture_info_t *capinfo);
+
+/**
+ * @brief Read frames from a memory mapped capture file
+ *
+ * Replacement of pcap_loop for mapped offline captures. Walks the file
+ * records invoking the given callback with the frame contents still in
+ * the mapping.
+ */
+void
+capture_mmap_loop(capture_info_t *capinfo, pcap_handler callback);
+
+/**
+ * @brief Enqueue a captured frame in pipeline mode
+ *
+ * Used as pcap callback when capture.pipeline setting is enabled. It
+ * only copies the raw frame into the source frames queue, all the
+ * parsing work is done by the parser thread (@see capture_parser_thread)
+ */
+void
+enqueue_packet(u_char *capinfo, const struct pcap_pkthdr *header, const u_char *packet);
+
 /**
  * @brief Reassembly capture IP fragments
  *
@@ -253,7 +375,8 @@ parse_packet(u_char *capinfo, const struct pcap_pkthdr *header, const u_char *pa
  *
  * @param capinfo Packet capture session information
  * @para header Header received from libpcap callback
- * @para packet Packet contents received from libpcap callback
+ * @para packet Packet contents received from libpcap callback, repointed
+ *  to the reassembly scratch buffer when fragments are assembled
  * @param size Packet size (not including Layer and Network headers)
  * @param caplen Full packet size (current fragment -> whole assembled packet)
  * @return a Packet structure when packet is not fragmented or fully reassembled
@@ -261,7 +384,7 @@ parse_packet(u_char *capinfo, const struct pcap_pkthdr *header, const u_char *pa
  */
 packet_t *
 capture_packet_reasm_ip(capture_info_t *capinfo, const struct pcap_pkthdr *header,
-                        u_char *packet, uint32_t *size, uint32_t *caplen);
+                        u_char **packet, uint32_t *size, uint32_t *caplen);
 
 /**
  * @brief Reassembly capture TCP segments
@@ -306,6 +429,44 @@ capture_ws_check_packet(packet_t *packet);
 int
 capture_packet_parse(packet_t *pkt);
 
+/**
+ * @brief Store an already pre-parsed packet
+ *
+ * Storage phase of capture_packet_parse for callers that have run
+ * sip_parse_packet outside the capture lock. Must be called with the
+ * capture lock held.
+ *
+ * @param pkt Packet structure pointer
+ * @param parsed Pre-parsed information from sip_parse_packet
+ * @return 0 in case this packets has SIP/RTP data
+ * @return 1 otherwise
+ */
+int
+capture_packet_store(packet_t *pkt, struct sip_parsed *parsed);
+
+/**
+ * @brief Handle transport and reassembly of a captured frame
+ *
+ * First phase of parse_packet: runs link, IP and TCP handling and
+ * returns a packet ready for SIP parsing. Reassembly is stateful, so
+ * this must always be called in capture order.
+ *
+ * @return a Packet structure ready for SIP parsing
+ * @return NULL when the packet is not handled or pending reassembly
+ */
+packet_t *
+capture_packet_prepare(capture_info_t *capinfo, const struct pcap_pkthdr *header, const u_char *packet);
+
+/**
+ * @brief Store a prepared and pre-parsed packet under the capture lock
+ *
+ * Final phase of parse_packet: takes the capture lock, stores the
+ * packet and runs the EEP forwarding and dump file side effects, or
+ * destroys the packet when it is not interesting.
+ */
+void
+capture_packet_commit(packet_t *pkt, struct sip_parsed *parsed);
+
 /**
  * @brief Create a capture thread for online mode
  *
@@ -323,6 +484,28 @@ capture_launch_thread();
 void
 capture_thread(void *none);
 
+/**
+ * @brief Frame parser thread for pipeline mode
+ *
+ * Drains the frames queue filled by the capture thread, parsing each
+ * frame as the pcap callback would have done inline. Exits when the
+ * capture thread has ended and the queue is empty.
+ */
+void
+capture_parser_thread(void *none);
+
+/**
+ * @brief Read all merged mapped capture files in timestamp order
+ *
+ * Rotated capture file sets are loaded as a single stream: on every
+ * step the source holding the earliest pending frame is advanced, so
+ * dialogs spanning rotation boundaries are rebuilt with their messages
+ * in order. The merged stream feeds one shared parsing worker pool,
+ * which stores packets in queue order (@see capture_parse_store_thread).
+ */
+void
+capture_merge_thread(void *none);
+
 /**
  * @brief Check if capture is in Online mode
  *
@@ -339,6 +522,19 @@ capture_is_online();
 int
 capture_is_running();
 
+/**
+ * @brief Compile and set a bpf filter in open capture sources
+ *
+ * Unlike capture_set_bpf_filter, the given text is not stored as the
+ * configured filter, so it can be used for transient filters derived
+ * from display filters (@see filter_bpf_pushdown).
+ *
+ * @param filter String containing the BPF filter text
+ * @return 0 if valid, 1 otherwise
+ */
+int
+capture_apply_bpf_filter(const char *filter);
+
 /**
  * @brief Set a bpf filter in open capture
  *
@@ -384,6 +580,36 @@ capture_status();
 const char *
 capture_status_desc();
 
+/**
+ * @brief Set the callback invoked when stored data changes
+ *
+ * The callback is run under the capture lock every time a packet is
+ * stored, so the UI can wake up and redraw instead of polling on a
+ * timer (@see ui_wait_for_input).
+ */
+void
+capture_set_change_callback(void (*cb)(void));
+
+/**
+ * @brief Set the callback invoked for every stored SIP message
+ *
+ * The callback is run under the capture lock right after the message
+ * has been stored, so exporters can stream messages as they arrive.
+ */
+void
+capture_set_msg_callback(void (*cb)(struct sip_msg *));
+
+/**
+ * @brief Get progress of mapped offline captures being loaded
+ *
+ * @param eta Output estimated remaining seconds (-1 when unknown)
+ * @param skipped Output frames rejected by the BPF pre-filter
+ * @return loaded percentage (0-100)
+ * @return -1 when no mapped capture file is being loaded
+ */
+int
+capture_progress(int *eta, uint64_t *skipped);
+
 /**
  * @brief Get Input file from Offline mode
  *
@@ -432,6 +658,20 @@ capture_tls_server();
 int
 capture_sources_count();
 
+/**
+ * @brief Get kernel level capture counters
+ *
+ * Polls pcap_stats of every live capture source and accumulates
+ * the received and dropped packet counters. Frames dropped because
+ * the pipeline frames queue was full are added to the drop counter.
+ * Offline sources have no kernel counters and are skipped.
+ *
+ * @param recv Output packets seen by the kernel capture filters
+ * @param drop Output packets dropped before reaching the parser
+ */
+void
+capture_kernel_stats(uint64_t *recv, uint64_t *drop);
+
 /**
  * @brief Return the last capture error
  */
@@ -478,11 +718,42 @@ dump_open(const char *dumpfile);
 /**
  * @brief Store a packet in dump file
  *
- * File must be previously opened with dump_open
+ * File must be previously opened with dump_open. Data is buffered;
+ * it reaches the disk when the file is closed or explicitly flushed.
  */
 void
 dump_packet(pcap_dumper_t *pd, const packet_t *packet);
 
+/**
+ * @brief Queue a captured packet for the dump file writer thread
+ *
+ * Frames are copied into the dump queue so the capture thread never
+ * blocks on disk writes. If no writer thread is running the packet is
+ * written inline. Frames that don't fit in the queue are dropped and
+ * counted (@see capture_dump_dropped)
+ */
+void
+capture_dump_packet(packet_t *packet);
+
+/**
+ * @brief Dump file writer thread
+ *
+ * Drains the queue of frames pending to be stored in the output file,
+ * flushing to disk every CAPTURE_DUMP_BATCH frames or when the queue
+ * runs empty. Exits when the capture has ended and the queue has been
+ * fully written.
+ */
+void
+capture_dumper_thread(void *none);
+
+/**
+ * @brief Get how many frames could not be queued to the dump file
+ *
+ * @return number of frames dropped because the writer couldn't keep up
+ */
+uint64_t
+capture_dump_dropped();
+
 /**
  * @brief Close a dump file
  */
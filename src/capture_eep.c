@@ -41,6 +41,7 @@
  */
 #include "config.h"
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
@@ -52,13 +53,48 @@
 
 capture_eep_config_t eep_cfg = { 0 };
 
+//! Kind of socket registered in the server event loop
+enum eep_sock_type {
+    //! Bound datagram socket receiving HEP datagrams
+    EEP_SOCK_UDP = 0,
+    //! Stream socket accepting TCP HEP connections
+    EEP_SOCK_TCP_LISTEN,
+    //! Accepted TCP HEP connection
+    EEP_SOCK_TCP_CONN,
+};
+
+/**
+ * @brief Server event loop socket state
+ *
+ * One of these is registered in the epoll descriptor for every listen
+ * socket and accepted connection. The framing buffer is only used for
+ * TCP connections, where HEP3 frames may arrive split or coalesced.
+ */
+struct eep_conn {
+    //! Socket descriptor
+    int sock;
+    //! Socket kind (@see eep_sock_type)
+    int type;
+    //! Bytes accumulated of the current frame
+    uint32_t have;
+    //! Frame reassembly buffer
+    u_char buffer[MAX_CAPTURE_LEN];
+};
+
 void *
 accept_eep_client(void *data);
 
+void *
+capture_eep_client(void *data);
+
+static int
+capture_eep_poll_add(int sock, int type);
+
 int
 capture_eep_init()
 {
-    struct addrinfo *ai, hints[1] = { { 0 } };
+    struct addrinfo *ai, *addr, hints[1] = { { 0 } };
+    int sock, reuse = 1;
 
     // Setting for EEP client
     if (setting_enabled(SETTING_EEP_SEND)) {
@@ -92,6 +128,23 @@ capture_eep_init()
                 return 1;
             }
         }
+
+        // Keep the collector address to reconnect after send failures
+        memcpy(&eep_cfg.client_addr, ai->ai_addr, ai->ai_addrlen);
+        eep_cfg.client_addrlen = (socklen_t) ai->ai_addrlen;
+
+        // Send queue drained by the client thread
+        // Too big for sng_malloc, so allocate it directly
+        if (!(eep_cfg.client_queue = malloc(CAPTURE_EEP_QUEUE * MAX_CAPTURE_LEN))) {
+            fprintf(stderr, "Error allocating EEP send queue\n");
+            return 1;
+        }
+
+        // Create a new thread to send the queued datagrams
+        if (pthread_create(&eep_cfg.client_thread, NULL, capture_eep_client, NULL) != 0) {
+            fprintf(stderr, "Error creating sender thread: %s\n", strerror(errno));
+            return 1;
+        }
     }
 
     if (setting_enabled(SETTING_EEP_LISTEN)) {
@@ -101,7 +154,7 @@ capture_eep_init()
         eep_cfg.capt_srv_port = setting_get_value(SETTING_EEP_LISTEN_PORT);
         eep_cfg.capt_srv_password = setting_get_value(SETTING_EEP_LISTEN_PASS);
 
-        hints->ai_flags = AI_NUMERICSERV;
+        hints->ai_flags = AI_NUMERICSERV | AI_PASSIVE;
         hints->ai_family = AF_UNSPEC;
         hints->ai_socktype = SOCK_DGRAM;
         hints->ai_protocol = IPPROTO_UDP;
@@ -112,20 +165,49 @@ capture_eep_init()
             return 1;
         }
 
-        // Create a socket for a new TCP IPv4 connection
-        eep_cfg.server_sock = socket(AF_INET, SOCK_DGRAM, 0);
-        if (eep_cfg.client_sock < 0) {
-            fprintf(stderr, "Error creating server socket: %s\n", strerror(errno));
+        // Epoll descriptor serving every listen socket and connection
+        if ((eep_cfg.server_epoll = epoll_create1(0)) < 0) {
+            fprintf(stderr, "Error creating server epoll: %s\n", strerror(errno));
             return 1;
         }
 
-        // Bind that socket to the requested address and port
-        if (bind(eep_cfg.server_sock, ai->ai_addr, ai->ai_addrlen) == -1) {
+        // Bind a datagram socket on every address resolved for the
+        // listen host, so all its address families are served at once
+        for (addr = ai; addr && eep_cfg.server_sock_count < CAPTURE_EEP_SOCKETS; addr = addr->ai_next) {
+            if ((sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) < 0)
+                continue;
+
+            if (bind(sock, addr->ai_addr, addr->ai_addrlen) == -1
+                    || capture_eep_poll_add(sock, EEP_SOCK_UDP) != 0) {
+                close(sock);
+                continue;
+            }
+
+            eep_cfg.server_socks[eep_cfg.server_sock_count++] = sock;
+        }
+
+        if (!eep_cfg.server_sock_count) {
             fprintf(stderr, "Error binding address: %s\n", strerror(errno));
             return 1;
         }
 
-        // Create a new thread for accepting client connections
+        // Stream socket for lossless TCP HEP delivery on the same port
+        hints->ai_socktype = SOCK_STREAM;
+        hints->ai_protocol = IPPROTO_TCP;
+        eep_cfg.server_tcp_sock = -1;
+        if (getaddrinfo(eep_cfg.capt_srv_host, eep_cfg.capt_srv_port, hints, &ai) == 0
+                && (eep_cfg.server_tcp_sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) >= 0) {
+            setsockopt(eep_cfg.server_tcp_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (bind(eep_cfg.server_tcp_sock, ai->ai_addr, ai->ai_addrlen) == -1
+                    || listen(eep_cfg.server_tcp_sock, CAPTURE_EEP_BACKLOG) == -1
+                    || capture_eep_poll_add(eep_cfg.server_tcp_sock, EEP_SOCK_TCP_LISTEN) != 0) {
+                fprintf(stderr, "Error listening on TCP address: %s\n", strerror(errno));
+                close(eep_cfg.server_tcp_sock);
+                eep_cfg.server_tcp_sock = -1;
+            }
+        }
+
+        // Create a new thread for the server event loop
         if (pthread_create(&eep_cfg.server_thread, NULL, accept_eep_client, NULL) != 0) {
             fprintf(stderr, "Error creating accept thread: %s\n", strerror(errno));
             return 1;
@@ -138,21 +220,192 @@ capture_eep_init()
 }
 
 
-void *
-accept_eep_client(void *data)
+/**
+ * @brief Register a socket in the server event loop
+ *
+ * @param sock Socket descriptor to be polled for input
+ * @param type Socket kind (@see eep_sock_type)
+ * @return 0 if the socket has been registered, 1 otherwise
+ */
+static int
+capture_eep_poll_add(int sock, int type)
+{
+    struct eep_conn *conn;
+    struct epoll_event event;
+
+    if (!(conn = sng_malloc(sizeof(struct eep_conn))))
+        return 1;
+    conn->sock = sock;
+    conn->type = type;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = conn;
+    if (epoll_ctl(eep_cfg.server_epoll, EPOLL_CTL_ADD, sock, &event) == -1) {
+        sng_free(conn);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Remove a connection from the event loop and release it
+ */
+static void
+capture_eep_close_conn(struct eep_conn *conn)
+{
+    epoll_ctl(eep_cfg.server_epoll, EPOLL_CTL_DEL, conn->sock, NULL);
+    close(conn->sock);
+    sng_free(conn);
+}
+
+/**
+ * @brief Read pending datagrams from a readable listen socket
+ */
+static void
+capture_eep_receive_udp(int sock)
 {
     packet_t *pkt;
+#ifdef HAVE_RECVMMSG
+    static struct mmsghdr msgs[CAPTURE_EEP_BATCH];
+    static struct iovec iovecs[CAPTURE_EEP_BATCH];
+    static u_char *buffers;
+    int count, i;
+
+    // Preallocated datagram buffers, reused for every batch
+    // Too big for sng_malloc, so allocate them directly
+    if (!buffers) {
+        if (!(buffers = malloc(CAPTURE_EEP_BATCH * MAX_CAPTURE_LEN)))
+            return;
+
+        for (i = 0; i < CAPTURE_EEP_BATCH; i++) {
+            iovecs[i].iov_base = buffers + i * MAX_CAPTURE_LEN;
+            iovecs[i].iov_len = MAX_CAPTURE_LEN;
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
 
-    // Begin accepting connections
-    while (eep_cfg.server_sock > 0) {
-        if ((pkt = capture_eep_receive())) {
-            // Avoid parsing from multiples sources.
-            // Avoid parsing while screen in being redrawn
-            capture_lock();
+    // Read as many queued datagrams as possible in a single syscall
+    count = recvmmsg(sock, msgs, CAPTURE_EEP_BATCH, MSG_DONTWAIT, NULL);
+    if (count <= 0)
+        return;
+
+    // Avoid parsing from multiples sources.
+    // Avoid parsing while screen in being redrawn
+    capture_lock();
+    for (i = 0; i < count; i++) {
+        if ((pkt = capture_eep_receive(buffers + i * MAX_CAPTURE_LEN, msgs[i].msg_len))) {
             if (capture_packet_parse(pkt) != 0) {
                 packet_destroy(pkt);
             }
-            capture_unlock();
+        }
+    }
+    capture_unlock();
+#else
+    u_char buffer[MAX_CAPTURE_LEN];
+    ssize_t received;
+
+    if ((received = recv(sock, buffer, MAX_CAPTURE_LEN, MSG_DONTWAIT)) <= 0)
+        return;
+
+    if ((pkt = capture_eep_receive(buffer, received))) {
+        // Avoid parsing from multiples sources.
+        // Avoid parsing while screen in being redrawn
+        capture_lock();
+        if (capture_packet_parse(pkt) != 0) {
+            packet_destroy(pkt);
+        }
+        capture_unlock();
+    }
+#endif
+}
+
+/**
+ * @brief Read from a TCP HEP connection, parsing every complete frame
+ *
+ * The stream is framed by the HEP3 header itself: each frame starts
+ * with the HEP3 magic followed by its total length, so frames split or
+ * coalesced by TCP are reassembled in the connection buffer. A stream
+ * that loses framing is dropped, the sender will reconnect.
+ */
+static void
+capture_eep_receive_conn(struct eep_conn *conn)
+{
+    packet_t *pkt;
+    ssize_t received;
+    uint16_t framelen;
+
+    received = recv(conn->sock, conn->buffer + conn->have,
+                    sizeof(conn->buffer) - conn->have, MSG_DONTWAIT);
+    if (received <= 0) {
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        // Peer closed the connection or receive failed
+        capture_eep_close_conn(conn);
+        return;
+    }
+    conn->have += received;
+
+    // Extract every complete frame from the stream
+    while (conn->have >= 6) {
+        // Total frame length follows the HEP3 magic
+        memcpy(&framelen, conn->buffer + 4, sizeof(framelen));
+        framelen = ntohs(framelen);
+        if (memcmp(conn->buffer, "HEP3", 4) != 0
+                || framelen < 6 || framelen > sizeof(conn->buffer)) {
+            capture_eep_close_conn(conn);
+            return;
+        }
+
+        // Wait for the rest of the frame
+        if (conn->have < framelen)
+            break;
+
+        // Avoid parsing from multiples sources.
+        // Avoid parsing while screen in being redrawn
+        capture_lock();
+        if ((pkt = capture_eep_receive_v3(conn->buffer, framelen))) {
+            if (capture_packet_parse(pkt) != 0) {
+                packet_destroy(pkt);
+            }
+        }
+        capture_unlock();
+
+        // Shift the remaining bytes of the next frame
+        conn->have -= framelen;
+        memmove(conn->buffer, conn->buffer + framelen, conn->have);
+    }
+}
+
+void *
+accept_eep_client(void *data)
+{
+    struct epoll_event events[CAPTURE_EEP_BATCH];
+    struct eep_conn *conn;
+    int nevents, i, sock;
+
+    // Serve every listen socket and connection from a single loop
+    while (eep_cfg.server_epoll > 0) {
+        nevents = epoll_wait(eep_cfg.server_epoll, events, CAPTURE_EEP_BATCH, 500);
+        for (i = 0; i < nevents; i++) {
+            conn = events[i].data.ptr;
+            switch (conn->type) {
+                case EEP_SOCK_UDP:
+                    capture_eep_receive_udp(conn->sock);
+                    break;
+                case EEP_SOCK_TCP_LISTEN:
+                    // Register the new connection in the event loop
+                    if ((sock = accept(conn->sock, NULL, NULL)) >= 0) {
+                        if (capture_eep_poll_add(sock, EEP_SOCK_TCP_CONN) != 0)
+                            close(sock);
+                    }
+                    break;
+                case EEP_SOCK_TCP_CONN:
+                    capture_eep_receive_conn(conn);
+                    break;
+            }
         }
     }
 
@@ -164,12 +417,23 @@ accept_eep_client(void *data)
 void
 capture_eep_deinit()
 {
+    int i;
+
     if (eep_cfg.client_sock)
         close(eep_cfg.client_sock);
 
-    if (eep_cfg.server_sock) {
-        close(eep_cfg.server_sock);
-        eep_cfg.server_sock = -1;
+    for (i = 0; i < eep_cfg.server_sock_count; i++)
+        close(eep_cfg.server_socks[i]);
+    eep_cfg.server_sock_count = 0;
+
+    if (eep_cfg.server_tcp_sock > 0) {
+        close(eep_cfg.server_tcp_sock);
+        eep_cfg.server_tcp_sock = -1;
+    }
+
+    if (eep_cfg.server_epoll > 0) {
+        close(eep_cfg.server_epoll);
+        eep_cfg.server_epoll = -1;
         //pthread_join(&eep_cfg.server_thread, &ret);
     }
 }
@@ -186,30 +450,138 @@ capture_eep_listen_port()
     return eep_cfg.capt_srv_port;
 }
 
+/**
+ * @brief Recreate the client socket after send failures
+ *
+ * Only called from the client thread. The capture path keeps queueing
+ * into the send queue while the socket is being replaced.
+ */
+static void
+capture_eep_client_reconnect()
+{
+    int sock;
+
+    if ((sock = socket(eep_cfg.client_addr.ss_family, SOCK_DGRAM, IPPROTO_UDP)) < 0)
+        return;
+
+    if (connect(sock, (struct sockaddr *) &eep_cfg.client_addr, eep_cfg.client_addrlen) == -1
+            && errno != EINPROGRESS) {
+        close(sock);
+        return;
+    }
+
+    close(eep_cfg.client_sock);
+    eep_cfg.client_sock = sock;
+}
+
+void *
+capture_eep_client(void *data)
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[CAPTURE_EEP_BATCH];
+    struct iovec iovecs[CAPTURE_EEP_BATCH];
+#endif
+    uint32_t head, tail, slot;
+    useconds_t backoff = 10000;
+    int count, sent, i;
+
+    while (eep_cfg.client_sock > 0) {
+        tail = eep_cfg.client_tail;
+        head = __atomic_load_n(&eep_cfg.client_head, __ATOMIC_ACQUIRE);
+
+        // Nothing queued, give the capture path some time
+        if (head == tail) {
+            usleep(1000);
+            continue;
+        }
+
+        count = head - tail;
+        if (count > CAPTURE_EEP_BATCH)
+            count = CAPTURE_EEP_BATCH;
+
+#ifdef HAVE_SENDMMSG
+        // Send as many queued datagrams as possible in a single syscall
+        memset(msgs, 0, sizeof(struct mmsghdr) * count);
+        for (i = 0; i < count; i++) {
+            slot = (tail + i) % CAPTURE_EEP_QUEUE;
+            iovecs[i].iov_base = eep_cfg.client_queue + slot * MAX_CAPTURE_LEN;
+            iovecs[i].iov_len = eep_cfg.client_sizes[slot];
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        sent = sendmmsg(eep_cfg.client_sock, msgs, count, 0);
+#else
+        slot = tail % CAPTURE_EEP_QUEUE;
+        sent = (send(eep_cfg.client_sock, eep_cfg.client_queue + slot * MAX_CAPTURE_LEN,
+                     eep_cfg.client_sizes[slot], 0) == -1) ? -1 : 1;
+#endif
+
+        if (sent <= 0) {
+            // The collector looks down, back off and try a new socket
+            usleep(backoff);
+            if (backoff < 1000000)
+                backoff *= 2;
+            capture_eep_client_reconnect();
+            continue;
+        }
+
+        // Sent datagrams can be overwritten by the capture path now
+        backoff = 10000;
+        __atomic_store_n(&eep_cfg.client_tail, tail + sent, __ATOMIC_RELEASE);
+    }
+
+    // Leave the thread gracefully
+    pthread_exit(NULL);
+    return 0;
+}
+
 int
 capture_eep_send(packet_t *pkt)
 {
+    uint32_t head, tail;
+    u_char *slot;
+    int len;
+
     // Dont send RTP packets
     if (pkt->type == PACKET_RTP)
         return 1;
 
     // Check we have a connection established
-    if (!eep_cfg.client_sock)
+    if (!eep_cfg.client_sock || !eep_cfg.client_queue)
+        return 1;
+
+    // Drop the packet if the client thread is not keeping up
+    head = eep_cfg.client_head;
+    tail = __atomic_load_n(&eep_cfg.client_tail, __ATOMIC_ACQUIRE);
+    if (head - tail == CAPTURE_EEP_QUEUE) {
+        eep_cfg.client_drops++;
         return 1;
+    }
 
+    // Serialize the datagram into the free queue slot
+    slot = eep_cfg.client_queue + (head % CAPTURE_EEP_QUEUE) * MAX_CAPTURE_LEN;
     switch (eep_cfg.capt_version) {
         case 2:
-            return capture_eep_send_v2(pkt);
+            len = capture_eep_serialize_v2(pkt, slot);
+            break;
         case 3:
-            return capture_eep_send_v3(pkt);
+            len = capture_eep_serialize_v3(pkt, slot);
+            break;
+        default:
+            return 1;
     }
-    return 1;
+    if (len <= 0)
+        return 1;
+
+    // Publish the datagram to the client thread
+    eep_cfg.client_sizes[head % CAPTURE_EEP_QUEUE] = len;
+    __atomic_store_n(&eep_cfg.client_head, head + 1, __ATOMIC_RELEASE);
+    return 0;
 }
 
 int
-capture_eep_send_v2(packet_t *pkt)
+capture_eep_serialize_v2(packet_t *pkt, u_char *buffer)
 {
-    void* buffer;
     uint32_t buflen = 0, tlen = 0;
     struct hep_hdr hdr;
     struct hep_timehdr hep_time;
@@ -258,9 +630,9 @@ capture_eep_send_v2(packet_t *pkt)
     tlen += len;
     hdr.hp_l = htons(tlen);
 
-    // Allocate memory for HEPv2 packet
-    if (!(buffer = sng_malloc(tlen)))
-        return 1;
+    // Check the datagram fits in the queue slot
+    if (tlen > MAX_CAPTURE_LEN)
+        return -1;
 
     // Copy basic headers
     buflen = 0;
@@ -287,21 +659,13 @@ capture_eep_send_v2(packet_t *pkt)
     memcpy((void*) buffer + buflen, data, len);
     buflen += len;
 
-    if (send(eep_cfg.client_sock, buffer, buflen, 0) == -1) {
-        return 1;
-    }
-
-    /* FREE */
-    sng_free(buffer);
-
-    return 1;
+    return buflen;
 }
 
 int
-capture_eep_send_v3(packet_t *pkt)
+capture_eep_serialize_v3(packet_t *pkt, u_char *buffer)
 {
     struct hep_generic *hg = NULL;
-    void* buffer;
     uint32_t buflen = 0, iplen = 0, tlen = 0;
     hep_chunk_ip4_t src_ip4, dst_ip4;
 #ifdef USE_IPV6
@@ -423,9 +787,10 @@ capture_eep_send_v3(packet_t *pkt)
     /* total */
     hg->header.length = htons(tlen);
 
-    if (!(buffer = sng_malloc(tlen))) {
+    // Check the datagram fits in the queue slot
+    if (tlen > MAX_CAPTURE_LEN) {
         sng_free(hg);
-        return 1;
+        return -1;
     }
     memcpy((void*) buffer, hg, sizeof(struct hep_generic));
     buflen = sizeof(struct hep_generic);
@@ -471,35 +836,29 @@ capture_eep_send_v3(packet_t *pkt)
     memcpy((void*) buffer + buflen, data, len);
     buflen += len;
 
-    if (send(eep_cfg.client_sock, buffer, buflen, 0) == -1) {
-        return 1;
-    }
-
     /* FREE */
-    sng_free(buffer);
     sng_free(hg);
-    return 0;
+    return buflen;
 }
 
 packet_t *
-capture_eep_receive()
+capture_eep_receive(u_char *buffer, uint32_t size)
 {
     switch (eep_cfg.capt_srv_version) {
         case 2:
-            return capture_eep_receive_v2();
+            return capture_eep_receive_v2(buffer, size);
         case 3:
-            return capture_eep_receive_v3();
+            return capture_eep_receive_v3(buffer, size);
     }
     return NULL;
 }
 
 packet_t *
-capture_eep_receive_v2()
+capture_eep_receive_v2(u_char *buffer, uint32_t size)
 {
     uint8_t family, proto;
     unsigned char *payload = 0;
     uint32_t pos;
-    char buffer[MAX_CAPTURE_LEN] ;
     //! Source Address
     address_t src;
     //! Destination address
@@ -508,9 +867,6 @@ capture_eep_receive_v2()
     struct pcap_pkthdr header;
     //! New created packet pointer
     packet_t *pkt;
-    //! EEP client data
-    struct sockaddr eep_client;
-    socklen_t eep_client_len;
     struct hep_hdr hdr;
     struct hep_timehdr hep_time;
     struct hep_iphdr hep_ipheader;
@@ -518,13 +874,14 @@ capture_eep_receive_v2()
     struct hep_ip6hdr hep_ip6header;
 #endif
 
-    // Initialize buffer
-    memset(buffer, 0, MAX_CAPTURE_LEN);
-
-    /* Receive EEP generic header */
-    if (recvfrom(eep_cfg.server_sock, buffer, MAX_CAPTURE_LEN, 0, &eep_client, &eep_client_len) == -1)
+    // Not enough data for the initial header
+    if (size < sizeof(struct hep_hdr))
         return NULL;
 
+    // Initialize addresses
+    memset(&src, 0, sizeof(address_t));
+    memset(&dst, 0, sizeof(address_t));
+
     /* Copy initial bytes to HEPv2 header */
     memcpy(&hdr, buffer, sizeof(struct hep_hdr));
 
@@ -532,6 +889,10 @@ capture_eep_receive_v2()
     if (hdr.hp_v != 2)
         return NULL;
 
+    // Check the packet announced length fits in received data
+    if (ntohs(hdr.hp_l) > size)
+        return NULL;
+
     /* IP proto */
     family = hdr.hp_f;
     /* Proto ID */
@@ -544,6 +905,9 @@ capture_eep_receive_v2()
         memcpy(&hep_ipheader, (void*) buffer + pos, sizeof(struct hep_iphdr));
         inet_ntop(AF_INET, &hep_ipheader.hp_src, src.ip, sizeof(src.ip));
         inet_ntop(AF_INET, &hep_ipheader.hp_dst, dst.ip, sizeof(dst.ip));
+        memcpy(src.raw, &hep_ipheader.hp_src, 4);
+        memcpy(dst.raw, &hep_ipheader.hp_dst, 4);
+        src.rawlen = dst.rawlen = 4;
         pos += sizeof(struct hep_iphdr);
     }
 #ifdef USE_IPV6
@@ -552,6 +916,9 @@ capture_eep_receive_v2()
         memcpy(&hep_ip6header, (void*) buffer + pos, sizeof(struct hep_ip6hdr));
         inet_ntop(AF_INET6, &hep_ip6header.hp6_src, src.ip, sizeof(src.ip));
         inet_ntop(AF_INET6, &hep_ip6header.hp6_dst, dst.ip, sizeof(dst.ip));
+        memcpy(src.raw, &hep_ip6header.hp6_src, 16);
+        memcpy(dst.raw, &hep_ip6header.hp6_dst, 16);
+        src.rawlen = dst.rawlen = 16;
         pos += sizeof(struct hep_ip6hdr);
     }
 #endif
@@ -591,71 +958,65 @@ capture_eep_receive_v2()
 
 
 /**
- * @brief Received a HEP3 packet
+ * @brief Parse a received HEP3 packet
  *
- * This function receives HEP protocol payload and converts it
+ * This function parses HEP protocol payload and converts it
  * to a Packet information. This code has been updated based on
  * Kamailio sipcapture module.
  *
+ * Chunks are walked in place over the receive buffer; packet data
+ * is only copied once, when the payload chunk is stored into the
+ * created packet structure.
+ *
  * @return packet pointer
  */
 packet_t *
-capture_eep_receive_v3()
+capture_eep_receive_v3(u_char *buffer, uint32_t size)
 {
-
-    struct hep_generic hg;
-    hep_chunk_ip4_t src_ip4, dst_ip4;
-#ifdef USE_IPV6
-    hep_chunk_ip6_t src_ip6, dst_ip6;
-#endif
-    hep_chunk_t payload_chunk;
-    hep_chunk_t authkey_chunk;
-    hep_chunk_t uuid_chunk;
-    char password[100];
-    int password_len;
-    unsigned char *payload = 0;
+    hep_ctrl_t *ctrl;
+    uint8_t family = 0, proto = 0;
+    const char *password = NULL;
+    int password_len = 0;
+    u_char *payload = NULL;
     uint32_t total_len, pos;
-    char buffer[MAX_CAPTURE_LEN] ;
     //! Source and Destination Address
     address_t src, dst;
-    //! EEP client data
-    struct sockaddr eep_client;
-    socklen_t eep_client_len;
     //! Packet header
     struct pcap_pkthdr header;
     //! New created packet pointer
     packet_t *pkt;
 
-    /* Receive EEP generic header */
-    if (recvfrom(eep_cfg.server_sock, buffer, MAX_CAPTURE_LEN, 0, &eep_client, &eep_client_len) == -1)
+    // Not enough data for the initial header
+    if (size < sizeof(hep_ctrl_t))
         return NULL;
 
     // Initialize structs
-    memset(&hg, 0, sizeof(hep_generic_t));
-    memset(&password, 0, sizeof(password));
     memset(&src, 0, sizeof(address_t));
     memset(&dst, 0, sizeof(address_t));
     memset(&header, 0, sizeof(struct pcap_pkthdr));
 
-    /* Copy initial bytes to EEP Generic header */
-    memcpy(&hg.header, buffer, sizeof(struct hep_generic));
-
     /* header check */
-    if (memcmp(hg.header.id, "\x48\x45\x50\x33", 4) != 0)
+    ctrl = (hep_ctrl_t *) buffer;
+    if (memcmp(ctrl->id, "\x48\x45\x50\x33", 4) != 0)
         return NULL;
 
-    total_len = ntohs(hg.header.length);
+    total_len = ntohs(ctrl->length);
     pos = sizeof(hep_ctrl_t);
 
-    while (pos < total_len) {
+    // Check the packet announced length fits in received data
+    if (total_len > size)
+        return NULL;
+
+    while (pos + sizeof(hep_chunk_t) <= total_len) {
 
         hep_chunk_t *chunk = (struct hep_chunk*) (buffer + pos);
         int chunk_vendor = ntohs(chunk->vendor_id);
         int chunk_type = ntohs(chunk->type_id);
         int chunk_len = ntohs(chunk->length);
+        u_char *chunk_data = buffer + pos + sizeof(hep_chunk_t);
 
         /* Bad length, drop packet */
-        if (chunk_len == 0) {
+        if (chunk_len < (int) sizeof(hep_chunk_t) || pos + chunk_len > total_len) {
             return NULL;
         }
 
@@ -669,63 +1030,54 @@ capture_eep_receive_v3()
             case CAPTURE_EEP_CHUNK_INVALID:
                 return NULL;
             case CAPTURE_EEP_CHUNK_FAMILY:
-                memcpy(&hg.ip_family, (void*) buffer + pos, sizeof(hep_chunk_uint8_t));
+                family = *chunk_data;
                 break;
             case CAPTURE_EEP_CHUNK_PROTO:
-                memcpy(&hg.ip_proto, (void*) buffer + pos, sizeof(hep_chunk_uint8_t));
+                proto = *chunk_data;
                 break;
             case CAPTURE_EEP_CHUNK_SRC_IP4:
-                memcpy(&src_ip4, (void*) buffer + pos, sizeof(struct hep_chunk_ip4));
-                inet_ntop(AF_INET, &src_ip4.data, src.ip, sizeof(src.ip));
+                inet_ntop(AF_INET, chunk_data, src.ip, sizeof(src.ip));
+                memcpy(src.raw, chunk_data, (src.rawlen = 4));
                 break;
             case CAPTURE_EEP_CHUNK_DST_IP4:
-                memcpy(&dst_ip4, (void*) buffer + pos, sizeof(struct hep_chunk_ip4));
-                inet_ntop(AF_INET, &dst_ip4.data, dst.ip, sizeof(src.ip));
+                inet_ntop(AF_INET, chunk_data, dst.ip, sizeof(dst.ip));
+                memcpy(dst.raw, chunk_data, (dst.rawlen = 4));
                 break;
 #ifdef USE_IPV6
             case CAPTURE_EEP_CHUNK_SRC_IP6:
-                memcpy(&src_ip6, (void*) buffer + pos, sizeof(struct hep_chunk_ip6));
-                inet_ntop(AF_INET6, &src_ip6.data, src.ip, sizeof(src.ip));
+                inet_ntop(AF_INET6, chunk_data, src.ip, sizeof(src.ip));
+                memcpy(src.raw, chunk_data, (src.rawlen = 16));
                 break;
             case CAPTURE_EEP_CHUNK_DST_IP6:
-                memcpy(&dst_ip6, (void*) buffer + pos, sizeof(struct hep_chunk_ip6));
-                inet_ntop(AF_INET6, &dst_ip6.data, dst.ip, sizeof(dst.ip));
+                inet_ntop(AF_INET6, chunk_data, dst.ip, sizeof(dst.ip));
+                memcpy(dst.raw, chunk_data, (dst.rawlen = 16));
                 break;
 #endif
             case CAPTURE_EEP_CHUNK_SRC_PORT:
-                memcpy(&hg.src_port, (void*) buffer + pos, sizeof(hep_chunk_uint16_t));
-                src.port = ntohs(hg.src_port.data);
+                src.port = ntohs(((hep_chunk_uint16_t *) chunk)->data);
                 break;
             case CAPTURE_EEP_CHUNK_DST_PORT:
-                memcpy(&hg.dst_port, (void*) buffer + pos, sizeof(hep_chunk_uint16_t));
-                dst.port = ntohs(hg.dst_port.data);
+                dst.port = ntohs(((hep_chunk_uint16_t *) chunk)->data);
                 break;
             case CAPTURE_EEP_CHUNK_TS_SEC:
-                memcpy(&hg.time_sec, (void*) buffer + pos, sizeof(hep_chunk_uint32_t));
-                header.ts.tv_sec = ntohl(hg.time_sec.data);
+                header.ts.tv_sec = ntohl(((hep_chunk_uint32_t *) chunk)->data);
                 break;
             case CAPTURE_EEP_CHUNK_TS_USEC:
-                memcpy(&hg.time_usec, (void*) buffer + pos, sizeof(hep_chunk_uint32_t));
-                header.ts.tv_usec = ntohl(hg.time_usec.data);
+                header.ts.tv_usec = ntohl(((hep_chunk_uint32_t *) chunk)->data);
                 break;
             case CAPTURE_EEP_CHUNK_PROTO_TYPE:
-                memcpy(&hg.proto_t, (void*) buffer + pos, sizeof(hep_chunk_uint8_t));
                 break;
             case CAPTURE_EEP_CHUNK_CAPT_ID:
-                memcpy(&hg.capt_id, (void*) buffer + pos, sizeof(hep_chunk_uint32_t));
                 break;
             case CAPTURE_EEP_CHUNK_KEEP_TM:
                 break;
             case CAPTURE_EEP_CHUNK_AUTH_KEY:
-                memcpy(&authkey_chunk, (void*) buffer + pos, sizeof(authkey_chunk));
-                password_len = ntohs(authkey_chunk.length) - sizeof(authkey_chunk);
-                memcpy(password, (void*) buffer + pos + sizeof(hep_chunk_t), password_len);
+                password = (const char *) chunk_data;
+                password_len = chunk_len - sizeof(hep_chunk_t);
                 break;
             case CAPTURE_EEP_CHUNK_PAYLOAD:
-                memcpy(&payload_chunk, (void*) buffer + pos, sizeof(payload_chunk));
                 header.caplen = header.len = chunk_len - sizeof(hep_chunk_t);
-                payload = sng_malloc(header.caplen);
-                memcpy(payload, (void*) buffer + pos + sizeof(hep_chunk_t), header.caplen);
+                payload = chunk_data;
                 break;
             case CAPTURE_EEP_CHUNK_CORRELATION_ID:
                 break;
@@ -740,21 +1092,25 @@ capture_eep_receive_v3()
     // Validate password
     if (eep_cfg.capt_srv_password != NULL) {
         // No password in packet
-        if (strlen(password) == 0)
+        if (password == NULL || password_len <= 0)
             return NULL;
         // Check password matches configured
+        if (password_len < (int) strlen(eep_cfg.capt_srv_password))
+            return NULL;
         if (strncmp(password, eep_cfg.capt_srv_password, strlen(eep_cfg.capt_srv_password)) != 0)
             return NULL;
     }
 
-    // Create a new packet
-    pkt = packet_create((hg.ip_family.data == AF_INET)?4:6, hg.ip_proto.data, src, dst, 0);
+    // No payload, nothing to parse
+    if (payload == NULL)
+        return NULL;
+
+    // Create a new packet, copying the payload straight from the receive buffer
+    pkt = packet_create((family == AF_INET) ? 4 : 6, proto, src, dst, 0);
     packet_add_frame(pkt, &header, payload);
     packet_set_type(pkt, PACKET_SIP_UDP);
     packet_set_payload(pkt, payload, header.caplen);
 
-    /* FREE */
-    sng_free(payload);
     return pkt;
 }
 
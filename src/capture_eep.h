@@ -44,6 +44,18 @@
 #include <pthread.h>
 #include "capture.h"
 
+//! Max number of datagrams read from the listen socket in one syscall
+#define CAPTURE_EEP_BATCH 32
+
+//! Number of serialized datagrams the async client queue can hold
+#define CAPTURE_EEP_QUEUE 256
+
+//! Max number of datagram sockets bound for the listen address
+#define CAPTURE_EEP_SOCKETS 8
+
+//! Pending connection backlog of the TCP listen socket
+#define CAPTURE_EEP_BACKLOG 16
+
 //! HEP chunk types
 enum
 {
@@ -77,8 +89,14 @@ struct capture_eep_config
 {
     //! Client socket for sending EEP data
     int client_sock;
-    //! Server socket for receiving EEP data
-    int server_sock;
+    //! Server datagram sockets, one per resolved listen address
+    int server_socks[CAPTURE_EEP_SOCKETS];
+    //! Number of bound server datagram sockets
+    int server_sock_count;
+    //! Server stream socket accepting TCP HEP connections
+    int server_tcp_sock;
+    //! Epoll descriptor driving the server event loop
+    int server_epoll;
     //! Capture agent id
     int capt_id;
     //! Hep Version for sending data (2 or 3)
@@ -99,6 +117,22 @@ struct capture_eep_config
     const char *capt_srv_password;
     //! Server thread to parse incoming data
     pthread_t server_thread;
+    //! Client thread draining the send queue
+    pthread_t client_thread;
+    //! Send queue of serialized datagrams (CAPTURE_EEP_QUEUE slots)
+    u_char *client_queue;
+    //! Length of each queued datagram
+    uint32_t client_sizes[CAPTURE_EEP_QUEUE];
+    //! Queue write counter, only advanced by the capture thread
+    uint32_t client_head;
+    //! Queue read counter, only advanced by the client thread
+    uint32_t client_tail;
+    //! Datagrams dropped because the send queue was full
+    uint32_t client_drops;
+    //! Collector address, kept to reconnect the client socket
+    struct sockaddr_storage client_addr;
+    //! Collector address length
+    socklen_t client_addrlen;
 };
 
 /* HEPv3 types */
@@ -266,7 +300,12 @@ const char *
 capture_eep_listen_port();
 
 /**
- * @brief Wrapper for sending packet in configured EEP version
+ * @brief Queue a packet to be sent in configured EEP version
+ *
+ * Serialize the packet into the client send queue. The datagram is
+ * sent later by the client thread, so a slow or unreachable collector
+ * never delays the capture path. When the queue is full the packet is
+ * dropped and accounted in the client_drops counter.
  *
  * @param pkt Packet Structure data
  * @return 1 on any error occurs, 0 otherwise
@@ -275,63 +314,67 @@ int
 capture_eep_send(packet_t *pkt);
 
 /**
- * @brief Send a captured packet (EEP version 2)
+ * @brief Serialize a captured packet (EEP version 2)
  *
- * Send a packet encapsulated into EEP through the client socket.
- * This function will only handle SIP packets if EEP client mode
- * has been enabled.
+ * Encapsulate a packet into an EEP datagram in the given buffer,
+ * which must hold at least MAX_CAPTURE_LEN bytes.
  *
  * @param pkt Packet Structure data
- * @return 1 on any error occurs, 0 otherwise
+ * @param buffer Where the datagram is serialized
+ * @return datagram length or -1 if it doesn't fit in the buffer
  */
 int
-capture_eep_send_v2(packet_t *pkt);
+capture_eep_serialize_v2(packet_t *pkt, u_char *buffer);
 
 /**
- * @brief Send a captured packet (EEP version 3)
+ * @brief Serialize a captured packet (EEP version 3)
  *
- * Send a packet encapsulated into EEP through the client socket.
- * This function will only handle SIP packets if EEP client mode
- * has been enabled.
+ * Encapsulate a packet into an EEP datagram in the given buffer,
+ * which must hold at least MAX_CAPTURE_LEN bytes.
  *
  * @param pkt Packet Structure data
- * @return 1 on any error occurs, 0 otherwise
+ * @param buffer Where the datagram is serialized
+ * @return datagram length or -1 if it doesn't fit in the buffer
  */
 int
-capture_eep_send_v3(packet_t *pkt);
+capture_eep_serialize_v3(packet_t *pkt, u_char *buffer);
 
 /**
- * @brief Wrapper for receiving packet in configured EEP version
+ * @brief Wrapper for parsing a received datagram in configured EEP version
  *
+ * @param buffer Datagram contents as read from the listen socket
+ * @param size Number of bytes in buffer
  * @return NULL on any error, packet structure otherwise
  */
 packet_t *
-capture_eep_receive();
+capture_eep_receive(u_char *buffer, uint32_t size);
 
 
 /**
- * @brief Received a captured packet (EEP version 2)
+ * @brief Parse a received datagram (EEP version 2)
  *
- * Wait for a packet to be received through the EEP server. This
- * function will parse received EEP data and create a new packet
- * structure.
+ * Parse EEP data read from the listen socket and create a new
+ * packet structure.
  *
+ * @param buffer Datagram contents as read from the listen socket
+ * @param size Number of bytes in buffer
  * @return NULL on any error, packet structure otherwise
  */
 packet_t *
-capture_eep_receive_v2();
+capture_eep_receive_v2(u_char *buffer, uint32_t size);
 
 /**
- * @brief Received a captured packet (EEP version 3)
+ * @brief Parse a received datagram (EEP version 3)
  *
- * Wait for a packet to be received through the EEP server. This
- * function will parse received EEP data and create a new packet
- * structure.
+ * Parse EEP data read from the listen socket and create a new
+ * packet structure.
  *
+ * @param buffer Datagram contents as read from the listen socket
+ * @param size Number of bytes in buffer
  * @return NULL on any error, packet structure otherwise
  */
 packet_t *
-capture_eep_receive_v3();
+capture_eep_receive_v3(u_char *buffer, uint32_t size);
 
 /**
  * @brief Set EEP server url
@@ -35,9 +35,31 @@
 #include "capture_gnutls.h"
 #include "option.h"
 #include "util.h"
+#include "hash.h"
 #include "sip.h"
 
-struct SSLConnection *connections;
+//! Active TLS connections indexed by their address tuple
+static htable_t *connections;
+
+/**
+ * @brief Build the hash table key of a connection
+ *
+ * Both directions of the connection use the same key: the lower
+ * endpoint, comparing address then port, always goes first.
+ */
+static void
+tls_connection_key(struct in_addr addr1, uint16_t port1,
+                   struct in_addr addr2, uint16_t port2, char *key, size_t len)
+{
+    if (ntohl(addr1.s_addr) < ntohl(addr2.s_addr)
+        || (addr1.s_addr == addr2.s_addr && port1 < port2)) {
+        snprintf(key, len, "%08x:%u-%08x:%u",
+                 ntohl(addr1.s_addr), port1, ntohl(addr2.s_addr), port2);
+    } else {
+        snprintf(key, len, "%08x:%u-%08x:%u",
+                 ntohl(addr2.s_addr), port2, ntohl(addr1.s_addr), port1);
+    }
+}
 
 struct CipherData ciphers[] = {
 /*  { number, encoder,    ivlen, bits, digest, diglen, mode }, */
@@ -233,9 +255,11 @@ tls_connection_create(struct in_addr caddr, uint16_t cport, struct in_addr saddr
     // Store this key into the connection
     conn->server_private_key = spkey;
 
-    // Add this connection to the list
-    conn->next = connections;
-    connections = conn;
+    // Add this connection to the hash table
+    if (!connections)
+        connections = htable_create(1024);
+    tls_connection_key(caddr, cport, saddr, sport, conn->hashkey, sizeof(conn->hashkey));
+    htable_insert(connections, conn->hashkey, conn);
 
     return conn;
 }
@@ -243,19 +267,8 @@ tls_connection_create(struct in_addr caddr, uint16_t cport, struct in_addr saddr
 void
 tls_connection_destroy(struct SSLConnection *conn)
 {
-    struct SSLConnection *c;
-
-    // Remove connection from connections list
-    if (conn == connections) {
-        connections = conn->next;
-    } else {
-        for (c = connections; c; c = c->next) {
-            if (c->next == conn) {
-                c->next = conn->next;
-                break;
-            }
-        }
-    }
+    // Remove connection from the hash table
+    htable_remove(connections, conn->hashkey);
 
     // Deallocate connection memory
     gnutls_deinit(conn->ssl);
@@ -332,19 +345,14 @@ tls_connection_dir(struct SSLConnection *conn, struct in_addr addr, uint16_t por
 
 struct SSLConnection*
 tls_connection_find(struct in_addr src, uint16_t sport, struct in_addr dst, uint16_t dport) {
-    struct SSLConnection *conn;
+    char key[48];
 
-    for (conn = connections; conn; conn = conn->next) {
-        if (tls_connection_dir(conn, src, sport) == 0 &&
-                tls_connection_dir(conn, dst, dport) == 1) {
-            return conn;
-        }
-        if (tls_connection_dir(conn, src, sport) == 1 &&
-                tls_connection_dir(conn, dst, dport) == 0) {
-            return conn;
-        }
-    }
-    return NULL;
+    if (!connections)
+        return NULL;
+
+    // Both directions of the connection share the same key
+    tls_connection_key(src, sport, dst, dport, key, sizeof(key));
+    return htable_find(connections, key);
 }
 
 int
@@ -259,7 +259,8 @@ struct SSLConnection {
     gcry_cipher_hd_t client_cipher_ctx;
     gcry_cipher_hd_t server_cipher_ctx;
 
-    struct SSLConnection *next;
+    //! Connection hash table key (@see tls_connection_find)
+    char hashkey[48];
 };
 
 /**
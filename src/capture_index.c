@@ -0,0 +1,272 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_index.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in capture_index.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "capture_index.h"
+#include "setting.h"
+#include "sip.h"
+#include "util.h"
+
+//! Storage option bits mixed into the index header flags
+#define CAPTURE_INDEX_FLAG_CALLS        (1 << 0)
+#define CAPTURE_INDEX_FLAG_NOINCOMPLETE (1 << 1)
+
+/**
+ * @brief Return the sidecar index path for a capture file
+ *
+ * @return allocated string to be freed by the caller
+ */
+static char *
+capture_index_path(const char *infile)
+{
+    char *path = sng_malloc(strlen(infile) + strlen(CAPTURE_INDEX_SUFFIX) + 1);
+    sprintf(path, "%s%s", infile, CAPTURE_INDEX_SUFFIX);
+    return path;
+}
+
+/**
+ * @brief Storage options that change which frames produce calls
+ *
+ * An index written under different options would skip frames the
+ * current options are interested in.
+ */
+static uint32_t
+capture_index_flags()
+{
+    uint32_t flags = 0;
+    if (setting_enabled(SETTING_SIP_CALLS))
+        flags |= CAPTURE_INDEX_FLAG_CALLS;
+    if (setting_enabled(SETTING_SIP_NOINCOMPLETE))
+        flags |= CAPTURE_INDEX_FLAG_NOINCOMPLETE;
+    return flags;
+}
+
+/**
+ * @brief Check if the sidecar index can be used at all
+ *
+ * Capture filters, match expressions and RTP capture change which
+ * frames are interesting, so the index is neither written nor replayed
+ * while any of them is configured.
+ */
+static bool
+capture_index_usable(capture_info_t *capinfo)
+{
+    if (!capinfo->mmap_data || !capinfo->infile)
+        return false;
+    if (capture_get_bpf_filter() || sip_get_match_expression())
+        return false;
+    if (setting_enabled(SETTING_CAPTURE_RTP))
+        return false;
+    return true;
+}
+
+/**
+ * @brief Sort helper for frame offsets
+ */
+static int
+capture_index_offset_cmp(const void *a, const void *b)
+{
+    uint64_t oa = *(const uint64_t *) a;
+    uint64_t ob = *(const uint64_t *) b;
+    if (oa == ob)
+        return 0;
+    return (oa < ob) ? -1 : 1;
+}
+
+bool
+capture_index_replay(capture_info_t *capinfo, pcap_handler callback)
+{
+    struct capture_index_hdr idx;
+    struct pcap_record_header *record;
+    struct pcap_pkthdr header;
+    struct stat st;
+    FILE *file;
+    char *path;
+    uint64_t i, offset, prev = 0;
+    bool nsec = ((struct pcap_file_header *) capinfo->mmap_data)->magic == CAPTURE_PCAP_MAGIC_NSEC;
+
+    if (!capture_index_usable(capinfo))
+        return false;
+
+    path = capture_index_path(capinfo->infile);
+    file = fopen(path, "r");
+    sng_free(path);
+    if (!file)
+        return false;
+
+    // Validate the index against the current capture file
+    if (fread(&idx, sizeof(idx), 1, file) != 1
+            || idx.magic != CAPTURE_INDEX_MAGIC
+            || idx.version != CAPTURE_INDEX_VERSION
+            || idx.pcap_size != capinfo->mmap_size
+            || stat(capinfo->infile, &st) != 0
+            || idx.pcap_mtime != (uint64_t) st.st_mtime
+            || idx.count > capinfo->mmap_size / sizeof(struct pcap_record_header)
+            || idx.flags != capture_index_flags()) {
+        fclose(file);
+        return false;
+    }
+
+    // Loading start time, for progress and ETA reporting
+    gettimeofday(&capinfo->load_start, NULL);
+
+    for (i = 0; capinfo->running && i < idx.count; i++) {
+        if (fread(&offset, sizeof(offset), 1, file) != 1)
+            break;
+
+        // Offsets must walk the mapped file forward within its bounds
+        if (offset < prev || offset + sizeof(struct pcap_record_header) > capinfo->mmap_size)
+            break;
+        prev = offset;
+
+        record = (struct pcap_record_header *) (capinfo->mmap_data + offset);
+        offset += sizeof(struct pcap_record_header);
+        if (record->caplen > capinfo->mmap_size - offset)
+            break;
+
+        // Fill the frame header as capture_mmap_loop would have done
+        header.ts.tv_sec = record->ts_sec;
+        header.ts.tv_usec = (nsec) ? record->ts_usec / 1000 : record->ts_usec;
+        header.caplen = record->caplen;
+        header.len = record->len;
+
+        callback((u_char *) capinfo, &header, capinfo->mmap_data + offset);
+
+        // Update read position for progress reporting
+        capinfo->mmap_pos = offset + record->caplen;
+    }
+
+    fclose(file);
+
+    // Everything after the last indexed frame is known not to be SIP
+    if (capinfo->running)
+        capinfo->mmap_pos = capinfo->mmap_size;
+
+    return true;
+}
+
+void
+capture_index_write(capture_info_t *capinfo)
+{
+    struct capture_index_hdr idx;
+    struct stat st;
+    sip_call_t *call;
+    sip_msg_t *msg;
+    frame_t *frame;
+    vector_iter_t calls, msgs, frames;
+    FILE *file;
+    char *path, *tmppath;
+    uint64_t *offsets;
+    uint64_t capacity = 64, count = 0, unique, i;
+    size_t offset;
+    bool written;
+
+    // Only index capture files that have been read to their last record
+    if (!capinfo->mmap_eof || !capture_index_usable(capinfo))
+        return;
+
+    // A full or rotated call list means frames were dropped along the
+    // way, the index would not cover them
+    if (sip_calls_count() >= sip_get_call_limit() || sip_calls_rotated())
+        return;
+
+    offsets = sng_malloc(capacity * sizeof(uint64_t));
+
+    // Collect the mapped offsets of every frame the call list references
+    capture_lock();
+    calls = sip_calls_iterator();
+    while ((call = vector_iterator_next(&calls))) {
+        msgs = vector_iterator(call->msgs);
+        while ((msg = vector_iterator_next(&msgs))) {
+            frames = vector_iterator(msg->packet->frames);
+            while ((frame = vector_iterator_next(&frames))) {
+                // Frames not pointing into the mapping (or freed by the
+                // storage mode) cannot be replayed, give up on the index
+                if (!frame->mapped || !frame->data
+                        || frame->data < capinfo->mmap_data
+                        || frame->data >= capinfo->mmap_data + capinfo->mmap_size) {
+                    capture_unlock();
+                    sng_free(offsets);
+                    return;
+                }
+                offset = frame->data - capinfo->mmap_data - sizeof(struct pcap_record_header);
+                if (count == capacity) {
+                    capacity *= 2;
+                    offsets = realloc(offsets, capacity * sizeof(uint64_t));
+                }
+                offsets[count++] = offset;
+            }
+        }
+    }
+    capture_unlock();
+
+    // Frames are indexed in capture order, duplicates removed
+    qsort(offsets, count, sizeof(uint64_t), capture_index_offset_cmp);
+    unique = 0;
+    for (i = 0; i < count; i++) {
+        if (unique == 0 || offsets[unique - 1] != offsets[i])
+            offsets[unique++] = offsets[i];
+    }
+    count = unique;
+
+    if (stat(capinfo->infile, &st) != 0) {
+        sng_free(offsets);
+        return;
+    }
+
+    memset(&idx, 0, sizeof(idx));
+    idx.magic = CAPTURE_INDEX_MAGIC;
+    idx.version = CAPTURE_INDEX_VERSION;
+    idx.pcap_size = capinfo->mmap_size;
+    idx.pcap_mtime = (uint64_t) st.st_mtime;
+    idx.count = count;
+    idx.flags = capture_index_flags();
+
+    // Write to a temporary file first, a crashed write must never
+    // leave a half built index behind
+    path = capture_index_path(capinfo->infile);
+    tmppath = sng_malloc(strlen(path) + 5);
+    sprintf(tmppath, "%s.tmp", path);
+
+    if ((file = fopen(tmppath, "w"))) {
+        written = fwrite(&idx, sizeof(idx), 1, file) == 1
+                  && (count == 0 || fwrite(offsets, sizeof(uint64_t), count, file) == count);
+        written = (fclose(file) == 0) && written;
+        if (!written || rename(tmppath, path) != 0)
+            unlink(tmppath);
+    }
+
+    sng_free(tmppath);
+    sng_free(path);
+    sng_free(offsets);
+}
@@ -0,0 +1,95 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_index.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Sidecar index to re-open large capture files quickly
+ *
+ * Loading a multigigabyte capture file parses every frame, although
+ * most of them (RTP streams, unrelated traffic) never produce a SIP
+ * message. After a mapped capture file has been read to its end, the
+ * offsets of the frames that ended up in the call list are written to
+ * a sidecar file next to it. The next time the same file is opened the
+ * sidecar is validated against its size and modification time, and
+ * only the indexed frames are parsed again, skipping everything that
+ * is known not to be SIP.
+ *
+ * The index is only used for memory mapped capture files (@see
+ * capture_mmap_file) and is ignored whenever a BPF filter or a match
+ * expression could change which frames are interesting.
+ */
+#ifndef __SNGREP_CAPTURE_INDEX_H
+#define __SNGREP_CAPTURE_INDEX_H
+
+#include "capture.h"
+
+//! Sidecar index file magic number
+#define CAPTURE_INDEX_MAGIC 0x53494458
+//! Sidecar index format version
+#define CAPTURE_INDEX_VERSION 1
+//! Suffix appended to the capture file name
+#define CAPTURE_INDEX_SUFFIX ".sidx"
+
+//! Sidecar index file header
+struct capture_index_hdr {
+    //! Magic number (CAPTURE_INDEX_MAGIC)
+    uint32_t magic;
+    //! Format version (CAPTURE_INDEX_VERSION)
+    uint32_t version;
+    //! Size of the capture file when the index was written
+    uint64_t pcap_size;
+    //! Modification time of the capture file when the index was written
+    uint64_t pcap_mtime;
+    //! Number of frame offsets following this header
+    uint64_t count;
+    //! Storage options the index was written with
+    uint32_t flags;
+};
+
+/**
+ * @brief Replay a capture file from its sidecar index
+ *
+ * If a valid sidecar index exists for the mapped capture file, feed
+ * only the indexed frames to the given callback, exactly as
+ * capture_mmap_loop would have done for them.
+ *
+ * @param capinfo Capture source with a mapped input file
+ * @param callback Frame parsing callback
+ * @return true if the file has been replayed from its index
+ */
+bool
+capture_index_replay(capture_info_t *capinfo, pcap_handler callback);
+
+/**
+ * @brief Write the sidecar index for a fully parsed capture file
+ *
+ * Collects the mapped file offsets of every frame referenced by the
+ * stored calls and writes them to the sidecar file. Does nothing if
+ * the mapped file was not read through to its last record.
+ *
+ * @param capinfo Capture source with a mapped input file
+ */
+void
+capture_index_write(capture_info_t *capinfo);
+
+#endif /* __SNGREP_CAPTURE_INDEX_H */
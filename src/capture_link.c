@@ -0,0 +1,313 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_link.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in capture_link.h
+ *
+ */
+#include "config.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "capture_link.h"
+#include "capture_eep.h"
+#include "sip.h"
+#include "util.h"
+
+//! Link state shared by the daemon and frontend sides
+struct capture_link {
+    //! Unix socket accepting frontend connections (daemon side)
+    int listen_sock;
+    //! Path of the daemon socket, unlinked at deinit
+    char path[108];
+    //! Attached frontend sockets, 0 marks a free slot
+    int clients[CAPTURE_LINK_CLIENTS];
+    //! Thread accepting frontend connections (daemon side)
+    pthread_t serve_thread;
+    //! Daemon socket connection (frontend side)
+    int attach_sock;
+    //! Thread reading the daemon stream (frontend side)
+    pthread_t attach_thread;
+    //! Flag to stop the link threads
+    bool running;
+};
+
+struct capture_link link_cfg = { 0 };
+
+/**
+ * @brief Replay every stored packet to a freshly attached frontend
+ *
+ * Runs under the capture lock so the frontend sees a consistent
+ * snapshot and no packet is missed between replay and live stream:
+ * capture pauses while the snapshot is written, which is the price of
+ * attaching. The client is registered before the lock is released.
+ */
+static void
+capture_serve_snapshot(int sock)
+{
+    u_char buffer[MAX_CAPTURE_LEN];
+    sip_call_t *call;
+    sip_msg_t *msg;
+    vector_iter_t calls, msgs;
+    int len, i;
+
+    capture_lock();
+    calls = sip_calls_iterator();
+    while ((call = vector_iterator_next(&calls))) {
+        msgs = vector_iterator(call->msgs);
+        while ((msg = vector_iterator_next(&msgs))) {
+            // Skip packets whose frames have been released
+            if (!vector_count(msg->packet->frames))
+                continue;
+            if ((len = capture_eep_serialize_v3(msg->packet, buffer)) <= 0)
+                continue;
+            // The frontend vanished while attaching, give up
+            if (send(sock, buffer, len, MSG_NOSIGNAL) != len) {
+                capture_unlock();
+                close(sock);
+                return;
+            }
+        }
+    }
+
+    // Register the frontend for the live stream
+    for (i = 0; i < CAPTURE_LINK_CLIENTS; i++) {
+        if (!link_cfg.clients[i]) {
+            link_cfg.clients[i] = sock;
+            break;
+        }
+    }
+    capture_unlock();
+
+    // No free slot for this frontend
+    if (i == CAPTURE_LINK_CLIENTS)
+        close(sock);
+}
+
+/**
+ * @brief Daemon thread accepting frontend connections
+ */
+static void *
+capture_serve_thread(void *data)
+{
+    int sock;
+
+    while (link_cfg.running) {
+        if ((sock = accept(link_cfg.listen_sock, NULL, NULL)) < 0)
+            continue;
+        capture_serve_snapshot(sock);
+    }
+
+    pthread_exit(NULL);
+    return 0;
+}
+
+int
+capture_serve_init(const char *path)
+{
+    struct sockaddr_un addr = { 0 };
+
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Serve socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    strcpy(link_cfg.path, path);
+
+    // Replace any socket left behind by a previous daemon
+    unlink(path);
+
+    if ((link_cfg.listen_sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        fprintf(stderr, "Error creating serve socket: %s\n", strerror(errno));
+        return 1;
+    }
+
+    if (bind(link_cfg.listen_sock, (struct sockaddr *) &addr, sizeof(addr)) == -1
+            || listen(link_cfg.listen_sock, CAPTURE_LINK_CLIENTS) == -1) {
+        fprintf(stderr, "Error binding serve socket %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    link_cfg.running = true;
+    if (pthread_create(&link_cfg.serve_thread, NULL, capture_serve_thread, NULL) != 0) {
+        fprintf(stderr, "Error creating serve thread: %s\n", strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
+
+void
+capture_serve_deinit()
+{
+    int i;
+
+    if (link_cfg.listen_sock > 0) {
+        link_cfg.running = false;
+        // Unblock the accept call so the thread can leave
+        close(link_cfg.listen_sock);
+        link_cfg.listen_sock = -1;
+        pthread_join(link_cfg.serve_thread, NULL);
+        unlink(link_cfg.path);
+    }
+
+    for (i = 0; i < CAPTURE_LINK_CLIENTS; i++) {
+        if (link_cfg.clients[i]) {
+            close(link_cfg.clients[i]);
+            link_cfg.clients[i] = 0;
+        }
+    }
+}
+
+void
+capture_serve_send(packet_t *packet)
+{
+    u_char buffer[MAX_CAPTURE_LEN];
+    int len = 0, i;
+
+    if (link_cfg.listen_sock <= 0)
+        return;
+
+    // Dont forward RTP packets
+    if (packet->type == PACKET_RTP)
+        return;
+
+    for (i = 0; i < CAPTURE_LINK_CLIENTS; i++) {
+        if (!link_cfg.clients[i])
+            continue;
+
+        // Serialize once, for the first attached frontend
+        if (!len && (len = capture_eep_serialize_v3(packet, buffer)) <= 0)
+            return;
+
+        // Detach frontends that are gone or not keeping up
+        if (send(link_cfg.clients[i], buffer, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len) {
+            close(link_cfg.clients[i]);
+            link_cfg.clients[i] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Frontend thread feeding the daemon stream into storage
+ *
+ * Reassembles HEP3 frames from the stream and parses them through the
+ * regular EEP ingest path, exactly like a TCP HEP connection.
+ */
+static void *
+capture_attach_thread(void *data)
+{
+    u_char buffer[MAX_CAPTURE_LEN];
+    uint32_t have = 0;
+    uint16_t framelen;
+    ssize_t received;
+    packet_t *pkt;
+
+    while (link_cfg.running) {
+        received = recv(link_cfg.attach_sock, buffer + have, sizeof(buffer) - have, 0);
+        // The daemon has gone away
+        if (received <= 0)
+            break;
+        have += received;
+
+        // Extract every complete frame from the stream
+        while (have >= 6) {
+            // Total frame length follows the HEP3 magic
+            memcpy(&framelen, buffer + 4, sizeof(framelen));
+            framelen = ntohs(framelen);
+            if (memcmp(buffer, "HEP3", 4) != 0
+                    || framelen < 6 || framelen > sizeof(buffer))
+                break;
+
+            // Wait for the rest of the frame
+            if (have < framelen)
+                break;
+
+            // Avoid parsing from multiples sources.
+            // Avoid parsing while screen in being redrawn
+            capture_lock();
+            if ((pkt = capture_eep_receive_v3(buffer, framelen))) {
+                if (capture_packet_parse(pkt) != 0) {
+                    packet_destroy(pkt);
+                }
+            }
+            capture_unlock();
+
+            // Shift the remaining bytes of the next frame
+            have -= framelen;
+            memmove(buffer, buffer + framelen, have);
+        }
+    }
+
+    pthread_exit(NULL);
+    return 0;
+}
+
+int
+capture_attach_init(const char *path)
+{
+    struct sockaddr_un addr = { 0 };
+
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Attach socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    if ((link_cfg.attach_sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        fprintf(stderr, "Error creating attach socket: %s\n", strerror(errno));
+        return 1;
+    }
+
+    if (connect(link_cfg.attach_sock, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        fprintf(stderr, "Error attaching to %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    link_cfg.running = true;
+    if (pthread_create(&link_cfg.attach_thread, NULL, capture_attach_thread, NULL) != 0) {
+        fprintf(stderr, "Error creating attach thread: %s\n", strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
+
+void
+capture_attach_deinit()
+{
+    if (link_cfg.attach_sock > 0) {
+        link_cfg.running = false;
+        // Unblock the recv call so the thread can leave
+        shutdown(link_cfg.attach_sock, SHUT_RDWR);
+        pthread_join(link_cfg.attach_thread, NULL);
+        close(link_cfg.attach_sock);
+        link_cfg.attach_sock = -1;
+    }
+}
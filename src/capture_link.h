@@ -0,0 +1,98 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_link.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to link a headless capture daemon with a frontend
+ *
+ * A daemon started with --serve keeps capturing and storing calls
+ * headless, and exposes them on a unix socket. A frontend started with
+ * --attach connects to that socket: the daemon first replays every
+ * stored packet as a snapshot and then streams new packets as they are
+ * captured, so the interface can be closed and reattached at any time
+ * without losing state.
+ *
+ * The wire format is HEP3, reusing the EEP serializers: frames are
+ * self-framing (magic plus total length) so the stream needs no extra
+ * protocol.
+ */
+
+#ifndef __SNGREP_CAPTURE_LINK_H
+#define __SNGREP_CAPTURE_LINK_H
+
+#include "config.h"
+#include "capture.h"
+
+//! Max number of frontends attached to a serving daemon
+#define CAPTURE_LINK_CLIENTS 8
+
+/**
+ * @brief Start serving captured calls on a unix socket
+ *
+ * Binds the socket and spawns a thread accepting frontend
+ * connections. Each accepted frontend receives a snapshot of the
+ * stored calls followed by the live packet stream.
+ *
+ * @param path Filesystem path of the unix socket
+ * @return 0 on success, 1 otherwise
+ */
+int
+capture_serve_init(const char *path);
+
+/**
+ * @brief Stop serving, disconnecting any attached frontend
+ */
+void
+capture_serve_deinit();
+
+/**
+ * @brief Forward a freshly captured packet to attached frontends
+ *
+ * Invoked from the capture path under the capture lock. Frontends
+ * that are not keeping up are detached instead of blocking capture.
+ *
+ * @param packet Packet to be forwarded
+ */
+void
+capture_serve_send(packet_t *packet);
+
+/**
+ * @brief Attach to a serving daemon socket
+ *
+ * Connects to the socket and spawns a thread feeding the received
+ * frames into the regular EEP ingest path, as if they had been
+ * captured locally.
+ *
+ * @param path Filesystem path of the unix socket
+ * @return 0 on success, 1 otherwise
+ */
+int
+capture_attach_init(const char *path);
+
+/**
+ * @brief Detach from the daemon socket
+ */
+void
+capture_attach_deinit();
+
+#endif /* __SNGREP_CAPTURE_LINK_H */
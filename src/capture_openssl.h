@@ -281,7 +281,8 @@ struct SSLConnection {
     EVP_CIPHER_CTX *client_cipher_ctx;
     EVP_CIPHER_CTX *server_cipher_ctx;
 
-    struct SSLConnection *next;
+    //! Connection hash table key (@see tls_connection_find)
+    char hashkey[48];
 };
 
 /**
@@ -0,0 +1,132 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_ring.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in capture_ring.h
+ *
+ */
+#include "config.h"
+#include <string.h>
+#include "capture_ring.h"
+#include "util.h"
+
+capture_ring_t *
+capture_ring_create()
+{
+    capture_ring_t *ring;
+
+    if (!(ring = sng_malloc(sizeof(capture_ring_t))))
+        return NULL;
+
+    if (!(ring->slots = malloc(CAPTURE_RING_SIZE * sizeof(capture_frame_t)))) {
+        sng_free(ring);
+        return NULL;
+    }
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+
+    return ring;
+}
+
+void
+capture_ring_destroy(capture_ring_t *ring)
+{
+    if (!ring)
+        return;
+    free(ring->slots);
+    sng_free(ring);
+}
+
+int
+capture_ring_push(capture_ring_t *ring, const struct pcap_pkthdr *header, const u_char *packet)
+{
+    capture_frame_t *slot;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    // Drop frames the parser would discard anyway
+    if (header->caplen > MAX_CAPTURE_LEN) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return 1;
+    }
+
+    // Ring is full, account the drop and keep capturing
+    if (head - tail == CAPTURE_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return 1;
+    }
+
+    // Copy frame data into the slot
+    slot = &ring->slots[head & (CAPTURE_RING_SIZE - 1)];
+    slot->header = *header;
+    memcpy(slot->data, packet, header->caplen);
+
+    // Publish the slot to the consumer
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 0;
+}
+
+capture_frame_t *
+capture_ring_read(capture_ring_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    // No pending frames
+    if (head == tail)
+        return NULL;
+
+    return &ring->slots[tail & (CAPTURE_RING_SIZE - 1)];
+}
+
+void
+capture_ring_commit(capture_ring_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    // Make the slot writable again for the producer
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+int
+capture_ring_empty(capture_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire)
+           == atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+int
+capture_ring_full(capture_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire)
+           - atomic_load_explicit(&ring->tail, memory_order_acquire)
+           == CAPTURE_RING_SIZE;
+}
+
+uint64_t
+capture_ring_dropped(capture_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,145 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_ring.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Lock free frame queue between capture and parser threads
+ *
+ * When capture.pipeline setting is enabled, the pcap capture thread no
+ * longer parses packets inline. Instead it copies each raw frame into
+ * this single-producer single-consumer ring and returns to the kernel
+ * as fast as possible, so a slow parser doesn't translate into kernel
+ * packet drops. One parser thread per capture source drains the ring.
+ */
+#ifndef __SNGREP_CAPTURE_RING_H
+#define __SNGREP_CAPTURE_RING_H
+
+#include "config.h"
+#include <stdatomic.h>
+#include <pcap.h>
+#include "capture.h"
+
+//! Number of frame slots of each capture ring (must be a power of two)
+#define CAPTURE_RING_SIZE 512
+
+//! Shorter declaration of capture_frame structure
+typedef struct capture_frame capture_frame_t;
+//! Shorter declaration of capture_ring structure
+typedef struct capture_ring capture_ring_t;
+
+/**
+ * @brief A raw frame as received from libpcap
+ *
+ * Frames bigger than MAX_CAPTURE_LEN are not enqueued; the parser
+ * would discard them anyway (@see parse_packet)
+ */
+struct capture_frame {
+    //! libpcap header with frame timestamp and lengths
+    struct pcap_pkthdr header;
+    //! Raw frame contents
+    u_char data[MAX_CAPTURE_LEN];
+};
+
+/**
+ * @brief Single producer, single consumer frame ring
+ *
+ * head is only written by the producer (capture thread) and tail is
+ * only written by the consumer (parser thread), so no locking is
+ * required: a slot is visible to the consumer only after the producer
+ * has published it with a release store on head.
+ */
+struct capture_ring {
+    //! Next slot to be written (owned by producer)
+    _Atomic uint32_t head;
+    //! Next slot to be read (owned by consumer)
+    _Atomic uint32_t tail;
+    //! Frames dropped because the ring was full or the frame too big
+    _Atomic uint64_t dropped;
+    //! Preallocated frame slots
+    capture_frame_t *slots;
+};
+
+/**
+ * @brief Allocate a new frame ring with all its slots
+ *
+ * @return an empty ring, or NULL if allocation fails
+ */
+capture_ring_t *
+capture_ring_create();
+
+/**
+ * @brief Deallocate ring memory
+ */
+void
+capture_ring_destroy(capture_ring_t *ring);
+
+/**
+ * @brief Copy a captured frame into the ring (producer side)
+ *
+ * @return 0 if the frame has been enqueued, 1 if it has been dropped
+ */
+int
+capture_ring_push(capture_ring_t *ring, const struct pcap_pkthdr *header, const u_char *packet);
+
+/**
+ * @brief Get the oldest unread frame of the ring (consumer side)
+ *
+ * The returned slot is owned by the consumer until it calls
+ * capture_ring_commit, which makes it writable again.
+ *
+ * @return oldest pending frame, or NULL if ring is empty
+ */
+capture_frame_t *
+capture_ring_read(capture_ring_t *ring);
+
+/**
+ * @brief Release the slot returned by capture_ring_read (consumer side)
+ */
+void
+capture_ring_commit(capture_ring_t *ring);
+
+/**
+ * @brief Check if the ring has no pending frames
+ *
+ * @return 1 if ring is empty, 0 otherwise
+ */
+int
+capture_ring_empty(capture_ring_t *ring);
+
+/**
+ * @brief Check if the ring has no free slots left
+ *
+ * @return 1 if ring is full, 0 otherwise
+ */
+int
+capture_ring_full(capture_ring_t *ring);
+
+/**
+ * @brief Get the number of frames dropped by this ring
+ *
+ * @return dropped frames count
+ */
+uint64_t
+capture_ring_dropped(capture_ring_t *ring);
+
+#endif /* __SNGREP_CAPTURE_RING_H */
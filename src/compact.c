@@ -0,0 +1,189 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file compact.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in compact.h
+ *
+ */
+#include "config.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+#include "compact.h"
+#include "capture.h"
+#include "setting.h"
+#include "sip.h"
+#include "util.h"
+
+//! Payloads smaller than this are not worth deflating
+#define COMPACT_MIN_PAYLOAD 128
+
+//! Compactor thread
+static pthread_t compact_t;
+//! Compactor thread running flag
+static bool compact_running = false;
+//! Seconds a call must stay idle before its payloads are deflated
+static int compact_idle = 0;
+
+#ifdef WITH_ZLIB
+
+/**
+ * @brief Deflate a stored packet payload in place
+ *
+ * The payload is replaced by its deflated form unless compression
+ * does not make it smaller.
+ */
+static void
+compact_packet(packet_t *packet)
+{
+    u_char *deflated;
+    uLongf deflated_len;
+
+    if (packet->payload_deflated || packet->payload_len < COMPACT_MIN_PAYLOAD)
+        return;
+
+    deflated_len = compressBound(packet->payload_len);
+    deflated = sng_malloc(deflated_len);
+
+    // Favour speed over ratio, payloads are small
+    if (compress2(deflated, &deflated_len, packet->payload,
+                  packet->payload_len, Z_BEST_SPEED) != Z_OK
+            || deflated_len >= packet->payload_len) {
+        // Not worth keeping deflated
+        sng_free(deflated);
+        return;
+    }
+
+    sng_free(packet->payload);
+    packet->payload = sng_malloc(deflated_len);
+    memcpy(packet->payload, deflated, deflated_len);
+    sng_free(deflated);
+    packet->payload_orig_len = packet->payload_len;
+    packet->payload_len = deflated_len;
+    packet->payload_deflated = true;
+}
+
+void
+compact_packet_restore(packet_t *packet)
+{
+    u_char *payload;
+    uLongf payload_len;
+
+    if (!packet->payload_deflated)
+        return;
+
+    // Readers treat the payload as a string, keep it terminated
+    payload_len = packet->payload_orig_len;
+    payload = sng_malloc(payload_len + 1);
+    if (uncompress(payload, &payload_len, packet->payload,
+                   packet->payload_len) != Z_OK) {
+        // Should not happen, leave an empty payload instead of garbage
+        payload_len = 0;
+    }
+    payload[payload_len] = '\0';
+
+    sng_free(packet->payload);
+    packet->payload = payload;
+    packet->payload_len = payload_len;
+    packet->payload_orig_len = 0;
+    packet->payload_deflated = false;
+}
+
+/**
+ * @brief Deflate payloads of every call idle for longer than the limit
+ */
+static void
+compact_calls()
+{
+    sip_call_t *call;
+    sip_msg_t *msg;
+    vector_iter_t calls, msgs;
+    time_t now = time(NULL);
+    struct timeval last;
+
+    calls = sip_calls_iterator();
+    while ((call = vector_iterator_next(&calls))) {
+        // Idle time is measured from the last captured message
+        if (!(msg = vector_last(call->msgs)))
+            continue;
+        last = msg_get_time(msg);
+        if (now - last.tv_sec < compact_idle)
+            continue;
+
+        msgs = vector_iterator(call->msgs);
+        while ((msg = vector_iterator_next(&msgs)))
+            compact_packet(msg->packet);
+    }
+}
+
+/**
+ * @brief Background thread deflating payloads of idle calls
+ */
+static void
+compact_thread_body()
+{
+    while (compact_running) {
+        sleep(1);
+        capture_lock();
+        compact_calls();
+        capture_unlock();
+    }
+}
+
+#else
+
+void
+compact_packet_restore(packet_t *packet)
+{
+    // Payloads are never deflated without zlib support
+}
+
+#endif /* WITH_ZLIB */
+
+void
+compact_init()
+{
+#ifdef WITH_ZLIB
+    compact_idle = setting_get_intvalue(SETTING_CAPTURE_COMPACT);
+    if (compact_idle <= 0)
+        return;
+
+    compact_running = true;
+    if (pthread_create(&compact_t, NULL, (void *) compact_thread_body, NULL))
+        compact_running = false;
+#endif
+}
+
+void
+compact_deinit()
+{
+    if (compact_running) {
+        compact_running = false;
+        pthread_join(compact_t, NULL);
+    }
+}
@@ -0,0 +1,68 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file compact.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Compressed cold storage for retained message payloads
+ *
+ * When sngrep is built with zlib and capture.compact is set to N
+ * seconds, a background thread deflates the payloads of calls that
+ * have been idle for longer than N. Payloads are inflated back
+ * transparently the first time msg_get_payload reads them, so the raw
+ * and diff views keep working unchanged.
+ *
+ */
+#ifndef __SNGREP_COMPACT_H
+#define __SNGREP_COMPACT_H
+
+#include "config.h"
+#include "packet.h"
+
+/**
+ * @brief Start the payload compactor thread
+ *
+ * Does nothing when capture.compact is 0 or sngrep was built without
+ * zlib support.
+ */
+void
+compact_init();
+
+/**
+ * @brief Stop the payload compactor thread
+ */
+void
+compact_deinit();
+
+/**
+ * @brief Inflate a deflated packet payload back in place
+ *
+ * Called by msg_get_payload before handing the payload to a reader.
+ * The packet becomes a candidate for compaction again once its call
+ * has been idle for long enough.
+ *
+ * @param packet Packet with a deflated payload
+ */
+void
+compact_packet_restore(packet_t *packet);
+
+#endif /* __SNGREP_COMPACT_H */
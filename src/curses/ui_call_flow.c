@@ -100,6 +100,11 @@ call_flow_create(ui_t *ui)
     info->columns = vector_create(2, 1);
     info->arrows = vector_create(20, 5);
     vector_set_sorter(info->arrows, call_flow_arrow_sorter);
+    info->progress = vector_create(2, 1);
+    vector_set_destroyer(info->progress, vector_generic_destroyer);
+
+    // Merged message iterator is created when the group is set
+    info->pending = call_group_msg_iterator(NULL);
 
     // Store it into panel userptr
     set_panel_userptr(ui->panel, (void*) info);
@@ -116,6 +121,9 @@ call_flow_destroy(ui_t *ui)
         vector_destroy_items(info->columns);
         // Delete panel arrows
         vector_destroy_items(info->arrows);
+        // Delete layout progress counters
+        vector_destroy(info->progress);
+        call_group_msg_iterator_destroy(&info->pending);
         // Delete panel windows
         delwin(info->flow_win);
         delwin(info->raw_win);
@@ -214,7 +222,10 @@ call_flow_draw(ui_t *ui)
         if (vector_iterator_current(&it) == info->first_arrow) {
             info->scroll.pos = info->scroll.max;
         }
-        info->scroll.max += call_flow_arrow_height(ui, arrow);
+        // Use the height cached while drawing when available
+        info->scroll.max += (arrow->height)
+                            ? arrow->height
+                            : call_flow_arrow_height(ui, arrow);
     }
     ui_scrollbar_draw(info->scroll);
 
@@ -248,6 +259,28 @@ call_flow_draw_footer(ui_t *ui)
     ui_draw_bindings(ui, keybindings, 22);
 }
 
+void
+call_flow_arrows_fetch(ui_t *ui, int total)
+{
+    call_flow_info_t *info;
+    call_flow_arrow_t *arrow;
+    sip_msg_t *msg;
+
+    // Get panel information
+    if (!(info = call_flow_info(ui)))
+        return;
+
+    while ((total < 0 || vector_count(info->arrows) < total)
+            && (msg = call_group_msg_iterator_next(&info->pending))) {
+        // Create columns for this message address pair
+        call_flow_column_add(ui, msg->call->callid, msg->packet->src);
+        call_flow_column_add(ui, msg->call->callid, msg->packet->dst);
+        // And the arrow that will draw it
+        arrow = call_flow_arrow_create(ui, msg, CF_ARROW_SIP);
+        vector_append(info->arrows, arrow);
+    }
+}
+
 int
 call_flow_draw_columns(ui_t *ui)
 {
@@ -255,7 +288,6 @@ call_flow_draw_columns(ui_t *ui)
     call_flow_column_t *column;
     sip_call_t *call = NULL;
     rtp_stream_t *stream;
-    sip_msg_t *msg = NULL;
     vector_iter_t streams;
     vector_iter_t columns;
     char coltext[MAX_SETTING_LEN];
@@ -271,11 +303,9 @@ call_flow_draw_columns(ui_t *ui)
         info->maxcallids = 2;
     }
 
-    // Load columns
-    while((msg = call_group_get_next_msg(info->group, msg))) {
-        call_flow_column_add(ui, msg->call->callid, msg->packet->src);
-        call_flow_column_add(ui, msg->call->callid, msg->packet->dst);
-    }
+    // Materialize arrows and columns for the visible window plus one
+    // screen of margin; scrolling down fetches more on later draws
+    call_flow_arrows_fetch(ui, info->first_arrow + 2 * getmaxy(info->flow_win));
 
     // Add RTP columns FIXME Really
     if (!setting_disabled(SETTING_CF_MEDIA)) {
@@ -345,20 +375,38 @@ call_flow_draw_arrows(ui_t *ui)
     // Get panel information
     info = call_flow_info(ui);
 
-    // Create pending SIP arrows
-    sip_msg_t *msg = NULL;
-    while ((msg = call_group_get_next_msg(info->group, msg))) {
-        if (!call_flow_arrow_find(ui, msg)) {
-            arrow = call_flow_arrow_create(ui, msg, CF_ARROW_SIP);
-            vector_append(info->arrows, arrow);
+    // Create arrows for streams that became active since the last
+    // draw; message arrows are materialized while loading columns
+    // (@see call_flow_arrows_fetch)
+    call_flow_progress_t *progress;
+    sip_call_t *call;
+    rtp_stream_t *stream;
+    vector_iter_t it;
+    int i, active;
+    for (i = 0; i < call_group_count(info->group); i++) {
+        call = vector_item(info->group->calls, i);
+        progress = call_flow_progress(ui, call);
+
+        // Create pending RTP arrows. Streams become interesting once
+        // they get their first packet, so count the active ones and
+        // rescan only when a new one has shown up
+        active = 0;
+        it = vector_iterator(call->streams);
+        while ((stream = vector_iterator_next(&it))) {
+            if (stream->type == PACKET_RTP && stream_get_count(stream))
+                active++;
         }
-    }
-    // Create pending RTP arrows
-    rtp_stream_t *stream = NULL;
-    while ((stream = call_group_get_next_stream(info->group, stream))) {
-        if (!call_flow_arrow_find(ui, stream)) {
-            arrow = call_flow_arrow_create(ui, stream, CF_ARROW_RTP);
-            vector_append(info->arrows, arrow);
+        if (progress->streams != active) {
+            it = vector_iterator(call->streams);
+            while ((stream = vector_iterator_next(&it))) {
+                if (stream->type != PACKET_RTP || !stream_get_count(stream))
+                    continue;
+                if (!call_flow_arrow_find(ui, stream)) {
+                    arrow = call_flow_arrow_create(ui, stream, CF_ARROW_RTP);
+                    vector_append(info->arrows, arrow);
+                }
+            }
+            progress->streams = active;
         }
     }
 
@@ -373,7 +421,7 @@ call_flow_draw_arrows(ui_t *ui)
     }
 
     // Draw arrows
-    vector_iter_t it = vector_iterator(info->darrows);
+    it = vector_iterator(info->darrows);
     vector_iterator_set_current(&it, info->first_arrow - 1);
     vector_iterator_set_filter(&it, call_flow_arrow_filter);
     while ((arrow = vector_iterator_next(&it))) {
@@ -497,9 +545,11 @@ call_flow_draw_message(ui_t *ui, call_flow_arrow_t *arrow, int cline)
     // Draw message type or status and line
     msglen = (strlen(method) > 24) ? 24 : strlen(method);
 
-    // Get origin and destination column
-    arrow->scolumn = call_flow_column_get(ui, callid, src);
-    arrow->dcolumn = call_flow_column_get(ui, callid, dst);
+    // Get origin and destination column, cached once per arrow
+    if (!arrow->scolumn)
+        arrow->scolumn = call_flow_column_get(ui, callid, src);
+    if (!arrow->dcolumn)
+        arrow->dcolumn = call_flow_column_get(ui, callid, dst);
 
     // Determine start and end position of the arrow line
     int startpos, endpos;
@@ -672,7 +722,7 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
 {
     call_flow_info_t *info;
     WINDOW *win;
-    char text[50], time[20];
+    char text[100], time[20];
     int height, width;
     const char *callid;
     rtp_stream_t *stream = arrow->item;
@@ -700,6 +750,13 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
     // Get arrow text
     sprintf(text, "RTP (%s) %d", stream_get_format(stream), stream_get_count(stream));
 
+    // Append quality metrics once there is enough traffic to measure
+    if (stream_get_count(stream) > 1) {
+        snprintf(text + strlen(text), sizeof(text) - strlen(text),
+                 " J=%.1f L=%u M=%.1f", stream_get_jitter(stream),
+                 stream_get_lost(stream), stream_get_mos(stream));
+    }
+
     // Get message data
     call = stream->media->msg->call;
     callid = call->callid;
@@ -713,7 +770,7 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
     msg = stream->media->msg;
 
     // If message and stream share the same IP address
-    if (address_equals(msg->packet->src, stream->dst)) {
+    if (!arrow->dcolumn && address_equals(msg->packet->src, stream->dst)) {
         // Reuse the msg arrow columns as destination column
         if ((msgarrow = call_flow_arrow_find(ui, msg))) {
             // Get origin and destination column
@@ -738,7 +795,7 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
     msg = call_msg_with_media(call, stream->src);
 
     // Try to find a message with configured SDP matching the source of this stream
-    if (msg && address_equals(msg->packet->src, stream->src)) {
+    if (!arrow->scolumn && msg && address_equals(msg->packet->src, stream->src)) {
         // Reuse the msg arrow columns as destination column
         if ((msgarrow = call_flow_arrow_find(ui, msg))) {
             // Get origin and destination column
@@ -881,15 +938,9 @@ call_flow_arrow_t *
 call_flow_arrow_create(ui_t *ui, void *item, int type)
 {
     call_flow_arrow_t *arrow;
-    call_flow_info_t *info;
-
-    if ((arrow = call_flow_arrow_find(ui, item)))
-        return arrow;
-
-    // Get panel information
-    info = call_flow_info(ui);
 
-    // Create a new arrow of the given type
+    // Create a new arrow of the given type. The caller must check no
+    // arrow exists for this item yet (@see call_flow_arrow_find)
     arrow = malloc(sizeof(call_flow_arrow_t));
     memset(arrow, 0, sizeof(call_flow_arrow_t));
     arrow->type = type;
@@ -945,6 +996,29 @@ call_flow_arrow_find(ui_t *ui, const void *data)
     return arrow;
 }
 
+call_flow_progress_t *
+call_flow_progress(ui_t *ui, sip_call_t *call)
+{
+    call_flow_info_t *info;
+    call_flow_progress_t *progress;
+    vector_iter_t it;
+
+    if (!(info = call_flow_info(ui)))
+        return NULL;
+
+    it = vector_iterator(info->progress);
+    while ((progress = vector_iterator_next(&it)))
+        if (progress->call == call)
+            return progress;
+
+    // First time this call is laid out
+    progress = malloc(sizeof(call_flow_progress_t));
+    memset(progress, 0, sizeof(call_flow_progress_t));
+    progress->call = call;
+    vector_append(info->progress, progress);
+    return progress;
+}
+
 sip_msg_t *
 call_flow_arrow_message(const  call_flow_arrow_t *arrow)
 {
@@ -1153,6 +1227,8 @@ call_flow_handle_key(ui_t *ui, int key)
                 call_flow_move(ui, 0);
                 break;
             case ACTION_END:
+                // Materialize every remaining arrow before jumping
+                call_flow_arrows_fetch(ui, -1);
                 call_flow_move(ui, vector_count(info->darrows));
                 break;
             case ACTION_SHOW_FLOW_EX:
@@ -1350,6 +1426,11 @@ call_flow_set_group(sip_call_group_t *group)
 
     vector_clear(info->columns);
     vector_clear(info->arrows);
+    vector_clear(info->progress);
+
+    // Restart the merged message iterator
+    call_group_msg_iterator_destroy(&info->pending);
+    info->pending = call_group_msg_iterator(group);
 
     info->group = group;
     info->cur_arrow = info->selected = -1;
@@ -1503,8 +1584,9 @@ call_flow_move(ui_t *ui, int arrowindex)
         // Draw the scrollbar
         vector_iterator_set_current(&it, info->first_arrow - 1);
         while ((arrow = vector_iterator_next(&it))) {
-            // Increase current arrow height position
-            curh += call_flow_arrow_height(ui, arrow);
+            // Increase current arrow height position, using the height
+            // cached while drawing when available
+            curh += (arrow->height) ? arrow->height : call_flow_arrow_height(ui, arrow);
             // If we have reached current arrow
             if (vector_iterator_current(&it) == info->cur_arrow) {
                 if (curh > flowh) {
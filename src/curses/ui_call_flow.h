@@ -66,6 +66,8 @@ typedef struct call_flow_info call_flow_info_t;
 typedef struct call_flow_column call_flow_column_t;
 //! Sorter declaration of struct call_flow_arrow
 typedef struct call_flow_arrow call_flow_arrow_t;
+//! Sorter declaration of struct call_flow_progress
+typedef struct call_flow_progress call_flow_progress_t;
 
 /**
  * @brief Call flow arrow types
@@ -129,6 +131,21 @@ struct call_flow_column {
     int colpos;
 };
 
+/**
+ * @brief Arrow layout progress of one displayed call
+ *
+ * Stream arrows are created incrementally: each redraw only processes
+ * the streams that became active since the last one, using these
+ * counters to know where the previous layout stopped. They are reset
+ * together with the arrow list (@see call_flow_set_group).
+ */
+struct call_flow_progress {
+    //! Call whose streams have been laid out
+    sip_call_t *call;
+    //! Active streams already turned into arrows
+    int streams;
+};
+
 /**
  * @brief Call flow Extended status information
  *
@@ -156,6 +173,10 @@ struct call_flow_info {
     scrollbar_t scroll;
     //! List of columns in the panel
     vector_t *columns;
+    //! Layout progress of each group call (call_flow_progress_t)
+    vector_t *progress;
+    //! Merged iterator over the group messages without an arrow yet
+    group_msg_iter_t pending;
     //! Max callids per column
     int maxcallids;
     //! Print timestamp next to the arrow
@@ -228,6 +249,21 @@ call_flow_draw(ui_t *ui);
 void
 call_flow_draw_footer(ui_t *ui);
 
+/**
+ * @brief Materialize arrows from the group merged message iterator
+ *
+ * Create arrows (and their address columns) for the next group
+ * messages until the arrow list holds total items or there are no
+ * messages left. This keeps huge dialogs usable: only the visible
+ * window plus a margin is laid out, and scrolling down materializes
+ * the rest on demand.
+ *
+ * @param ui UI structure pointer
+ * @param total Arrow list size to reach, -1 to materialize everything
+ */
+void
+call_flow_arrows_fetch(ui_t *ui, int total);
+
 /**
  * @brief Draw the visible columns in panel window
  *
@@ -300,8 +336,8 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline);
  * @brief Create a new arrow of given type
  *
  * Allocate memory for a new arrow of the given type and associate the
- * item pointer. If the arrow already exists in the ui arrows vector
- * this function will return that arrow instead of creating a new one.
+ * item pointer. The caller must check no arrow exists for the item yet
+ * (@see call_flow_arrow_find).
  *
  * This function WON'T add the arrow to any ui vector.
  *
@@ -340,6 +376,19 @@ call_flow_arrow_height(ui_t *ui, const call_flow_arrow_t *arrow);
 call_flow_arrow_t *
 call_flow_arrow_find(ui_t *ui, const void *data);
 
+/**
+ * @brief Get the layout progress of a group call
+ *
+ * Returns the progress counters of the given call, creating a zeroed
+ * entry the first time the call is laid out.
+ *
+ * @param ui UI structure pointer
+ * @param call Call member of the displayed group
+ * @return a pointer to the call progress counters
+ */
+call_flow_progress_t *
+call_flow_progress(ui_t *ui, sip_call_t *call);
+
 /**
  * @brief Return the SIP message associated with the arrow
  *
@@ -45,6 +45,7 @@
 #include "ui_filter.h"
 #include "ui_save.h"
 #include "sip.h"
+#include "spill.h"
 
 /**
  * Ui Structure definition for Call List panel
@@ -141,6 +142,7 @@ call_list_destroy(ui_t *ui)
         // Deallocate group data
         call_group_destroy(info->group);
         vector_destroy(info->dcalls);
+        sng_free(info->drawn);
 
         // Deallocate panel windows
         delwin(info->list_win);
@@ -187,11 +189,71 @@ call_list_resize(ui_t *ui)
     return 0;
 }
 
+/**
+ * @brief Bring the displayed calls vector up to date with the storage
+ *
+ * Keeps dcalls as an incrementally maintained copy of the stored calls
+ * that pass the display filters, so the header counters, the scrollbar
+ * geometry and the list itself never walk the full storage on redraw.
+ * The list is rebuilt from scratch only when the storage epoch or the
+ * sorting make the incremental append invalid.
+ */
+static void
+call_list_update_dcalls(ui_t *ui)
+{
+    call_list_info_t *info = call_list_info(ui);
+    sip_call_t *call = NULL;
+
+    // Store selected call
+    if (info->cur_call >= 0)
+        call = vector_item(info->dcalls, info->cur_call);
+
+    // Get the list of calls that are goint to be displayed
+    sip_sort_t sort = sip_sort_options();
+    info->dcalls_rebuilt = false;
+    if (!info->dcalls || info->dcalls_epoch != sip_calls_epoch()
+            || sort.by != SIP_ATTR_CALLINDEX || !sort.asc) {
+        // Rebuild the whole displayed list
+        vector_destroy(info->dcalls);
+        info->dcalls = vector_copy_if(sip_calls_vector(), filter_check_call);
+        info->dcalls_checked = vector_count(sip_calls_vector());
+        info->dcalls_epoch = sip_calls_epoch();
+        info->dcalls_rebuilt = true;
+    } else {
+        // Default sorting appends new calls at the bottom of the stored
+        // list, so only calls added since the last refresh must be checked
+        while (info->dcalls_checked < vector_count(sip_calls_vector())) {
+            sip_call_t *added = vector_item(sip_calls_vector(), info->dcalls_checked++);
+            if (filter_check_call(added))
+                vector_append(info->dcalls, added);
+        }
+    }
+
+    // If no active call, use the fist one (if exists)
+    if (info->cur_call == -1 && vector_count(info->dcalls)) {
+        info->cur_call = info->scroll.pos = 0;
+    }
+
+    // If autoscroll is enabled, select the last dialog
+    if (info->autoscroll)  {
+        if (sort.asc) {
+            call_list_move(ui, vector_count(info->dcalls) - 1);
+        } else {
+            call_list_move(ui, 0);
+        }
+    } else if (info->dcalls_rebuilt && call) {
+        // Relocate the selected call, its position may have changed
+        call_list_move(ui, vector_index(info->dcalls, call));
+    }
+}
+
 void
 call_list_draw_header(ui_t *ui)
 {
     const char *infile, *coldesc;
     int colpos, collen, i;
+    int loadprog, loadeta;
+    uint64_t loadskip;
     char sortind;
     const char *countlb;
     const char *device, *filterexpr, *filterbpf;
@@ -234,6 +296,26 @@ call_list_draw_header(ui_t *ui)
     wattroff(ui->win, COLOR_PAIR(CP_GREEN_ON_DEF));
     wattroff(ui->win, COLOR_PAIR(CP_RED_ON_DEF));
 
+    // Show progress of capture files still being loaded
+    if ((loadprog = capture_progress(&loadeta, &loadskip)) >= 0) {
+        if (loadeta >= 0) {
+            wprintw(ui->win, "[loading %d%%, eta %ds]", loadprog, loadeta);
+        } else {
+            wprintw(ui->win, "[loading %d%%]", loadprog);
+        }
+        // Frames discarded by the BPF pre-filter without being decoded
+        if (loadskip) {
+            wprintw(ui->win, "[skipped: %lu]", (unsigned long) loadskip);
+        }
+    }
+
+    // Warn if the dump file writer is losing packets
+    if (capture_dump_dropped()) {
+        wattron(ui->win, COLOR_PAIR(CP_RED_ON_DEF));
+        wprintw(ui->win, "[dump dropped: %lu]", (unsigned long) capture_dump_dropped());
+        wattroff(ui->win, COLOR_PAIR(CP_RED_ON_DEF));
+    }
+
     // Label for Display filter
     mvwprintw(ui->win, 3, 2, "Display Filter: ");
 
@@ -305,13 +387,21 @@ call_list_draw_header(ui_t *ui)
         countlb = "Dialogs";
     }
 
-    // Print calls count (also filtered)
-    sip_stats_t stats = sip_calls_stats();
+    // Print calls count (also filtered), maintained incrementally with
+    // the displayed calls vector instead of recounting the storage
+    int total = vector_count(sip_calls_vector());
+    int displayed = vector_count(info->dcalls);
     mvwprintw(ui->win, 1, 45, "%*s", 30, "");
-    if (stats.total != stats.displayed) {
-        mvwprintw(ui->win, 1, 45, "%s: %d (%d displayed)", countlb, stats.total, stats.displayed);
+    if (total != displayed) {
+        mvwprintw(ui->win, 1, 45, "%s: %d (%d displayed)", countlb, total, displayed);
     } else {
-        mvwprintw(ui->win, 1, 45, "%s: %d", countlb, stats.total);
+        mvwprintw(ui->win, 1, 45, "%s: %d", countlb, total);
+    }
+
+    // Show the storage footprint when a byte based limit is set
+    if (sip_get_memory_limit()) {
+        wprintw(ui->win, " [mem: %zu/%zuMB]",
+                sip_get_memory_usage() >> 20, sip_get_memory_limit() >> 20);
     }
 
 }
@@ -356,33 +446,27 @@ call_list_draw_list(ui_t *ui)
     list_win = info->list_win;
     getmaxyx(list_win, listh, listw);
 
-    // Store selected call
-    if (info->cur_call >= 0)
-        call = vector_item(info->dcalls, info->cur_call);
+    // The displayed calls vector is updated before the header is drawn
+    // (@see call_list_update_dcalls)
+    bool rebuilt = info->dcalls_rebuilt;
 
-    // Get the list of calls that are goint to be displayed
-    vector_destroy(info->dcalls);
-    info->dcalls = vector_copy_if(sip_calls_vector(), filter_check_call);
+    // Repaint every row when the list was rebuilt, the window geometry
+    // changed or the visible range moved
+    bool full = rebuilt || !info->drawn || info->drawn_rows != listh
+                || info->drawn_width != listw || info->drawn_pos != info->scroll.pos;
 
-    // If no active call, use the fist one (if exists)
-    if (info->cur_call == -1 && vector_count(info->dcalls)) {
-        info->cur_call = info->scroll.pos = 0;
-    }
-
-    // If autoscroll is enabled, select the last dialog
-    if (info->autoscroll)  {
-        sip_sort_t sort = sip_sort_options();
-        if (sort.asc) {
-            call_list_move(ui, vector_count(info->dcalls) - 1);
-        } else {
-            call_list_move(ui, 0);
-        }
-    } else if (call) {
-        call_list_move(ui, vector_index(info->dcalls, call));
+    // Resize the drawn rows snapshot with the window
+    if (!info->drawn || info->drawn_rows != listh) {
+        sng_free(info->drawn);
+        info->drawn = sng_malloc(sizeof(struct call_list_row) * listh);
+        info->drawn_rows = listh;
     }
+    info->drawn_width = listw;
+    info->drawn_pos = info->scroll.pos;
 
     // Clear call list before redrawing
-    werase(list_win);
+    if (full)
+        werase(list_win);
 
     // Set the iterator position to the first call
     vector_iter_t it = vector_iterator(info->dcalls);
@@ -398,12 +482,29 @@ call_list_draw_list(ui_t *ui)
         if (!call_msg_count(call))
             continue;
 
+        bool highlighted = (info->cur_call == vector_iterator_current(&it));
+        bool ingroup = call_group_exists(info->group, call);
+        struct call_list_row *row = &info->drawn[cline];
+
+        // Skip rows already painted like this in the last refresh
+        if (!full && row->call == call && !call->changed
+                && row->highlighted == highlighted && row->ingroup == ingroup) {
+            cline++;
+            continue;
+        }
+
+        // Remember how this row has been painted
+        call->changed = false;
+        row->call = call;
+        row->highlighted = highlighted;
+        row->ingroup = ingroup;
+
         // Show bold selected rows
-        if (call_group_exists(info->group, call))
+        if (ingroup)
             wattron(list_win, A_BOLD | COLOR_PAIR(CP_DEFAULT));
 
         // Highlight active call
-        if (info->cur_call == vector_iterator_current(&it)) {
+        if (highlighted) {
             wattron(list_win, COLOR_PAIR(CP_WHITE_ON_BLUE));
             // Reverse colors on monochrome terminals
             if (!has_colors())
@@ -412,7 +513,7 @@ call_list_draw_list(ui_t *ui)
         // Set current line background
         mvwprintw(list_win, cline, 0, "%*s", listw, "");
         // Set current line selection box
-        mvwprintw(list_win, cline, 2, call_group_exists(info->group, call) ? "[*]" : "[ ]");
+        mvwprintw(list_win, cline, 2, ingroup ? "[*]" : "[ ]");
 
         // Print requested columns
         colpos = 6;
@@ -436,8 +537,8 @@ call_list_draw_list(ui_t *ui)
 
             // Enable attribute color (if not current one)
             color = 0;
-            if (info->cur_call != vector_iterator_current(&it)) {
-                if ((color = sip_attr_get_color(colid, coltext)) > 0) {
+            if (!highlighted) {
+                if ((color = call_get_attribute_color(call, colid, coltext)) > 0) {
                     wattron(list_win, color);
                 }
             }
@@ -457,6 +558,15 @@ call_list_draw_list(ui_t *ui)
         wattroff(list_win, A_BOLD | A_REVERSE);
     }
 
+    // Clear rows left over from a longer list
+    for (; cline < listh; cline++) {
+        if (!full && info->drawn[cline].call) {
+            wmove(list_win, cline, 0);
+            wclrtoeol(list_win);
+        }
+        info->drawn[cline].call = NULL;
+    }
+
     // Draw scrollbar to the right
     info->scroll.max = vector_count(info->dcalls);
     ui_scrollbar_draw(info->scroll);
@@ -474,6 +584,8 @@ call_list_draw(ui_t *ui)
     // Store cursor position
     getyx(ui->win, cury, curx);
 
+    // Update the displayed calls, the header counters depend on it
+    call_list_update_dcalls(ui);
     // Draw the header
     call_list_draw_header(ui);
     // Draw the footer
@@ -655,6 +767,9 @@ call_list_handle_key(ui_t *ui, int key)
             case ACTION_SHOW_STATS:
                 ui_create_panel(PANEL_STATS);
                 break;
+            case ACTION_SHOW_PERF:
+                ui_create_panel(PANEL_PERF);
+                break;
             case ACTION_SAVE:
                 if (capture_sources_count() > 1) {
                     dialog_run("Saving is not possible when multiple input sources are specified.");
@@ -826,6 +941,10 @@ call_list_handle_form_key(ui_t *ui, int key)
 
     // Set display filter
     filter_set(FILTER_CALL_LIST, strlen(dfilter) ? dfilter : NULL);
+
+    // A search that misses memory may still hit the disk spill ring
+    if (strlen(dfilter))
+        spill_search(dfilter);
     free(dfilter);
 
     // Return if this panel has handled or not the key
@@ -1010,50 +1129,33 @@ void
 call_list_move(ui_t *ui, int line)
 {
     call_list_info_t *info;
+    int count;
 
     // Get panel info
     if (!(info = call_list_info(ui)))
         return;
 
-    // Already in this position?
-    if (info->cur_call == line)
+    // Nothing to select in an empty list
+    if (!(count = vector_count(info->dcalls)))
         return;
 
-    // Moving down or up?
-    bool move_down = (info->cur_call < line);
-
-    vector_iter_t it = vector_iterator(info->dcalls);
-    vector_iterator_set_current(&it, info->cur_call);
+    // Keep the position inside the displayed list
+    if (line >= count)
+        line = count - 1;
+    if (line < 0)
+        line = 0;
 
-    if (move_down) {
-        while (info->cur_call < line) {
-            // Check if there is a call below us
-            if (!vector_iterator_next(&it))
-               break;
+    // Already in this position?
+    if (info->cur_call == line)
+        return;
 
-            // Increase current call position
-            info->cur_call++;
+    info->cur_call = line;
 
-            // If we are out of the bottom of the displayed list
-            // refresh it starting in the next call
-            if (info->cur_call - info->scroll.pos == getmaxy(info->list_win)) {
-               info->scroll.pos++;
-            }
-        }
-    } else {
-        while (info->cur_call > line) {
-            // Check if there is a call above us
-            if (!vector_iterator_prev(&it))
-              break;
-            // If we are out of the top of the displayed list
-            // refresh it starting in the previous (in fact current) call
-            if (info->cur_call ==  info->scroll.pos) {
-              info->scroll.pos--;
-            }
-            // Move current call position
-            info->cur_call--;
-        }
-    }
+    // Scroll the list window just enough to keep the selection visible
+    if (info->scroll.pos > line)
+        info->scroll.pos = line;
+    if (line - info->scroll.pos >= getmaxy(info->list_win))
+        info->scroll.pos = line - getmaxy(info->list_win) + 1;
 }
 
 void
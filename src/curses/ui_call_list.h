@@ -65,6 +65,21 @@ struct call_list_column {
     int width;
 };
 
+/**
+ * @brief Snapshot of a drawn call list row
+ *
+ * Stores what was painted on a list row in the last refresh, so rows
+ * that have not changed since are not repainted.
+ */
+struct call_list_row {
+    //! Call drawn in the row
+    sip_call_t *call;
+    //! The row was drawn highlighted as the selected call
+    bool highlighted;
+    //! The row was drawn inside the selection group
+    bool ingroup;
+};
+
 /**
  * @brief Call List panel status information
  *
@@ -74,6 +89,12 @@ struct call_list_column {
 struct call_list_info {
     //! Displayed calls vector
     vector_t *dcalls;
+    //! Stored calls already checked against display filters
+    int dcalls_checked;
+    //! Storage epoch when dcalls was built (@see sip_calls_epoch)
+    unsigned int dcalls_epoch;
+    //! The last refresh rebuilt dcalls from scratch
+    bool dcalls_rebuilt;
     //! Selected call in the list
     int cur_call;
     //! Selected calls with space
@@ -100,6 +121,14 @@ struct call_list_info {
     int autoscroll;
     //! List scrollbar
     scrollbar_t scroll;
+    //! Rows painted in the last refresh, to repaint only changed ones
+    struct call_list_row *drawn;
+    //! Number of rows in the drawn snapshot
+    int drawn_rows;
+    //! List window width of the drawn snapshot
+    int drawn_width;
+    //! Scroll position of the drawn snapshot
+    int drawn_pos;
 };
 
 /**
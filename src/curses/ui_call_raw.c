@@ -75,6 +75,7 @@ call_raw_destroy(ui_t *ui)
     if ((info = call_raw_info(ui))) {
         // Delete panel windows
         delwin(info->pad);
+        call_group_msg_iterator_destroy(&info->iter);
         sng_free(info);
     }
     ui_panel_destroy(ui);
@@ -108,8 +109,11 @@ call_raw_draw(ui_t *ui)
         return -1;
 
     if (info->group) {
-        // Print the call group messages into the pad
-        while ((msg = call_group_get_next_msg(info->group, info->last)))
+        // Print group messages into the pad, stopping once the visible
+        // part plus one screen of margin is covered; scrolling down
+        // prints the rest on demand
+        while (info->padline < info->scroll + 2 * ui->height
+                && (msg = call_group_msg_iterator_next(&info->iter)))
             call_raw_print_msg(ui, msg);
     } else {
         call_raw_set_msg(info->msg);
@@ -321,6 +325,10 @@ call_raw_set_group(sip_call_group_t *group)
     info->group = group;
     info->msg = NULL;
 
+    // Restart the merged message iterator
+    call_group_msg_iterator_destroy(&info->iter);
+    info->iter = call_group_msg_iterator(group);
+
     // Initialize internal pad
     info->padline = 0;
     wclear(info->pad);
@@ -51,6 +51,8 @@ struct call_raw_info {
     sip_msg_t *msg;
     //! Last printed message on panel (Call raw display)
     sip_msg_t *last;
+    //! Merged iterator over the group messages (Call raw display)
+    group_msg_iter_t iter;
     //! Window pad to copy on displayed screen
     WINDOW *pad;
     //! Already used lines of the window pad
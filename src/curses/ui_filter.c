@@ -390,6 +390,9 @@ filter_save_options(ui_t *ui)
     // Set Method filter
     filter_method_from_setting(method_expr);
 
+    // Push address filters into the kernel capture filter
+    filter_bpf_pushdown();
+
     // Force filter evaluation
     filter_reset_calls();
     // TODO FIXME Refresh call list FIXME
@@ -32,6 +32,10 @@
 #include <math.h>
 #include <stdlib.h>
 #include <locale.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/time.h>
 #include "setting.h"
 #include "ui_manager.h"
 #include "capture.h"
@@ -51,6 +55,30 @@
  * and pointer to their main functions.
 
  */
+//! Self pipe to wake the input loop when stored data changes
+static int ui_notify_fd[2] = { -1, -1 };
+//! Avoid writing one notification per captured packet
+static bool ui_notify_pending = false;
+
+/**
+ * @brief Wake the input loop, stored data has changed
+ *
+ * Invoked by the capture layer under the capture lock every time a
+ * packet is stored (@see capture_set_change_callback). A single byte
+ * is kept in the pipe until the input loop consumes it, so packet
+ * bursts cost one write.
+ */
+static void
+ui_notify_change()
+{
+    if (!ui_notify_pending && ui_notify_fd[1] != -1) {
+        ui_notify_pending = true;
+        if (write(ui_notify_fd[1], "x", 1) != 1) {
+            // Pipe is full or closed, the timeout will catch up
+        }
+    }
+}
+
 static ui_t *panel_pool[] = {
     &ui_call_list,
     &ui_call_flow,
@@ -60,7 +88,8 @@ static ui_t *panel_pool[] = {
     &ui_msg_diff,
     &ui_column_select,
     &ui_settings,
-    &ui_stats
+    &ui_stats,
+    &ui_perf
 };
 
 int
@@ -139,12 +168,26 @@ ncurses_init()
     init_pair(CP_CYAN_ON_WHITE, COLOR_CYAN, COLOR_WHITE);
     init_pair(CP_CYAN_ON_BLACK, COLOR_CYAN, COLOR_BLACK);
 
+    // Wake the input loop as soon as stored data changes
+    if (pipe(ui_notify_fd) == 0) {
+        fcntl(ui_notify_fd[0], F_SETFL, O_NONBLOCK);
+        fcntl(ui_notify_fd[1], F_SETFL, O_NONBLOCK);
+        capture_set_change_callback(ui_notify_change);
+    }
+
     return 0;
 }
 
 void
 ncurses_deinit()
 {
+    // Stop receiving data change notifications
+    capture_set_change_callback(NULL);
+    if (ui_notify_fd[0] != -1) {
+        close(ui_notify_fd[0]);
+        close(ui_notify_fd[1]);
+        ui_notify_fd[0] = ui_notify_fd[1] = -1;
+    }
     // Clear screen before leaving
     refresh();
     // End ncurses mode
@@ -182,12 +225,86 @@ ui_find_by_type(enum panel_types type)
     return NULL;
 }
 
+//! Ingest rate in packets per second that slows down redraws
+#define UI_THROTTLE_RATE 2000
+
+//! Minimum microseconds between redraws for each throttle level
+static const uint64_t ui_throttle_usecs[] = { 0, 500000, 2000000 };
+
+/**
+ * @brief Return the current redraw throttle level under capture load
+ *
+ * Samples the kernel capture counters once per second. Level 1 slows
+ * the refresh cadence while the ingest rate is high, level 2 while the
+ * kernel is dropping packets; level 0 redraws on every change.
+ */
+static int
+ui_throttle_level()
+{
+    static struct timeval last = { 0 };
+    static uint64_t last_recv = 0, last_drop = 0;
+    static int level = 0;
+    struct timeval now;
+    uint64_t recv, drop, elapsed;
+
+    gettimeofday(&now, NULL);
+    elapsed = (now.tv_sec - last.tv_sec) * 1000000 + now.tv_usec - last.tv_usec;
+    if (elapsed < 1000000)
+        return level;
+
+    capture_kernel_stats(&recv, &drop);
+    if (drop > last_drop) {
+        level = 2;
+    } else if ((recv - last_recv) * 1000000 / elapsed > UI_THROTTLE_RATE) {
+        level = 1;
+    } else {
+        level = 0;
+    }
+
+    last = now;
+    last_recv = recv;
+    last_drop = drop;
+    return level;
+}
+
+/**
+ * @brief Check if a pending redraw must wait for the throttle interval
+ *
+ * While capture is under pressure changes are coalesced into fewer
+ * redraws, so the interface stops competing with the parser for the
+ * lock and CPU exactly when capture needs them most.
+ *
+ * @return true to postpone the redraw, false to draw now
+ */
+static bool
+ui_redraw_deferred()
+{
+    static struct timeval lastdraw = { 0 };
+    struct timeval now;
+    uint64_t min = ui_throttle_usecs[ui_throttle_level()];
+
+    gettimeofday(&now, NULL);
+    if (min) {
+        uint64_t since = (now.tv_sec - lastdraw.tv_sec) * 1000000
+                         + now.tv_usec - lastdraw.tv_usec;
+        if (since < min)
+            return true;
+    }
+
+    lastdraw = now;
+    return false;
+}
+
 int
 ui_wait_for_input()
 {
     ui_t *ui;
     WINDOW *win;
     PANEL *panel;
+    fd_set fds;
+    struct timeval timeout;
+    char drained[32];
+    int c, maxfd;
 
     // While there are still panels
     while ((panel = panel_below(NULL))) {
@@ -195,24 +312,24 @@ ui_wait_for_input()
         // Get panel interface structure
         ui = ui_find_by_panel(panel);
 
-        // Set character input timeout 200 ms
-        halfdelay(REFRESHTHSECS);
-
         // Avoid parsing any packet while UI is being drawn
         capture_lock();
         // Query the interface if it needs to be redrawn
-        if (ui_draw_redraw(ui)) {
+        if (ui_draw_redraw(ui) && !ui_redraw_deferred()) {
             // Redraw this panel
             if (ui_draw_panel(ui) != 0) {
                 capture_unlock();
                 return -1;
             }
+            capture_unlock();
+            // Flush the drawn screen to the terminal with capture
+            // running: on slow (remote) terminals this is by far the
+            // longest part of a redraw and only touches curses buffers
+            update_panels();
+            doupdate();
+        } else {
+            capture_unlock();
         }
-        capture_unlock();
-
-        // Update panel stack
-        update_panels();
-        doupdate();
 
         // Get topmost panel
         panel = panel_below(NULL);
@@ -221,12 +338,37 @@ ui_wait_for_input()
         win = panel_window(panel);
         keypad(win, TRUE);
 
-        // Get pressed key
-        int c = wgetch(win);
+        // Check for a key already buffered by ncurses before sleeping
+        nodelay(win, TRUE);
+        c = wgetch(win);
+        nodelay(win, FALSE);
+
+        // No pending input: sleep until a key is pressed or stored
+        // data changes, instead of redrawing on a fixed timer
+        if (c == ERR) {
+            FD_ZERO(&fds);
+            FD_SET(STDIN_FILENO, &fds);
+            maxfd = STDIN_FILENO;
+            if (ui_notify_fd[0] != -1) {
+                FD_SET(ui_notify_fd[0], &fds);
+                if (ui_notify_fd[0] > maxfd)
+                    maxfd = ui_notify_fd[0];
+            }
+
+            // Keep the old refresh interval as a safety net
+            timeout.tv_sec = 0;
+            timeout.tv_usec = REFRESHTHSECS * 100000;
 
-        // Timeout, no key pressed
-        if (c == ERR)
+            if (select(maxfd + 1, &fds, NULL, NULL, &timeout) > 0
+                    && ui_notify_fd[0] != -1 && FD_ISSET(ui_notify_fd[0], &fds)) {
+                // Consume the notification, changes are drawn next cycle
+                ui_notify_pending = false;
+                if (read(ui_notify_fd[0], drained, sizeof(drained)) < 0) {
+                    // Nothing to do, changes are drawn anyway
+                }
+            }
             continue;
+        }
 
         capture_lock();
         // Handle received key
@@ -110,34 +110,181 @@ msg_diff_info(ui_t *ui)
     return (msg_diff_info_t*) panel_userptr(ui->panel);
 }
 
-int
-msg_diff_line_highlight(const char* payload1, const char* payload2, char *highlight)
+/**
+ * @brief One payload line prepared for diffing
+ */
+struct msg_diff_line {
+    //! Offset of the first line character inside the payload
+    int offset;
+    //! Line length in characters, including the line feed
+    int length;
+    //! Hash of the line contents, ignoring carriage returns
+    uint32_t hash;
+};
+
+/**
+ * @brief Split a payload into hashed lines
+ *
+ * Lines are compared through their hashes while running the diff, so
+ * each one is hashed once here instead of once per comparison.
+ *
+ * @return number of lines stored, up to MAX_DIFF_LINES
+ */
+static int
+msg_diff_split_lines(const char *payload, struct msg_diff_line *lines)
+{
+    struct msg_diff_line *line = NULL;
+    int count = 0, i;
+
+    for (i = 0; payload[i]; i++) {
+        if (!line) {
+            if (count == MAX_DIFF_LINES)
+                break;
+            line = &lines[count++];
+            line->offset = i;
+            line->length = 0;
+            line->hash = 5381;
+        }
+        line->length++;
+        // Hash the line contents, ignoring line endings
+        if (payload[i] != '\r' && payload[i] != '\n')
+            line->hash = line->hash * 33 + (unsigned char) payload[i];
+        if (payload[i] == '\n')
+            line = NULL;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Check if two payload lines have the same contents
+ *
+ * Hashes discard most of the comparisons, matching hashes are verified
+ * against the real contents (ignoring line endings) to be safe from
+ * collisions.
+ */
+static bool
+msg_diff_line_equals(const char *payload1, struct msg_diff_line *one,
+                     const char *payload2, struct msg_diff_line *two)
+{
+    int i = 0, j = 0;
+
+    if (one->hash != two->hash)
+        return false;
+
+    for (;;) {
+        while (i < one->length && payload1[one->offset + i] == '\r')
+            i++;
+        while (j < two->length && payload2[two->offset + j] == '\r')
+            j++;
+        if (i == one->length || j == two->length)
+            break;
+        if (payload1[one->offset + i] != payload2[two->offset + j])
+            return false;
+        i++;
+        j++;
+    }
+
+    return (i == one->length && j == two->length);
+}
+
+/**
+ * @brief Diff two payloads, marking their changed lines
+ *
+ * Run a line based Myers diff over the hashed lines of both payloads.
+ * Lines that are not part of the longest common subsequence get their
+ * characters marked with '1' in the corresponding highlight mask.
+ */
+static void
+msg_diff_payloads(const char *payload1, const char *payload2,
+                  char *highlight1, char *highlight2)
 {
-    char search[MAX_SIP_PAYLOAD];
-    int len, i;
-
-    // Initialize search terms
-    memset(search, 0, sizeof(search));
-    len = 0;
-
-    for (i = 0; i < strlen(payload1); i++) {
-        // Store this char in the search term
-        search[len++] = payload1[i];
-        // If we have a full line in search array
-        if (payload1[i] == '\n') {
-            // Check if this line is in the other payload
-            if (strstr(payload2, search) == NULL) {
-                // Highlight this line as different from the other payload
-                memset(highlight + i - len + 1, '1', len);
+    struct msg_diff_line *one, *two;
+    int **trace, *v, *pv;
+    int n, m, max, vsize, found = -1;
+    int d, k, pk, x, y, px, py, end;
+
+    one = sng_malloc(sizeof(struct msg_diff_line) * MAX_DIFF_LINES);
+    two = sng_malloc(sizeof(struct msg_diff_line) * MAX_DIFF_LINES);
+    n = msg_diff_split_lines(payload1, one);
+    m = msg_diff_split_lines(payload2, two);
+
+    // Whatever exceeds the tracked lines is plainly marked as changed
+    if (n == MAX_DIFF_LINES) {
+        end = one[n - 1].offset + one[n - 1].length;
+        memset(highlight1 + end, '1', strlen(payload1) - end);
+    }
+    if (m == MAX_DIFF_LINES) {
+        end = two[m - 1].offset + two[m - 1].length;
+        memset(highlight2 + end, '1', strlen(payload2) - end);
+    }
+
+    // Furthest reaching x position of each diagonal, one snapshot per
+    // edit distance for the backtracking phase
+    max = n + m;
+    vsize = (2 * max + 1) * sizeof(int);
+    v = sng_malloc(vsize + sizeof(int));
+    trace = sng_malloc((max + 1) * sizeof(int *));
+
+    // Forward phase: find the smallest edit distance between payloads
+    for (d = 0; d <= max && found < 0; d++) {
+        trace[d] = sng_malloc(vsize + sizeof(int));
+        memcpy(trace[d], v, vsize + sizeof(int));
+        for (k = -d; k <= d; k += 2) {
+            if (k == -d || (k != d && v[max + k - 1] < v[max + k + 1])) {
+                x = v[max + k + 1];
+            } else {
+                x = v[max + k - 1] + 1;
             }
+            y = x - k;
+            // Follow the snake of equal lines
+            while (x < n && y < m && msg_diff_line_equals(payload1, &one[x], payload2, &two[y])) {
+                x++;
+                y++;
+            }
+            v[max + k] = x;
+            if (x >= n && y >= m) {
+                found = d;
+                break;
+            }
+        }
+    }
 
-            // Reset search terms
-            memset(search, 0, sizeof(search));
-            len = 0;
+    // Backward phase: mark the inserted and removed lines of each step
+    x = n;
+    y = m;
+    for (d = found; d > 0; d--) {
+        pv = trace[d];
+        k = x - y;
+        if (k == -d || (k != d && pv[max + k - 1] < pv[max + k + 1])) {
+            pk = k + 1;
+        } else {
+            pk = k - 1;
+        }
+        px = pv[max + pk];
+        py = px - pk;
+        // Skip back over the snake of equal lines
+        while (x > px && y > py) {
+            x--;
+            y--;
+        }
+        if (x == px) {
+            // This step inserted a line in the second payload
+            y--;
+            memset(highlight2 + two[y].offset, '1', two[y].length);
+        } else {
+            // This step removed a line from the first payload
+            x--;
+            memset(highlight1 + one[x].offset, '1', one[x].length);
         }
     }
 
-    return 0;
+    for (d = 0; d <= found; d++)
+        sng_free(trace[d]);
+    sng_free(trace);
+    sng_free(v);
+    sng_free(one);
+    sng_free(two);
 }
 
 void
@@ -156,16 +303,11 @@ msg_diff_draw(ui_t *ui)
 {
     // Get panel information
     msg_diff_info_t *info = msg_diff_info(ui);
-    char highlight[MAX_SIP_PAYLOAD];
 
-    // Draw first message
-    memset(highlight, 0, sizeof(highlight));
-    msg_diff_line_highlight(msg_get_payload(info->one), msg_get_payload(info->two), highlight);
-    msg_diff_draw_message(info->one_win, info->one, highlight);
-    // Draw second message
-    memset(highlight, 0, sizeof(highlight));
-    msg_diff_line_highlight(msg_get_payload(info->two), msg_get_payload(info->one), highlight);
-    msg_diff_draw_message(info->two_win, info->two, highlight);
+    // Repaint both messages using the diff masks computed when the
+    // message pair was set
+    msg_diff_draw_message(info->one_win, info->one, info->one_highlight);
+    msg_diff_draw_message(info->two_win, info->two, info->two_highlight);
 
     // Redraw footer
     msg_diff_draw_footer(ui);
@@ -232,6 +374,13 @@ msg_diff_set_msgs(ui_t *ui, sip_msg_t *one, sip_msg_t *two)
     info->one = one;
     info->two = two;
 
+    // Compute the payload diff once for this pair, redraws just
+    // repaint the stored masks
+    memset(info->one_highlight, 0, sizeof(info->one_highlight));
+    memset(info->two_highlight, 0, sizeof(info->two_highlight));
+    msg_diff_payloads(msg_get_payload(one), msg_get_payload(two),
+                      info->one_highlight, info->two_highlight);
+
     return 0;
 }
 
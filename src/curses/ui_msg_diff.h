@@ -34,6 +34,9 @@
 //! Sorter declaration of struct msg_diff_info
 typedef struct msg_diff_info msg_diff_info_t;
 
+//! Maximum number of payload lines the diff will track per message
+#define MAX_DIFF_LINES 512
+
 /**
  * @brief Call raw status information
  *
@@ -49,6 +52,10 @@ struct msg_diff_info {
     WINDOW *one_win;
     //! Right displayed subwindow
     WINDOW *two_win;
+    //! Diff mask of the first payload, computed once per message pair
+    char one_highlight[MAX_SIP_PAYLOAD];
+    //! Diff mask of the second payload, computed once per message pair
+    char two_highlight[MAX_SIP_PAYLOAD];
 };
 
 /**
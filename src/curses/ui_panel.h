@@ -74,6 +74,8 @@ enum panel_types {
     PANEL_SETTINGS,
     //! Stats panel
     PANEL_STATS,
+    //! Performance counters panel
+    PANEL_PERF,
     //! Panel Counter
     PANEL_COUNT,
 };
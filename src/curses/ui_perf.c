@@ -0,0 +1,134 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file ui_perf.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in ui_perf.h
+ */
+/*
+ * +---------------------------------------------------------+
+ * |                 Performance Information                 |
+ * +---------------------------------------------------------+
+ * |  Captured: 72522               Kernel recv: 80000       |
+ * |  Parsed:   70233               Kernel drop: 120         |
+ * |  Matched:  70100                                        |
+ * |  Dropped:  2289                                         |
+ * +---------------------------------------------------------+
+ * |  PARSE: 70233 samples          STORE: 70233 samples     |
+ * |  avg 12 us, max 312 us         avg 3 us, max 150 us     |
+ * |  < 8 us:    123                < 8 us:    4223          |
+ * |  < 16 us:   63211              < 16 us:   65000         |
+ * |  ...                                                    |
+ * +---------------------------------------------------------+
+ * |               Press any key to continue                 |
+ * +---------------------------------------------------------+
+ *
+ */
+#include "config.h"
+#include "perf.h"
+#include "ui_manager.h"
+#include "ui_perf.h"
+
+/**
+ * Ui Structure definition for Perf panel
+ */
+ui_t ui_perf = {
+    .type = PANEL_PERF,
+    .panel = NULL,
+    .create = perf_create,
+    .destroy = ui_panel_destroy,
+    .handle_key = NULL
+};
+
+/**
+ * @brief Print one latency histogram column
+ */
+static void
+perf_draw_histogram(ui_t *ui, perf_stats_t *stats, enum perf_timer timer,
+                    const char *label, int col)
+{
+    int bucket, first, last, line;
+
+    mvwprintw(ui->win, 11, col, "%s: %lu samples", label,
+              (unsigned long) stats->samples[timer]);
+
+    if (!stats->samples[timer])
+        return;
+
+    mvwprintw(ui->win, 12, col, "avg %lu us, max %lu us",
+              (unsigned long) (stats->total_us[timer] / stats->samples[timer]),
+              (unsigned long) stats->max_us[timer]);
+
+    // Skip leading and trailing empty buckets
+    for (first = 0; first < PERF_HIST_BUCKETS - 1; first++) {
+        if (stats->hist[timer][first])
+            break;
+    }
+    for (last = PERF_HIST_BUCKETS - 1; last > first; last--) {
+        if (stats->hist[timer][last])
+            break;
+    }
+
+    line = 13;
+    for (bucket = first; bucket <= last && line < ui->height - 3; bucket++, line++) {
+        mvwprintw(ui->win, line, col, "< %lu us: %lu",
+                  (unsigned long) 1 << bucket,
+                  (unsigned long) stats->hist[timer][bucket]);
+    }
+}
+
+void
+perf_create(ui_t *ui)
+{
+    perf_stats_t stats;
+
+    // Calculate window dimensions
+    ui_panel_create(ui, 25, 60);
+
+    // Set the window title and boxes
+    mvwprintw(ui->win, 1, ui->width / 2 - 12, "Performance Information");
+    wattron(ui->win, COLOR_PAIR(CP_BLUE_ON_DEF));
+    title_foot_box(ui->panel);
+    mvwhline(ui->win, 10, 1, ACS_HLINE, ui->width - 1);
+    mvwaddch(ui->win, 10, 0, ACS_LTEE);
+    mvwaddch(ui->win, 10, ui->width - 1, ACS_RTEE);
+    mvwprintw(ui->win, ui->height - 2, ui->width / 2 - 9, "Press ESC to leave");
+    wattroff(ui->win, COLOR_PAIR(CP_BLUE_ON_DEF));
+
+    // Read the current counters snapshot
+    stats = perf_get_stats();
+
+    // Pipeline stage counters
+    mvwprintw(ui->win, 3, 3, "Captured: %lu", (unsigned long) stats.stage[PERF_CAPTURED]);
+    mvwprintw(ui->win, 4, 3, "Parsed:   %lu", (unsigned long) stats.stage[PERF_PARSED]);
+    mvwprintw(ui->win, 5, 3, "Matched:  %lu", (unsigned long) stats.stage[PERF_MATCHED]);
+    mvwprintw(ui->win, 6, 3, "Dropped:  %lu", (unsigned long) stats.stage[PERF_DROPPED]);
+
+    // Kernel counters, only available on live captures
+    mvwprintw(ui->win, 3, 33, "Kernel recv: %lu", (unsigned long) stats.kernel_recv);
+    mvwprintw(ui->win, 4, 33, "Kernel drop: %lu", (unsigned long) stats.kernel_drop);
+
+    // Latency histograms
+    perf_draw_histogram(ui, &stats, PERF_TIMER_PARSE, "PARSE", 3);
+    perf_draw_histogram(ui, &stats, PERF_TIMER_STORE, "STORE", 33);
+}
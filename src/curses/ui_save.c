@@ -405,6 +405,181 @@ save_set_msg(ui_t *ui, sip_msg_t *msg)
     field_opts_on(info->fields[FLD_SAVE_MESSAGE], O_VISIBLE);
 }
 
+/**
+ * @brief One time ordered packet source for the save merge
+ *
+ * Each call contributes its SIP packets (and optionally its RTP
+ * packets) as one source whose items are already sorted by capture
+ * time.
+ */
+struct save_source {
+    //! Vector with the items left to merge
+    vector_t *items;
+    //! Next unmerged item position
+    int pos;
+    //! Items are SIP messages instead of packets
+    bool msgs;
+};
+
+/**
+ * @brief Shared state between the interface and the writing thread
+ */
+struct save_task {
+    //! Dump file where packets are being written
+    pcap_dumper_t *pd;
+    //! Time sorted packets to write
+    vector_t *sorted;
+    //! Packets already written by the thread
+    int cur;
+    //! Request the thread to stop before writing everything
+    bool cancel;
+    //! The thread has finished writing
+    bool done;
+};
+
+/**
+ * @brief Return the packet a merge source is currently pointing to
+ */
+static packet_t *
+save_source_packet(struct save_source *source)
+{
+    sip_msg_t *msg;
+
+    if (source->msgs) {
+        if (!(msg = vector_item(source->items, source->pos)))
+            return NULL;
+        return msg->packet;
+    }
+    return vector_item(source->items, source->pos);
+}
+
+/**
+ * @brief Check if the head packet of one source is older than another
+ */
+static bool
+save_source_before(struct save_source *one, struct save_source *two)
+{
+    return !timeval_is_older(packet_time(save_source_packet(one)),
+                             packet_time(save_source_packet(two)));
+}
+
+/**
+ * @brief Restore the min heap property from given position downwards
+ */
+static void
+save_merge_sift(struct save_source **heap, int size, int pos)
+{
+    struct save_source *tmp;
+    int left, right, min;
+
+    for (;;) {
+        left = pos * 2 + 1;
+        right = pos * 2 + 2;
+        min = pos;
+        if (left < size && save_source_before(heap[left], heap[min]))
+            min = left;
+        if (right < size && save_source_before(heap[right], heap[min]))
+            min = right;
+        if (min == pos)
+            break;
+        tmp = heap[pos];
+        heap[pos] = heap[min];
+        heap[min] = tmp;
+        pos = min;
+    }
+}
+
+/**
+ * @brief Merge the packets of given calls into a time sorted vector
+ *
+ * Every call keeps its SIP and RTP packets in capture order, so the
+ * export list is built with a heap based k-way merge over the per call
+ * vectors instead of sorted-inserting every single packet.
+ *
+ * @param calls Iterator of the calls to be saved
+ * @param rtp Also include the RTP packets of each call
+ * @return a new vector with the packets sorted by capture time
+ */
+static vector_t *
+save_merge_packets(vector_iter_t *calls, bool rtp)
+{
+    sip_call_t *call;
+    vector_t *sorted;
+    struct save_source *sources, *top;
+    struct save_source **heap;
+    int count = 0, size = 0, total = 0, i;
+
+    // Count merge sources, one per non empty packet vector
+    while ((call = vector_iterator_next(calls))) {
+        if (vector_count(call->msgs))
+            count++;
+        if (rtp && vector_count(call->rtp_packets))
+            count++;
+    }
+    vector_iterator_reset(calls);
+
+    // One source per call can exceed sng_malloc size limit
+    sources = malloc(sizeof(struct save_source) * (count + 1));
+    heap = malloc(sizeof(struct save_source *) * (count + 1));
+
+    while ((call = vector_iterator_next(calls)) && size < count) {
+        if (vector_count(call->msgs)) {
+            sources[size].items = call->msgs;
+            sources[size].pos = 0;
+            sources[size].msgs = true;
+            heap[size] = &sources[size];
+            total += vector_count(call->msgs);
+            size++;
+        }
+        if (rtp && vector_count(call->rtp_packets) && size < count) {
+            sources[size].items = call->rtp_packets;
+            sources[size].pos = 0;
+            sources[size].msgs = false;
+            heap[size] = &sources[size];
+            total += vector_count(call->rtp_packets);
+            size++;
+        }
+    }
+    vector_iterator_reset(calls);
+
+    // Arrange the sources in a min heap by their head packet time
+    for (i = size / 2 - 1; i >= 0; i--)
+        save_merge_sift(heap, size, i);
+
+    sorted = vector_create(100, 50);
+    vector_reserve(sorted, total);
+
+    // Repeatedly move the oldest head into the sorted list
+    while (size) {
+        top = heap[0];
+        vector_append(sorted, save_source_packet(top));
+        top->pos++;
+        if (!save_source_packet(top))
+            heap[0] = heap[--size];
+        save_merge_sift(heap, size, 0);
+    }
+
+    free(heap);
+    free(sources);
+    return sorted;
+}
+
+/**
+ * @brief Background thread that writes the sorted packets to disk
+ */
+static void
+save_thread(struct save_task *task)
+{
+    packet_t *packet;
+    vector_iter_t it = vector_iterator(task->sorted);
+
+    while (!task->cancel && (packet = vector_iterator_next(&it))) {
+        dump_packet(task->pd, packet);
+        task->cur++;
+    }
+    task->done = true;
+}
+
 int
 save_to_file(ui_t *ui)
 {
@@ -415,11 +590,14 @@ save_to_file(ui_t *ui)
     sip_msg_t *msg = NULL;
     pcap_dumper_t *pd = NULL;
     FILE *f = NULL;
-    int cur = 0, total = 0;
+    int total = 0;
     WINDOW *progress;
-    vector_iter_t calls, msgs, rtps, packets;
+    vector_iter_t calls, msgs, packets;
     packet_t *packet;
     vector_t *sorted;
+    struct save_task task;
+    pthread_t thread;
+    bool cancelled = false;
 
     // Get panel information
     save_info_t *info = save_info(ui);
@@ -476,6 +654,8 @@ save_to_file(ui_t *ui)
             dialog_run("Error: %s", strerror(errno));
             return 0;
         }
+        // Batch the message writes into fewer system calls
+        setvbuf(f, NULL, _IOFBF, 1 << 18);
     }
 
     // Get calls iterator
@@ -515,49 +695,39 @@ save_to_file(ui_t *ui)
             }
         }
     } else {
-        // Store all messages in a time sorted vector
-        sorted = vector_create(100, 50);
-        vector_set_sorter(sorted, capture_packet_time_sorter);
+        // Merge each call packets, they are already sorted by time
+        sorted = save_merge_packets(&calls, info->saveformat == SAVE_PCAP_RTP);
+        total = vector_count(sorted);
 
-        // Count packages for progress bar
-        while ((call = vector_iterator_next(&calls))) {
-            total += vector_count(call->msgs);
-            if (info->saveformat == SAVE_PCAP_RTP)
-                total += vector_count(call->rtp_packets);
-        }
-        vector_iterator_reset(&calls);
-
-        progress = dialog_progress_run("Saving packets...");
+        progress = dialog_progress_run("Saving packets... (Esc to cancel)");
         dialog_progress_set_value(progress, 0);
 
-        // Save selected packets to file
-        while ((call = vector_iterator_next(&calls))) {
-            msgs = vector_iterator(call->msgs);
-            // Save SIP message content
-            while ((msg = vector_iterator_next(&msgs))) {
-                // Update progress bar dialog
-                dialog_progress_set_value(progress, (++cur * 100) / total);
-                vector_append(sorted, msg->packet);
+        // Write from a background thread so the interface can keep the
+        // progress bar updated and watch for the cancel key
+        memset(&task, 0, sizeof(task));
+        task.pd = pd;
+        task.sorted = sorted;
+        if (pthread_create(&thread, NULL, (void *) save_thread, &task) == 0) {
+            nodelay(progress, TRUE);
+            while (!task.done) {
+                if (total)
+                    dialog_progress_set_value(progress, (task.cur * 100) / total);
+                if (wgetch(progress) == KEY_ESC)
+                    task.cancel = true;
+                usleep(20000);
             }
-
-            // Save RTP packets
-            if (info->saveformat == SAVE_PCAP_RTP) {
-                rtps = vector_iterator(call->rtp_packets);
-                while ((packet = vector_iterator_next(&rtps))) {
-                    // Update progress bar dialog
-                    dialog_progress_set_value(progress, (++cur * 100) / total);
-                    vector_append(sorted, packet);
-                }
+            pthread_join(thread, NULL);
+            cancelled = task.cancel;
+        } else {
+            // No thread available, write the packets from here
+            packets = vector_iterator(sorted);
+            while ((packet = vector_iterator_next(&packets))) {
+                dump_packet(pd, packet);
             }
         }
 
-        // Save sorted packets
-        packets = vector_iterator(sorted);
-        while ((packet = vector_iterator_next(&packets))) {
-            dump_packet(pd, packet);
-        }
-
         dialog_progress_destroy(progress);
+        vector_destroy(sorted);
     }
 
     // Close saved file
@@ -567,6 +737,13 @@ save_to_file(ui_t *ui)
         fclose(f);
     }
 
+    // Remove the partially written file on user request
+    if (cancelled) {
+        unlink(fullfile);
+        dialog_run("Save cancelled");
+        return 1;
+    }
+
     // Show success popup
     if (info->savemode == SAVE_MESSAGE) {
       dialog_run("Successfully saved selected SIP message to %s", savefile);
@@ -580,12 +757,27 @@ save_to_file(ui_t *ui)
 void
 save_msg_txt(FILE *f, sip_msg_t *msg)
 {
-    char date[20], time[20], src[80], dst[80];
-
-    fprintf(f, "%s %s %s -> %s\n%s\n\n",
-            msg_get_attribute(msg, SIP_ATTR_DATE, date),
-            msg_get_attribute(msg, SIP_ATTR_TIME, time),
-            msg_get_attribute(msg, SIP_ATTR_SRC, src),
-            msg_get_attribute(msg, SIP_ATTR_DST, dst),
-            msg_get_payload(msg));
+    static char header[256];
+    static char date[20], time[20];
+    static time_t rendered = 0;
+    struct timeval ts = msg_get_time(msg);
+    const char *payload = msg_get_payload(msg);
+    int len;
+
+    // Consecutive messages usually share their timestamp second, so
+    // the strftime renderings are reused until the second changes
+    if (ts.tv_sec != rendered || !rendered) {
+        timeval_to_date(ts, date);
+        timeval_to_time(ts, time);
+        rendered = ts.tv_sec;
+    }
+    sprintf(time + 9, "%06d", (int) ts.tv_usec);
+
+    len = snprintf(header, sizeof(header), "%s %s %s:%u -> %s:%u\n",
+                   date, time,
+                   msg->packet->src.ip, msg->packet->src.port,
+                   msg->packet->dst.ip, msg->packet->dst.port);
+    fwrite(header, 1, len, f);
+    fwrite(payload, 1, strlen(payload), f);
+    fwrite("\n\n", 1, 2, f);
 }
@@ -74,9 +74,7 @@ void
 stats_create(ui_t *ui)
 {
     vector_iter_t calls;
-    vector_iter_t msgs;
-    sip_call_t *call;
-    sip_msg_t *msg;
+    sip_stats_counters_t counters;
 
     // Counters!
     struct {
@@ -110,57 +108,44 @@ stats_create(ui_t *ui)
         return;
     }
 
-    while ((call = vector_iterator_next(&calls))) {
-        // If this dialog is a call
-        if (call->state) {
-            // Increase call counter
-            stats.dcalls++;
-            // Increase call status counter
-            switch (call->state) {
-                case SIP_CALLSTATE_CALLSETUP: stats.setup++; break;
-                case SIP_CALLSTATE_INCALL: stats.incall++; break;
-                case SIP_CALLSTATE_CANCELLED: stats.cancelled++; break;
-                case SIP_CALLSTATE_REJECTED: stats.rejected++; break;
-                case SIP_CALLSTATE_BUSY: stats.busy++; break;
-                case SIP_CALLSTATE_DIVERTED: stats.diverted++; break;
-                case SIP_CALLSTATE_COMPLETED: stats.completed++; break;
-            }
-        }
-        // For each message in call
-        msgs = vector_iterator(call->msgs);
-        while ((msg = vector_iterator_next(&msgs))) {
-            // Increase message counter
-            stats.mtotal++;
-            // Check message type
-            switch (msg->reqresp) {
-                case SIP_METHOD_REGISTER: stats.regist++; break;
-                case SIP_METHOD_INVITE: stats.invite++; break;
-                case SIP_METHOD_SUBSCRIBE: stats.subscribe++; break;
-                case SIP_METHOD_NOTIFY: stats.notify++; break;
-                case SIP_METHOD_OPTIONS: stats.options++; break;
-                case SIP_METHOD_PUBLISH: stats.publish++; break;
-                case SIP_METHOD_MESSAGE: stats.message++; break;
-                case SIP_METHOD_CANCEL: stats.cancel++; break;
-                case SIP_METHOD_BYE: stats.bye++; break;
-                case SIP_METHOD_ACK: stats.ack++; break;
-                // case SIP_METHOD_PRACK:
-                case SIP_METHOD_INFO: stats.info++; break;
-                // case SIP_METHOD_REFER:
-                case SIP_METHOD_UPDATE: stats.update++; break;
-                default:
-                    if (msg->reqresp >= 800) stats.r800++;
-                    else if (msg->reqresp >= 700) stats.r700++;
-                    else if (msg->reqresp >= 600) stats.r600++;
-                    else if (msg->reqresp >= 500) stats.r500++;
-                    else if (msg->reqresp >= 400) stats.r400++;
-                    else if (msg->reqresp >= 300) stats.r300++;
-                    else if (msg->reqresp >= 200) stats.r200++;
-                    else if (msg->reqresp >= 100) stats.r100++;
-            }
-        }
+    // Read the running aggregate counters instead of walking every
+    // stored message (@see sip_stats_get_counters)
+    counters = sip_stats_get_counters();
 
+    // Call status counters
+    stats.dcalls    = counters.call_total;
+    stats.setup     = counters.call_states[SIP_CALLSTATE_CALLSETUP];
+    stats.incall    = counters.call_states[SIP_CALLSTATE_INCALL];
+    stats.cancelled = counters.call_states[SIP_CALLSTATE_CANCELLED];
+    stats.rejected  = counters.call_states[SIP_CALLSTATE_REJECTED];
+    stats.busy      = counters.call_states[SIP_CALLSTATE_BUSY];
+    stats.diverted  = counters.call_states[SIP_CALLSTATE_DIVERTED];
+    stats.completed = counters.call_states[SIP_CALLSTATE_COMPLETED];
 
-    }
+    // Message type counters
+    stats.mtotal    = counters.msg_total;
+    stats.regist    = counters.msg_methods[SIP_METHOD_REGISTER];
+    stats.invite    = counters.msg_methods[SIP_METHOD_INVITE];
+    stats.subscribe = counters.msg_methods[SIP_METHOD_SUBSCRIBE];
+    stats.notify    = counters.msg_methods[SIP_METHOD_NOTIFY];
+    stats.options   = counters.msg_methods[SIP_METHOD_OPTIONS];
+    stats.publish   = counters.msg_methods[SIP_METHOD_PUBLISH];
+    stats.message   = counters.msg_methods[SIP_METHOD_MESSAGE];
+    stats.cancel    = counters.msg_methods[SIP_METHOD_CANCEL];
+    stats.bye       = counters.msg_methods[SIP_METHOD_BYE];
+    stats.ack       = counters.msg_methods[SIP_METHOD_ACK];
+    stats.info      = counters.msg_methods[SIP_METHOD_INFO];
+    stats.update    = counters.msg_methods[SIP_METHOD_UPDATE];
+
+    // Response code counters
+    stats.r100 = counters.msg_responses[0];
+    stats.r200 = counters.msg_responses[1];
+    stats.r300 = counters.msg_responses[2];
+    stats.r400 = counters.msg_responses[3];
+    stats.r500 = counters.msg_responses[4];
+    stats.r600 = counters.msg_responses[5];
+    stats.r700 = counters.msg_responses[6];
+    stats.r800 = counters.msg_responses[7];
 
     // Print parses data
     mvwprintw(ui->win, 3,  3,  "Dialogs: %d", stats.dtotal);
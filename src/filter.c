@@ -28,17 +28,79 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include "sip.h"
+#include "capture.h"
 #include "curses/ui_call_list.h"
 #include "filter.h"
+#include "perf.h"
 
 //! Storage of filter information
 filter_t filters[FILTER_COUNT] = { };
 
+#ifdef WITH_PCRE2
+//! Match data block, reused by every filter match
+static pcre2_match_data *filter_match_data;
+#endif
+
+//! Marker bit for already computed call trigram signatures
+#define FILTER_TRIGRAM_VALID (1ULL << 63)
+
+//! Characters of a filter expression that match themselves
+#define FILTER_LITERAL_CHARS \
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789@_- :"
+
+/**
+ * @brief Trigram signature of a text
+ *
+ * Every three-byte window of the lowercased text sets one bit of the
+ * signature, so a text can only contain a literal substring if its
+ * signature contains all the bits of the substring signature.
+ */
+static uint64_t
+filter_trigrams(const char *text)
+{
+    uint64_t sig = 0;
+    unsigned int a, b, c;
+
+    while (text[0] && text[1] && text[2]) {
+        a = tolower((unsigned char) text[0]);
+        b = tolower((unsigned char) text[1]);
+        c = tolower((unsigned char) text[2]);
+        sig |= 1ULL << (((a * 31 + b) * 31 + c) % 63);
+        text++;
+    }
+
+    return sig;
+}
+
+/**
+ * @brief Trigram signature of the searchable attributes of a call
+ *
+ * Computed once per call and kept for its whole life: From and To are
+ * set by the first message and never change afterwards.
+ */
+static uint64_t
+filter_call_trigrams(sip_call_t *call)
+{
+    char data[MAX_SIP_PAYLOAD];
+
+    if (!(call->trigrams & FILTER_TRIGRAM_VALID)) {
+        memset(data, 0, sizeof(data));
+        call_get_attribute(call, SIP_ATTR_SIPFROM, data);
+        call->trigrams = filter_trigrams(data);
+        memset(data, 0, sizeof(data));
+        call_get_attribute(call, SIP_ATTR_SIPTO, data);
+        call->trigrams |= filter_trigrams(data) | FILTER_TRIGRAM_VALID;
+    }
+
+    return call->trigrams;
+}
+
 int
 filter_set(int type, const char *expr)
 {
-#ifdef WITH_PCRE
+#if defined(WITH_PCRE)
     pcre *regex = NULL;
 
     // If we have an expression, check if compiles before changing the filter
@@ -62,6 +124,38 @@ filter_set(int type, const char *expr)
     filters[type].expr = (expr) ? strdup(expr) : NULL;
     filters[type].regex = regex;
 
+#elif defined(WITH_PCRE2)
+    pcre2_code *regex = NULL;
+
+    // If we have an expression, check if compiles before changing the filter
+    if (expr) {
+        int re_err = 0;
+        PCRE2_SIZE err_offset = 0;
+        uint32_t pcre_options = PCRE2_UNGREEDY | PCRE2_CASELESS;
+
+        // Check if we have a valid expression
+        if (!(regex = pcre2_compile((PCRE2_SPTR) expr, PCRE2_ZERO_TERMINATED,
+                                    pcre_options, &re_err, &err_offset, NULL)))
+            return 1;
+
+        // Speed up matching with the JIT compiler (falls back if unavailable)
+        pcre2_jit_compile(regex, PCRE2_JIT_COMPLETE);
+
+        // Create the match data block shared by all filters
+        if (!filter_match_data)
+            filter_match_data = pcre2_match_data_create(1, NULL);
+    }
+
+    // Remove previous value
+    if (filters[type].expr) {
+        sng_free(filters[type].expr);
+        pcre2_code_free(filters[type].regex);
+    }
+
+    // Set new expresion values
+    filters[type].expr = (expr) ? strdup(expr) : NULL;
+    filters[type].regex = regex;
+
 #else
     regex_t regex;
     // If we have an expression, check if compiles before changing the filter
@@ -82,6 +176,13 @@ filter_set(int type, const char *expr)
     memcpy(&filters[type].regex, &regex, sizeof(regex));
 #endif
 
+    // Literal From/To substrings prune candidates by trigram signature
+    filters[type].trigrams = 0;
+    if (expr && (type == FILTER_SIPFROM || type == FILTER_SIPTO)
+            && strspn(expr, FILTER_LITERAL_CHARS) == strlen(expr)) {
+        filters[type].trigrams = filter_trigrams(expr);
+    }
+
     return 0;
 }
 
@@ -91,8 +192,14 @@ filter_get(int type)
     return filters[type].expr;
 }
 
-int
-filter_check_call(void *item)
+/**
+ * @brief Evaluate all enabled filters against a call
+ *
+ * Body of filter_check_call, separated so profiling builds can time
+ * every evaluation (@see PROF_TIMER_START).
+ */
+static int
+filter_check_call_match(void *item)
 {
     int i;
     char data[MAX_SIP_PAYLOAD];
@@ -117,6 +224,14 @@ filter_check_call(void *item)
         if (!filters[i].expr)
             continue;
 
+        // Discard candidates by trigram signature before running the
+        // full expression (@see filter_trigrams)
+        if (filters[i].trigrams &&
+                (filter_call_trigrams(call) & filters[i].trigrams) != filters[i].trigrams) {
+            call->filtered = 1;
+            break;
+        }
+
         // Initialize
         memset(data, 0, sizeof(data));
 
@@ -179,17 +294,80 @@ filter_check_call(void *item)
     return (call->filtered == 0);
 }
 
+int
+filter_check_call(void *item)
+{
+    PROF_TIMER_START(ftime);
+    int shown = filter_check_call_match(item);
+    PROF_TIMER_RECORD(PERF_TIMER_FILTER, ftime);
+    return shown;
+}
+
 int
 filter_check_expr(filter_t filter, const char *data)
 {
-#ifdef WITH_PCRE
+#if defined(WITH_PCRE)
         return pcre_exec(filter.regex, 0, data, strlen(data), 0, 0, 0, 0);
+#elif defined(WITH_PCRE2)
+        return pcre2_match(filter.regex, (PCRE2_SPTR) data, PCRE2_ZERO_TERMINATED,
+                           0, 0, filter_match_data, NULL) < 0;
 #else
         // Call doesn't match this filter
         return regexec(&filter.regex, data, 0, NULL, 0);
 #endif
 }
 
+int
+filter_admit_msg(packet_t *packet, sip_msg_t *msg, const u_char *payload)
+{
+    int i;
+    char data[MAX_SIP_PAYLOAD];
+
+    // Check all filter types
+    for (i = 0; i < FILTER_COUNT; i++) {
+        // If filter is not enabled, go to the next
+        if (!filters[i].expr)
+            continue;
+
+        // Initialize
+        memset(data, 0, sizeof(data));
+
+        // Get filtered field from the not yet stored message
+        switch (i) {
+            case FILTER_SIPFROM:
+            case FILTER_SIPTO:
+                // The message has no packet attached yet, parse From/To
+                // from the payload the caller is still holding
+                if (!msg->disp || !msg->disp->sip_from)
+                    sip_parse_msg_payload(msg, payload);
+                sprintf(data, "%.*s", SIP_ATTR_MAXLEN,
+                        (i == FILTER_SIPFROM) ? msg->disp->sip_from : msg->disp->sip_to);
+                break;
+            case FILTER_SOURCE:
+                sprintf(data, "%s:%u", packet->src.ip, packet->src.port);
+                break;
+            case FILTER_DESTINATION:
+                sprintf(data, "%s:%u", packet->dst.ip, packet->dst.port);
+                break;
+            case FILTER_METHOD:
+                sprintf(data, "%.*s", SIP_ATTR_MAXLEN, sip_get_msg_reqresp_str(msg));
+                break;
+            case FILTER_PAYLOAD:
+                strcpy(data, (const char *) payload);
+                break;
+            default:
+                // Remaining filters only apply to displayed calls
+                continue;
+        }
+
+        // The dialog opening message didn't match this filter
+        if (filter_check_expr(filters[i], data) != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
 void
 filter_reset_calls()
 {
@@ -199,4 +377,82 @@ filter_reset_calls()
     // Force filter evaluation
     while ((call = vector_iterator_next(&calls)))
         call->filtered = -1;
+
+    // Cached displayed lists must be rebuilt
+    sip_calls_epoch_bump();
+}
+
+/**
+ * @brief Translate an address display filter into a BPF predicate
+ *
+ * Only literal addresses ("192.168.1.1" or "192.168.1.1:5060") can be
+ * expressed in BPF; regular expressions are left to userspace matching.
+ * The predicate is direction-less so both legs of a dialog keep being
+ * captured.
+ *
+ * @param expr Display filter expression or NULL
+ * @param bpf Output buffer for the BPF predicate
+ * @param len Output buffer size
+ * @return 1 if the expression has been translated, 0 otherwise
+ */
+static int
+filter_bpf_address(const char *expr, char *bpf, size_t len)
+{
+    int a, b, c, d, port, end;
+
+    if (!expr)
+        return 0;
+
+    // Only literal addresses can be pushed into a BPF program
+    if (strspn(expr, "0123456789.:") != strlen(expr))
+        return 0;
+
+    end = 0;
+    if (sscanf(expr, "%3d.%3d.%3d.%3d:%5d%n", &a, &b, &c, &d, &port, &end) == 5
+            && !expr[end]) {
+        snprintf(bpf, len, "(host %d.%d.%d.%d and port %d)", a, b, c, d, port);
+        return 1;
+    }
+
+    end = 0;
+    if (sscanf(expr, "%3d.%3d.%3d.%3d%n", &a, &b, &c, &d, &end) == 4
+            && !expr[end]) {
+        snprintf(bpf, len, "host %d.%d.%d.%d", a, b, c, d);
+        return 1;
+    }
+
+    return 0;
+}
+
+void
+filter_bpf_pushdown()
+{
+    const char *base = capture_get_bpf_filter();
+    char source[64], destination[64];
+    char predicate[160];
+    char bpf[512];
+
+    // Translate the address display filters BPF can express
+    predicate[0] = '\0';
+    if (filter_bpf_address(filter_get(FILTER_SOURCE), source, sizeof(source)))
+        strcat(predicate, source);
+    if (filter_bpf_address(filter_get(FILTER_DESTINATION), destination, sizeof(destination))) {
+        if (predicate[0])
+            strcat(predicate, " and ");
+        strcat(predicate, destination);
+    }
+
+    // Combine the predicates with the startup capture filter
+    if (base && predicate[0]) {
+        snprintf(bpf, sizeof(bpf), "(%s) and %s", base, predicate);
+    } else if (predicate[0]) {
+        snprintf(bpf, sizeof(bpf), "%s", predicate);
+    } else {
+        // Nothing to push down, restore the startup filter
+        snprintf(bpf, sizeof(bpf), "%s", (base) ? base : "");
+    }
+
+    // Push the filter to the kernel; on failure keep the startup filter
+    if (capture_apply_bpf_filter(bpf) != 0)
+        capture_apply_bpf_filter((base) ? base : "");
 }
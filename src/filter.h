@@ -41,8 +41,10 @@
 #define __SNGREP_FILTER_H_
 
 #include "config.h"
-#ifdef WITH_PCRE
+#if defined(WITH_PCRE)
 #include <pcre.h>
+#elif defined(WITH_PCRE2)
+#include <pcre2.h>
 #else
 #include <regex.h>
 #endif
@@ -79,9 +81,14 @@ enum filter_type {
 struct filter {
     //! The filter text
     char *expr;
-#ifdef WITH_PCRE
+    //! Trigram signature of literal expressions, 0 when not applicable
+    uint64_t trigrams;
+#if defined(WITH_PCRE)
     //! The filter compiled expression
     pcre *regex;
+#elif defined(WITH_PCRE2)
+    //! The filter compiled expression (JIT compiled when available)
+    pcre2_code *regex;
 #else
     //! The filter compiled expression
     regex_t regex;
@@ -128,6 +135,23 @@ filter_check_call(void *item);
 int
 filter_check_expr(filter_t filter, const char *data);
 
+/**
+ * @brief Check if the opening message of a dialog passes the filters
+ *
+ * Used when filter.discard setting is enabled to evaluate display
+ * filters at ingest time, before a sip_call_t is created, so non
+ * matching dialogs are never stored. Only the message being admitted is
+ * inspected, so a Payload filter matched by a later message of the
+ * dialog will still discard it.
+ *
+ * @param packet Packet the message was parsed from
+ * @param msg Parsed message not yet attached to any call
+ * @param payload Message payload
+ * @return 1 if the message passes all enabled filters, 0 otherwise
+ */
+int
+filter_admit_msg(packet_t *packet, sip_msg_t *msg, const u_char *payload);
+
 /**
  * @brief Reset filtered flag in all calls
  *
@@ -137,4 +161,16 @@ filter_check_expr(filter_t filter, const char *data);
 void
 filter_reset_calls();
 
+/**
+ * @brief Push address display filters into the kernel BPF program
+ *
+ * Source and Destination filters holding a literal address (with an
+ * optional port) are translated into BPF predicates, combined with the
+ * startup capture filter and pushed to the capture sources, so traffic
+ * from unrelated peers is discarded before being parsed. Filters BPF
+ * cannot express keep being evaluated in userspace only.
+ */
+void
+filter_bpf_pushdown();
+
 #endif /* __SNGREP_FILTER_H_ */
@@ -30,6 +30,31 @@
 #include <stdlib.h>
 #include "group.h"
 
+/**
+ * @brief Return the position of a call inside the group
+ *
+ * The position is cached on the call when it is added, so drawing a
+ * group flow does not scan the calls vector once per arrow. Positions
+ * cached before a call was removed are detected and rescanned.
+ *
+ * @param group Pointer to an existing group
+ * @param call Pointer to an existing call
+ * @return Position of the call in the group, -1 if not found
+ */
+static int
+call_group_index(sip_call_group_t *group, sip_call_t *call)
+{
+    int idx = call->gindex;
+
+    // Use the cached position while it still points to this call
+    if (vector_item(group->calls, idx) == call)
+        return idx;
+
+    // Rescan and remember the position for the next probes
+    call->gindex = vector_index(group->calls, call);
+    return call->gindex;
+}
+
 sip_call_group_t *
 call_group_create()
 {
@@ -102,6 +127,7 @@ call_group_add(sip_call_group_t *group, sip_call_t *call)
     if (!call_group_exists(group, call)) {
         call->locked = true;
         vector_append(group->calls, call);
+        call->gindex = vector_count(group->calls) - 1;
     }
 }
 
@@ -116,6 +142,7 @@ call_group_add_calls(sip_call_group_t *group, vector_t *calls)
         call->locked = true;
         if (!call_group_exists(group, call)) {
             vector_append(group->calls, call);
+            call->gindex = vector_count(group->calls) - 1;
         }
     }
 }
@@ -125,19 +152,20 @@ call_group_del(sip_call_group_t *group, sip_call_t *call)
 {
     if (!call) return;
     call->locked = false;
+    call->gindex = -1;
     vector_remove(group->calls, call);
 }
 
 int
 call_group_exists(sip_call_group_t *group, sip_call_t *call)
 {
-    return (vector_index(group->calls, call) >= 0) ? 1 : 0;
+    return (call_group_index(group, call) >= 0) ? 1 : 0;
 }
 
 int
 call_group_color(sip_call_group_t *group, sip_call_t *call)
 {
-    return (vector_index(group->calls, call) % 7) + 1;
+    return (call_group_index(group, call) % 7) + 1;
 }
 
 sip_call_t *
@@ -208,49 +236,38 @@ int
 call_group_msg_number(sip_call_group_t *group, sip_msg_t *msg)
 {
     int number = 0;
-    sip_msg_t *cur = NULL;
-    while ((cur = call_group_get_next_msg(group, cur))) {
-        if (group->sdp_only && !msg_has_sdp(msg))
-            continue;
+    sip_msg_t *cur;
+    group_msg_iter_t it = call_group_msg_iterator(group);
 
+    while ((cur = call_group_msg_iterator_next(&it))) {
         if (cur == msg)
-            return number;
+            break;
         number++;
     }
-    return 0;
+    call_group_msg_iterator_destroy(&it);
+
+    return (cur) ? number : 0;
 }
 
 sip_msg_t *
 call_group_get_next_msg(sip_call_group_t *group, sip_msg_t *msg)
 {
+    group_msg_iter_t it;
     sip_msg_t *next;
 
-    if (call_group_count(group) == 1) {
-        sip_call_t *call = vector_first(group->calls);
-        vector_iter_t it = vector_iterator(call->msgs);
-        vector_iterator_set_current(&it, vector_index(call->msgs, msg));
-        next = vector_iterator_next(&it);
-    } else {
-        vector_t *messages = vector_create(1,10);
-        vector_set_sorter(messages, call_group_msg_sorter);
-        vector_iter_t callsit = vector_iterator(group->calls);
-        sip_call_t *call;
-        while ((call = vector_iterator_next(&callsit))) {
-            vector_append_vector(messages, call->msgs);
-        }
+    it = call_group_msg_iterator(group);
 
-        if (msg == NULL) {
-            next = vector_first(messages);
-        } else {
-            next = vector_item(messages, vector_index(messages, msg) + 1);
+    // Walk the merge to position it right after the given message
+    if (msg) {
+        while ((next = call_group_msg_iterator_next(&it)) && next != msg);
+        if (!next) {
+            call_group_msg_iterator_destroy(&it);
+            return NULL;
         }
-        vector_destroy(messages);
     }
 
-    next = sip_parse_msg(next);
-    if (next && group->sdp_only && !msg_has_sdp(next)) {
-        return call_group_get_next_msg(group, next);
-    }
+    next = call_group_msg_iterator_next(&it);
+    call_group_msg_iterator_destroy(&it);
 
     return next;
 }
@@ -258,38 +275,90 @@ call_group_get_next_msg(sip_call_group_t *group, sip_msg_t *msg)
 sip_msg_t *
 call_group_get_prev_msg(sip_call_group_t *group, sip_msg_t *msg)
 {
-    sip_msg_t *prev;
-
-    if (call_group_count(group) == 1) {
-        sip_call_t *call = vector_first(group->calls);
-        vector_iter_t it = vector_iterator(call->msgs);
-        vector_iterator_set_current(&it, vector_index(call->msgs, msg));
-        prev = vector_iterator_prev(&it);
-    } else {
-        vector_t *messages = vector_create(1, 10);
-        vector_set_sorter(messages, call_group_msg_sorter);
-
-
-        vector_iter_t callsit = vector_iterator(group->calls);
-        sip_call_t *call;
-        while ((call = vector_iterator_next(&callsit))) {
-            vector_append_vector(messages, call->msgs);
-        }
+    group_msg_iter_t it;
+    sip_msg_t *cur, *prev = NULL;
+
+    // The merge only moves forward, so remember the message returned
+    // right before reaching the given one
+    it = call_group_msg_iterator(group);
+    while ((cur = call_group_msg_iterator_next(&it)) && cur != msg)
+        prev = cur;
+    call_group_msg_iterator_destroy(&it);
+
+    return prev;
+}
 
-        if (msg == NULL) {
-            prev = vector_last(messages);
-        } else {
-            prev = vector_item(messages, vector_index(messages, msg) - 1);
+group_msg_iter_t
+call_group_msg_iterator(sip_call_group_t *group)
+{
+    group_msg_iter_t it;
+
+    it.group = group;
+    it.calls = (group) ? vector_count(group->calls) : 0;
+    it.current = sng_malloc(sizeof(int) * (it.calls + 1));
+    it.last = NULL;
+
+    return it;
+}
+
+sip_msg_t *
+call_group_msg_iterator_next(group_msg_iter_t *it)
+{
+    sip_call_t *call;
+    sip_msg_t *head, *next;
+    int i, count, nextcall;
+
+    // Calls added to the group since the last step join the merge,
+    // skipping their messages older than the last returned one
+    count = vector_count(it->group->calls);
+    if (count > it->calls) {
+        it->current = realloc(it->current, sizeof(int) * count);
+        for (i = it->calls; i < count; i++) {
+            it->current[i] = 0;
+            call = vector_item(it->group->calls, i);
+            while (it->last && (head = vector_item(call->msgs, it->current[i]))
+                   && !msg_is_older(head, it->last))
+                it->current[i]++;
         }
-        vector_destroy(messages);
+        it->calls = count;
+    } else if (count < it->calls) {
+        it->calls = count;
     }
 
-    prev = sip_parse_msg(prev);
-    if (prev && group->sdp_only && !msg_has_sdp(prev)) {
-        return call_group_get_prev_msg(group, prev);
+    for (;;) {
+        // Get the call with the oldest unvisited message
+        next = NULL;
+        nextcall = -1;
+        for (i = 0; i < it->calls; i++) {
+            call = vector_item(it->group->calls, i);
+            if (!(head = vector_item(call->msgs, it->current[i])))
+                continue;
+            if (!next || !msg_is_older(head, next)) {
+                next = head;
+                nextcall = i;
+            }
+        }
+
+        if (!next)
+            return NULL;
+
+        it->current[nextcall]++;
+        it->last = next;
+
+        next = sip_parse_msg(next);
+        if (it->group->sdp_only && !msg_has_sdp(next))
+            continue;
+
+        return next;
     }
+}
 
-    return prev;
+void
+call_group_msg_iterator_destroy(group_msg_iter_t *it)
+{
+    sng_free(it->current);
+    it->current = NULL;
+    it->calls = 0;
 }
 
 rtp_stream_t *
@@ -319,27 +388,3 @@ call_group_get_next_stream(sip_call_group_t *group, rtp_stream_t *stream)
 
     return next;
 }
-
-void
-call_group_msg_sorter(vector_t *vector, void *item)
-{
-    struct timeval curts, prevts;
-    int count = vector_count(vector);
-    int i;
-
-    // Current and last packet times
-    curts = msg_get_time(item);
-
-    for (i = count - 2 ; i >= 0; i--) {
-        // Get previous packet
-        prevts = msg_get_time(vector_item(vector, i));
-        // Check if the item is already in a sorted position
-        if (timeval_is_older(curts, prevts)) {
-            vector_insert(vector, item, i + 1);
-            return;
-        }
-    }
-
-    // Put this item at the begining of the vector
-    vector_insert(vector, item, 0);
-}
@@ -39,6 +39,8 @@
 
 //! Shorter declaration of sip_call_group structure
 typedef struct sip_call_group sip_call_group_t;
+//! Shorter declaration of group message iterator structure
+typedef struct group_msg_iter group_msg_iter_t;
 
 /**
  * @brief Contains a list of calls
@@ -58,6 +60,26 @@ struct sip_call_group {
     int sdp_only;
 };
 
+/**
+ * @brief Merged iterator over the messages of a group
+ *
+ * Each call keeps its messages in capture order, so the messages of a
+ * group can be traversed chronologically by merging the per call
+ * vectors instead of sorting every message again on each step. The
+ * iterator keeps one position per call and can be reused across draws:
+ * messages already returned are never visited again.
+ */
+struct group_msg_iter {
+    //! Group that's being iterated
+    sip_call_group_t *group;
+    //! Next unvisited message of each grouped call
+    int *current;
+    //! Number of grouped calls tracked in current
+    int calls;
+    //! Last message returned by the iterator
+    sip_msg_t *last;
+};
+
 /**
  * @brief Create a new groupt to hold Calls in it
  *
@@ -220,6 +242,40 @@ call_group_get_next_msg(sip_call_group_t *group, sip_msg_t *msg);
 sip_msg_t *
 call_group_get_prev_msg(sip_call_group_t *group, sip_msg_t *msg);
 
+/**
+ * @brief Return a new merged message iterator for given group
+ *
+ * The returned iterator must be deallocated using
+ * call_group_msg_iterator_destroy after use.
+ *
+ * @param group Pointer to an existing group
+ * @return a merged iterator positioned before the first message
+ */
+group_msg_iter_t
+call_group_msg_iterator(sip_call_group_t *group);
+
+/**
+ * @brief Return the next chronological message of the group
+ *
+ * Messages are parsed before being returned and, if the group only
+ * considers SDP messages, those without SDP content are skipped.
+ * Calls added to the group after the iterator was created join the
+ * merge at their first message not older than the last returned one.
+ *
+ * @param it Pointer to a merged iterator of the group messages
+ * @return Next chronological message in the group or NULL
+ */
+sip_msg_t *
+call_group_msg_iterator_next(group_msg_iter_t *it);
+
+/**
+ * @brief Free the per call positions of a merged message iterator
+ *
+ * @param it Pointer to a merged iterator of the group messages
+ */
+void
+call_group_msg_iterator_destroy(group_msg_iter_t *it);
+
 /**
  * @brief Find the next stream in a call group
  *
@@ -230,12 +286,4 @@ call_group_get_prev_msg(sip_call_group_t *group, sip_msg_t *msg);
 rtp_stream_t *
 call_group_get_next_stream(sip_call_group_t *group, rtp_stream_t *stream);
 
-/**
- * @brief Sort messages in a group by message time
- * @param vector sorted vector
- * @param item item to add to the vector
- */
-void
-call_group_msg_sorter(vector_t *vector, void *item);
-
 #endif /* __SNGREP_GROUP_H_ */
@@ -30,6 +30,42 @@
 #include <string.h>
 #include <stdlib.h>
 
+/**
+ * @brief Double the bucket count of the table
+ *
+ * Entries are relinked into the new bucket array using their cached
+ * hash value, so keys are not hashed again. On allocation failure the
+ * table is left untouched and chains simply grow longer.
+ */
+static void
+htable_resize(htable_t *table)
+{
+    size_t newsize = table->size * 2;
+    hentry_t **buckets;
+    hentry_t *entry, *next;
+    size_t i;
+
+    // Allocate memory for the new bucket array
+    if (!(buckets = malloc(sizeof(hentry_t *) * newsize)))
+        return;
+    memset(buckets, 0, sizeof(hentry_t *) * newsize);
+
+    // Relink all entries into their new positions
+    for (i = 0; i < table->size; i++) {
+        for (entry = table->buckets[i]; entry; entry = next) {
+            next = entry->next;
+            size_t pos = entry->hash & (newsize - 1);
+            entry->next = buckets[pos];
+            buckets[pos] = entry;
+        }
+    }
+
+    // Replace the old bucket array
+    free(table->buckets);
+    table->buckets = buckets;
+    table->size = newsize;
+}
+
 htable_t *
 htable_create(size_t size)
 {
@@ -39,16 +75,20 @@ htable_create(size_t size)
     if (!(h = malloc(sizeof(htable_t))))
         return NULL;
 
-    h->size = size;
+    // Round the requested size up to a power of two for hash masking
+    h->size = 1;
+    while (h->size < size)
+        h->size <<= 1;
+    h->count = 0;
 
     // Allocate memory for this table buckets
-    if (!(h->buckets = malloc(sizeof(hentry_t) * size))) {
+    if (!(h->buckets = malloc(sizeof(hentry_t *) * h->size))) {
         free(h);
         return NULL;
     }
 
     // Initialize allocated memory
-    memset(h->buckets, 0, sizeof(hentry_t) * size);
+    memset(h->buckets, 0, sizeof(hentry_t *) * h->size);
 
     // Return allocated table
     return h;
@@ -57,6 +97,17 @@ htable_create(size_t size)
 void
 htable_destroy(htable_t *table)
 {
+    hentry_t *entry, *next;
+    size_t i;
+
+    // Remove all remaining entries
+    for (i = 0; i < table->size; i++) {
+        for (entry = table->buckets[i]; entry; entry = next) {
+            next = entry->next;
+            free(entry);
+        }
+    }
+
     free(table->buckets);
     free(table);
 }
@@ -64,8 +115,13 @@ htable_destroy(htable_t *table)
 int
 htable_insert(htable_t *table, const char *key, void *data)
 {
+    // Grow the table when chains start getting long
+    if (table->count >= table->size * HASH_LOAD_FACTOR)
+        htable_resize(table);
+
     // Get hash position for given entry
-    size_t pos = htable_hash(table, key);
+    size_t hash = htable_hash(key);
+    size_t pos = hash & (table->size - 1);
 
     // Create a new entry for given key
     hentry_t *entry;
@@ -73,6 +129,7 @@ htable_insert(htable_t *table, const char *key, void *data)
         return -1;
 
     entry->key = key;
+    entry->hash = hash;
     entry->data = data;
     entry->next = 0;
 
@@ -87,6 +144,7 @@ htable_insert(htable_t *table, const char *key, void *data)
         }
         exists->next = entry;
     }
+    table->count++;
     return 0;
 }
 
@@ -94,12 +152,37 @@ void
 htable_remove(htable_t *table, const char *key)
 {
     // Get hash position for given entry
-    size_t pos = htable_hash(table, key);
+    size_t hash = htable_hash(key);
+    size_t pos = hash & (table->size - 1);
+
+    // Check if the hash position is in use
+    hentry_t *entry, *prev = NULL;
+    for (entry = table->buckets[pos]; entry; prev = entry, entry = entry->next) {
+        if (entry->hash == hash && !strcmp(entry->key, key)) {
+            if (prev) {
+                prev->next = entry->next;
+            } else {
+                table->buckets[pos] = entry->next;
+            }
+            // Remove item memory
+            free(entry);
+            table->count--;
+            return;
+        }
+    }
+}
+
+void
+htable_remove_data(htable_t *table, const char *key, void *data)
+{
+    // Get hash position for given entry
+    size_t hash = htable_hash(key);
+    size_t pos = hash & (table->size - 1);
 
     // Check if the hash position is in use
     hentry_t *entry, *prev = NULL;
     for (entry = table->buckets[pos]; entry; prev = entry, entry = entry->next) {
-        if (!strcmp(entry->key, key)) {
+        if (entry->hash == hash && entry->data == data && !strcmp(entry->key, key)) {
             if (prev) {
                 prev->next = entry->next;
             } else {
@@ -107,6 +190,8 @@ htable_remove(htable_t *table, const char *key)
             }
             // Remove item memory
             free(entry);
+            table->count--;
+            return;
         }
     }
 }
@@ -115,12 +200,13 @@ void *
 htable_find(htable_t *table, const char *key)
 {
     // Get hash position for given entry
-    size_t pos = htable_hash(table, key);
+    size_t hash = htable_hash(key);
+    size_t pos = hash & (table->size - 1);
 
     // Check if the hash position is in use
     hentry_t *entry;
     for (entry = table->buckets[pos]; entry; entry = entry->next) {
-        if (!strcmp(entry->key, key)) {
+        if (entry->hash == hash && !strcmp(entry->key, key)) {
             //! Found
             return entry->data;
         }
@@ -131,12 +217,13 @@ htable_find(htable_t *table, const char *key)
 }
 
 size_t
-htable_hash(htable_t *table, const char *key)
+htable_hash(const char *key)
 {
-    // dbj2 - http://www.cse.yorku.ca/~oz/hash.html
-    size_t hash = 5381;
-    while (*key++) {
-        hash = ((hash << 5) + hash) ^ *key;
+    // FNV-1a - http://www.isthe.com/chongo/tech/comp/fnv/
+    size_t hash = 2166136261u;
+    while (*key) {
+        hash ^= (unsigned char) *key++;
+        hash *= 16777619u;
     }
-    return hash & (table->size - 1);
+    return hash;
 }
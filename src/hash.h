@@ -39,9 +39,14 @@ typedef struct hentry hentry_t;
 /**
  *  Structure to hold a Hash table entry
  */
+//! Bucket usage ratio that triggers a table resize
+#define HASH_LOAD_FACTOR 0.75f
+
 struct hentry {
     //! Key of the hash entry
     const char *key;
+    //! Full hash of the key, cached to avoid re-hashing on resize
+    size_t hash;
     //! Pointer to has entry data
     void *data;
     //! Next entry sharing the same hash value
@@ -49,8 +54,10 @@ struct hentry {
 };
 
 struct htable {
-    //! Fixed hash table limit
+    //! Current hash table bucket count (always a power of two)
     size_t size;
+    //! Number of entries stored in the table
+    size_t count;
     // Hash table entries
     hentry_t **buckets;
 };
@@ -67,10 +74,14 @@ htable_insert(htable_t *table, const char *key, void *data);
 void
 htable_remove(htable_t *table, const char *key);
 
+//! Remove the entry matching both key and data, for multimap tables
+void
+htable_remove_data(htable_t *table, const char *key, void *data);
+
 void *
 htable_find(htable_t *table, const char *key);
 
 size_t
-htable_hash(htable_t *table, const char *key);
+htable_hash(const char *key);
 
 #endif /* __SNGREP_HASH_H_ */
@@ -0,0 +1,102 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file intern.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in intern.h
+ *
+ */
+#include "config.h"
+#include <string.h>
+#include <pthread.h>
+#include "hash.h"
+#include "util.h"
+#include "intern.h"
+
+/**
+ * @brief One pooled string with its reference count
+ */
+struct intern_entry {
+    //! Number of sng_intern references to this string
+    int refcount;
+    //! The pooled string itself, used as hash table key
+    char text[];
+};
+
+//! Pooled strings indexed by their text
+static htable_t *intern_pool = NULL;
+//! Pool lock, interning also runs in parser worker threads
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *
+sng_intern(const char *str)
+{
+    return sng_intern_n(str, strlen(str));
+}
+
+const char *
+sng_intern_n(const char *str, int len)
+{
+    struct intern_entry *entry, *found;
+
+    // Build the candidate entry before taking the lock
+    if (!(entry = sng_malloc(sizeof(struct intern_entry) + len + 1)))
+        return NULL;
+    memcpy(entry->text, str, len);
+    entry->text[len] = '\0';
+
+    pthread_mutex_lock(&intern_lock);
+
+    if (!intern_pool)
+        intern_pool = htable_create(1024);
+
+    if ((found = htable_find(intern_pool, entry->text))) {
+        // Already pooled, reference the existing copy
+        found->refcount++;
+        pthread_mutex_unlock(&intern_lock);
+        sng_free(entry);
+        return found->text;
+    }
+
+    // First reference of this string
+    entry->refcount = 1;
+    htable_insert(intern_pool, entry->text, entry);
+    pthread_mutex_unlock(&intern_lock);
+    return entry->text;
+}
+
+void
+sng_unintern(const char *str)
+{
+    struct intern_entry *entry;
+
+    if (!str)
+        return;
+
+    pthread_mutex_lock(&intern_lock);
+    if ((entry = htable_find(intern_pool, str)) && --entry->refcount == 0) {
+        htable_remove(intern_pool, str);
+        sng_free(entry);
+    }
+    pthread_mutex_unlock(&intern_lock);
+}
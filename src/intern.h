@@ -0,0 +1,72 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file intern.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Refcounted string interning pool
+ *
+ * Highly repetitive strings (response texts, From/To headers, rendered
+ * attribute values) are stored once in a shared pool instead of being
+ * duplicated per message or per call. Callers keep a reference with
+ * sng_intern and drop it with sng_unintern; the string is freed when
+ * the last reference is gone.
+ *
+ * The pool has its own lock, so it can be used from parser worker
+ * threads that run outside the capture lock.
+ */
+#ifndef __SNGREP_INTERN_H
+#define __SNGREP_INTERN_H
+
+#include "config.h"
+
+/**
+ * @brief Get a pooled copy of the given string
+ *
+ * @param str String to intern
+ * @return pooled copy of the string, valid until its last sng_unintern
+ */
+const char *
+sng_intern(const char *str);
+
+/**
+ * @brief Get a pooled copy of the first len bytes of the given string
+ *
+ * @param str Text to intern, not required to be null terminated
+ * @param len Number of bytes of the string
+ * @return pooled copy of the string, valid until its last sng_unintern
+ */
+const char *
+sng_intern_n(const char *str, int len);
+
+/**
+ * @brief Drop a reference taken with sng_intern
+ *
+ * The string is freed when its last reference is dropped.
+ * A NULL string is silently ignored.
+ *
+ * @param str String returned by sng_intern
+ */
+void
+sng_unintern(const char *str);
+
+#endif /* __SNGREP_INTERN_H */
@@ -32,10 +32,12 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <getopt.h>
+#include <sys/stat.h>
 #include "option.h"
 #include "vector.h"
 #include "capture.h"
 #include "capture_eep.h"
+#include "capture_link.h"
 #ifdef WITH_GNUTLS
 #include "capture_gnutls.h"
 #endif
@@ -43,6 +45,15 @@
 #include "capture_openssl.h"
 #endif
 #include "curses/ui_manager.h"
+#include "pipe.h"
+#include "compact.h"
+#include "spill.h"
+#include "perf.h"
+
+//! Headless JSON export mode flag, set by the --pipe long option
+static int pipe_mode = 0;
+//! Print performance counters at exit, set by the --perf-stats long option
+static int perf_stats_mode = 0;
 
 /**
  * @brief Usage function
@@ -67,11 +78,13 @@ usage()
            "    -O --output\t\t Write captured data to pcap file\n"
            "    -c --calls\t\t Only display dialogs starting with INVITE\n"
            "    -r --rtp\t\t Capture RTP packets payload\n"
-           "    -l --limit\t\t Set capture limit to N dialogs\n"
+           "    -l --limit\t\t Set capture limit to N dialogs (or bytes with a K/M/G suffix)\n"
            "    -i --icase\t\t Make <match expression> case insensitive\n"
            "    -v --invert\t\t Invert <match expression>\n"
            "    -N --no-interface\t Don't display sngrep interface, just capture\n"
            "    -q --quiet\t\t Don't print captured dialogs in no interface mode\n"
+           "    --pipe\t\t Write captured SIP messages to stdout as JSON lines\n"
+           "    --perf-stats\t Print capture performance counters at exit\n"
            "    -D --dump-config\t Print active configuration settings and exit\n"
            "    -f --config\t\t Read configuration from file\n"
            "    -F --no-config\t Do not read configuration from default config file\n"
@@ -79,6 +92,8 @@ usage()
 #ifdef USE_EEP
            "    -H --eep-send\t Homer sipcapture url (udp:X.X.X.X:XXXX)\n"
            "    -L --eep-listen\t Listen for encapsulated packets (udp:X.X.X.X:XXXX)\n"
+           "    -S --serve\t\t Serve captured calls on a unix socket path\n"
+           "    -A --attach\t Attach to a serving sngrep daemon socket\n"
 #endif
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
            "    -k --keyfile\t RSA private keyfile to decrypt captured packets\n"
@@ -107,6 +122,9 @@ version()
 #ifdef WITH_PCRE
            " * Compiled with Perl Compatible regular expressions support.\n"
 #endif
+#ifdef WITH_PCRE2
+           " * Compiled with Perl Compatible regular expressions (v2) support.\n"
+#endif
 #ifdef USE_IPV6
            " * Compiled with IPv6 support.\n"
 #endif
@@ -126,6 +144,8 @@ int
 main(int argc, char* argv[])
 {
     int opt, idx, limit, only_calls, no_incomplete, i;
+    size_t memlimit = 0;
+    char *suffix;
     const char *device, *outfile;
     char bpf[512];
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
@@ -134,6 +154,9 @@ main(int argc, char* argv[])
     const char *match_expr;
     int match_insensitive = 0, match_invert = 0;
     int no_interface = 0, quiet = 0, rtp_capture = 0, rotate = 0, no_config = 0;
+#ifdef USE_EEP
+    const char *serve_path = NULL, *attach_path = NULL;
+#endif
     vector_t *infiles = vector_create(0, 1);
     vector_t *indevices = vector_create(0, 1);
 
@@ -153,6 +176,8 @@ main(int argc, char* argv[])
         { "icase", no_argument, 0, 'i' },
         { "invert", no_argument, 0, 'v' },
         { "no-interface", no_argument, 0, 'N' },
+        { "pipe", no_argument, &pipe_mode, 1 },
+        { "perf-stats", no_argument, &perf_stats_mode, 1 },
         { "dump-config", no_argument, 0, 'D' },
         { "rotate", no_argument, 0, 'R' },
         { "config", required_argument, 0, 'f' },
@@ -160,13 +185,15 @@ main(int argc, char* argv[])
 #ifdef USE_EEP
         { "eep-listen", required_argument, 0, 'L' },
         { "eep-send", required_argument, 0, 'H' },
+        { "serve", required_argument, 0, 'S' },
+        { "attach", required_argument, 0, 'A' },
 #endif
         { "quiet", no_argument, 0, 'q' },
     };
 
     // Parse command line arguments that have high priority
     opterr = 0;
-    char *options = "hVd:I:O:pqtW:k:crl:ivNqDL:H:Rf:F";
+    char *options = "hVd:I:O:pqtW:k:crl:ivNqDL:H:S:A:Rf:F";
     while ((opt = getopt_long(argc, argv, options, long_options, &idx)) != -1) {
         switch (opt) {
             case 'h':
@@ -217,7 +244,23 @@ main(int argc, char* argv[])
                 outfile = optarg;
                 break;
             case 'l':
-                if(!(limit = atoi(optarg))) {
+                limit = strtol(optarg, &suffix, 10);
+                if (limit > 0 && *suffix) {
+                    // Byte based storage limit (e.g. -l 2G)
+                    memlimit = (size_t) limit;
+                    if (*suffix == 'K' || *suffix == 'k') {
+                        memlimit <<= 10;
+                    } else if (*suffix == 'M' || *suffix == 'm') {
+                        memlimit <<= 20;
+                    } else if (*suffix == 'G' || *suffix == 'g') {
+                        memlimit <<= 30;
+                    } else {
+                        fprintf(stderr, "Invalid limit value.\n");
+                        return 0;
+                    }
+                    // Keep the default dialog count limit
+                    limit = setting_get_intvalue(SETTING_CAPTURE_LIMIT);
+                } else if (limit <= 0) {
                     fprintf(stderr, "Invalid limit value.\n");
                     return 0;
                 }
@@ -284,6 +327,22 @@ main(int argc, char* argv[])
 #else
                 fprintf(stderr, "sngrep is not compiled with HEP/EEP support.");
                 exit(1);
+#endif
+            case 'S':
+#ifdef USE_EEP
+                serve_path = optarg;
+                break;
+#else
+                fprintf(stderr, "sngrep is not compiled with HEP/EEP support.");
+                exit(1);
+#endif
+            case 'A':
+#ifdef USE_EEP
+                attach_path = optarg;
+                break;
+#else
+                fprintf(stderr, "sngrep is not compiled with HEP/EEP support.");
+                exit(1);
 #endif
             case '?':
                 if (strchr(options, optopt)) {
@@ -316,20 +375,56 @@ main(int argc, char* argv[])
         return 0;
     }
 
+    // Headless export implies no interface and no progress output
+    if (pipe_mode) {
+        no_interface = 1;
+        quiet = 1;
+    }
+
     // Initialize SIP Messages Storage
     sip_init(limit, only_calls, no_incomplete);
 
+    // Set the byte based storage limit
+    sip_set_memory_limit(memlimit);
+
     // Set capture options
     capture_init(limit, rtp_capture, rotate);
 
+    // Stream stored messages to stdout as JSON lines
+    if (pipe_mode)
+        pipe_init();
+
+    // Start the cold storage payload compactor if configured
+    compact_init();
+
+    // Open the disk spill ring for rotated calls if configured
+    spill_init();
+
 #ifdef USE_EEP
     // Initialize EEP if enabled
     capture_eep_init();
+
+    // Attach to a capture daemon socket
+    if (attach_path && capture_attach_init(attach_path) != 0)
+        return 1;
 #endif
 
+    // Treat leading positional arguments naming regular files as
+    // captures, so shell globs of rotated pcap sets can be passed
+    // directly; remaining arguments keep their match/BPF meaning
+    struct stat fstat;
+    while (argv[optind] && stat(argv[optind], &fstat) == 0 && S_ISREG(fstat.st_mode)) {
+        vector_append(infiles, argv[optind]);
+        optind++;
+    }
+
     // If no device or files has been specified in command line, use default
     if (vector_count(indevices) == 0 && vector_count(infiles) == 0) {
-        vector_append(indevices, (char *) device);
+#ifdef USE_EEP
+        // When attaching to a daemon, packets come from its socket
+        if (!attach_path)
+#endif
+            vector_append(indevices, (char *) device);
     }
 
     // If we have an input file, load it
@@ -392,6 +487,12 @@ main(int argc, char* argv[])
         return 1;
     }
 
+#ifdef USE_EEP
+    // Serve captured calls to attachable frontends
+    if (serve_path && capture_serve_init(serve_path) != 0)
+        return 1;
+#endif
+
     if (!no_interface) {
         // Initialize interface
         ncurses_init();
@@ -400,7 +501,9 @@ main(int argc, char* argv[])
         ui_create_panel(PANEL_CALL_LIST);
         ui_wait_for_input();
     } else {
-        setbuf(stdout, NULL);
+        // Keep the exporter buffering in pipe mode
+        if (!pipe_mode)
+            setbuf(stdout, NULL);
         while(capture_is_running()) {
             if (!quiet)
                 printf("\rDialog count: %d", sip_calls_count());
@@ -410,9 +513,23 @@ main(int argc, char* argv[])
             printf("\rDialog count: %d\n", sip_calls_count());
     }
 
+    // Print capture performance counters while sources are still open
+    if (perf_stats_mode)
+        perf_dump(stderr);
+
+    // Stop the payload compactor before destroying storage
+    compact_deinit();
+
+    // Close the disk spill ring
+    spill_deinit();
+
     // Capture deinit
     capture_deinit();
 
+    // Flush pending export output
+    if (pipe_mode)
+        pipe_deinit();
+
     // Deinitialize interface
     ncurses_deinit();
 
@@ -422,6 +539,9 @@ main(int argc, char* argv[])
     // Deallocate sip stored messages
     sip_deinit();
 
+    // Remove packet pools once no packet remains
+    packet_pool_deinit();
+
     // Leaving!
     return 0;
 }
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include "media.h"
 #include "rtp.h"
+#include "sip_msg.h"
 #include "util.h"
 
 sdp_media_t *
@@ -95,6 +96,11 @@ media_get_format(sdp_media_t *media, uint32_t code)
 {
     sdp_media_fmt_t *format;
     vector_iter_t iter;
+
+    // Format lines are parsed lazily the first time they are needed
+    if (media->msg)
+        msg_parse_media_formats(media->msg);
+
     iter = vector_iterator(media->formats);
     while ((format = vector_iterator_next(&iter))) {
         if (format->id == code)
@@ -36,6 +36,7 @@
 #include "option.h"
 #include "setting.h"
 #include "util.h"
+#include "hash.h"
 
 /**
  * @brief Configuration options array
@@ -185,29 +186,34 @@ set_option_value(const char *opt, const char *value)
     }
 }
 
+//! Aliases hashed by address, resolved once per render otherwise
+static htable_t *aliases = NULL;
+
 void
 set_alias_value(const char *address, const char *alias)
 {
     options[optscnt].type = ALIAS;
     options[optscnt].opt = strdup(address);
     options[optscnt].value = strdup(alias);
+
+    // Hash the alias by its address for the display paths
+    if (!aliases)
+        aliases = htable_create(256);
+    htable_insert(aliases, options[optscnt].opt, options[optscnt].value);
+
     optscnt++;
 }
 
 const char *
 get_alias_value(const char *address)
 {
-    int i;
+    const char *alias;
 
     if (!address)
         return NULL;
 
-    for (i = 0; i < optscnt; i++) {
-        if (options[i].type != ALIAS)
-            continue;
-        if (!strcmp(options[i].opt, address))
-            return options[i].value;
-    }
+    if (aliases && (alias = htable_find(aliases, address)))
+        return alias;
 
     return address;
 }
@@ -30,14 +30,42 @@
 #include <stdlib.h>
 #include <string.h>
 #include "packet.h"
+#include "pool.h"
+
+//! Packet and frame object pools, shared by all capture sources
+static mpool_t *packet_pool;
+static mpool_t *frame_pool;
+
+void
+packet_pool_init()
+{
+    packet_pool = mpool_create(sizeof(packet_t));
+    frame_pool = mpool_create(sizeof(frame_t));
+}
+
+void
+packet_pool_reserve(size_t count)
+{
+    // Stored packets keep a single frame, so both pools share the count
+    mpool_reserve(packet_pool, count);
+    mpool_reserve(frame_pool, count);
+}
+
+void
+packet_pool_deinit()
+{
+    mpool_destroy(packet_pool);
+    mpool_destroy(frame_pool);
+    packet_pool = NULL;
+    frame_pool = NULL;
+}
 
 packet_t *
 packet_create(uint8_t ip_ver, uint8_t proto, address_t src, address_t dst, uint32_t id)
 {
     // Create a new packet
     packet_t *packet;
-    packet = malloc(sizeof(packet_t));
-    memset(packet, 0, sizeof(packet_t));
+    packet = mpool_alloc(packet_pool);
     packet->ip_version = ip_ver;
     packet->proto = proto;
     packet->frames = vector_create(1, 1);
@@ -77,14 +105,16 @@ packet_destroy(packet_t *packet)
     vector_iter_t it = vector_iterator(packet->frames);
     while ((frame = vector_iterator_next(&it))) {
         free(frame->header);
-        free(frame->data);
+        if (!frame->mapped)
+            free(frame->data);
+        mpool_free(frame_pool, frame);
     }
 
     // TODO Free remaining packet data
-    vector_set_destroyer(packet->frames, vector_generic_destroyer);
     vector_destroy(packet->frames);
     free(packet->payload);
-    free(packet);
+    free(packet->tcp_key);
+    mpool_free(packet_pool, packet);
 }
 
 void
@@ -100,7 +130,9 @@ packet_free_frames(packet_t *pkt)
     vector_iter_t it = vector_iterator(pkt->frames);
 
     while ((frame = vector_iterator_next(&it))) {
-        free(frame->data);
+        // Mapped frames point into the capture file, nothing to free
+        if (!frame->mapped)
+            free(frame->data);
         frame->data = NULL;
     }
 }
@@ -116,11 +148,25 @@ packet_set_transport_data(packet_t *pkt, uint16_t sport, uint16_t dport)
 frame_t *
 packet_add_frame(packet_t *pkt, const struct pcap_pkthdr *header, const u_char *packet)
 {
-    frame_t *frame = malloc(sizeof(frame_t));
+    frame_t *frame = mpool_alloc(frame_pool);
     frame->header = malloc(sizeof(struct pcap_pkthdr));
     memcpy(frame->header, header, sizeof(struct pcap_pkthdr));
     frame->data = malloc(header->caplen);
     memcpy(frame->data, packet, header->caplen);
+    frame->mapped = false;
+    vector_append(pkt->frames, frame);
+    return frame;
+}
+
+frame_t *
+packet_add_frame_mapped(packet_t *pkt, const struct pcap_pkthdr *header, const u_char *packet)
+{
+    frame_t *frame = mpool_alloc(frame_pool);
+    frame->header = malloc(sizeof(struct pcap_pkthdr));
+    memcpy(frame->header, header, sizeof(struct pcap_pkthdr));
+    // Keep pointing into the mapped capture file, avoiding a copy
+    frame->data = (u_char *) packet;
+    frame->mapped = true;
     vector_append(pkt->frames, frame);
     return frame;
 }
@@ -137,18 +183,30 @@ packet_set_payload(packet_t *packet, u_char *payload, uint32_t payload_len)
     // Free previous payload
     if (packet->payload)
         free(packet->payload);
+    packet->payload = NULL;
     packet->payload_len = 0;
 
     // Set new payload
     if (payload) {
         packet->payload = malloc(payload_len + 1);
-        memset(packet->payload, 0, payload_len + 1);
         memcpy(packet->payload, payload, payload_len);
         packet->payload[payload_len] = '\0';
         packet->payload_len = payload_len;
     }
 }
 
+void
+packet_take_payload(packet_t *packet, u_char *payload, uint32_t payload_len)
+{
+    // Free previous payload
+    if (packet->payload)
+        free(packet->payload);
+
+    // Own the given buffer without copying it
+    packet->payload = payload;
+    packet->payload_len = payload_len;
+}
+
 uint32_t
 packet_payloadlen(packet_t *packet)
 {
@@ -177,3 +235,25 @@ packet_time(packet_t *packet)
     return ts;
 }
 
+size_t
+packet_memsize(packet_t *packet)
+{
+    frame_t *frame;
+    vector_iter_t it;
+    size_t bytes = sizeof(packet_t);
+
+    // Account frame structures and their captured content
+    it = vector_iterator(packet->frames);
+    while ((frame = vector_iterator_next(&it))) {
+        bytes += sizeof(frame_t) + sizeof(struct pcap_pkthdr);
+        if (!frame->mapped)
+            bytes += frame->header->caplen;
+    }
+
+    // Account reassembled payload
+    if (packet->payload)
+        bytes += packet->payload_len;
+
+    return bytes;
+}
+
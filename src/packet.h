@@ -38,6 +38,7 @@
 
 #include <time.h>
 #include <sys/types.h>
+#include <stdbool.h>
 #include <pcap.h>
 #include "address.h"
 #include "vector.h"
@@ -84,10 +85,16 @@ struct packet {
     uint32_t ip_exp_len;
     //! Last TCP sequence frame
     uint32_t tcp_seq;
+    //! TCP reassembly hash table key (only set while pending reassembly)
+    char *tcp_key;
     //! PCAP Packet payload when it can not be get from data
     u_char *payload;
     //! Payload length
     uint32_t payload_len;
+    //! Payload length before compaction (@see compact.c)
+    uint32_t payload_orig_len;
+    //! Payload is held deflated by the cold storage compactor
+    bool payload_deflated;
     //! Packet frame list (frame_t)
     vector_t *frames;
 };
@@ -103,8 +110,37 @@ struct frame {
     struct pcap_pkthdr *header;
     //! PCAP Frame content
     u_char *data;
+    //! Frame content points into a mapped capture file (not owned)
+    bool mapped;
 };
 
+/**
+ * @brief Create the packet and frame object pools
+ *
+ * Must be called before any packet is created (@see capture_init)
+ */
+void
+packet_pool_init();
+
+/**
+ * @brief Warm the packet pools up to the expected working set
+ *
+ * Preallocates packet and frame pool slabs for the given number of
+ * stored packets (@see capture_init)
+ *
+ * @param count Number of packets to preallocate
+ */
+void
+packet_pool_reserve(size_t count);
+
+/**
+ * @brief Free the packet and frame object pools
+ *
+ * All packets must have been destroyed before this point
+ */
+void
+packet_pool_deinit();
+
 /**
  * @brief Allocate memory to store new packet data
  */
@@ -129,6 +165,15 @@ packet_set_transport_data(packet_t *pkt, uint16_t sport, uint16_t dport);
 frame_t *
 packet_add_frame(packet_t *pkt, const struct pcap_pkthdr *header, const u_char *packet);
 
+/**
+ * @brief Add a new frame pointing into a mapped capture file
+ *
+ * Unlike packet_add_frame, the frame content is not copied: it keeps
+ * pointing into the memory mapped file, which outlives the packet.
+ */
+frame_t *
+packet_add_frame_mapped(packet_t *pkt, const struct pcap_pkthdr *header, const u_char *packet);
+
 /**
  * @brief Deallocate a packet structure memory
  */
@@ -161,6 +206,16 @@ packet_set_type(packet_t *packet, enum packet_type type);
 void
 packet_set_payload(packet_t *packet, u_char *payload, uint32_t payload_len);
 
+/**
+ * @brief Set packet payload adopting an already allocated buffer
+ *
+ * The buffer must hold payload_len + 1 bytes, be NUL terminated and
+ * will be owned (and eventually freed) by the packet, avoiding the
+ * extra copy packet_set_payload would make.
+ */
+void
+packet_take_payload(packet_t *packet, u_char *payload, uint32_t payload_len);
+
 /**
  * @brief Getter for capture payload size
  */
@@ -179,4 +234,17 @@ packet_payload(packet_t *packet);
 struct timeval
 packet_time(packet_t *packet);
 
+/**
+ * @brief Approximate memory used by a packet
+ *
+ * Accounts the packet structure, its frames and extra payload.
+ * Frames pointing into a mapped capture file don't own their content,
+ * so only their headers are counted.
+ *
+ * @param packet Packet structure
+ * @return memory used by the packet in bytes
+ */
+size_t
+packet_memsize(packet_t *packet);
+
 #endif /* __SNGREP_CAPTURE_PACKET_H */
@@ -0,0 +1,148 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file perf.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in perf.h
+ *
+ */
+#include "config.h"
+#include <stdatomic.h>
+#include <sys/time.h>
+#include "capture.h"
+#include "perf.h"
+
+//! Per stage packet counters
+static _Atomic uint64_t perf_stage_count[PERF_STAGE_COUNT];
+//! Latency histograms, bucket i counts durations below 2^i microseconds
+static _Atomic uint64_t perf_hist[PERF_TIMER_COUNT][PERF_HIST_BUCKETS];
+//! Number of timed samples per timer
+static _Atomic uint64_t perf_samples[PERF_TIMER_COUNT];
+//! Accumulated duration per timer in microseconds
+static _Atomic uint64_t perf_total_us[PERF_TIMER_COUNT];
+//! Longest timed duration per timer in microseconds
+static _Atomic uint64_t perf_max_us[PERF_TIMER_COUNT];
+
+void
+perf_count(enum perf_stage stage)
+{
+    atomic_fetch_add_explicit(&perf_stage_count[stage], 1, memory_order_relaxed);
+}
+
+uint64_t
+perf_timer_start()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+void
+perf_timer_record(enum perf_timer timer, uint64_t start)
+{
+    uint64_t elapsed = perf_timer_start() - start;
+    uint64_t max;
+    int bucket;
+
+    // Find the first bucket the elapsed time fits in
+    for (bucket = 0; bucket < PERF_HIST_BUCKETS - 1; bucket++) {
+        if (elapsed < ((uint64_t) 1 << bucket))
+            break;
+    }
+
+    atomic_fetch_add_explicit(&perf_hist[timer][bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&perf_samples[timer], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&perf_total_us[timer], elapsed, memory_order_relaxed);
+
+    // Update the maximum, retrying if another thread raced us
+    max = atomic_load_explicit(&perf_max_us[timer], memory_order_relaxed);
+    while (elapsed > max
+           && !atomic_compare_exchange_weak_explicit(&perf_max_us[timer], &max, elapsed,
+                                                     memory_order_relaxed, memory_order_relaxed));
+}
+
+perf_stats_t
+perf_get_stats()
+{
+    perf_stats_t stats;
+    int i, j;
+
+    for (i = 0; i < PERF_STAGE_COUNT; i++)
+        stats.stage[i] = atomic_load_explicit(&perf_stage_count[i], memory_order_relaxed);
+
+    for (i = 0; i < PERF_TIMER_COUNT; i++) {
+        for (j = 0; j < PERF_HIST_BUCKETS; j++)
+            stats.hist[i][j] = atomic_load_explicit(&perf_hist[i][j], memory_order_relaxed);
+        stats.samples[i] = atomic_load_explicit(&perf_samples[i], memory_order_relaxed);
+        stats.total_us[i] = atomic_load_explicit(&perf_total_us[i], memory_order_relaxed);
+        stats.max_us[i] = atomic_load_explicit(&perf_max_us[i], memory_order_relaxed);
+    }
+
+    // Poll the kernel counters from libpcap
+    capture_kernel_stats(&stats.kernel_recv, &stats.kernel_drop);
+
+    return stats;
+}
+
+void
+perf_dump(FILE *out)
+{
+    perf_stats_t stats = perf_get_stats();
+    const char *names[PERF_TIMER_COUNT] = {
+        "parse", "store", "reasm_tcp", "sip_store", "rtp_check", "filter"
+    };
+    int i, j, last;
+
+    fprintf(out, "Capture performance counters:\n");
+    fprintf(out, "  captured: %lu  parsed: %lu  matched: %lu  dropped: %lu\n",
+            (unsigned long) stats.stage[PERF_CAPTURED],
+            (unsigned long) stats.stage[PERF_PARSED],
+            (unsigned long) stats.stage[PERF_MATCHED],
+            (unsigned long) stats.stage[PERF_DROPPED]);
+    fprintf(out, "  kernel: received %lu, dropped %lu\n",
+            (unsigned long) stats.kernel_recv,
+            (unsigned long) stats.kernel_drop);
+
+    for (i = 0; i < PERF_TIMER_COUNT; i++) {
+        if (!stats.samples[i])
+            continue;
+
+        fprintf(out, "  %s latency: %lu samples, avg %lu us, max %lu us\n",
+                names[i],
+                (unsigned long) stats.samples[i],
+                (unsigned long) (stats.total_us[i] / stats.samples[i]),
+                (unsigned long) stats.max_us[i]);
+
+        // Skip trailing empty buckets
+        for (last = PERF_HIST_BUCKETS - 1; last > 0; last--) {
+            if (stats.hist[i][last])
+                break;
+        }
+
+        for (j = 0; j <= last; j++) {
+            fprintf(out, "    < %lu us: %lu\n",
+                    (unsigned long) 1 << j,
+                    (unsigned long) stats.hist[i][j]);
+        }
+    }
+}
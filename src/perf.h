@@ -0,0 +1,161 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file perf.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Capture pipeline performance counters
+ *
+ * Per stage packet counters and latency histograms for the capture
+ * pipeline, used to tell why packets are being dropped. Counters are
+ * updated from capture and parser threads with relaxed atomics, so
+ * the cost on the hot path is a couple of uncontended additions.
+ *
+ * Counters can be displayed in the perf panel (@see ui_perf.h) and
+ * printed at exit with the --perf-stats command line flag.
+ */
+#ifndef __SNGREP_PERF_H
+#define __SNGREP_PERF_H
+
+#include "config.h"
+#include <stdio.h>
+#include <stdint.h>
+
+//! Histogram buckets: bucket i counts durations below 2^i microseconds
+#define PERF_HIST_BUCKETS 20
+
+//! Capture pipeline stages being counted
+enum perf_stage {
+    //! Frames handed to us by libpcap
+    PERF_CAPTURED = 0,
+    //! Packets whose payload parsed as a SIP message
+    PERF_PARSED,
+    //! SIP messages matched and stored into the calls list
+    PERF_MATCHED,
+    //! Frames discarded before parsing (paused, limits, unhandled protocol)
+    PERF_DROPPED,
+    //! Stage counter
+    PERF_STAGE_COUNT,
+};
+
+//! Capture pipeline sections being timed
+enum perf_timer {
+    //! SIP payload parsing (@see sip_parse_packet)
+    PERF_TIMER_PARSE = 0,
+    //! Storage under the capture lock, including the lock wait
+    PERF_TIMER_STORE,
+    //! TCP segment reassembly, profiling builds only
+    PERF_TIMER_REASM_TCP,
+    //! SIP message storage into the calls list, profiling builds only
+    PERF_TIMER_SIP_STORE,
+    //! RTP stream matching, profiling builds only
+    PERF_TIMER_RTP_CHECK,
+    //! Display filter evaluation, profiling builds only
+    PERF_TIMER_FILTER,
+    //! Timer counter
+    PERF_TIMER_COUNT,
+};
+
+/**
+ * Fine grained timers around the known hot functions, only compiled
+ * in --enable-profiling builds so the default build pays nothing for
+ * them. Their histograms are printed with the rest of the counters at
+ * exit with the --perf-stats command line flag.
+ */
+#ifdef WITH_PROFILING
+#define PROF_TIMER_START(var)           uint64_t var = perf_timer_start()
+#define PROF_TIMER_RECORD(timer, var)   perf_timer_record(timer, var)
+#else
+#define PROF_TIMER_START(var)
+#define PROF_TIMER_RECORD(timer, var)
+#endif
+
+/**
+ * @brief Counters snapshot returned by perf_get_stats
+ */
+struct perf_stats {
+    //! Per stage packet counters
+    uint64_t stage[PERF_STAGE_COUNT];
+    //! Packets seen by the kernel capture filters (@see capture_kernel_stats)
+    uint64_t kernel_recv;
+    //! Packets dropped before reaching us (kernel and frames queue)
+    uint64_t kernel_drop;
+    //! Latency histograms, bucket i counts durations below 2^i microseconds
+    uint64_t hist[PERF_TIMER_COUNT][PERF_HIST_BUCKETS];
+    //! Number of timed samples per timer
+    uint64_t samples[PERF_TIMER_COUNT];
+    //! Accumulated duration per timer in microseconds
+    uint64_t total_us[PERF_TIMER_COUNT];
+    //! Longest timed duration per timer in microseconds
+    uint64_t max_us[PERF_TIMER_COUNT];
+};
+
+//! Shorter declaration of perf_stats structure
+typedef struct perf_stats perf_stats_t;
+
+/**
+ * @brief Increment one pipeline stage counter
+ *
+ * @param stage Counter to increment
+ */
+void
+perf_count(enum perf_stage stage);
+
+/**
+ * @brief Get the current time for a latency measurement
+ *
+ * @return Current time in microseconds
+ */
+uint64_t
+perf_timer_start();
+
+/**
+ * @brief Account the time elapsed since perf_timer_start
+ *
+ * @param timer Histogram the sample belongs to
+ * @param start Value returned by perf_timer_start
+ */
+void
+perf_timer_record(enum perf_timer timer, uint64_t start);
+
+/**
+ * @brief Get a snapshot of all performance counters
+ *
+ * Kernel drop counters are polled from libpcap at this point
+ * (@see capture_kernel_stats).
+ *
+ * @return Counters snapshot
+ */
+perf_stats_t
+perf_get_stats();
+
+/**
+ * @brief Print a counters summary
+ *
+ * Used at exit when the --perf-stats flag has been given.
+ *
+ * @param out File to print the summary to
+ */
+void
+perf_dump(FILE *out);
+
+#endif /* __SNGREP_PERF_H */
@@ -0,0 +1,122 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file pipe.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in pipe.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include "capture.h"
+#include "pipe.h"
+
+//! Output buffer for the streamed JSON lines
+static char pipe_buffer[65536];
+
+/**
+ * @brief Write a JSON escaped string value to standard output
+ */
+static void
+pipe_write_escaped(const char *value)
+{
+    const char *p;
+
+    putchar('"');
+    for (p = value; *p; p++) {
+        switch (*p) {
+            case '"':
+                fputs("\\\"", stdout);
+                break;
+            case '\\':
+                fputs("\\\\", stdout);
+                break;
+            case '\n':
+                fputs("\\n", stdout);
+                break;
+            case '\r':
+                fputs("\\r", stdout);
+                break;
+            case '\t':
+                fputs("\\t", stdout);
+                break;
+            default:
+                if ((unsigned char) *p < 0x20) {
+                    printf("\\u%04x", *p);
+                } else {
+                    putchar(*p);
+                }
+        }
+    }
+    putchar('"');
+}
+
+void
+pipe_write_msg(sip_msg_t *msg)
+{
+    struct timeval ts = msg_get_time(msg);
+
+    // Make sure From/To headers have been parsed
+    sip_parse_msg(msg);
+
+    printf("{\"ts\":%ld.%06ld", (long) ts.tv_sec, (long) ts.tv_usec);
+    printf(",\"src\":\"%s\",\"src_port\":%u", msg->packet->src.ip, msg->packet->src.port);
+    printf(",\"dst\":\"%s\",\"dst_port\":%u", msg->packet->dst.ip, msg->packet->dst.port);
+
+    fputs(",\"method\":", stdout);
+    pipe_write_escaped(sip_get_msg_reqresp_str(msg));
+
+    // Responses also carry their numeric code
+    if (msg->reqresp >= 100)
+        printf(",\"response_code\":%d", msg->reqresp);
+
+    printf(",\"cseq\":%u", msg->cseq);
+
+    fputs(",\"call_id\":", stdout);
+    pipe_write_escaped(msg->call->callid);
+
+    fputs(",\"from\":", stdout);
+    pipe_write_escaped((msg->disp && msg->disp->sip_from) ? msg->disp->sip_from : "");
+    fputs(",\"to\":", stdout);
+    pipe_write_escaped((msg->disp && msg->disp->sip_to) ? msg->disp->sip_to : "");
+
+    fputs("}\n", stdout);
+}
+
+void
+pipe_init()
+{
+    // Buffer the output, one line per message at high rates
+    setvbuf(stdout, pipe_buffer, _IOFBF, sizeof(pipe_buffer));
+
+    // Write a line for every stored SIP message
+    capture_set_msg_callback(pipe_write_msg);
+}
+
+void
+pipe_deinit()
+{
+    capture_set_msg_callback(NULL);
+    fflush(stdout);
+}
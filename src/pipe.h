@@ -0,0 +1,63 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file pipe.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to stream stored SIP messages as JSON lines
+ *
+ * Headless export mode (--pipe): every stored SIP message is written
+ * to standard output as one JSON line, without any interface.
+ *
+ */
+#ifndef __SNGREP_PIPE_H
+#define __SNGREP_PIPE_H
+
+#include "config.h"
+#include "sip.h"
+
+/**
+ * @brief Start the headless export mode
+ *
+ * Registers a capture callback that writes one JSON line to standard
+ * output for every stored SIP message, using a buffered writer.
+ */
+void
+pipe_init();
+
+/**
+ * @brief Flush pending output and unregister the export callback
+ */
+void
+pipe_deinit();
+
+/**
+ * @brief Write a stored SIP message as a JSON line
+ *
+ * Invoked from the capture layer for every stored message.
+ *
+ * @param msg stored SIP message
+ */
+void
+pipe_write_msg(sip_msg_t *msg);
+
+#endif /* __SNGREP_PIPE_H */
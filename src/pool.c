@@ -0,0 +1,154 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file pool.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in pool.h
+ *
+ */
+#include "pool.h"
+#include <string.h>
+#include <stdlib.h>
+
+mpool_t *
+mpool_create(size_t objsz)
+{
+    mpool_t *pool;
+
+    // Allocate memory for the pool data
+    if (!(pool = malloc(sizeof(mpool_t))))
+        return NULL;
+
+    // Released objects store the freelist link inside themselves
+    if (objsz < sizeof(void *))
+        objsz = sizeof(void *);
+
+    memset(pool, 0, sizeof(mpool_t));
+    pool->objsz = objsz;
+    pthread_mutex_init(&pool->lock, NULL);
+
+    // Return allocated pool
+    return pool;
+}
+
+void
+mpool_destroy(mpool_t *pool)
+{
+    mpool_slab_t *slab, *next;
+
+    if (!pool)
+        return;
+
+    // Free all allocated slabs
+    for (slab = pool->slabs; slab; slab = next) {
+        next = slab->next;
+        free(slab);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+void
+mpool_reserve(mpool_t *pool, size_t count)
+{
+    mpool_slab_t *slab;
+    char *obj;
+    size_t i;
+
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+
+    // Request full slabs and link their objects into the freelist,
+    // touching every page so the capture path won't fault them in
+    while (count > 0) {
+        if (!(slab = malloc(sizeof(mpool_slab_t) + pool->objsz * POOL_SLAB_OBJECTS)))
+            break;
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+
+        obj = (char *) slab + sizeof(mpool_slab_t);
+        for (i = 0; i < POOL_SLAB_OBJECTS; i++, obj += pool->objsz) {
+            *(void **) obj = pool->freelist;
+            pool->freelist = obj;
+        }
+
+        count = (count > POOL_SLAB_OBJECTS) ? count - POOL_SLAB_OBJECTS : 0;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void *
+mpool_alloc(mpool_t *pool)
+{
+    void *obj;
+    mpool_slab_t *slab;
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->freelist) {
+        // Reuse the most recently released object
+        obj = pool->freelist;
+        pool->freelist = *(void **) obj;
+    } else {
+        // Grow the pool when the newest slab is exhausted
+        if (!pool->avail) {
+            if (!(slab = malloc(sizeof(mpool_slab_t) + pool->objsz * POOL_SLAB_OBJECTS))) {
+                pthread_mutex_unlock(&pool->lock);
+                return NULL;
+            }
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->next = (char *) slab + sizeof(mpool_slab_t);
+            pool->avail = POOL_SLAB_OBJECTS;
+        }
+        // Take the next unused object of the slab
+        obj = pool->next;
+        pool->next = (char *) pool->next + pool->objsz;
+        pool->avail--;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    // Initialize object memory
+    memset(obj, 0, pool->objsz);
+    return obj;
+}
+
+void
+mpool_free(mpool_t *pool, void *obj)
+{
+    if (!obj)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+
+    // Link the object into the freelist for reuse
+    *(void **) obj = pool->freelist;
+    pool->freelist = obj;
+
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,126 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file pool.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to manage fixed size object pools
+ *
+ * The capture hot path allocates and frees the same small structures
+ * (packets, frames, messages) millions of times during a long capture,
+ * fragmenting the heap. These pools request memory from the system in
+ * slabs of many objects and keep released objects in a freelist, so
+ * most allocations are a single pointer operation.
+ *
+ * Pools are thread safe: objects may be allocated from the capture
+ * thread and released from the UI thread.
+ */
+
+#ifndef __SNGREP_POOL_H_
+#define __SNGREP_POOL_H_
+
+#include "config.h"
+#include <stdio.h>
+#include <pthread.h>
+
+//! Objects requested from the system on each pool grow
+#define POOL_SLAB_OBJECTS 256
+
+//! Shorter declaration of pool structures
+typedef struct mpool mpool_t;
+typedef struct mpool_slab mpool_slab_t;
+
+/**
+ * @brief One block of objects requested from the system
+ */
+struct mpool_slab {
+    //! Next allocated slab of this pool
+    mpool_slab_t *next;
+    //! Object storage follows this header
+};
+
+struct mpool {
+    //! Size of a single pooled object
+    size_t objsz;
+    //! List of allocated slabs (freed with the pool)
+    mpool_slab_t *slabs;
+    //! List of released objects ready for reuse
+    void *freelist;
+    //! Unused objects left in the newest slab
+    size_t avail;
+    //! First unused object of the newest slab
+    void *next;
+    //! Allocation lock
+    pthread_mutex_t lock;
+};
+
+/**
+ * @brief Create a new pool for objects of the given size
+ *
+ * No slab is allocated until the first object is requested.
+ *
+ * @param objsz Size in bytes of the pooled objects
+ * @return pointer to the created pool, NULL on failure
+ */
+mpool_t *
+mpool_create(size_t objsz);
+
+/**
+ * @brief Free all the slabs of a pool and the pool itself
+ *
+ * All objects allocated from the pool become invalid.
+ */
+void
+mpool_destroy(mpool_t *pool);
+
+/**
+ * @brief Preallocate slabs for the given number of objects
+ *
+ * Requests the slabs from the system and links their objects into the
+ * freelist, so the following allocations neither call the system
+ * allocator nor fault in new pages. Intended to warm pools up to the
+ * expected working set at startup, before any object is allocated.
+ *
+ * @param pool Pool to grow
+ * @param count Number of objects to preallocate
+ */
+void
+mpool_reserve(mpool_t *pool, size_t count);
+
+/**
+ * @brief Request a zero initialized object from the pool
+ *
+ * Reuses a released object when available, otherwise takes the next
+ * unused object of the current slab, growing the pool if required.
+ *
+ * @return pointer to the object, NULL on failure
+ */
+void *
+mpool_alloc(mpool_t *pool);
+
+/**
+ * @brief Return an object to the pool for reuse
+ */
+void
+mpool_free(mpool_t *pool, void *obj);
+
+#endif /* __SNGREP_POOL_H_ */
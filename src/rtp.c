@@ -35,6 +35,119 @@
 #include "rtp.h"
 #include "sip.h"
 #include "vector.h"
+#include "hash.h"
+
+//! Global stream index: streams grouped by destination address
+static htable_t *stream_dst_idx = NULL;
+//! Global stream index: streams resolved by learned SSRC
+static htable_t *stream_ssrc_idx = NULL;
+
+//! Buckets of the global stream index tables
+#define RTP_STREAM_IDX_BUCKETS 1024
+
+/**
+ * @brief Get the streams sharing the given index key, creating tables on demand
+ */
+static vector_t *
+rtp_stream_index_bucket(const char *key, bool create)
+{
+    vector_t *streams;
+
+    if (!stream_dst_idx)
+        stream_dst_idx = htable_create(RTP_STREAM_IDX_BUCKETS);
+
+    if (!(streams = htable_find(stream_dst_idx, key)) && create) {
+        streams = vector_create(0, 2);
+        // The key memory belongs to the first indexed stream, that may be
+        // destroyed before others sharing its destination, so store a copy
+        htable_insert(stream_dst_idx, strdup(key), streams);
+    }
+
+    return streams;
+}
+
+/**
+ * @brief Drop streams that will not receive more packets from a bucket
+ *
+ * Complete streams of finished calls that have been inactive for a
+ * while keep their destination entry in the index, so lookups under
+ * port churn scan them over and over. Remove them from the bucket; the
+ * streams still belong to their call and keep their SSRC entry, so a
+ * resumed stream is found through the SSRC fast path anyway.
+ */
+static void
+rtp_stream_index_expire(vector_t *streams)
+{
+    rtp_stream_t *stream;
+    struct sip_call *call;
+    int i = 0;
+
+    while ((stream = vector_item(streams, i))) {
+        call = stream_get_call(stream);
+        if (stream_is_complete(stream) && !stream_is_active(stream)
+                && call && !call_is_active(call)) {
+            vector_remove(streams, stream);
+        } else {
+            i++;
+        }
+    }
+}
+
+//! Entries of the negative cache of flows with no matching stream
+#define RTP_NOSTREAM_CACHE 256
+
+//! Address pair recently checked without finding any stream
+struct rtp_nostream_entry {
+    //! Source and destination address pair key
+    char key[ADDRESSLEN * 2 + 16];
+    //! Stream index generation the check was done against
+    uint32_t gen;
+};
+
+//! Negative cache: address pairs checked without finding any stream
+static struct rtp_nostream_entry rtp_nostream_cache[RTP_NOSTREAM_CACHE];
+//! Bumped when a stream is indexed, invalidating the negative cache
+static uint32_t rtp_stream_gen = 1;
+
+/**
+ * @brief Build the negative cache key of a packet address pair
+ */
+static void
+rtp_nostream_key(address_t src, address_t dst, char *key, size_t len)
+{
+    snprintf(key, len, "%s:%u-%s:%u", src.ip, src.port, dst.ip, dst.port);
+}
+
+/**
+ * @brief Check if an address pair is known to have no stream
+ *
+ * Entries are only valid against the current stream index generation,
+ * so a flow cached before its SDP was seen is checked again.
+ */
+static bool
+rtp_nostream_cached(const char *key)
+{
+    struct rtp_nostream_entry *entry;
+
+    entry = &rtp_nostream_cache[htable_hash(key) % RTP_NOSTREAM_CACHE];
+    return entry->gen == rtp_stream_gen && !strcmp(entry->key, key);
+}
+
+/**
+ * @brief Remember an address pair no stream matched
+ *
+ * The cache is direct mapped: a colliding pair simply takes over the
+ * entry, keeping the most recently rejected flows cached.
+ */
+static void
+rtp_nostream_store(const char *key)
+{
+    struct rtp_nostream_entry *entry;
+
+    entry = &rtp_nostream_cache[htable_hash(key) % RTP_NOSTREAM_CACHE];
+    strcpy(entry->key, key);
+    entry->gen = rtp_stream_gen;
+}
 
 /**
  * @brief Known RTP encodings
@@ -97,12 +210,100 @@ stream_set_format(rtp_stream_t *stream, uint32_t format)
     stream->rtpinfo.fmtcode = format;
 }
 
+/**
+ * @brief Get the RTP clock rate of a stream in Hz
+ *
+ * Parsed from the encoding name of the stream format. Dynamic payload
+ * types default to 8000Hz, as most audio encodings.
+ */
+static uint32_t
+stream_get_clockrate(rtp_stream_t *stream)
+{
+    const char *rate;
+    int i;
+
+    for (i = 0; encodings[i].name; i++) {
+        if (encodings[i].id == stream->rtpinfo.fmtcode) {
+            if ((rate = strchr(encodings[i].name, '/')))
+                return atoi(rate + 1);
+            break;
+        }
+    }
+
+    return 8000;
+}
+
+/**
+ * @brief Update stream quality counters with a new RTP packet
+ *
+ * Maintains the RFC 3550 receiver statistics incrementally: the
+ * extended highest sequence number for loss detection and the
+ * interarrival jitter estimator (RFC 3550 A.8). Only O(1) state per
+ * stream is kept, no packet needs to be retained.
+ */
+static void
+stream_update_quality(rtp_stream_t *stream, packet_t *packet)
+{
+    u_char *payload = packet_payload(packet);
+    struct timeval time;
+    uint32_t ts, arrival, rate;
+    uint16_t seq;
+    int32_t delta;
+
+    if (packet_payloadlen(packet) < RTP_HDR_LENGTH)
+        return;
+
+    // Sequence number and timestamp from the RTP header
+    memcpy(&seq, payload + 2, sizeof(seq));
+    seq = ntohs(seq);
+    memcpy(&ts, payload + 4, sizeof(ts));
+    ts = ntohl(ts);
+
+    // Arrival time expressed in RTP timestamp units
+    rate = stream_get_clockrate(stream);
+    time = packet_time(packet);
+    arrival = time.tv_sec * rate + ((uint64_t) time.tv_usec * rate) / 1000000;
+
+    if (stream->pktcnt == 0) {
+        stream->rtpinfo.baseseq = seq;
+        stream->rtpinfo.maxseq = seq;
+        stream->rtpinfo.transit = arrival - ts;
+        return;
+    }
+
+    // Advance the extended highest sequence number received
+    if ((uint16_t)(seq - stream->rtpinfo.maxseq) < 0x8000) {
+        if (seq < stream->rtpinfo.maxseq)
+            stream->rtpinfo.cycles += 1 << 16;
+        stream->rtpinfo.maxseq = seq;
+    }
+
+    // Interarrival jitter estimator, kept scaled by 16
+    delta = (arrival - ts) - stream->rtpinfo.transit;
+    stream->rtpinfo.transit = arrival - ts;
+    if (delta < 0)
+        delta = -delta;
+    stream->rtpinfo.jitter += delta - ((stream->rtpinfo.jitter + 8) >> 4);
+}
+
 void
 stream_add_packet(rtp_stream_t *stream, packet_t *packet)
 {
+    struct sip_call *call;
+
     if (stream->pktcnt == 0)
         stream->time = packet_time(packet);
 
+    // Update quality metrics with the RTP header of this packet
+    if (stream->type == PACKET_RTP)
+        stream_update_quality(stream, packet);
+
+    // Quality evolves with media, not SIP, so repaint the call rows
+    if ((call = stream_get_call(stream))) {
+        call->changed = true;
+        sip_calls_mark_changed();
+    }
+
     stream->lasttm = (int) time(NULL);
     stream->pktcnt++;
 }
@@ -113,6 +314,61 @@ stream_get_count(rtp_stream_t *stream)
     return stream->pktcnt;
 }
 
+uint32_t
+stream_get_lost(rtp_stream_t *stream)
+{
+    uint32_t expected;
+
+    if (stream->type != PACKET_RTP || !stream->pktcnt)
+        return 0;
+
+    // Expected packets from the extended sequence range (RFC 3550 A.3)
+    expected = stream->rtpinfo.cycles + stream->rtpinfo.maxseq
+               - stream->rtpinfo.baseseq + 1;
+
+    // Duplicated packets may push the received count over the expected
+    return (expected > stream->pktcnt) ? expected - stream->pktcnt : 0;
+}
+
+float
+stream_get_jitter(rtp_stream_t *stream)
+{
+    if (stream->type != PACKET_RTP)
+        return 0;
+
+    // The estimator is kept scaled by 16 in timestamp units
+    return (float) (stream->rtpinfo.jitter >> 4) * 1000 / stream_get_clockrate(stream);
+}
+
+float
+stream_get_mos(rtp_stream_t *stream)
+{
+    float rfactor, effective, losspct;
+    uint32_t lost;
+
+    if (stream->type != PACKET_RTP || !stream->pktcnt)
+        return 0;
+
+    // Loss percentage over the expected packet count
+    lost = stream_get_lost(stream);
+    losspct = 100.0 * lost / (stream->pktcnt + lost);
+
+    // Take the jitter buffering as the only measurable delay source
+    effective = stream_get_jitter(stream) * 2 + 10;
+    if (effective < 160) {
+        rfactor = 93.2 - effective / 40;
+    } else {
+        rfactor = 93.2 - (effective - 120) / 10;
+    }
+    rfactor -= losspct * 2.5;
+
+    if (rfactor < 0)
+        rfactor = 0;
+
+    // R factor to MOS conversion (ITU-T G.107 Annex B)
+    return 1 + 0.035 * rfactor + 7e-6 * rfactor * (rfactor - 60) * (100 - rfactor);
+}
+
 struct sip_call *
 stream_get_call(rtp_stream_t *stream) {
     if (stream && stream->media && stream->media->msg)
@@ -156,6 +412,87 @@ rtp_get_standard_format(uint32_t code)
     return NULL;
 }
 
+void
+rtp_stream_index_add(rtp_stream_t *stream)
+{
+    vector_t *streams;
+
+    // Build this stream destination key
+    snprintf(stream->dst_key, sizeof(stream->dst_key), "%s:%u",
+             stream->dst.ip, stream->dst.port);
+
+    // Add the stream to its destination bucket
+    streams = rtp_stream_index_bucket(stream->dst_key, true);
+    vector_append(streams, stream);
+
+    // Flows rejected before this stream existed must be checked again
+    rtp_stream_gen++;
+}
+
+void
+rtp_stream_index_remove(rtp_stream_t *stream)
+{
+    vector_t *streams;
+
+    // Not indexed stream
+    if (!stream->dst_key[0])
+        return;
+
+    // Remove the stream from its destination bucket
+    if ((streams = rtp_stream_index_bucket(stream->dst_key, false)))
+        vector_remove(streams, stream);
+
+    // Remove the learned SSRC entry
+    if (stream->ssrc_key[0] && stream_ssrc_idx)
+        htable_remove(stream_ssrc_idx, stream->ssrc_key);
+}
+
+/**
+ * @brief Learn the SSRC of a stream for packet fast path resolution
+ */
+static void
+rtp_stream_learn_ssrc(rtp_stream_t *stream, uint32_t ssrc)
+{
+    if (!stream_ssrc_idx)
+        stream_ssrc_idx = htable_create(RTP_STREAM_IDX_BUCKETS);
+
+    // Remove the previous learned value
+    if (stream->ssrc_key[0])
+        htable_remove(stream_ssrc_idx, stream->ssrc_key);
+
+    stream->ssrc = ssrc;
+    snprintf(stream->ssrc_key, sizeof(stream->ssrc_key), "%08x", ssrc);
+    htable_insert(stream_ssrc_idx, stream->ssrc_key, stream);
+}
+
+/**
+ * @brief Resolve a stream by the SSRC of a received RTP packet
+ *
+ * The SSRC may collide between unrelated streams, so the packet
+ * addresses and format must also match the indexed stream.
+ */
+static rtp_stream_t *
+rtp_stream_find_ssrc(uint32_t ssrc, address_t src, address_t dst, uint32_t format)
+{
+    rtp_stream_t *stream;
+    char key[12];
+
+    if (!stream_ssrc_idx)
+        return NULL;
+
+    snprintf(key, sizeof(key), "%08x", ssrc);
+    if (!(stream = htable_find(stream_ssrc_idx, key)))
+        return NULL;
+
+    // Check this is really the same stream
+    if (stream->rtpinfo.fmtcode != format)
+        return NULL;
+    if (!addressport_equals(stream->src, src) || !addressport_equals(stream->dst, dst))
+        return NULL;
+
+    return stream;
+}
+
 rtp_stream_t *
 rtp_check_packet(packet_t *packet)
 {
@@ -171,6 +508,7 @@ rtp_check_packet(packet_t *packet)
     struct rtcp_hdr_xr hdr_xr;
     struct rtcp_blk_xr blk_xr;
     struct rtcp_blk_xr_voip blk_xr_voip;
+    char nokey[ADDRESSLEN * 2 + 16];
 
     // Get packet data
     payload = packet_payload(packet);
@@ -180,17 +518,35 @@ rtp_check_packet(packet_t *packet)
     src = packet->src;
     dst = packet->dst;
 
+    // Reject repeat packets of flows already known to have no stream
+    rtp_nostream_key(src, dst, nokey, sizeof(nokey));
+    if (rtp_nostream_cached(nokey))
+        return NULL;
+
     if (data_is_rtp(payload, size) == 0) {
 
         // Get RTP payload type
         format = RTP_PAYLOAD_TYPE(*(payload + 1));
 
+        // Get RTP Synchronization source
+        uint32_t ssrc;
+        memcpy(&ssrc, payload + 8, sizeof(ssrc));
+        ssrc = ntohl(ssrc);
+
+        // Fast path: packet of an already learned stream
+        if ((stream = rtp_stream_find_ssrc(ssrc, src, dst, format))) {
+            stream_add_packet(stream, packet);
+            return stream;
+        }
+
         // Find the matching stream
         stream = rtp_find_stream_format(src, dst, format);
 
         // Check if a valid stream has been found
-        if (!stream)
+        if (!stream) {
+            rtp_nostream_store(nokey);
             return NULL;
+        }
 
         // We have found a stream, but with different format
         if (stream_is_complete(stream) && stream->rtpinfo.fmtcode != format) {
@@ -245,6 +601,9 @@ rtp_check_packet(packet_t *packet)
             }
         }
 
+        // Learn this stream SSRC for following packets
+        rtp_stream_learn_ssrc(stream, ssrc);
+
         // Add packet to stream
         stream_add_packet(stream, packet);
     } else if (data_is_rtcp(payload, size) == 0) {
@@ -320,9 +679,12 @@ rtp_check_packet(packet_t *packet)
             // Add packet to stream
             stream_complete(stream, src);
             stream_add_packet(stream, packet);
+        } else {
+            rtp_nostream_store(nokey);
         }
     } else {
-      return NULL;
+        rtp_nostream_store(nokey);
+        return NULL;
     }
 
     return stream;
@@ -333,45 +695,45 @@ rtp_find_stream_format(address_t src, address_t dst, uint32_t format)
 {
     // Structure for RTP packet streams
     rtp_stream_t *stream;
-    // Check if this is a RTP packet from active calls
-    sip_call_t *call;
-    // Iterator for active calls
-    vector_iter_t calls;
-    // Iterator for call streams
-    vector_iter_t streams;
+    // Streams sharing the packet destination address
+    vector_t *streams;
+    // Iterator for destination streams
+    vector_iter_t it;
     // Candiate stream
     rtp_stream_t *candidate = NULL;
+    // Index key for the packet destination
+    char dst_key[ADDRESSLEN + 12];
 
-    // Get active calls (during conversation)
-    calls = sip_calls_iterator();
-    vector_iterator_set_current(&calls, vector_iterator_count(&calls));
-
-    while ((call = vector_iterator_prev(&calls))) {
-        streams = vector_iterator(call->streams);
-        vector_iterator_set_last(&streams);
-        while ((stream = vector_iterator_prev(&streams))) {
-            // Only look RTP packets
-            if (stream->type != PACKET_RTP)
-                continue;
-
-            // Stream complete, check source, dst
-            if (stream_is_complete(stream)) {
-                if (addressport_equals(stream->src, src) &&
-                    addressport_equals(stream->dst, dst)) {
-                    // Exact searched stream format
-                    if (stream->rtpinfo.fmtcode == format) {
-                        return stream;
-                    } else {
-                        // Matching addresses but different format
-                        candidate = stream;
-                    }
-                }
-            } else {
-                // Incomplete stream, if dst match is enough
-                if (addressport_equals(stream->dst, dst)) {
-                       return stream;
+    // Get the streams setup towards this destination
+    snprintf(dst_key, sizeof(dst_key), "%s:%u", dst.ip, dst.port);
+    if (!(streams = rtp_stream_index_bucket(dst_key, false)))
+        return NULL;
+
+    // Expire streams that will not receive more packets
+    rtp_stream_index_expire(streams);
+
+    // Newest streams first, as the all-calls iteration did
+    it = vector_iterator(streams);
+    vector_iterator_set_last(&it);
+    while ((stream = vector_iterator_prev(&it))) {
+        // Only look RTP packets
+        if (stream->type != PACKET_RTP)
+            continue;
+
+        // Stream complete, check source, dst
+        if (stream_is_complete(stream)) {
+            if (addressport_equals(stream->src, src)) {
+                // Exact searched stream format
+                if (stream->rtpinfo.fmtcode == format) {
+                    return stream;
+                } else {
+                    // Matching addresses but different format
+                    candidate = stream;
                 }
             }
+        } else {
+            // Incomplete stream, destination match is enough
+            return stream;
         }
     }
 
@@ -383,22 +745,45 @@ rtp_find_stream(address_t src, address_t dst)
 {
     // Structure for RTP packet streams
     rtp_stream_t *stream;
-    // Check if this is a RTP packet from active calls
-    sip_call_t *call;
-    // Iterator for active calls
-    vector_iter_t calls;
-
-    // Get active calls (during conversation)
-    calls = sip_calls_iterator();
-    vector_iterator_set_current(&calls, vector_iterator_count(&calls));
-
-    while ((call = vector_iterator_prev(&calls))) {
-        // Check if this call has an RTP stream for current packet data
-        if ((stream = rtp_find_call_stream(call, src, dst))) {
+    // Streams sharing the packet destination address
+    vector_t *streams;
+    // Iterator for destination streams
+    vector_iter_t it;
+    // Index key for the packet destination
+    char dst_key[ADDRESSLEN + 12];
+
+    // Get the streams setup towards this destination
+    snprintf(dst_key, sizeof(dst_key), "%s:%u", dst.ip, dst.port);
+    if (!(streams = rtp_stream_index_bucket(dst_key, false)))
+        return NULL;
+
+    // Expire streams that will not receive more packets
+    rtp_stream_index_expire(streams);
+
+    // Look for an incomplete stream with this destination
+    it = vector_iterator(streams);
+    vector_iterator_set_last(&it);
+    while ((stream = vector_iterator_prev(&it))) {
+        if (!src.port) {
             return stream;
+        } else {
+            if (!stream->pktcnt) {
+                return stream;
+            }
+        }
+    }
+
+    // Try to look for a complete stream with this destination
+    if (src.port) {
+        vector_iterator_set_last(&it);
+        while ((stream = vector_iterator_prev(&it))) {
+            if (addressport_equals(src, stream->src)) {
+                return stream;
+            }
         }
     }
 
+    // Nothing found
     return NULL;
 }
 
@@ -113,12 +113,28 @@ struct rtp_stream {
     struct timeval time;
     //! Unix timestamp of last received packet
     int lasttm;
+    //! RTP Synchronization source, learned from the first matched packet
+    uint32_t ssrc;
+    //! Global stream index key: destination address of this stream
+    char dst_key[ADDRESSLEN + 12];
+    //! Global stream index key: SSRC of this stream
+    char ssrc_key[12];
 
     // Stream information (depending on type)
     union {
         struct {
             //! Format of first received packet of stre
             uint32_t fmtcode;
+            //! Highest sequence number received
+            uint16_t maxseq;
+            //! Sequence number cycles, shifted 16 bits
+            uint32_t cycles;
+            //! Sequence number of the first received packet
+            uint32_t baseseq;
+            //! Relative transit time of the last packet
+            int32_t transit;
+            //! Interarrival jitter estimator, timestamp units scaled by 16
+            uint32_t jitter;
         } rtpinfo;
         struct {
             //! Sender packet count
@@ -288,6 +304,34 @@ stream_add_packet(rtp_stream_t *stream, packet_t *packet);
 uint32_t
 stream_get_count(rtp_stream_t *stream);
 
+/**
+ * @brief Number of packets lost in a stream
+ *
+ * Computed from the gap between the expected and the received packet
+ * count (RFC 3550 A.3), updated as each packet arrives.
+ */
+uint32_t
+stream_get_lost(rtp_stream_t *stream);
+
+/**
+ * @brief Interarrival jitter estimate of a stream in milliseconds
+ *
+ * Maintained incrementally with the RFC 3550 A.8 estimator, converted
+ * from timestamp units using the stream format clock rate.
+ */
+float
+stream_get_jitter(rtp_stream_t *stream);
+
+/**
+ * @brief Estimated Mean Opinion Score of a stream
+ *
+ * E-model style estimate derived from the measured jitter and loss.
+ * One-way delay cannot be measured from a capture point, so only
+ * jitter and loss degrade the score.
+ */
+float
+stream_get_mos(rtp_stream_t *stream);
+
 struct sip_call *
 stream_get_call(rtp_stream_t *stream);
 
@@ -300,6 +344,25 @@ rtp_get_standard_format(uint32_t code);
 rtp_stream_t *
 rtp_check_packet(packet_t *packet);
 
+/**
+ * @brief Add a stream to the global stream index
+ *
+ * Streams are indexed by their destination address so any RTP/RTCP
+ * packet can resolve its owning stream in constant time, without
+ * iterating every stream of every call. Called when a stream is
+ * attached to a call (@see call_add_stream)
+ */
+void
+rtp_stream_index_add(rtp_stream_t *stream);
+
+/**
+ * @brief Remove a stream from the global stream index
+ *
+ * Called when the owning call is destroyed
+ */
+void
+rtp_stream_index_remove(rtp_stream_t *stream);
+
 rtp_stream_t *
 rtp_find_stream_format(address_t src, address_t dst, uint32_t format);
 
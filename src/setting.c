@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include "setting.h"
 #include "util.h"
+#include "hash.h"
 
 
 //! Available configurable settings
@@ -53,6 +54,22 @@ setting_t settings[SETTING_COUNT] = {
     { SETTING_CAPTURE_RTP,        "capture.rtp",        SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
     { SETTING_CAPTURE_STORAGE,    "capture.storage",    SETTING_FMT_ENUM,    "memory",    SETTING_ENUM_STORAGE },
     { SETTING_CAPTURE_ROTATE,     "capture.rotate",     SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
+    { SETTING_CAPTURE_PIPELINE,   "capture.pipeline",   SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
+    { SETTING_CAPTURE_WORKERS,    "capture.workers",    SETTING_FMT_NUMBER,  "2",         NULL },
+    { SETTING_CAPTURE_BUFSIZE,    "capture.bufsize",    SETTING_FMT_NUMBER,  "2",         NULL },
+    { SETTING_CAPTURE_FANOUT,     "capture.fanout",     SETTING_FMT_NUMBER,  "1",         NULL },
+    { SETTING_CAPTURE_SNAPLEN,    "capture.snaplen",    SETTING_FMT_NUMBER,  "262144",    NULL },
+    { SETTING_CAPTURE_IMMEDIATE,  "capture.immediate",  SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
+    { SETTING_CAPTURE_TSTAMP,     "capture.tstamp",     SETTING_FMT_STRING,  "",          NULL },
+    { SETTING_CAPTURE_COMPACT,    "capture.compact",    SETTING_FMT_NUMBER,  "0",         NULL },
+    { SETTING_CAPTURE_SPILL,      "capture.spill",      SETTING_FMT_STRING,  "",          NULL },
+    { SETTING_CAPTURE_SPILLSIZE,  "capture.spillsize",  SETTING_FMT_NUMBER,  "64",        NULL },
+    { SETTING_CAPTURE_WARMUP,     "capture.warmup",     SETTING_FMT_NUMBER,  "4",         NULL },
+    { SETTING_DUMP_ROTATESIZE,    "dump.rotatesize",    SETTING_FMT_NUMBER,  "0",         NULL },
+    { SETTING_DUMP_ROTATEAGE,     "dump.rotateage",     SETTING_FMT_NUMBER,  "0",         NULL },
+    { SETTING_DUMP_KEEP,          "dump.keep",          SETTING_FMT_NUMBER,  "0",         NULL },
+    { SETTING_DUMP_GZIP,          "dump.gzip",          SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
+    { SETTING_SIP_FASTPARSER,     "sip.fastparser",     SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
     { SETTING_SIP_NOINCOMPLETE,   "sip.noincomplete",   SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
     { SETTING_SIP_HEADER_X_CID,   "sip.xcid",           SETTING_FMT_STRING,  "X-Call-ID|X-CID", NULL },
     { SETTING_SIP_CALLS,          "sip.calls",          SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
@@ -79,6 +96,7 @@ setting_t settings[SETTING_COUNT] = {
     { SETTING_CR_NON_ASCII,       "cr.nonascii",        SETTING_FMT_STRING,  ".",        NULL },
     { SETTING_FILTER_PAYLOAD,     "filter.payload",     SETTING_FMT_STRING,  "",          NULL },
     { SETTING_FILTER_METHODS,     "filter.methods",     SETTING_FMT_STRING,  "",          NULL },
+    { SETTING_FILTER_DISCARD,     "filter.discard",     SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
 #ifdef USE_EEP
     { SETTING_EEP_SEND,           "eep.send",           SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
     { SETTING_EEP_SEND_VER,       "eep.send.version",   SETTING_FMT_ENUM,    "3",         SETTING_ENUM_HEPVERSION },
@@ -95,26 +113,46 @@ setting_t settings[SETTING_COUNT] = {
 #endif
 };
 
+//! Resolved runtime settings (@see setting_runtime_refresh)
+struct setting_runtime setting_runtime = { 0 };
+
 setting_t *
 setting_by_id(int id)
 {
+    // Setting array positions indexed by id, settings disabled at
+    // compile time leave gaps so ids don't always match positions
+    static int index[SETTING_COUNT];
+    static int indexed = 0;
     int i;
-    for (i = 0; i < SETTING_COUNT; i++) {
-        if (id == settings[i].id)
-            return &settings[i];
+
+    if (!indexed) {
+        for (i = 0; i < SETTING_COUNT; i++)
+            index[i] = -1;
+        // Entries disabled at compile time leave zeroed tail slots
+        for (i = 0; i < SETTING_COUNT && settings[i].name; i++)
+            index[settings[i].id] = i;
+        indexed = 1;
     }
-    return NULL;
+
+    if (id < 0 || id >= SETTING_COUNT || index[id] < 0)
+        return NULL;
+    return &settings[index[id]];
 }
 
 setting_t *
 setting_by_name(const char *name)
 {
+    // Settings hashed by name, built on the first lookup
+    static htable_t *names = NULL;
     int i;
-    for (i = 0; i < SETTING_COUNT; i++) {
-        if (!strcmp(name, settings[i].name))
-            return &settings[i];
+
+    if (!names) {
+        names = htable_create(SETTING_COUNT);
+        for (i = 0; i < SETTING_COUNT && settings[i].name; i++)
+            htable_insert(names, settings[i].name, &settings[i]);
     }
-    return NULL;
+
+    return htable_find(names, name);
 }
 
 int
@@ -173,9 +211,20 @@ setting_set_value(int id, const char *value)
                 exit(1);
             }
         }
+        // Keep the resolved runtime settings in sync
+        setting_runtime_refresh();
     }
 }
 
+void
+setting_runtime_refresh()
+{
+    setting_runtime.fastparser = setting_enabled(SETTING_SIP_FASTPARSER);
+    setting_runtime.displayalias = setting_enabled(SETTING_DISPLAY_ALIAS);
+    setting_runtime.rtpcapture = setting_enabled(SETTING_CAPTURE_RTP);
+    setting_runtime.filterdiscard = setting_enabled(SETTING_FILTER_DISCARD);
+}
+
 void
 setting_set_intvalue(int id, int value)
 {
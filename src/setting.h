@@ -89,6 +89,22 @@ enum setting_id {
     SETTING_CAPTURE_RTP,
     SETTING_CAPTURE_STORAGE,
     SETTING_CAPTURE_ROTATE,
+    SETTING_CAPTURE_PIPELINE,
+    SETTING_CAPTURE_WORKERS,
+    SETTING_CAPTURE_BUFSIZE,
+    SETTING_CAPTURE_FANOUT,
+    SETTING_CAPTURE_SNAPLEN,
+    SETTING_CAPTURE_IMMEDIATE,
+    SETTING_CAPTURE_TSTAMP,
+    SETTING_CAPTURE_COMPACT,
+    SETTING_CAPTURE_SPILL,
+    SETTING_CAPTURE_SPILLSIZE,
+    SETTING_CAPTURE_WARMUP,
+    SETTING_DUMP_ROTATESIZE,
+    SETTING_DUMP_ROTATEAGE,
+    SETTING_DUMP_KEEP,
+    SETTING_DUMP_GZIP,
+    SETTING_SIP_FASTPARSER,
     SETTING_SIP_NOINCOMPLETE,
     SETTING_SIP_HEADER_X_CID,
     SETTING_SIP_CALLS,
@@ -115,6 +131,7 @@ enum setting_id {
     SETTING_CR_NON_ASCII,
     SETTING_FILTER_PAYLOAD,
     SETTING_FILTER_METHODS,
+    SETTING_FILTER_DISCARD,
 #ifdef USE_EEP
     SETTING_EEP_SEND,
     SETTING_EEP_SEND_VER,
@@ -155,6 +172,28 @@ struct setting_option {
     const char **valuelist;
 };
 
+/**
+ * @brief Capture path settings resolved to plain values
+ *
+ * Per packet code consults some settings for every captured packet.
+ * Instead of looking them up by id and parsing their text value each
+ * time, the relevant ones are resolved into this struct, which is
+ * refreshed whenever a setting value changes.
+ */
+struct setting_runtime {
+    //! Parse SIP payloads without regexps (@see SETTING_SIP_FASTPARSER)
+    int fastparser;
+    //! Display address aliases instead of addresses (@see SETTING_DISPLAY_ALIAS)
+    int displayalias;
+    //! Store the RTP packets of each call (@see SETTING_CAPTURE_RTP)
+    int rtpcapture;
+    //! Discard dialogs not matching display filters (@see SETTING_FILTER_DISCARD)
+    int filterdiscard;
+};
+
+//! Resolved runtime settings (@see struct setting_runtime)
+extern struct setting_runtime setting_runtime;
+
 setting_t *
 setting_by_id(int id);
 
@@ -209,6 +248,15 @@ setting_has_value(int id, const char *value);
 void
 setting_toggle(int id);
 
+/**
+ * @brief Resolve the runtime settings from the current values
+ *
+ * Invoked whenever a setting value changes, so the capture path can
+ * read setting_runtime fields instead of looking settings up.
+ */
+void
+setting_runtime_refresh();
+
 const char *
 setting_enum_next(int id, const char *value);
 
@@ -33,8 +33,11 @@
 #include <pthread.h>
 #include <stdarg.h>
 #include "sip.h"
+#include "sip_parser.h"
+#include "intern.h"
 #include "option.h"
 #include "setting.h"
+#include "spill.h"
 #include "filter.h"
 
 /**
@@ -46,6 +49,15 @@
 sip_call_list_t calls =
 { 0 };
 
+/**
+ * @brief Running aggregate counters of stored dialogs
+ *
+ * Updated while storing messages, so they are only modified (and read
+ * from the interface) with the capture lock held.
+ */
+static sip_stats_counters_t counters =
+{ 0 };
+
 /* @brief list of methods and responses */
 sip_code_t sip_codes[] = {
     { SIP_METHOD_REGISTER,  "REGISTER" },
@@ -150,14 +162,28 @@ sip_init(int limit, int only_calls, int no_incomplete)
     calls.ignore_incomplete = no_incomplete;
     calls.last_index = 0;
 
+    // Create the SIP message object pool
+    msg_pool_init();
+
     // Create a vector to store calls
     calls.list = vector_create(200, 50);
     vector_set_destroyer(calls.list, call_destroyer);
     vector_set_sorter(calls.list, sip_list_sorter);
     calls.active = vector_create(10, 10);
+    calls.trash = vector_create(10, 10);
 
     // Create hash table for callid search
     calls.callids = htable_create(calls.limit);
+    calls.xcallids = htable_create(calls.limit);
+
+    // Presize storage to the working set given by the call limit, so
+    // the first traffic burst does not pay for growth reallocations
+    if (setting_get_intvalue(SETTING_CAPTURE_WARMUP) > 0 && limit > 0) {
+        vector_reserve(calls.list, limit);
+        vector_reserve(calls.active, limit / 10 + 1);
+        // Expected messages per dialog at working-set size
+        msg_pool_reserve((size_t) limit * setting_get_intvalue(SETTING_CAPTURE_WARMUP));
+    }
 
     // Set default sorting field
     if (sip_attr_from_name(setting_get_value(SETTING_CL_SORTFIELD)) >= 0) {
@@ -209,11 +235,13 @@ sip_deinit()
 {
     // Remove all calls
     sip_calls_clear();
-    // Remove Call-id hash table
+    // Remove Call-id hash tables
     htable_destroy(calls.callids);
+    htable_destroy(calls.xcallids);
     // Remove calls vector
     vector_destroy(calls.list);
     vector_destroy(calls.active);
+    vector_destroy(calls.trash);
     // Deallocate regular expressions
     regfree(&calls.reg_method);
     regfree(&calls.reg_callid);
@@ -227,13 +255,111 @@ sip_deinit()
     regfree(&calls.reg_body);
     regfree(&calls.reg_reason);
     regfree(&calls.reg_warning);
+    // Remove the SIP message object pool
+    msg_pool_deinit();
+}
+
+
+/**
+ * @brief Set message request/response data from scanned headers
+ *
+ * Fast parser counterpart of sip_get_msg_reqresp
+ *
+ * @return the message request/response code
+ */
+static int
+sip_load_msg_reqresp(sip_msg_t *msg, sip_hdrs_t *hdrs)
+{
+    char resp_str[SIP_ATTR_MAXLEN];
+    char reqresp[SIP_ATTR_MAXLEN];
+    const char *resp_def;
+
+    // Initialize variables
+    memset(resp_str, 0, sizeof(resp_str));
+    memset(reqresp, 0, sizeof(reqresp));
+
+    // If not already parsed
+    if (!msg->reqresp) {
+        // Method
+        if (hdrs->method.len) {
+            if (hdrs->method.len >= SIP_ATTR_MAXLEN) {
+                strncpy(reqresp, "<malformed>", 11);
+            } else {
+                sip_parser_slice_cpy(&hdrs->method, reqresp, sizeof(reqresp));
+            }
+        }
+
+        // CSeq
+        if (hdrs->cseq)
+            msg->cseq = hdrs->cseq;
+
+        // Response code
+        if (hdrs->resp_text.len) {
+            if (hdrs->resp_text.len >= SIP_ATTR_MAXLEN) {
+                strncpy(resp_str, "<malformed>", 11);
+            } else {
+                sip_parser_slice_cpy(&hdrs->resp_text, resp_str, sizeof(resp_str));
+            }
+            sip_parser_slice_cpy(&hdrs->resp_code, reqresp, sizeof(reqresp));
+        }
+
+        // Get Request/Response Code
+        msg->reqresp = sip_method_from_str(reqresp);
+
+        // For response codes, check if the text matches the default
+        if (!msg_is_request(msg)) {
+            resp_def = sip_method_str(msg->reqresp);
+            if (!resp_def || strcmp(resp_def, resp_str)) {
+                msg_disp(msg)->resp_str = (char *) sng_intern(resp_str);
+            }
+        }
+    }
+
+    return msg->reqresp;
 }
 
+/**
+ * @brief Set message From/To attributes from scanned headers
+ *
+ * Fast parser counterpart of sip_parse_msg_payload
+ */
+static int
+sip_load_msg_payload(sip_msg_t *msg, sip_hdrs_t *hdrs)
+{
+    struct sip_msg_disp *disp = msg_disp(msg);
+
+    // From
+    if (hdrs->from.len) {
+        disp->sip_from = (char *) sng_intern_n(hdrs->from.text, hdrs->from.len);
+    } else {
+        // Malformed From Header
+        disp->sip_from = (char *) sng_intern("<malformed>");
+    }
+
+    // To
+    if (hdrs->to.len) {
+        disp->sip_to = (char *) sng_intern_n(hdrs->to.text, hdrs->to.len);
+    } else {
+        // Malformed To Header
+        disp->sip_to = (char *) sng_intern("<malformed>");
+    }
+
+    return 0;
+}
 
 char *
 sip_get_callid(const char* payload, char *callid)
 {
     regmatch_t pmatch[3];
+    sip_hdrs_t hdrs;
+
+    // Scan the payload without regexps if fast parser is enabled
+    if (setting_runtime.fastparser) {
+        sip_parser_scan(payload, &hdrs);
+        if (hdrs.callid.len && hdrs.callid.len < 1024)
+            sip_parser_slice_cpy(&hdrs.callid, callid, hdrs.callid.len + 1);
+        return callid;
+    }
 
     // Try to get Call-ID from payload
     if (regexec(&calls.reg_callid, payload, 3, pmatch, 0) == 0) {
@@ -248,6 +374,15 @@ char *
 sip_get_xcallid(const char *payload, char *xcallid)
 {
     regmatch_t pmatch[3];
+    sip_hdrs_t hdrs;
+
+    // Scan the payload without regexps if fast parser is enabled
+    if (setting_runtime.fastparser) {
+        sip_parser_scan(payload, &hdrs);
+        if (hdrs.xcallid.len && hdrs.xcallid.len < 1024)
+            sip_parser_slice_cpy(&hdrs.xcallid, xcallid, hdrs.xcallid.len + 1);
+        return xcallid;
+    }
 
     // Try to get X-Call-ID from payload
     if (regexec(&calls.reg_xcallid, (const char *)payload, 3, pmatch, 0) == 0) {
@@ -278,29 +413,60 @@ sip_validate_packet(packet_t *packet)
     // Initialize variables
     memset(cl_header, 0, sizeof(cl_header));
 
-    // Check if the first line follows SIP request or response format
-    if (regexec(&calls.reg_valid, (const char *) payload, 2, pmatch, 0) != 0) {
-        // Not a SIP message AT ALL
-        return VALIDATE_NOT_SIP;
-    }
+    int body_off;
 
-    // Check if we have Content Length header
-    if (regexec(&calls.reg_cl, (const char *) payload, 4, pmatch, 0) != 0) {
-        // Not a SIP message or not complete
-        return VALIDATE_PARTIAL_SIP;
-    }
+    if (setting_runtime.fastparser) {
+        sip_hdrs_t hdrs;
 
-    strncpy(cl_header, (const char *)payload +  pmatch[2].rm_so, (int)pmatch[2].rm_eo - pmatch[2].rm_so);
-    content_len = atoi(cl_header);
+        // Check if the first line follows SIP request or response format
+        if (sip_parser_scan((const char *) payload, &hdrs) != 0) {
+            // Not a SIP message AT ALL
+            return VALIDATE_NOT_SIP;
+        }
 
-    // Check if we have Body separator field
-    if (regexec(&calls.reg_body, (const char *) payload, 2, pmatch, 0) != 0) {
-        // Not a SIP message or not complete
-        return VALIDATE_PARTIAL_SIP;
-    }
+        // Check if we have Content Length header
+        if (!hdrs.cl.len) {
+            // Not a SIP message or not complete
+            return VALIDATE_PARTIAL_SIP;
+        }
+        sip_parser_slice_cpy(&hdrs.cl, cl_header, sizeof(cl_header));
+        content_len = atoi(cl_header);
 
-    // Get the SIP message body length
-    bodylen = (int) pmatch[1].rm_eo - pmatch[1].rm_so;
+        // Check if we have Body separator field
+        if (hdrs.body < 0) {
+            // Not a SIP message or not complete
+            return VALIDATE_PARTIAL_SIP;
+        }
+
+        // Get the SIP message body length
+        body_off = hdrs.body;
+        bodylen = strlen((const char *) payload + body_off);
+    } else {
+        // Check if the first line follows SIP request or response format
+        if (regexec(&calls.reg_valid, (const char *) payload, 2, pmatch, 0) != 0) {
+            // Not a SIP message AT ALL
+            return VALIDATE_NOT_SIP;
+        }
+
+        // Check if we have Content Length header
+        if (regexec(&calls.reg_cl, (const char *) payload, 4, pmatch, 0) != 0) {
+            // Not a SIP message or not complete
+            return VALIDATE_PARTIAL_SIP;
+        }
+
+        strncpy(cl_header, (const char *)payload +  pmatch[2].rm_so, (int)pmatch[2].rm_eo - pmatch[2].rm_so);
+        content_len = atoi(cl_header);
+
+        // Check if we have Body separator field
+        if (regexec(&calls.reg_body, (const char *) payload, 2, pmatch, 0) != 0) {
+            // Not a SIP message or not complete
+            return VALIDATE_PARTIAL_SIP;
+        }
+
+        // Get the SIP message body length
+        body_off = (int) pmatch[1].rm_so;
+        bodylen = (int) pmatch[1].rm_eo - pmatch[1].rm_so;
+    }
 
     // The SDP body of the SIP message ends in another packet
     if (content_len > bodylen) {
@@ -309,12 +475,12 @@ sip_validate_packet(packet_t *packet)
 
     if (content_len < bodylen) {
         // Check body ends with '\r\n'
-        if (payload[pmatch[1].rm_so + content_len - 1] != '\n')
+        if (payload[body_off + content_len - 1] != '\n')
             return VALIDATE_NOT_SIP;
-        if (payload[pmatch[1].rm_so + content_len - 2] != '\r')
+        if (payload[body_off + content_len - 2] != '\r')
             return VALIDATE_NOT_SIP;
         // We got more than one SIP message in the same packet
-        packet_set_payload(packet, payload, pmatch[1].rm_so + content_len);
+        packet_set_payload(packet, payload, body_off + content_len);
         return VALIDATE_MULTIPLE_SIP;
     }
 
@@ -324,47 +490,133 @@ sip_validate_packet(packet_t *packet)
 
 sip_msg_t *
 sip_check_packet(packet_t *packet)
+{
+    sip_parsed_t parsed;
+
+    // Parse the interesting payload headers
+    if (!sip_parse_packet(packet, &parsed))
+        return NULL;
+
+    // Store the parsed message into the calls list
+    return sip_store_packet(packet, &parsed);
+}
+
+sip_msg_t *
+sip_parse_packet(packet_t *packet, sip_parsed_t *parsed)
 {
     sip_msg_t *msg;
-    sip_call_t *call;
-    char callid[1024], xcallid[1024];
-    address_t src, dst;
-    u_char payload[MAX_SIP_PAYLOAD];
-    bool newcall = false;
+
+    // No message parsed yet
+    parsed->msg = NULL;
+    parsed->fast = setting_runtime.fastparser;
 
     // Max SIP payload allowed
     if (packet->payload_len > MAX_SIP_PAYLOAD)
         return NULL;
 
-    // Get Addresses from packet
-    src = packet->src;
-    dst = packet->dst;
-
     // Initialize local variables
-    memset(callid, 0, sizeof(callid));
-    memset(xcallid, 0, sizeof(xcallid));
+    memset(parsed->callid, 0, sizeof(parsed->callid));
 
     // Get payload from packet(s)
-    memset(payload, 0, MAX_SIP_PAYLOAD);
-    memcpy(payload, packet_payload(packet), packet_payloadlen(packet));
+    memset(parsed->payload, 0, MAX_SIP_PAYLOAD);
+    memcpy(parsed->payload, packet_payload(packet), packet_payloadlen(packet));
 
     // Get the Call-ID of this message
-    if (!sip_get_callid((const char*) payload, callid))
+    if (parsed->fast) {
+        // Scan the whole payload in a single pass
+        sip_parser_scan((const char *) parsed->payload, &parsed->hdrs);
+        if (parsed->hdrs.callid.len && parsed->hdrs.callid.len < (int) sizeof(parsed->callid))
+            sip_parser_slice_cpy(&parsed->hdrs.callid, parsed->callid, parsed->hdrs.callid.len + 1);
+    } else if (!sip_get_callid((const char*) parsed->payload, parsed->callid)) {
         return NULL;
+    }
 
     // Create a new message from this data
-    if (!(msg = msg_create((const char*) payload)))
+    if (!(msg = msg_create((const char*) parsed->payload)))
         return NULL;
 
     // Get Method and request for the following checks
     // There is no need to parse all payload at this point
     // If no response or request code is found, this is not a SIP message
-    if (!sip_get_msg_reqresp(msg, payload)) {
+    if (!(parsed->fast ? sip_load_msg_reqresp(msg, &parsed->hdrs)
+                       : sip_get_msg_reqresp(msg, parsed->payload))) {
         // Deallocate message memory
         msg_destroy(msg);
         return NULL;
     }
 
+    parsed->msg = msg;
+    return msg;
+}
+
+//! Owned structures released per drained batch (@see sip_calls_trash_drain)
+#define SIP_TRASH_BATCH 200
+
+/**
+ * @brief Release rotated calls in bounded batches
+ *
+ * Rotated calls are unlinked from the storage right away but their
+ * messages and packets are freed a few at a time, so evicting a big
+ * call does not stall the capture thread. A negative budget releases
+ * everything at once.
+ *
+ * @param budget Maximum number of messages and packets to release
+ */
+static void
+sip_calls_trash_drain(int budget)
+{
+    sip_call_t *call;
+
+    while ((call = vector_first(calls.trash))) {
+        // Free from the tail, so every removal is O(1)
+        while (budget != 0 && vector_count(call->rtp_packets)) {
+            vector_remove(call->rtp_packets, vector_last(call->rtp_packets));
+            budget--;
+        }
+        while (budget != 0 && vector_count(call->msgs)) {
+            vector_remove(call->msgs, vector_last(call->msgs));
+            budget--;
+        }
+        if (budget == 0)
+            return;
+
+        // Streams and the call structure itself are small, free them at once
+        vector_remove(calls.trash, call);
+        call_destroy(call);
+    }
+}
+
+sip_msg_t *
+sip_store_packet(packet_t *packet, sip_parsed_t *parsed)
+{
+    sip_msg_t *msg = parsed->msg;
+    sip_call_t *call;
+    char xcallid[1024];
+    u_char *payload = parsed->payload;
+    char *callid = parsed->callid;
+    bool newcall = false;
+    bool fast = parsed->fast;
+    sip_hdrs_t hdrs = parsed->hdrs;
+
+    // Nothing parsed, nothing to store
+    if (!msg)
+        return NULL;
+
+    // Keep releasing previously rotated calls
+    sip_calls_trash_drain(SIP_TRASH_BATCH);
+
+    // Rotate oldest calls while the memory limit is exceeded
+    while (calls.memlimit && calls.memsize > calls.memlimit && sip_calls_count() > 1) {
+        int precount = sip_calls_count();
+        sip_calls_rotate();
+        // All remaining calls are locked, give up
+        if (sip_calls_count() == precount)
+            break;
+    }
+
+    // Initialize local variables
+    memset(xcallid, 0, sizeof(xcallid));
+
     // Find the call for this msg
     if (!(call = sip_find_by_callid(callid))) {
 
@@ -372,6 +624,11 @@ sip_check_packet(packet_t *packet)
         if (!sip_check_match_expression((const char*) payload))
             goto skip_message;
 
+        // With filter.discard enabled display filters become admission
+        // control and dialogs they would hide are never stored
+        if (setting_runtime.filterdiscard && !filter_admit_msg(packet, msg, payload))
+            goto skip_message;
+
         // User requested only INVITE starting dialogs
         if (calls.only_calls && msg->reqresp != SIP_METHOD_INVITE)
             goto skip_message;
@@ -382,7 +639,12 @@ sip_check_packet(packet_t *packet)
             goto skip_message;
 
         // Get the Call-ID of this message
-        sip_get_xcallid((const char*) payload, xcallid);
+        if (fast) {
+            if (hdrs.xcallid.len && hdrs.xcallid.len < (int) sizeof(xcallid))
+                sip_parser_slice_cpy(&hdrs.xcallid, xcallid, hdrs.xcallid.len + 1);
+        } else {
+            sip_get_xcallid((const char*) payload, xcallid);
+        }
 
         // Rotate call list if limit has been reached
         if (calls.limit == sip_calls_count())
@@ -405,19 +667,34 @@ sip_check_packet(packet_t *packet)
     // At this point we know we're handling an interesting SIP Packet
     msg->packet = packet;
 
-    // Always parse first call message
-    if (call_msg_count(call) == 0) {
-        // Parse SIP payload
-        sip_parse_msg_payload(msg, payload);
-        // If this call has X-Call-Id, append it to the parent call
-        if (strlen(call->xcallid)) {
-            call_add_xcall(sip_find_by_callid(call->xcallid), call);
+    // If this call has X-Call-Id, append it to the parent call.
+    // From/To parsing is deferred until the message is displayed
+    // (@see sip_parse_msg), most stored messages never are.
+    if (call_msg_count(call) == 0 && strlen(call->xcallid)) {
+        sip_call_t *parent = sip_find_by_callid(call->xcallid);
+        if (parent) {
+            call_add_xcall(parent, call);
+        } else {
+            // Wait for the referenced leg in the X-Call-ID index
+            htable_insert(calls.xcallids, call->xcallid, call);
+        }
+    }
+
+    // Attach legs that referenced this call before it was stored
+    if (newcall) {
+        sip_call_t *xcall;
+        while ((xcall = htable_find(calls.xcallids, call->callid))) {
+            call_add_xcall(call, xcall);
+            htable_remove_data(calls.xcallids, call->callid, xcall);
         }
     }
 
     // Add the message to the call
     call_add_message(call, msg);
 
+    // Update aggregate counters
+    sip_stats_count_msg(msg, 1);
+
     // check if message is a retransmission
     call_msg_retrans_check(msg);
 
@@ -425,16 +702,21 @@ sip_check_packet(packet_t *packet)
         // Parse media data
         sip_parse_msg_media(msg, payload);
         // Update Call State
+        int oldstate = call->state;
         call_update_state(call, msg);
+        if (call->state != oldstate)
+            sip_stats_update_state(oldstate, call->state);
         // Parse extra fields
         sip_parse_extra_headers(msg, payload);
         // Check if this call should be in active call list
         if (call_is_active(call)) {
-            if (sip_call_is_active(call)) {
+            if (!sip_call_is_active(call)) {
+                call->active = true;
                 vector_append(calls.active, call);
             }
         } else {
             if (sip_call_is_active(call)) {
+                call->active = false;
                 vector_remove(calls.active, call);
             }
         }
@@ -466,6 +748,24 @@ sip_calls_has_changed()
     return changed;
 }
 
+void
+sip_calls_mark_changed()
+{
+    calls.changed = true;
+}
+
+unsigned int
+sip_calls_epoch()
+{
+    return calls.epoch;
+}
+
+void
+sip_calls_epoch_bump()
+{
+    calls.epoch++;
+}
+
 int
 sip_calls_count()
 {
@@ -487,7 +787,7 @@ sip_active_calls_iterator()
 bool
 sip_call_is_active(sip_call_t *call)
 {
-    return vector_index(calls.active, call) != -1;
+    return call->active;
 }
 
 vector_t *
@@ -516,6 +816,96 @@ sip_calls_stats()
     return stats;
 }
 
+sip_stats_counters_t
+sip_stats_get_counters()
+{
+    return counters;
+}
+
+void
+sip_stats_count_msg(sip_msg_t *msg, int count)
+{
+    // Total stored messages
+    counters.msg_total += count;
+
+    // Request method or response code counters
+    if (msg->reqresp >= 100) {
+        if (msg->reqresp / 100 <= 8)
+            counters.msg_responses[msg->reqresp / 100 - 1] += count;
+    } else if (msg->reqresp >= SIP_METHOD_REGISTER && msg->reqresp <= SIP_METHOD_PRACK) {
+        counters.msg_methods[msg->reqresp] += count;
+    }
+
+    // Transport counters
+    if (msg->packet && msg->packet->type <= PACKET_SIP_WSS)
+        counters.msg_transports[msg->packet->type] += count;
+}
+
+void
+sip_stats_update_state(int oldstate, int newstate)
+{
+    if (oldstate) {
+        counters.call_states[oldstate]--;
+    } else {
+        // This dialog has just become a call
+        counters.call_total++;
+    }
+    counters.call_states[newstate]++;
+}
+
+void
+sip_stats_remove_call(sip_call_t *call)
+{
+    sip_msg_t *msg;
+    vector_iter_t it = vector_iterator(call->msgs);
+
+    // Discount all call messages
+    while ((msg = vector_iterator_next(&it)))
+        sip_stats_count_msg(msg, -1);
+
+    // Discount call state
+    if (call->state) {
+        counters.call_total--;
+        counters.call_states[call->state]--;
+    }
+}
+
+void
+sip_set_memory_limit(size_t limit)
+{
+    calls.memlimit = limit;
+}
+
+size_t
+sip_get_memory_limit()
+{
+    return calls.memlimit;
+}
+
+size_t
+sip_get_memory_usage()
+{
+    return calls.memsize;
+}
+
+int
+sip_get_call_limit()
+{
+    return calls.limit;
+}
+
+int
+sip_calls_rotated()
+{
+    return calls.rotated;
+}
+
+void
+sip_calls_account_memory(long bytes)
+{
+    calls.memsize += bytes;
+}
+
 sip_call_t *
 sip_find_by_index(int index)
 {
@@ -536,6 +926,13 @@ sip_get_msg_reqresp(sip_msg_t *msg, const u_char *payload)
     char reqresp[SIP_ATTR_MAXLEN];
     char cseq[11];
     const char *resp_def;
+    sip_hdrs_t hdrs;
+
+    // Scan the payload without regexps if fast parser is enabled
+    if (setting_runtime.fastparser) {
+        sip_parser_scan((const char *) payload, &hdrs);
+        return sip_load_msg_reqresp(msg, &hdrs);
+    }
 
     // Initialize variables
     memset(pmatch, 0, sizeof(pmatch));
@@ -582,7 +979,7 @@ sip_get_msg_reqresp(sip_msg_t *msg, const u_char *payload)
         if (!msg_is_request(msg)) {
             resp_def = sip_method_str(msg->reqresp);
             if (!resp_def || strcmp(resp_def, resp_str)) {
-                msg->resp_str = strdup(resp_str);
+                msg_disp(msg)->resp_str = (char *) sng_intern(resp_str);
             }
         }
     }
@@ -594,8 +991,8 @@ const char *
 sip_get_msg_reqresp_str(sip_msg_t *msg)
 {
     // Check if code has non-standard text
-    if (msg->resp_str) {
-        return msg->resp_str;
+    if (msg->disp && msg->disp->resp_str) {
+        return msg->disp->resp_str;
     } else {
         return sip_method_str(msg->reqresp);
     }
@@ -604,7 +1001,8 @@ sip_get_msg_reqresp_str(sip_msg_t *msg)
 sip_msg_t *
 sip_parse_msg(sip_msg_t *msg)
 {
-    if (msg && !msg->cseq) {
+    // From/To are the last attributes parsed lazily
+    if (msg && (!msg->disp || !msg->disp->sip_from)) {
         sip_parse_msg_payload(msg, (u_char*) msg_get_payload(msg));
     }
     return msg;
@@ -614,25 +1012,33 @@ int
 sip_parse_msg_payload(sip_msg_t *msg, const u_char *payload)
 {
     regmatch_t pmatch[4];
+    sip_hdrs_t hdrs;
+    struct sip_msg_disp *disp;
+
+    // Scan the payload without regexps if fast parser is enabled
+    if (setting_runtime.fastparser) {
+        sip_parser_scan((const char *) payload, &hdrs);
+        return sip_load_msg_payload(msg, &hdrs);
+    }
+
+    disp = msg_disp(msg);
 
     // From
     if (regexec(&calls.reg_from, (const char *)payload, 4, pmatch, 0) == 0) {
-        msg->sip_from = sng_malloc((int)pmatch[2].rm_eo - pmatch[2].rm_so + 1);
-        strncpy(msg->sip_from, (const char *)payload +  pmatch[2].rm_so, (int)pmatch[2].rm_eo - pmatch[2].rm_so);
+        disp->sip_from = (char *) sng_intern_n((const char *) payload + pmatch[2].rm_so,
+                                               (int) pmatch[2].rm_eo - pmatch[2].rm_so);
     } else {
         // Malformed From Header
-        msg->sip_from = sng_malloc(12);
-        strncpy(msg->sip_from, "<malformed>", 11);
+        disp->sip_from = (char *) sng_intern("<malformed>");
     }
 
     // To
     if (regexec(&calls.reg_to, (const char *)payload, 4, pmatch, 0) == 0) {
-        msg->sip_to = sng_malloc((int)pmatch[2].rm_eo - pmatch[2].rm_so + 1);
-        strncpy(msg->sip_to, (const char *)payload +  pmatch[2].rm_so, (int)pmatch[2].rm_eo - pmatch[2].rm_so);
+        disp->sip_to = (char *) sng_intern_n((const char *) payload + pmatch[2].rm_so,
+                                             (int) pmatch[2].rm_eo - pmatch[2].rm_so);
     } else {
         // Malformed To Header
-        msg->sip_to = sng_malloc(12);
-        strncpy(msg->sip_to, "<malformed>", 11);
+        disp->sip_to = (char *) sng_intern("<malformed>");
     }
 
     return 0;
@@ -652,14 +1058,14 @@ sip_parse_msg_media(sip_msg_t *msg, const u_char *payload)
       } \
     }
 
-    address_t dst, src = { };
+    address_t dst = { }, src = { };
     rtp_stream_t *rtp_stream = NULL, *rtcp_stream = NULL, *msg_rtp_stream = NULL;
     char media_type[MEDIATYPELEN] = { };
-    char media_format[30] = { };
     uint32_t media_fmt_pref;
-    uint32_t media_fmt_code;
     sdp_media_t *media = NULL;
-    char *payload2, *tofree, *line;
+    char line[SIP_ATTR_MAXLEN];
+    const char *cursor, *next;
+    size_t linelen;
     sip_call_t *call = msg_get_call(msg);
 
     // If message is retrans, there's no need to parse the payload again
@@ -669,9 +1075,24 @@ sip_parse_msg_media(sip_msg_t *msg, const u_char *payload)
         return;
     }
 
-    // Parse each line of payload looking for sdp information
-    tofree = payload2 = strdup((char*)payload);
-    while ((line = strsep(&payload2, "\r\n")) != NULL) {
+    // Parse each line of payload looking for sdp information. Lines are
+    // scanned in place over the stored payload and only the interesting
+    // ones are copied out for sscanf, so parsing allocates nothing.
+    for (cursor = (const char *) payload; cursor; cursor = next) {
+        const char *eol = sng_scan_eol(cursor);
+        next = (*eol) ? eol + 1 : NULL;
+
+        // Skip lines that carry no media information
+        if (strncmp(cursor, "m=", 2) && strncmp(cursor, "c=", 2)
+            && strncmp(cursor, "a=rtcp:", 7))
+            continue;
+
+        // Bounded copy of the line so sscanf gets a terminated string
+        if ((linelen = eol - cursor) >= sizeof(line))
+            continue;
+        memcpy(line, cursor, linelen);
+        line[linelen] = '\0';
+
         // Check if we have a media string
         if (!strncmp(line, "m=", 2)) {
             if (sscanf(line, "m=%s %hu RTP/%*s %u", media_type, &dst.port, &media_fmt_pref) == 3
@@ -714,18 +1135,18 @@ sip_parse_msg_media(sip_msg_t *msg, const u_char *payload)
         // Check if we have a connection string
         if (!strncmp(line, "c=", 2)) {
             if (sscanf(line, "c=IN IP4 %s", dst.ip) && media) {
+                address_parse_raw(&dst);
                 media_set_address(media, dst);
                 strcpy(rtp_stream->dst.ip, dst.ip);
                 strcpy(rtcp_stream->dst.ip, dst.ip);
+                address_parse_raw(&rtp_stream->dst);
+                address_parse_raw(&rtcp_stream->dst);
             }
         }
 
-        // Check if we have attribute format string
-        if (!strncmp(line, "a=rtpmap:", 9)) {
-            if (media && sscanf(line, "a=rtpmap:%u %30[^ ]", &media_fmt_code, media_format)) {
-                media_add_format(media, media_fmt_code, media_format);
-            }
-        }
+        // Format lines (a=rtpmap) are not parsed here: they are only
+        // needed for display, so they are loaded lazily the first time
+        // a media format is queried (@see msg_parse_media_formats)
 
         // Check if we have attribute format RTCP port
         if (!strncmp(line, "a=rtcp:", 7) && rtcp_stream) {
@@ -740,8 +1161,6 @@ sip_parse_msg_media(sip_msg_t *msg, const u_char *payload)
     ADD_STREAM(rtp_stream);
     ADD_STREAM(rtcp_stream);
 
-    sng_free(tofree);
-
 #undef ADD_STREAM
 }
 
@@ -753,35 +1172,45 @@ sip_parse_extra_headers(sip_msg_t *msg, const u_char *payload)
 
      // Reason text
      if (regexec(&calls.reg_reason, (const char *)payload, 2, pmatch, 0) == 0) {
-         msg->call->reasontxt = sng_malloc((int)pmatch[1].rm_eo - pmatch[1].rm_so + 1);
-         strncpy(msg->call->reasontxt, (const char *)payload +  pmatch[1].rm_so, (int)pmatch[1].rm_eo - pmatch[1].rm_so);
+         struct sip_call_disp *disp = call_disp(msg->call);
+         sng_unintern(disp->reasontxt);
+         disp->reasontxt = (char *) sng_intern_n((const char *) payload + pmatch[1].rm_so,
+                                                 (int) pmatch[1].rm_eo - pmatch[1].rm_so);
      }
 
      // Warning code
      if (regexec(&calls.reg_warning, (const char *)payload, 2, pmatch, 0) == 0) {
          strncpy(warning, (const char *)payload +  pmatch[1].rm_so, (int)pmatch[1].rm_eo - pmatch[1].rm_so);
-         msg->call->warning = atoi(warning);
+         call_disp(msg->call)->warning = atoi(warning);
      }
 }
 
 void
 sip_calls_clear()
 {
-    // Create again the callid hash table
+    // Release any call still pending destruction
+    sip_calls_trash_drain(-1);
+
+    // Create again the callid hash tables
     htable_destroy(calls.callids);
     calls.callids = htable_create(calls.limit);
+    htable_destroy(calls.xcallids);
+    calls.xcallids = htable_create(calls.limit);
 
     // Remove all items from vector
     vector_clear(calls.list);
     vector_clear(calls.active);
+    sip_calls_epoch_bump();
 }
 
 void
 sip_calls_clear_soft()
 {
-        // Create again the callid hash table
+        // Create again the callid hash tables
         htable_destroy(calls.callids);
         calls.callids = htable_create(calls.limit);
+        htable_destroy(calls.xcallids);
+        calls.xcallids = htable_create(calls.limit);
 
         // Repopulate list applying current filter
         calls.list = vector_copy_if(sip_calls_vector(), filter_check_call);
@@ -795,6 +1224,15 @@ sip_calls_clear_soft()
         {
                 htable_insert(calls.callids, call->callid, call);
         }
+
+        // Repopulate the X-Call-ID index with still unresolved legs
+        vector_iterator_reset(&it);
+        while ((call = vector_iterator_next(&it)))
+        {
+                if (strlen(call->xcallid) && !sip_find_by_callid(call->xcallid))
+                        htable_insert(calls.xcallids, call->xcallid, call);
+        }
+        sip_calls_epoch_bump();
 }
 
 void
@@ -804,11 +1242,25 @@ sip_calls_rotate()
     vector_iter_t it = vector_iterator(calls.list);
     while ((call = vector_iterator_next(&it))) {
         if (!call->locked) {
+            // Serialize the call to the disk spill ring if enabled
+            spill_store(call);
             // Remove from callids hash
             htable_remove(calls.callids, call->callid);
+            // Remove its pending X-Call-ID entry, if any
+            if (strlen(call->xcallid))
+                htable_remove_data(calls.xcallids, call->xcallid, call);
             // Remove first call from active and call lists
             vector_remove(calls.active, call);
-            vector_remove(calls.list, call);
+            vector_extract(calls.list, call);
+            // Discount the call now, so memory pressure checks see it gone
+            // even though its content is freed later in bounded batches
+            sip_stats_remove_call(call);
+            sip_calls_account_memory(-(long) call->memsize);
+            call->memsize = 0;
+            call->state = 0;
+            vector_append(calls.trash, call);
+            calls.rotated++;
+            sip_calls_epoch_bump();
             return;
         }
     }
@@ -822,7 +1274,7 @@ sip_set_match_expression(const char *expr, int insensitive, int invert)
     // Set invert flag
     calls.match_invert = invert;
 
-#ifdef WITH_PCRE
+#if defined(WITH_PCRE)
     const char *re_err = NULL;
     int32_t err_offset;
     int32_t pflags = PCRE_UNGREEDY | PCRE_DOTALL;
@@ -833,6 +1285,23 @@ sip_set_match_expression(const char *expr, int insensitive, int invert)
     // Check if we have a valid expression
     calls.match_regex = pcre_compile(expr, pflags, &re_err, &err_offset, 0);
     return calls.match_regex == NULL;
+#elif defined(WITH_PCRE2)
+    int re_err = 0;
+    PCRE2_SIZE err_offset = 0;
+    uint32_t pflags = PCRE2_UNGREEDY | PCRE2_DOTALL;
+
+    if (insensitive)
+        pflags |= PCRE2_CASELESS;
+
+    // Check if we have a valid expression
+    if (!(calls.match_regex = pcre2_compile((PCRE2_SPTR) expr, PCRE2_ZERO_TERMINATED,
+                                            pflags, &re_err, &err_offset, NULL)))
+        return 1;
+
+    // Speed up matching with the JIT compiler (falls back if unavailable)
+    pcre2_jit_compile(calls.match_regex, PCRE2_JIT_COMPLETE);
+    calls.match_data = pcre2_match_data_create(1, NULL);
+    return 0;
 #else
     int cflags = REG_EXTENDED;
 
@@ -858,12 +1327,18 @@ sip_check_match_expression(const char *payload)
     if (!calls.match_expr)
         return 1;
 
-#ifdef WITH_PCRE
+#if defined(WITH_PCRE)
     switch (pcre_exec(calls.match_regex, 0, payload, strlen(payload), 0, 0, 0, 0)) {
         case PCRE_ERROR_NOMATCH:
             return 1 == calls.match_invert;
     }
 
+    return 0 == calls.match_invert;
+#elif defined(WITH_PCRE2)
+    if (pcre2_match(calls.match_regex, (PCRE2_SPTR) payload, PCRE2_ZERO_TERMINATED,
+                    0, 0, calls.match_data, NULL) == PCRE2_ERROR_NOMATCH)
+        return 1 == calls.match_invert;
+
     return 0 == calls.match_invert;
 #else
     // Check if payload matches the given expresion
@@ -928,7 +1403,7 @@ sip_get_msg_header(sip_msg_t *msg, char *out)
     msg_get_attribute(msg, SIP_ATTR_DST, to_addr);
 
     // Get msg header
-    if (setting_enabled(SETTING_DISPLAY_ALIAS)) {
+    if (setting_runtime.displayalias) {
         sprintf(out, "%s %s %s -> %s", date, time, get_alias_value(from_addr), get_alias_value(to_addr));
     } else {
         sprintf(out, "%s %s %s -> %s", date, time, from_addr, to_addr);
@@ -949,44 +1424,26 @@ sip_sort_options()
     return calls.sort;
 }
 
+/**
+ * @brief Compare two calls following the current sorting options
+ */
+static int
+sip_list_comparator(void *one, void *two)
+{
+    int cmp = call_attr_compare(one, two, calls.sort.by);
+    return (calls.sort.asc) ? cmp : -cmp;
+}
+
 void
 sip_sort_list()
 {
-    // Cloning the vector automatically sorts it
-    vector_t *clone = vector_clone(calls.list);
-
-    // FIXME FIXME FIXME
-    // There should be a way to destroy the vector without calling the
-    // vector destroyer for each item...
-    vector_set_destroyer(calls.list, NULL);
-    vector_destroy(calls.list);
-
-    // The new sorted list
-    calls.list = clone;
+    // Sort the whole list with the current sorting options
+    vector_sort(calls.list, sip_list_comparator);
+    sip_calls_epoch_bump();
 }
 
 void
 sip_list_sorter(vector_t *vector, void *item)
 {
-    sip_call_t *prev, *cur = (sip_call_t *)item;
-    int count = vector_count(vector);
-    int i;
-
-    // First item is alway sorted
-    if (vector_count(vector) == 1)
-        return;
-
-    for (i = count - 2 ; i >= 0; i--) {
-        // Get previous item
-        prev = vector_item(vector, i);
-        // Check if the item is already in a sorted position
-        int cmp = call_attr_compare(cur, prev, calls.sort.by);
-        if ((calls.sort.asc && cmp > 0) || (!calls.sort.asc && cmp < 0)) {
-            vector_insert(vector, item, i + 1);
-            return;
-        }
-    }
-
-    // Put this item at the begining of the vector
-    vector_insert(vector, item, 0);
+    vector_insert_sorted(vector, item, sip_list_comparator);
 }
@@ -35,10 +35,13 @@
 #include "config.h"
 #include <stdbool.h>
 #include <regex.h>
-#ifdef WITH_PCRE
+#if defined(WITH_PCRE)
 #include <pcre.h>
+#elif defined(WITH_PCRE2)
+#include <pcre2.h>
 #endif
 #include "sip_call.h"
+#include "sip_parser.h"
 #include "vector.h"
 #include "hash.h"
 
@@ -50,8 +53,12 @@ typedef struct sip_call_list sip_call_list_t;
 typedef struct sip_code sip_code_t;
 //! Shorter declaration of sip stats
 typedef struct sip_stats sip_stats_t;
+//! Shorter declaration of sip aggregate counters
+typedef struct sip_stats_counters sip_stats_counters_t;
 //! Shorter declaration of sip sort
 typedef struct sip_sort sip_sort_t;
+//! Shorter declaration of sip parsed packet info
+typedef struct sip_parsed sip_parsed_t;
 
 //! SIP Methods
 enum sip_methods {
@@ -100,6 +107,29 @@ struct sip_stats
     int displayed;
 };
 
+/**
+ * @brief Running aggregate counters for stored dialogs
+ *
+ * These counters are updated incrementally while messages are being
+ * stored and calls change state or are destroyed, so consumers like
+ * the stats panel don't need to walk every stored message.
+ */
+struct sip_stats_counters
+{
+    //! Total number of stored messages
+    int msg_total;
+    //! Stored request messages by method (indexed by enum sip_methods)
+    int msg_methods[SIP_METHOD_PRACK + 1];
+    //! Stored response messages grouped by hundreds (index 0 for 1XX)
+    int msg_responses[8];
+    //! Stored messages by transport (indexed by enum packet_type)
+    int msg_transports[PACKET_SIP_WSS + 1];
+    //! Number of dialogs considered calls (with a call state)
+    int call_total;
+    //! Calls by state (indexed by enum call_state)
+    int call_states[SIP_CALLSTATE_COMPLETED + 1];
+};
+
 /**
  * @brief Sorting information for the sip list
  */
@@ -111,6 +141,27 @@ struct sip_sort
     bool asc;
 };
 
+/**
+ * @brief Pre-parsed SIP packet information
+ *
+ * Filled by sip_parse_packet without touching the shared calls
+ * storage, so capture threads of different sources can run the
+ * expensive payload parsing in parallel and only serialize the
+ * short sip_store_packet phase.
+ */
+struct sip_parsed {
+    //! Created message, still not added to any call
+    sip_msg_t *msg;
+    //! Call-ID of the message
+    char callid[1024];
+    //! Copy of the packet payload, zero terminated
+    u_char payload[MAX_SIP_PAYLOAD];
+    //! Header positions when sip.fastparser is enabled
+    sip_hdrs_t hdrs;
+    //! Parsed using the single pass payload scanner
+    bool fast;
+};
+
 /**
  * @brief call structures head list
  *
@@ -121,26 +172,43 @@ struct sip_call_list {
     vector_t *list;
     //! List of active captured calls
     vector_t *active;
+    //! Rotated calls released in bounded batches (@see sip_calls_trash_drain)
+    vector_t *trash;
     //! Changed flag. For interface optimal updates
     bool changed;
+    //! Storage epoch. Bumped when calls are removed or the list resorted
+    unsigned int epoch;
     //! Sort call list following this options
     sip_sort_t sort;
     //! Last created id
     int last_index;
     //! Call-Ids hash table
     htable_t *callids;
+    //! Calls waiting for the leg their X-Call-ID references (multimap)
+    htable_t *xcallids;
 
     // Max call limit
     int limit;
+    //! Number of calls rotated out of the list (@see sip_calls_rotate)
+    int rotated;
+    //! Maximum memory for stored calls in bytes (0 = no byte limit)
+    size_t memlimit;
+    //! Approximate memory used by stored calls in bytes
+    size_t memsize;
     //! Only store dialogs starting with INVITE
     int only_calls;
     //! Only store dialogs starting with some Methods
     int ignore_incomplete;
     //! match expression text
     const char *match_expr;
-#ifdef WITH_PCRE
+#if defined(WITH_PCRE)
     //! Compiled match expression
     pcre *match_regex;
+#elif defined(WITH_PCRE2)
+    //! Compiled match expression (JIT compiled when available)
+    pcre2_code *match_regex;
+    //! Match data block reused by every match
+    pcre2_match_data *match_data;
 #else
     //! Compiled match expression
     regex_t match_regex;
@@ -234,6 +302,37 @@ sip_validate_packet(packet_t *packet);
 sip_msg_t *
 sip_check_packet(packet_t *packet);
 
+/**
+ * @brief Parse packet payload without touching the calls storage
+ *
+ * First phase of sip_check_packet: copy the payload, extract the
+ * Call-ID and create the message structure with its request/response
+ * parsed. This phase reads no shared state, so multiple capture
+ * threads can run it in parallel before serializing on the storage
+ * phase.
+ *
+ * @param packet Packet structure pointer
+ * @param parsed Output structure with the pre-parsed information
+ * @return the created message, NULL if the packet is not SIP
+ */
+sip_msg_t *
+sip_parse_packet(packet_t *packet, sip_parsed_t *parsed);
+
+/**
+ * @brief Store a pre-parsed message into the calls list
+ *
+ * Second phase of sip_check_packet: find or create the call for the
+ * parsed message and add it to the storage. Must be called with the
+ * capture lock held. The parsed message is deallocated if it doesn't
+ * match the storage filters.
+ *
+ * @param packet Packet structure pointer
+ * @param parsed Pre-parsed information from sip_parse_packet
+ * @return the stored message, NULL if it has been discarded
+ */
+sip_msg_t *
+sip_store_packet(packet_t *packet, sip_parsed_t *parsed);
+
 /**
  * @brief Return if the call list has changed
  *
@@ -246,6 +345,35 @@ sip_check_packet(packet_t *packet);
 bool
 sip_calls_has_changed();
 
+/**
+ * @brief Flag the call list as changed
+ *
+ * Used by non SIP paths (RTP stream counters) that update displayed
+ * call data without storing a new message.
+ */
+void
+sip_calls_mark_changed();
+
+/**
+ * @brief Return the storage epoch of the call list
+ *
+ * The epoch changes every time stored calls are removed, the list is
+ * resorted or display filters are reset, so any cached copy of the
+ * list contents built on a previous epoch must be fully rebuilt.
+ *
+ * @return current storage epoch
+ */
+unsigned int
+sip_calls_epoch();
+
+/**
+ * @brief Invalidate cached copies of the call list
+ *
+ * Move the call list to a new storage epoch (@see sip_calls_epoch)
+ */
+void
+sip_calls_epoch_bump();
+
 /**
  * @brief Getter for calls linked list size
  *
@@ -300,6 +428,96 @@ sip_active_calls_vector();
 sip_stats_t
 sip_calls_stats();
 
+/**
+ * @brief Return a copy of the running aggregate counters
+ *
+ * @return counters structure with current values
+ */
+sip_stats_counters_t
+sip_stats_get_counters();
+
+/**
+ * @brief Update aggregate counters for a stored or removed message
+ *
+ * @param msg SIP message being stored or removed
+ * @param count 1 when the message is stored, -1 when removed
+ */
+void
+sip_stats_count_msg(sip_msg_t *msg, int count);
+
+/**
+ * @brief Update aggregate counters after a call state change
+ *
+ * @param oldstate previous call state (0 if the dialog was not a call)
+ * @param newstate new call state
+ */
+void
+sip_stats_update_state(int oldstate, int newstate);
+
+/**
+ * @brief Remove a call contributions from aggregate counters
+ *
+ * Invoked from call_destroy before the call messages are deallocated.
+ *
+ * @param call SIP call being destroyed
+ */
+void
+sip_stats_remove_call(sip_call_t *call);
+
+/**
+ * @brief Set the maximum memory for stored calls
+ *
+ * When the approximate footprint of stored calls exceeds this limit,
+ * the oldest calls are rotated out regardless of the call count limit.
+ *
+ * @param limit maximum memory in bytes (0 disables the byte limit)
+ */
+void
+sip_set_memory_limit(size_t limit);
+
+/**
+ * @brief Get the maximum memory for stored calls
+ *
+ * @return maximum memory in bytes (0 when no byte limit is set)
+ */
+size_t
+sip_get_memory_limit();
+
+/**
+ * @brief Get the approximate memory used by stored calls
+ *
+ * @return memory used in bytes
+ */
+size_t
+sip_get_memory_usage();
+
+/**
+ * @brief Get the maximum number of stored calls
+ *
+ * @return maximum number of calls kept in the list
+ */
+int
+sip_get_call_limit();
+
+/**
+ * @brief Get the number of calls rotated out of the list
+ *
+ * @return calls removed by sip_calls_rotate since startup
+ */
+int
+sip_calls_rotated();
+
+/**
+ * @brief Update the storage memory accounting
+ *
+ * Invoked from the call storage functions when data is added to or
+ * removed from a call.
+ *
+ * @param bytes bytes to add (negative to discount)
+ */
+void
+sip_calls_account_memory(long bytes);
+
 
 /**
  * @brief Find a call structure in calls linked list given a call index
@@ -85,6 +85,8 @@ enum sip_attr_id {
     SIP_ATTR_REASON_TXT,
     //! Warning Header
     SIP_ATTR_WARNING,
+    //! Estimated MOS of the call RTP streams
+    SIP_ATTR_RTPMOS,
     //! SIP Attribute count
     SIP_ATTR_COUNT
 };
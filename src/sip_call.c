@@ -29,10 +29,43 @@
  *
  */
 
+#include <ctype.h>
 #include "sip_call.h"
 #include "sip.h"
+#include "intern.h"
 #include "setting.h"
 
+/**
+ * @brief Destroy a call stream, removing it from the global stream index
+ */
+static void
+call_stream_destroyer(void *stream)
+{
+    rtp_stream_index_remove((rtp_stream_t *) stream);
+    sng_free(stream);
+}
+
+/**
+ * @brief Invalidate the cached rendered attribute texts of a call
+ *
+ * Must be called whenever the call data changes, so the next redraw
+ * renders the attributes again (@see call_get_attribute).
+ */
+static void
+call_attr_cache_clear(sip_call_t *call)
+{
+    int i;
+
+    if (!call->disp)
+        return;
+
+    for (i = 0; i < SIP_ATTR_COUNT; i++) {
+        sng_unintern(call->disp->attrcache[i]);
+        call->disp->attrcache[i] = NULL;
+        call->disp->attrcolor[i] = -1;
+    }
+}
+
 sip_call_t *
 call_create(char *callid, char *xcallid)
 {
@@ -47,14 +80,14 @@ call_create(char *callid, char *xcallid)
     vector_set_destroyer(call->msgs, msg_destroyer);
 
     // Create an empty vector to store rtp packets
-    if (setting_enabled(SETTING_CAPTURE_RTP)) {
+    if (setting_runtime.rtpcapture) {
         call->rtp_packets = vector_create(0, 40);
         vector_set_destroyer(call->rtp_packets, packet_destroyer);
     }
 
     // Create an empty vector to strore stream data
     call->streams = vector_create(0, 2);
-    vector_set_destroyer(call->streams, vector_generic_destroyer);
+    vector_set_destroyer(call->streams, call_stream_destroyer);
 
     // Create an empty vector to store x-calls
     call->xcalls = vector_create(0, 1);
@@ -62,6 +95,9 @@ call_create(char *callid, char *xcallid)
     // Initialize call filter status
     call->filtered = -1;
 
+    // Not in any call group yet
+    call->gindex = -1;
+
     // Set message callid
     call->callid = strdup(callid);
     call->xcallid = strdup(xcallid);
@@ -69,9 +105,27 @@ call_create(char *callid, char *xcallid)
     return call;
 }
 
+struct sip_call_disp *
+call_disp(sip_call_t *call)
+{
+    int i;
+
+    if (!call->disp) {
+        call->disp = sng_malloc(sizeof(struct sip_call_disp));
+        // No cached text has been color classified yet
+        for (i = 0; i < SIP_ATTR_COUNT; i++)
+            call->disp->attrcolor[i] = -1;
+    }
+    return call->disp;
+}
+
 void
 call_destroy(sip_call_t *call)
 {
+    // Discount this call from aggregate counters
+    sip_stats_remove_call(call);
+    // Discount this call from storage memory accounting
+    sip_calls_account_memory(-(long) call->memsize);
     // Remove all call messages
     vector_destroy(call->msgs);
     // Remove all call streams
@@ -80,10 +134,16 @@ call_destroy(sip_call_t *call)
     vector_destroy(call->rtp_packets);
     // Remove all xcalls
     vector_destroy(call->xcalls);
+    // Remove cached attribute texts
+    call_attr_cache_clear(call);
+    // Remove display data block
+    if (call->disp) {
+        sng_unintern(call->disp->reasontxt);
+        sng_free(call->disp);
+    }
     // Deallocate call memory
     sng_free(call->callid);
     sng_free(call->xcallid);
-    sng_free(call->reasontxt);
     sng_free(call);
 }
 
@@ -99,6 +159,19 @@ call_has_changed(sip_call_t *call)
     return call->changed;
 }
 
+/**
+ * @brief Add bytes to the call memory footprint
+ *
+ * Keeps the global storage accounting in sync
+ * (@see sip_calls_account_memory)
+ */
+static void
+call_account_memory(sip_call_t *call, size_t bytes)
+{
+    call->memsize += bytes;
+    sip_calls_account_memory(bytes);
+}
+
 void
 call_add_message(sip_call_t *call, sip_msg_t *msg)
 {
@@ -106,8 +179,12 @@ call_add_message(sip_call_t *call, sip_msg_t *msg)
     msg->call = call;
     // Put this msg at the end of the msg list
     msg->index = vector_append(call->msgs, msg);
+    // Account the message memory in the call footprint
+    call_account_memory(call, sizeof(sip_msg_t) + packet_memsize(msg->packet));
     // Flag this call as changed
     call->changed = true;
+    // Attribute texts must be rendered again
+    call_attr_cache_clear(call);
 }
 
 void
@@ -115,6 +192,10 @@ call_add_stream(sip_call_t *call, rtp_stream_t *stream)
 {
     // Store stream
     vector_append(call->streams, stream);
+    // Account the stream memory in the call footprint
+    call_account_memory(call, sizeof(rtp_stream_t));
+    // Make the stream reachable from the global stream index
+    rtp_stream_index_add(stream);
     // Flag this call as changed
     call->changed = true;
 }
@@ -124,6 +205,8 @@ call_add_rtp_packet(sip_call_t *call, packet_t *packet)
 {
     // Store packet
     vector_append(call->rtp_packets, packet);
+    // Account the packet memory in the call footprint
+    call_account_memory(call, packet_memsize(packet));
     // Flag this call as changed
     call->changed = true;
 }
@@ -150,24 +233,52 @@ call_is_invite(sip_call_t *call)
     return 0;
 }
 
+//! How many previous messages are compared while checking retransmissions
+#define RETRANS_WINDOW 5
+
+/**
+ * @brief Case-insensitive FNV-1a hash of a message payload
+ *
+ * Retransmission checks compare payloads ignoring case, so each byte
+ * is folded to lowercase before being mixed into the hash.
+ */
+static uint64_t
+call_msg_payload_hash(const char *payload)
+{
+    uint64_t hash = 14695981039346656037UL;
+    while (*payload) {
+        hash ^= (unsigned char) tolower((unsigned char) *payload++);
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
 void
 call_msg_retrans_check(sip_msg_t *msg)
 {
-    sip_msg_t *prev = NULL;
+    sip_msg_t *prev;
     vector_iter_t it;
+    int checked = 0;
+
+    // Hash the new payload once; stored messages already have theirs
+    msg->payload_hash = call_msg_payload_hash(msg_get_payload(msg));
 
-    // Get previous message in call with same origin and destination
+    // Check the last messages in call with same origin and destination,
+    // so delayed retransmissions interleaved with responses also match
     it = vector_iterator(msg->call->msgs);
     vector_iterator_set_current(&it, vector_index(msg->call->msgs, msg));
-    while ((prev = vector_iterator_prev(&it))) {
-        if (addressport_equals(prev->packet->src, msg->packet->src) &&
-                addressport_equals(prev->packet->dst, msg->packet->dst))
-            break;
-    }
-
-    // Store the flag that determines if message is retrans
-    if (prev && !strcasecmp(msg_get_payload(msg), msg_get_payload(prev))) {
-        msg->retrans = prev;
+    while ((prev = vector_iterator_prev(&it)) && checked < RETRANS_WINDOW) {
+        if (!addressport_equals(prev->packet->src, msg->packet->src) ||
+                !addressport_equals(prev->packet->dst, msg->packet->dst))
+            continue;
+        checked++;
+
+        // Compare the full payloads only when their hashes match
+        if (prev->payload_hash == msg->payload_hash &&
+                !strcasecmp(msg_get_payload(msg), msg_get_payload(prev))) {
+            msg->retrans = prev;
+            return;
+        }
     }
 }
 
@@ -252,10 +363,19 @@ const char *
 call_get_attribute(sip_call_t *call, enum sip_attr_id id, char *value)
 {
     sip_msg_t *first, *last;
+    rtp_stream_t *stream;
+    vector_iter_t streams;
+    float mos = 0;
 
     if (!call)
         return NULL;
 
+    // Return the cached text rendered by a previous redraw
+    if (call->disp && call->disp->attrcache[id]) {
+        strcpy(value, call->disp->attrcache[id]);
+        return value;
+    }
+
     switch (id) {
         case SIP_ATTR_CALLINDEX:
             sprintf(value, "%d", call->index);
@@ -285,19 +405,57 @@ call_get_attribute(sip_call_t *call, enum sip_attr_id id, char *value)
             timeval_to_duration(msg_get_time(first), msg_get_time(last), value);
             break;
         case SIP_ATTR_REASON_TXT:
-            if (call->reasontxt)
-                sprintf(value, "%s", call->reasontxt);
+            if (call->disp && call->disp->reasontxt)
+                sprintf(value, "%s", call->disp->reasontxt);
             break;
         case SIP_ATTR_WARNING:
-            if (call->warning)
-                sprintf(value, "%d", call->warning);
+            if (call->disp && call->disp->warning)
+                sprintf(value, "%d", call->disp->warning);
             break;
+        case SIP_ATTR_RTPMOS:
+            // Worst scored stream of the call
+            streams = vector_iterator(call->streams);
+            while ((stream = vector_iterator_next(&streams))) {
+                if (stream->type != PACKET_RTP || stream_get_count(stream) < 2)
+                    continue;
+                if (!mos || stream_get_mos(stream) < mos)
+                    mos = stream_get_mos(stream);
+            }
+            if (!mos)
+                return NULL;
+            sprintf(value, "%.1f", mos);
+            // Quality evolves with RTP traffic, not SIP, so skip the cache
+            return value;
         default:
-            return msg_get_attribute(vector_first(call->msgs), id, value);
+            if (!msg_get_attribute(vector_first(call->msgs), id, value))
+                return NULL;
             break;
     }
 
-    return strlen(value) ? value : NULL;
+    if (!strlen(value))
+        return NULL;
+
+    // Cache the rendered text until the call changes again, sharing
+    // repeated values (method, state...) through the string pool
+    call_disp(call)->attrcache[id] = (char *) sng_intern(value);
+    return value;
+}
+
+int
+call_get_attribute_color(sip_call_t *call, enum sip_attr_id id, const char *value)
+{
+    if (!setting_enabled(SETTING_CL_COLORATTR))
+        return 0;
+
+    // Values rendered outside the cache are classified on each call
+    if (!call->disp || !call->disp->attrcache[id])
+        return sip_attr_get_color(id, value);
+
+    // Classify the cached text once and reuse its color pair
+    if (call->disp->attrcolor[id] < 0)
+        call->disp->attrcolor[id] = sip_attr_get_color(id, value);
+
+    return call->disp->attrcolor[id];
 }
 
 const char *
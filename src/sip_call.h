@@ -59,6 +59,25 @@ enum call_state
  * callid (considered a dialog). It contains some replicated
  * data from its messages to speed up searches.
  */
+/**
+ * @brief Display-only data of a call
+ *
+ * This data is only touched when the call is rendered, so it lives in
+ * a separately allocated block to keep sip_call_t compact while the
+ * capture path iterates the stored calls. The block is created on
+ * demand (@see call_disp).
+ */
+struct sip_call_disp {
+    //! Last reason text value for this call
+    char *reasontxt;
+    //! Last warning text value for this call
+    int warning;
+    //! Cached rendered attribute texts (@see call_get_attribute)
+    char *attrcache[SIP_ATTR_COUNT];
+    //! Color pairs of the cached texts, -1 if not yet classified
+    int attrcolor[SIP_ATTR_COUNT];
+};
+
 struct sip_call {
     // Call index in the call list
     int index;
@@ -74,10 +93,12 @@ struct sip_call {
     bool changed;
     //! Locked flag. Calls locked are never deleted
     bool locked;
-    //! Last reason text value for this call
-    char *reasontxt;
-    //! Last warning text value for this call
-    int warning;
+    //! Position of this call in the call group (display cache)
+    int gindex;
+    //! Trigram signature of the searchable attributes (@see filter.c)
+    uint64_t trigrams;
+    //! This call is in the active calls vector (@see sip_call_is_active)
+    bool active;
     //! List of calls with with this call as X-Call-Id
     vector_t *xcalls;
     //! Cseq from invite startint the call
@@ -90,6 +111,10 @@ struct sip_call {
     vector_t *streams;
     //! RTP packets for this call (capture_packet_t *)
     vector_t *rtp_packets;
+    //! Approximate memory used by this call in bytes
+    size_t memsize;
+    //! Display-only data, allocated on demand (@see call_disp)
+    struct sip_call_disp *disp;
 };
 
 /**
@@ -105,6 +130,17 @@ struct sip_call {
 sip_call_t *
 call_create(char *callid, char *xcallid);
 
+/**
+ * @brief Return the display data block of a call
+ *
+ * The block is allocated the first time it is requested.
+ *
+ * @param call SIP call structure
+ * @return the display-only data of the call
+ */
+struct sip_call_disp *
+call_disp(sip_call_t *call);
+
 /**
  * @brief Free all related memory from a call and remove from call list
  *
@@ -241,6 +277,21 @@ call_update_state(sip_call_t *call, sip_msg_t *msg);
 const char *
 call_get_attribute(struct sip_call *call, enum sip_attr_id id, char *value);
 
+/**
+ * @brief Return the color pair of a call attribute value
+ *
+ * Classifies the attribute value once and stores the color pair beside
+ * the cached attribute text, so colored rendering does not repeat the
+ * strcmp based classification on every redraw.
+ *
+ * @param call SIP call structure
+ * @param id Attribute id
+ * @param value Attribute value returned by call_get_attribute
+ * @return Color pair to display the value, 0 for the default color
+ */
+int
+call_get_attribute_color(struct sip_call *call, enum sip_attr_id id, const char *value);
+
 /**
  * @brief Return the string represtation of a call state
  *
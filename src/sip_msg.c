@@ -28,19 +28,59 @@
  * This file contains the functions and structure to manage SIP message data
  *
  */
+#include <string.h>
 #include "sip_msg.h"
 #include "media.h"
+#include "pool.h"
+#include "intern.h"
+#include "compact.h"
 #include "sip.h"
 
+//! SIP message object pool
+static mpool_t *msg_pool;
+static mpool_t *msg_disp_pool;
+
+void
+msg_pool_init()
+{
+    msg_pool = mpool_create(sizeof(sip_msg_t));
+    msg_disp_pool = mpool_create(sizeof(struct sip_msg_disp));
+}
+
+void
+msg_pool_reserve(size_t count)
+{
+    // Display blocks are allocated lazily for rendered messages only,
+    // so warming the message pool is enough for the capture path
+    mpool_reserve(msg_pool, count);
+}
+
+void
+msg_pool_deinit()
+{
+    mpool_destroy(msg_pool);
+    mpool_destroy(msg_disp_pool);
+    msg_pool = NULL;
+    msg_disp_pool = NULL;
+}
+
 sip_msg_t *
 msg_create()
 {
     sip_msg_t *msg;
-    if (!(msg = sng_malloc(sizeof(sip_msg_t))))
+    if (!(msg = mpool_alloc(msg_pool)))
         return NULL;
     return msg;
 }
 
+struct sip_msg_disp *
+msg_disp(sip_msg_t *msg)
+{
+    if (!msg->disp)
+        msg->disp = mpool_alloc(msg_disp_pool);
+    return msg->disp;
+}
+
 void
 msg_destroy(sip_msg_t *msg)
 {
@@ -50,11 +90,14 @@ msg_destroy(sip_msg_t *msg)
 
     // Free message packets
     packet_destroy(msg->packet);
-    // Free all memory
-    sng_free(msg->resp_str);
-    sng_free(msg->sip_from);
-    sng_free(msg->sip_to);
-    sng_free(msg);
+    // Drop the display block and its pooled string references
+    if (msg->disp) {
+        sng_unintern(msg->disp->resp_str);
+        sng_unintern(msg->disp->sip_from);
+        sng_unintern(msg->disp->sip_to);
+        mpool_free(msg_disp_pool, msg->disp);
+    }
+    mpool_free(msg_pool, msg);
 }
 
 void
@@ -97,9 +140,57 @@ msg_add_media(sip_msg_t *msg, sdp_media_t *media)
     vector_append(msg->medias, media);
 }
 
+void
+msg_parse_media_formats(sip_msg_t *msg)
+{
+    char media_type[MEDIATYPELEN] = { };
+    char media_format[30] = { };
+    uint32_t media_fmt_pref;
+    uint32_t media_fmt_code;
+    uint16_t media_port;
+    sdp_media_t *media = NULL;
+    char *payload, *tofree, *line;
+    vector_iter_t medias;
+
+    // Only parse the format lines once
+    if (msg->fmts_parsed)
+        return;
+    msg->fmts_parsed = true;
+
+    // Nothing to parse without medias or payload
+    if (!msg->medias || !msg_get_payload(msg))
+        return;
+
+    // Walk the payload matching each media line with its structure,
+    // using the same conditions the capture time pre-scan used to
+    // create them (@see sip_parse_msg_media)
+    medias = vector_iterator(msg->medias);
+    tofree = payload = strdup(msg_get_payload(msg));
+    while ((line = strsep(&payload, "\r\n")) != NULL) {
+        // Check if we have a media string
+        if (!strncmp(line, "m=", 2)) {
+            if (sscanf(line, "m=%s %hu RTP/%*s %u", media_type, &media_port, &media_fmt_pref) == 3
+            ||  sscanf(line, "m=%s %hu UDP/%*s %u", media_type, &media_port, &media_fmt_pref) == 3) {
+                media = vector_iterator_next(&medias);
+            }
+        }
+
+        // Check if we have attribute format string
+        if (!strncmp(line, "a=rtpmap:", 9)) {
+            if (media && sscanf(line, "a=rtpmap:%u %30[^ ]", &media_fmt_code, media_format)) {
+                media_add_format(media, media_fmt_code, media_format);
+            }
+        }
+    }
+    sng_free(tofree);
+}
+
 const char *
 msg_get_payload(sip_msg_t *msg)
 {
+    // Inflate cold storage payloads before handing them out
+    if (msg->packet->payload_deflated)
+        compact_packet_restore(msg->packet);
     return (const char *) packet_payload(msg->packet);
 }
 
@@ -129,19 +220,19 @@ msg_get_attribute(sip_msg_t *msg, int id, char *value)
             sprintf(value, "%.*s", SIP_ATTR_MAXLEN, sip_get_msg_reqresp_str(msg));
             break;
         case SIP_ATTR_SIPFROM:
-            sprintf(value, "%.*s", SIP_ATTR_MAXLEN, msg->sip_from);
+            sprintf(value, "%.*s", SIP_ATTR_MAXLEN, sip_parse_msg(msg)->disp->sip_from);
             break;
         case SIP_ATTR_SIPTO:
-            sprintf(value, "%.*s", SIP_ATTR_MAXLEN, msg->sip_to);
+            sprintf(value, "%.*s", SIP_ATTR_MAXLEN, sip_parse_msg(msg)->disp->sip_to);
             break;
         case SIP_ATTR_SIPFROMUSER:
-            if ((ar = strchr(msg->sip_from, '@'))) {
-                strncpy(value, msg->sip_from, ar - msg->sip_from);
+            if ((ar = strchr(sip_parse_msg(msg)->disp->sip_from, '@'))) {
+                strncpy(value, msg->disp->sip_from, ar - msg->disp->sip_from);
             }
             break;
         case SIP_ATTR_SIPTOUSER:
-            if ((ar = strchr(msg->sip_to, '@'))) {
-                strncpy(value, msg->sip_to, ar - msg->sip_to);
+            if ((ar = strchr(sip_parse_msg(msg)->disp->sip_to, '@'))) {
+                strncpy(value, msg->disp->sip_to, ar - msg->disp->sip_to);
             }
             break;
         case SIP_ATTR_DATE:
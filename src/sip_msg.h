@@ -49,30 +49,74 @@ typedef struct sip_msg sip_msg_t;
  */
 struct sip_call;
 
-struct sip_msg {
-    //! Request Method or Response Code @see sip_methods
-    int reqresp;
+/**
+ * @brief Display-only data of a message
+ *
+ * These strings are only read when the message is rendered, so they
+ * live in a separately allocated block to keep sip_msg_t compact for
+ * the capture and filter paths. The block is created on demand
+ * (@see msg_disp).
+ */
+struct sip_msg_disp {
     //!  Response text if it doesn't matches an standard
     char *resp_str;
-    //! Message Cseq
-    uint32_t cseq;
     //! SIP From Header
     char *sip_from;
     //! SIP To Header
     char *sip_to;
-    //! SDP payload information (sdp_media_t *)
-    vector_t *medias;
-    //! Captured packet for this message
-    packet_t *packet;
+};
+
+struct sip_msg {
+    //! Request Method or Response Code @see sip_methods
+    int reqresp;
+    //! Message Cseq
+    uint32_t cseq;
     //! Index of this message in call
     uint32_t index;
+    //! SDP format lines have been parsed (@see msg_parse_media_formats)
+    bool fmts_parsed;
+    //! Captured packet for this message
+    packet_t *packet;
     //! Message owner
     struct sip_call *call;
     //! Message is a retransmission from other message
     sip_msg_t *retrans;
+    //! SDP payload information (sdp_media_t *)
+    vector_t *medias;
+    //! Payload hash, set while checking for retransmissions
+    uint64_t payload_hash;
+    //! Display-only data, allocated on demand (@see msg_disp)
+    struct sip_msg_disp *disp;
 };
 
 
+/**
+ * @brief Create the SIP message object pool
+ *
+ * Must be called before any message is created (@see sip_init)
+ */
+void
+msg_pool_init();
+
+/**
+ * @brief Warm the SIP message pool up to the expected working set
+ *
+ * Preallocates pool slabs for the given number of messages so the
+ * first traffic burst does not pay for pool growth (@see sip_init)
+ *
+ * @param count Number of messages to preallocate
+ */
+void
+msg_pool_reserve(size_t count);
+
+/**
+ * @brief Free the SIP message object pool
+ *
+ * All messages must have been destroyed before this point
+ */
+void
+msg_pool_deinit();
+
 /**
  * @brief Create a new message from the readed header and payload
  *
@@ -86,6 +130,17 @@ struct sip_msg {
 sip_msg_t *
 msg_create();
 
+/**
+ * @brief Return the display data block of a message
+ *
+ * The block is allocated the first time it is requested.
+ *
+ * @param msg SIP message structure
+ * @return the display-only data of the message
+ */
+struct sip_msg_disp *
+msg_disp(sip_msg_t *msg);
+
 /**
  * @brief Destroy a SIP message and free its memory
  *
@@ -158,6 +213,19 @@ msg_is_request(sip_msg_t *msg);
 void
 msg_add_media(sip_msg_t *msg, sdp_media_t *media);
 
+/**
+ * @brief Parse the SDP format lines of this message medias
+ *
+ * Format lines (a=rtpmap) are not parsed at capture time: they are
+ * only needed when media information is displayed, so they are loaded
+ * here the first time a media format is queried
+ * (@see media_get_format).
+ *
+ * @param msg SIP message owning the media structures
+ */
+void
+msg_parse_media_formats(sip_msg_t *msg);
+
 /**
  * @brief Get SIP Message payload
  */
@@ -0,0 +1,229 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file sip_parser.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in sip_parser.h
+ *
+ */
+#include "config.h"
+#include <string.h>
+#include <ctype.h>
+#include "sip_parser.h"
+#include "setting.h"
+#include "util.h"
+
+/**
+ * @brief Case insensitive header name comparison against a known name
+ *
+ * Folds both sides with the ASCII case bit instead of calling the
+ * locale aware strncasecmp: reference names only contain letters and
+ * dashes, for which the fold is exact, and CR can never appear inside
+ * a header line.
+ *
+ * @return 1 if the name matches the whole reference, 0 otherwise
+ */
+static int
+sip_parser_name_is(const char *name, int namelen, const char *ref)
+{
+    int i;
+
+    for (i = 0; i < namelen; i++) {
+        if ((unsigned char) (name[i] | 0x20) != (unsigned char) (ref[i] | 0x20))
+            return 0;
+    }
+    // Only a match if the reference name ends here too
+    return ref[namelen] == '\0';
+}
+
+/**
+ * @brief Check if a header line name matches its full or compact form
+ *
+ * Header names are compared case insensitive, as the regexps did.
+ *
+ * @return 1 if the name matches, 0 otherwise
+ */
+static int
+sip_parser_hdr_is(const char *name, int namelen, const char *full, const char *compact)
+{
+    if (sip_parser_name_is(name, namelen, full))
+        return 1;
+    if (compact && sip_parser_name_is(name, namelen, compact))
+        return 1;
+    return 0;
+}
+
+/**
+ * @brief Check if a header name matches any of the sip.xcid setting names
+ *
+ * The setting contains pipe separated header names (X-Call-ID|X-CID)
+ *
+ * @return 1 if the name matches, 0 otherwise
+ */
+static int
+sip_parser_hdr_is_xcallid(const char *name, int namelen)
+{
+    const char *setting = setting_get_value(SETTING_SIP_HEADER_X_CID);
+    const char *alt = setting;
+    const char *end;
+
+    while (alt && *alt) {
+        if (!(end = strchr(alt, '|')))
+            end = alt + strlen(alt);
+        if ((int) (end - alt) == namelen && !strncasecmp(name, alt, namelen))
+            return 1;
+        alt = (*end) ? end + 1 : end;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse a From/To style header value
+ *
+ * Mimics regexp ^(From|f):[ ]*[^:]*:(([^@>]+)@?[^\r>;]+) capture group 2:
+ * skip everything until the URI scheme colon and take the user@host part
+ * until the end of line, '>' or ';'.
+ */
+static void
+sip_parser_parse_uri(const char *value, const char *eol, sip_slice_t *slice)
+{
+    const char *start;
+
+    // Find the URI scheme separator
+    for (start = value; start < eol && *start != ':'; start++);
+    if (start == eol)
+        return;
+    start++;
+
+    slice->text = start;
+    while (start < eol && *start != '>' && *start != ';')
+        start++;
+    slice->len = start - slice->text;
+}
+
+int
+sip_parser_scan(const char *payload, sip_hdrs_t *hdrs)
+{
+    const char *line = payload;
+    const char *eol, *name, *value;
+    int namelen;
+
+    // Initialize all header slices as not found
+    memset(hdrs, 0, sizeof(sip_hdrs_t));
+    hdrs->body = -1;
+
+    // Get first line boundary
+    eol = sng_scan_eol(line);
+
+    if (!strncasecmp(line, "SIP/2.0 ", 8)) {
+        // Response format: SIP/2.0 code text
+        value = line + 8;
+        while (value < eol && *value == ' ')
+            value++;
+        if (eol - value < 3 || !isdigit(value[0]) || !isdigit(value[1]) || !isdigit(value[2]))
+            return 1;
+        hdrs->resp_code.text = value;
+        hdrs->resp_code.len = 3;
+        // Response text includes the numeric code, without trailing spaces
+        hdrs->resp_text.text = value;
+        name = eol;
+        while (name > value && *(name - 1) == ' ')
+            name--;
+        hdrs->resp_text.len = name - value;
+    } else {
+        // Request format: METHOD scheme:uri SIP/2.0
+        for (value = line; value < eol && isalpha((unsigned char) *value); value++);
+        if (value == line || value == eol || *value != ' ')
+            return 1;
+        // Request uri must begin with a scheme
+        for (name = value + 1; name < eol && isalpha((unsigned char) *name); name++);
+        if (name == value + 1 || name == eol || *name != ':')
+            return 1;
+
+        // Store the method only for complete request lines
+        if (eol - line > 8 && !strncasecmp(eol - 8, " SIP/2.0", 8)) {
+            hdrs->method.text = line;
+            hdrs->method.len = value - line;
+        }
+    }
+
+    // Walk the rest of lines looking for interesting headers
+    while (*eol) {
+        // Move to the next line
+        line = (*eol == '\r' && *(eol + 1) == '\n') ? eol + 2 : eol + 1;
+
+        // An empty line separates headers from body
+        if (line[0] == '\r' && line[1] == '\n') {
+            hdrs->body = (line + 2) - payload;
+            break;
+        }
+
+        // Get this line boundary
+        eol = sng_scan_eol(line);
+
+        // Split header name from its value
+        for (name = line; *name && *name != ':' && name < eol; name++);
+        if (name == eol)
+            continue;
+        namelen = name - line;
+        for (value = name + 1; value < eol && *value == ' '; value++);
+
+        if (sip_parser_hdr_is(line, namelen, "Call-ID", "i")) {
+            hdrs->callid.text = value;
+            while (value < eol && *value != ' ')
+                value++;
+            hdrs->callid.len = value - hdrs->callid.text;
+        } else if (sip_parser_hdr_is(line, namelen, "CSeq", NULL)) {
+            while (value < eol && isdigit((unsigned char) *value))
+                hdrs->cseq = hdrs->cseq * 10 + (*value++ - '0');
+        } else if (sip_parser_hdr_is(line, namelen, "From", "f")) {
+            sip_parser_parse_uri(value, eol, &hdrs->from);
+        } else if (sip_parser_hdr_is(line, namelen, "To", "t")) {
+            sip_parser_parse_uri(value, eol, &hdrs->to);
+        } else if (sip_parser_hdr_is(line, namelen, "Content-Length", "l")) {
+            hdrs->cl.text = value;
+            while (value < eol && isdigit((unsigned char) *value))
+                value++;
+            hdrs->cl.len = value - hdrs->cl.text;
+        } else if (sip_parser_hdr_is_xcallid(line, namelen)) {
+            hdrs->xcallid.text = value;
+            while (value < eol && *value != ' ')
+                value++;
+            hdrs->xcallid.len = value - hdrs->xcallid.text;
+        }
+    }
+
+    return 0;
+}
+
+void
+sip_parser_slice_cpy(const sip_slice_t *slice, char *out, int size)
+{
+    int len = slice->len;
+
+    if (len > size - 1)
+        len = size - 1;
+    if (len > 0)
+        memcpy(out, slice->text, len);
+    out[len] = '\0';
+}
@@ -0,0 +1,106 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file sip_parser.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Single-pass SIP payload scanner
+ *
+ * Hand written parser used instead of the POSIX regular expressions of
+ * sip.c when sip.fastparser setting is enabled (default). It walks the
+ * payload once, splitting it at CRLF boundaries, and stores zero-copy
+ * slices pointing to the interesting header values. The regexp code
+ * remains available as fallback disabling that setting.
+ */
+#ifndef __SNGREP_SIP_PARSER_H
+#define __SNGREP_SIP_PARSER_H
+
+#include "config.h"
+
+//! Shorter declaration of sip_slice structure
+typedef struct sip_slice sip_slice_t;
+//! Shorter declaration of sip_hdrs structure
+typedef struct sip_hdrs sip_hdrs_t;
+
+/**
+ * @brief Zero-copy reference to a part of the scanned payload
+ */
+struct sip_slice {
+    //! Beginning of the value inside the payload (not NULL terminated)
+    const char *text;
+    //! Value length in bytes
+    int len;
+};
+
+/**
+ * @brief Interesting header values of a scanned SIP payload
+ *
+ * All slices point inside the scanned payload, so they are only valid
+ * while the payload memory is.  Slices not present in the payload have
+ * zero length.
+ */
+struct sip_hdrs {
+    //! Request method text (only for requests with a full request line)
+    sip_slice_t method;
+    //! Response code (only for responses)
+    sip_slice_t resp_code;
+    //! Response code and text, trailing spaces removed (only for responses)
+    sip_slice_t resp_text;
+    //! Call-ID header value
+    sip_slice_t callid;
+    //! X-Call-ID header value (using sip.xcid setting header names)
+    sip_slice_t xcallid;
+    //! From header user@host part
+    sip_slice_t from;
+    //! To header user@host part
+    sip_slice_t to;
+    //! Content-Length header value
+    sip_slice_t cl;
+    //! CSeq header numeric value, 0 if not found
+    int cseq;
+    //! Offset of the message body after the headers, -1 if not found
+    int body;
+};
+
+/**
+ * @brief Scan a SIP payload extracting all interesting headers
+ *
+ * Single forward pass over a NULL terminated payload. Validates the
+ * first line has SIP request or response format and fills the given
+ * headers structure with the found values.
+ *
+ * @param payload NULL terminated SIP payload
+ * @param hdrs Output structure for header value slices
+ * @return 0 if the payload first line looks like SIP, 1 otherwise
+ */
+int
+sip_parser_scan(const char *payload, sip_hdrs_t *hdrs);
+
+/**
+ * @brief Copy a scanned slice into a NULL terminated buffer
+ *
+ * At most size - 1 bytes of the slice are copied.
+ */
+void
+sip_parser_slice_cpy(const sip_slice_t *slice, char *out, int size);
+
+#endif /* __SNGREP_SIP_PARSER_H */
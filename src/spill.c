@@ -0,0 +1,303 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file spill.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in spill.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "spill.h"
+#include "capture.h"
+#include "setting.h"
+#include "sip.h"
+#include "util.h"
+#include "vector.h"
+
+//! Magic number starting every spilled call record
+#define SPILL_MAGIC 0x53504c31
+//! Upper bound of messages accepted from a single record
+#define SPILL_MAX_MSGS 4096
+//! Upper bound of frames accepted for a single message
+#define SPILL_MAX_FRAMES 128
+
+//! Per message header preceding its frames and payload on disk
+struct spill_msg_hdr {
+    //! IP version of the original packet
+    uint8_t ip_version;
+    //! Transport of the original packet
+    uint8_t proto;
+    //! Source address
+    address_t src;
+    //! Destination address
+    address_t dst;
+    //! Payload bytes following the frames
+    uint32_t payload_len;
+    //! Number of frames following this header
+    uint32_t frame_count;
+};
+
+//! Index entry pointing at a spilled call record
+struct spill_entry {
+    //! Record offset in the spill file
+    long offset;
+    //! Call-ID of the spilled call
+    char *callid;
+};
+
+//! Spill ring file
+static FILE *spill_file = NULL;
+//! Next write offset in the spill file
+static long spill_write_off = 0;
+//! Ring size limit in bytes
+static long spill_limit = 0;
+//! Index of spilled calls (struct spill_entry)
+static vector_t *spill_index = NULL;
+//! A search is walking the index, delay ring resets
+static bool spill_busy = false;
+
+/**
+ * @brief Vector destroyer for spill index entries
+ */
+static void
+spill_entry_destroyer(void *item)
+{
+    struct spill_entry *entry = (struct spill_entry *) item;
+    sng_free(entry->callid);
+    sng_free(entry);
+}
+
+void
+spill_init()
+{
+    const char *file = setting_get_value(SETTING_CAPTURE_SPILL);
+
+    // Spilling is disabled without a file
+    if (!file || !strlen(file))
+        return;
+
+    if (!(spill_file = fopen(file, "w+"))) {
+        fprintf(stderr, "Couldn't open spill file %s\n", file);
+        return;
+    }
+
+    spill_limit = (long) setting_get_intvalue(SETTING_CAPTURE_SPILLSIZE) * 1024 * 1024;
+    spill_index = vector_create(64, 64);
+    vector_set_destroyer(spill_index, spill_entry_destroyer);
+}
+
+void
+spill_deinit()
+{
+    if (spill_file) {
+        fclose(spill_file);
+        spill_file = NULL;
+    }
+    vector_destroy(spill_index);
+    spill_index = NULL;
+}
+
+void
+spill_store(sip_call_t *call)
+{
+    struct spill_entry *entry;
+    struct spill_msg_hdr hdr;
+    sip_msg_t *msg;
+    frame_t *frame;
+    vector_iter_t msgs, frames;
+    uint32_t magic = SPILL_MAGIC;
+    uint32_t count;
+    long offset;
+
+    if (!spill_file)
+        return;
+
+    // Ring limit reached, restart dropping the oldest generation.
+    // Never reset while a search is walking the index, the ring may
+    // exceed its limit by a few records instead
+    if (spill_write_off > spill_limit && !spill_busy) {
+        if (ftruncate(fileno(spill_file), 0) != 0)
+            return;
+        spill_write_off = 0;
+        vector_destroy(spill_index);
+        spill_index = vector_create(64, 64);
+        vector_set_destroyer(spill_index, spill_entry_destroyer);
+    }
+
+    // The file position is not preserved between calls
+    offset = spill_write_off;
+    if (fseek(spill_file, offset, SEEK_SET) != 0)
+        return;
+
+    count = call_msg_count(call);
+    fwrite(&magic, sizeof(magic), 1, spill_file);
+    fwrite(&count, sizeof(count), 1, spill_file);
+
+    msgs = vector_iterator(call->msgs);
+    while ((msg = vector_iterator_next(&msgs))) {
+        // Reading the payload inflates it if it has been compacted
+        msg_get_payload(msg);
+
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.ip_version = msg->packet->ip_version;
+        hdr.proto = msg->packet->proto;
+        hdr.src = msg->packet->src;
+        hdr.dst = msg->packet->dst;
+        hdr.payload_len = msg->packet->payload_len;
+        // Frame contents are freed when storage is disabled, only
+        // frames still holding their data can be serialized
+        hdr.frame_count = 0;
+        frames = vector_iterator(msg->packet->frames);
+        while ((frame = vector_iterator_next(&frames))) {
+            if (frame->data)
+                hdr.frame_count++;
+        }
+        fwrite(&hdr, sizeof(hdr), 1, spill_file);
+
+        // Frames first, so saving a reloaded call still works
+        frames = vector_iterator(msg->packet->frames);
+        while ((frame = vector_iterator_next(&frames))) {
+            if (!frame->data)
+                continue;
+            fwrite(frame->header, sizeof(struct pcap_pkthdr), 1, spill_file);
+            fwrite(frame->data, frame->header->caplen, 1, spill_file);
+        }
+
+        fwrite(msg->packet->payload, hdr.payload_len, 1, spill_file);
+    }
+
+    if (fflush(spill_file) != 0)
+        return;
+    spill_write_off = ftell(spill_file);
+
+    // Index this record by Call-ID
+    entry = sng_malloc(sizeof(struct spill_entry));
+    entry->offset = offset;
+    entry->callid = strdup(call->callid);
+    vector_append(spill_index, entry);
+}
+
+/**
+ * @brief Parse a spilled call record back into the call list
+ *
+ * @return number of messages restored
+ */
+static int
+spill_load(struct spill_entry *entry)
+{
+    struct spill_msg_hdr hdr;
+    struct pcap_pkthdr frame_hdr;
+    packet_t *packet;
+    u_char *data;
+    uint32_t magic, count, i, f;
+    long offset;
+    int restored = 0;
+
+    if (fseek(spill_file, entry->offset, SEEK_SET) != 0)
+        return 0;
+
+    if (fread(&magic, sizeof(magic), 1, spill_file) != 1 || magic != SPILL_MAGIC)
+        return 0;
+    if (fread(&count, sizeof(count), 1, spill_file) != 1 || count > SPILL_MAX_MSGS)
+        return 0;
+    offset = ftell(spill_file);
+
+    for (i = 0; i < count; i++) {
+        // Storing a message may spill another call and move the file
+        // position, keep track of our own read offset
+        if (fseek(spill_file, offset, SEEK_SET) != 0)
+            break;
+        if (fread(&hdr, sizeof(hdr), 1, spill_file) != 1)
+            break;
+        if (hdr.payload_len > MAX_SIP_PAYLOAD || hdr.frame_count > SPILL_MAX_FRAMES)
+            break;
+
+        packet = packet_create(hdr.ip_version, hdr.proto, hdr.src, hdr.dst, 0);
+
+        for (f = 0; f < hdr.frame_count; f++) {
+            if (fread(&frame_hdr, sizeof(frame_hdr), 1, spill_file) != 1
+                    || frame_hdr.caplen > MAXIMUM_SNAPLEN) {
+                packet_destroy(packet);
+                return restored;
+            }
+            data = sng_malloc(frame_hdr.caplen);
+            if (fread(data, frame_hdr.caplen, 1, spill_file) != 1) {
+                sng_free(data);
+                packet_destroy(packet);
+                return restored;
+            }
+            packet_add_frame(packet, &frame_hdr, data);
+            sng_free(data);
+        }
+
+        data = sng_malloc(hdr.payload_len + 1);
+        if (fread(data, hdr.payload_len, 1, spill_file) != 1) {
+            sng_free(data);
+            packet_destroy(packet);
+            return restored;
+        }
+        packet_set_payload(packet, data, hdr.payload_len);
+        sng_free(data);
+        offset = ftell(spill_file);
+
+        // Run the packet through the regular storage path
+        if (!sip_check_packet(packet)) {
+            packet_destroy(packet);
+        } else {
+            restored++;
+        }
+    }
+
+    return restored;
+}
+
+int
+spill_search(const char *text)
+{
+    struct spill_entry *entry;
+    int i, loaded = 0;
+
+    if (!spill_file || !text || !strlen(text))
+        return 0;
+
+    // Walk the index newest first, so a call spilled several times is
+    // reloaded from its most recent record
+    spill_busy = true;
+    for (i = vector_count(spill_index) - 1; i >= 0; i--) {
+        entry = vector_item(spill_index, i);
+        // Not what we're looking for
+        if (!strcasestr(entry->callid, text))
+            continue;
+        // Already (or back) in memory
+        if (sip_find_by_callid(entry->callid))
+            continue;
+        if (spill_load(entry))
+            loaded++;
+    }
+    spill_busy = false;
+
+    return loaded;
+}
@@ -0,0 +1,80 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file spill.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Disk spill ring for rotated calls
+ *
+ * When capture.spill points to a file, calls evicted by
+ * sip_calls_rotate are serialized there (packet frames and payload)
+ * instead of being lost, with an in-memory index by Call-ID. A call
+ * list search that misses memory but hits the index reloads the call
+ * transparently. The file is bounded by capture.spillsize: when the
+ * limit is reached the ring restarts and the oldest generation of
+ * spilled calls is dropped.
+ *
+ * All entry points expect the caller to hold the capture lock, which
+ * is already the case for the storage path and for UI key handling.
+ *
+ */
+#ifndef __SNGREP_SPILL_H
+#define __SNGREP_SPILL_H
+
+#include "config.h"
+#include "sip_call.h"
+
+/**
+ * @brief Open the spill file if capture.spill is configured
+ */
+void
+spill_init();
+
+/**
+ * @brief Close the spill file and deallocate the index
+ */
+void
+spill_deinit();
+
+/**
+ * @brief Serialize an evicted call into the spill ring
+ *
+ * Invoked by sip_calls_rotate right before the call is destroyed.
+ *
+ * @param call Call being rotated out of memory
+ */
+void
+spill_store(sip_call_t *call);
+
+/**
+ * @brief Reload spilled calls whose Call-ID matches a search
+ *
+ * Every indexed call whose Call-ID contains the given text and that is
+ * no longer in memory is parsed back into the call list.
+ *
+ * @param text Display filter text entered in the call list
+ * @return number of calls reloaded
+ */
+int
+spill_search(const char *text);
+
+#endif /* __SNGREP_SPILL_H */
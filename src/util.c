@@ -32,6 +32,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "util.h"
 
 
@@ -88,9 +94,17 @@ timeval_is_older(struct timeval t1, struct timeval t2)
 const char *
 timeval_to_date(struct timeval time, char *out)
 {
+    // Rows drawn in the same second reuse the last formatted date
+    static char cached[11];
+    static time_t second = 0;
     time_t t = (time_t) time.tv_sec;
-    struct tm *timestamp = localtime(&t);
-    strftime(out, 11, "%Y/%m/%d", timestamp);
+
+    if (t != second || !second) {
+        struct tm *timestamp = localtime(&t);
+        strftime(cached, sizeof(cached), "%Y/%m/%d", timestamp);
+        second = t;
+    }
+    memcpy(out, cached, sizeof(cached));
     return out;
 }
 
@@ -98,9 +112,17 @@ timeval_to_date(struct timeval time, char *out)
 const char *
 timeval_to_time(struct timeval time, char *out)
 {
+    // Rows drawn in the same second reuse the last formatted time
+    static char cached[9];
+    static time_t second = 0;
     time_t t = (time_t) time.tv_sec;
-    struct tm *timestamp = localtime(&t);
-    strftime(out, 19, "%H:%M:%S", timestamp);
+
+    if (t != second || !second) {
+        struct tm *timestamp = localtime(&t);
+        strftime(cached, sizeof(cached), "%H:%M:%S", timestamp);
+        second = t;
+    }
+    memcpy(out, cached, sizeof(cached));
     sprintf(out + 8, ".%06d", (int) time.tv_usec);
     return out;
 }
@@ -156,3 +178,63 @@ strtrim(char *str)
 
     return str;
 }
+
+const char *
+sng_scan_eol(const char *str)
+{
+#if defined(__SSE2__)
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i nul = _mm_setzero_si128();
+    __m128i chunk;
+    unsigned mask;
+
+    // Align down to a sixteen byte boundary so full loads never cross
+    // a page boundary, and mask out the matches before the string
+    const char *ptr = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+    chunk = _mm_load_si128((const __m128i *) ptr);
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, cr))
+           | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf))
+           | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nul));
+    mask &= ~0u << (str - ptr);
+
+    while (!mask) {
+        ptr += 16;
+        chunk = _mm_load_si128((const __m128i *) ptr);
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, cr))
+               | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf))
+               | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nul));
+    }
+
+    return ptr + __builtin_ctz(mask);
+#elif defined(__ARM_NEON)
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    const uint8x16_t lf = vdupq_n_u8('\n');
+    const uint8x16_t nul = vdupq_n_u8(0);
+    uint8x16_t chunk, match;
+    uint64_t mask;
+
+    // Same aligned load approach as the SSE2 version, using the
+    // four bits per byte shrn trick to get a match mask
+    const char *ptr = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+    chunk = vld1q_u8((const uint8_t *) ptr);
+    match = vorrq_u8(vorrq_u8(vceqq_u8(chunk, cr), vceqq_u8(chunk, lf)),
+                     vceqq_u8(chunk, nul));
+    mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+    mask &= ~(uint64_t) 0 << ((str - ptr) * 4);
+
+    while (!mask) {
+        ptr += 16;
+        chunk = vld1q_u8((const uint8_t *) ptr);
+        match = vorrq_u8(vorrq_u8(vceqq_u8(chunk, cr), vceqq_u8(chunk, lf)),
+                         vceqq_u8(chunk, nul));
+        mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+    }
+
+    return ptr + (__builtin_ctzll(mask) >> 2);
+#else
+    while (*str && *str != '\r' && *str != '\n')
+        str++;
+    return str;
+#endif
+}
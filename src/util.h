@@ -96,4 +96,17 @@ timeval_to_delta(struct timeval start, struct timeval end, char *out);
 char *
 strtrim(char *str);
 
+/**
+ * @brief Find the end of the current line
+ *
+ * Scans sixteen bytes at a time (SSE2 or NEON when available, with a
+ * scalar fallback) looking for the line boundary. Used by the payload
+ * parser and the SDP scanner, where line splitting dominates the scan.
+ *
+ * @param str Start of the line
+ * @return pointer to the first CR, LF or the terminating null byte
+ */
+const char *
+sng_scan_eol(const char *str);
+
 #endif /* __SNGREP_UTIL_H */
@@ -41,6 +41,7 @@ vector_create(int limit, int step)
         return NULL;
 
     v->count = 0;
+    v->head = 0;
     v->limit = limit;
     v->step = step;
     v->list = NULL;
@@ -74,7 +75,7 @@ vector_destroy_items(vector_t *vector)
     // If vector contains items
     if (vector->count) {
         for (i = 0; i < vector->count; i++) {
-            free(vector->list[i]);
+            free(vector->list[vector->head + i]);
         }
         free(vector->list);
     }
@@ -151,17 +152,28 @@ vector_append(vector_t *vector, void *item)
     }
 
     // Check if we need to increase vector size
-    if (vector->count == vector->limit) {
-        // Increase vector size
-        vector->limit += vector->step;
-        // Add more memory to the list
-        vector->list = realloc(vector->list, sizeof(void *) * vector->limit);
-        // Initialize new allocated memory
-        memset(vector->list + vector->limit - vector->step, 0, vector->step);
+    if (vector->head + vector->count == vector->limit) {
+        if (vector->head && vector->head >= vector->limit / 2) {
+            // Plenty of free space at the front: compact instead of growing
+            memmove(vector->list, vector->list + vector->head,
+                    sizeof(void *) * vector->count);
+            vector->head = 0;
+        } else {
+            // Grow geometrically so appending N items needs O(log N)
+            // reallocations, using step as the minimum growth
+            int growth = (vector->limit > vector->step) ? vector->limit : vector->step;
+            // Increase vector size
+            vector->limit += growth;
+            // Add more memory to the list
+            vector->list = realloc(vector->list, sizeof(void *) * vector->limit);
+            // Initialize new allocated memory
+            memset(vector->list + vector->limit - growth, 0,
+                   sizeof(void *) * growth);
+        }
     }
 
     // Add item to the end of the list
-    vector->list[vector->count++] = item;
+    vector->list[vector->head + vector->count++] = item;
 
     // Check if vector has a sorter
     if (vector->sorter) {
@@ -171,17 +183,55 @@ vector_append(vector_t *vector, void *item)
     return vector->count - 1;
 }
 
+void
+vector_reserve(vector_t *vector, int count)
+{
+    int limit;
+
+    if (!vector)
+        return;
+
+    // Required list size to hold the requested items
+    limit = vector->head + count;
+    if (limit < vector->limit)
+        limit = vector->limit;
+
+    if (!vector->list) {
+        vector->list = malloc(sizeof(void *) * limit);
+        memset(vector->list, 0, sizeof(void *) * limit);
+    } else if (limit > vector->limit) {
+        vector->list = realloc(vector->list, sizeof(void *) * limit);
+        memset(vector->list + vector->limit, 0,
+               sizeof(void *) * (limit - vector->limit));
+    }
+    vector->limit = limit;
+}
+
 int
 vector_append_vector(vector_t *dst, vector_t *src)
 {
+    vector_iter_t it;
+    void *item;
+
     if (!dst || !src)
         return 1;
 
-    vector_iter_t it = vector_iterator(src);
+    if (!vector_count(src))
+        return 0;
 
-    void *item;
-    while ((item = vector_iterator_next(&it)))
-        vector_append(dst, item);
+    // Vectors with a sorter must place items one by one
+    if (dst->sorter) {
+        it = vector_iterator(src);
+        while ((item = vector_iterator_next(&it)))
+            vector_append(dst, item);
+        return 0;
+    }
+
+    // Copy all the items in one go
+    vector_reserve(dst, dst->count + src->count);
+    memcpy(dst->list + dst->head + dst->count, src->list + src->head,
+           sizeof(void *) * src->count);
+    dst->count += src->count;
 
     return 0;
 }
@@ -196,41 +246,105 @@ vector_insert(vector_t *vector, void *item, int pos)
         return vector->count;
 
     // If position is already filled with that item, we're done
-    if (vector->list[pos] == item)
+    if (vector->list[vector->head + pos] == item)
         return vector->count;
 
     // If possition is occupied, move the other position
-    if (vector->list[pos]) {
-        memmove(vector->list + pos + 1, vector->list + pos,
+    if (vector->list[vector->head + pos]) {
+        memmove(vector->list + vector->head + pos + 1, vector->list + vector->head + pos,
                 sizeof(void *) * (vector->count - pos - 1));
     }
 
     // Set the position
-    vector->list[pos] = item;
+    vector->list[vector->head + pos] = item;
     return vector->count;
 }
 
+void
+vector_insert_sorted(vector_t *vector, void *item, int (*cmp)(void *one, void *two))
+{
+    int lo = 0, hi, mid;
+
+    // The appended item is at the last position
+    hi = vector->count - 1;
+
+    // Binary search the first position with a greater item
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (cmp(vector->list[vector->head + mid], item) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // Item is already in its sorted position
+    if (lo == vector->count - 1)
+        return;
+
+    // Shift greater items one position and place the item
+    memmove(vector->list + vector->head + lo + 1, vector->list + vector->head + lo,
+            sizeof(void *) * (vector->count - 1 - lo));
+    vector->list[vector->head + lo] = item;
+}
+
+//! Comparator used by the libc qsort callback (@see vector_sort)
+static int (*vector_sort_comparator)(void *one, void *two);
+
+static int
+vector_sort_qsort_cmp(const void *one, const void *two)
+{
+    return vector_sort_comparator(*(void **) one, *(void **) two);
+}
+
+void
+vector_sort(vector_t *vector, int (*cmp)(void *one, void *two))
+{
+    if (!vector || vector->count < 2)
+        return;
+
+    vector_sort_comparator = cmp;
+    qsort(vector->list + vector->head, vector->count, sizeof(void *),
+          vector_sort_qsort_cmp);
+}
 
 void
 vector_remove(vector_t *vector, void *item)
+{
+    // Unlink the item and destroy it if vector has a destroyer
+    if (vector_extract(vector, item) && vector->destroyer) {
+        vector->destroyer(item);
+    }
+}
+
+void *
+vector_extract(vector_t *vector, void *item)
 {
     // Get item position
     int idx = vector_index(vector, item);
     // Not found in the vector
     if (idx == -1)
-        return;
-
-    // Decrease item counter
-    vector->count--;
-    // Move the rest of the elements one position up
-    memmove(vector->list + idx, vector->list + idx + 1, sizeof(void *) * (vector->count - idx));
-    // Reset vector last position
-    vector->list[vector->count] = NULL;
+        return NULL;
 
-    // Destroy the item if vector has a destroyer
-    if (vector->destroyer) {
-        vector->destroyer(item);
+    if (idx == 0) {
+        // Removing the first item only moves the start of the list
+        vector->list[vector->head] = NULL;
+        vector->head++;
+        vector->count--;
+        // List is empty, reuse the whole allocated space
+        if (!vector->count)
+            vector->head = 0;
+    } else {
+        // Decrease item counter
+        vector->count--;
+        // Move the rest of the elements one position up
+        memmove(vector->list + vector->head + idx, vector->list + vector->head + idx + 1,
+                sizeof(void *) * (vector->count - idx));
+        // Reset vector last position
+        vector->list[vector->head + vector->count] = NULL;
     }
+
+    return item;
 }
 
 void
@@ -256,7 +370,7 @@ vector_item(vector_t *vector, int index)
 {
     if (!vector || index >= vector->count || index < 0)
         return NULL;
-    return vector->list[index];
+    return vector->list[vector->head + index];
 }
 
 void
@@ -264,7 +378,7 @@ vector_set_item(vector_t *vector, int index, void *item)
 {
     if (!vector || index >= vector->count || index < 0)
         return;
-    vector->list[index] = item;
+    vector->list[vector->head + index] = item;
 }
 
 void *
@@ -285,7 +399,7 @@ vector_index(vector_t *vector, void *item)
     // FIXME Bad perfomance
     int i;
     for (i = 0; i < vector->count; i++) {
-        if (vector->list[i] == item)
+        if (vector->list[vector->head + i] == item)
             return i;
     }
     return -1;
@@ -45,6 +45,10 @@ typedef struct vector_iter vector_iter_t;
 struct vector {
     //! Number of elements in list
     uint32_t count;
+    //! Position of the first element in list
+    //! Removing the first item only moves this offset, so vectors can
+    //! be used as queues without paying a full shift per removal
+    uint32_t head;
     //! Total space in list (available + elements)
     uint32_t limit;
     //! Number of new spaces to be reallocated
@@ -127,6 +131,18 @@ vector_clear(vector_t *vector);
 int
 vector_append(vector_t *vector, void *item);
 
+/**
+ * @brief Ensure the vector can hold a number of items
+ *
+ * Grow the vector list in one allocation so the following
+ * appends don't need to reallocate it.
+ *
+ * @param vector Vector to grow
+ * @param count Total number of items the vector must hold
+ */
+void
+vector_reserve(vector_t *vector, int count);
+
 /**
  * @brief Append a vector to another vector
  * @param dst Vector that will append the new items
@@ -144,12 +160,47 @@ vector_append_vector(vector_t *dst, vector_t *src);
 int
 vector_insert(vector_t *vector, void *item, int pos);
 
+/**
+ * @brief Move an appended item to its sorted position
+ *
+ * Helper for sorter callbacks: the item has just been appended at the
+ * end of the list, so binary search its position among the rest of
+ * (already sorted) items and shift them with a single memmove. Items
+ * that compare equal keep their insertion order.
+ *
+ * @param vector Vector with the item already appended
+ * @param item The appended item
+ * @param cmp comparator returning <0, 0 or >0 (qsort style)
+ */
+void
+vector_insert_sorted(vector_t *vector, void *item, int (*cmp)(void *one, void *two));
+
+/**
+ * @brief Sort all the vector items at once
+ *
+ * @param vector Vector to be sorted
+ * @param cmp comparator returning <0, 0 or >0 (qsort style)
+ */
+void
+vector_sort(vector_t *vector, int (*cmp)(void *one, void *two));
+
 /**
  * @brief Remove itemn from vector
  */
 void
 vector_remove(vector_t *vector, void *item);
 
+/**
+ * @brief Remove item from vector without destroying it
+ *
+ * Unlike vector_remove, the vector destroyer is not invoked, so the
+ * caller takes the ownership of the extracted item.
+ *
+ * @return the extracted item, NULL if it was not in the vector
+ */
+void *
+vector_extract(vector_t *vector, void *item);
+
 /**
  * @brief Set the vector destroyer
  *
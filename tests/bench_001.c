@@ -0,0 +1,169 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file bench_001.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * Benchmark replaying a pcap corpus through the full parse path.
+ *
+ * Runs the sngrep binary in headless mode (-N -q) over the corpus
+ * pcap repeated BENCH_REPEAT times, reading the pipeline counters
+ * from --perf-stats, and reports packets per second and peak RSS.
+ * Invoked through the bench target of tests/Makefile.am.
+ *
+ * Environment:
+ *   BENCH_SNGREP   sngrep binary to run (default ../src/sngrep)
+ *   BENCH_PCAP     corpus pcap to replay (default aaa.pcap)
+ *   BENCH_REPEAT   times the corpus is replayed (default 20)
+ *   BENCH_MIN_PPS  fail below this packets/sec rate (default 0, off)
+ *   BENCH_MAX_RSS  fail above this peak RSS in KB (default 0, off)
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+//! Maximum corpus repetitions in a single run
+#define BENCH_MAX_REPEAT 512
+//! Collected child counters output size
+#define BENCH_OUTPUT_LEN 65536
+
+int main ()
+{
+    const char *sngrep = getenv("BENCH_SNGREP");
+    const char *pcap = getenv("BENCH_PCAP");
+    const char *value;
+    char *argv[5 + 2 * BENCH_MAX_REPEAT];
+    char output[BENCH_OUTPUT_LEN + 1];
+    long repeat = 20, min_pps = 0, max_rss = 0;
+    long captured = 0, rss, pps;
+    struct timeval start, end;
+    struct rusage usage;
+    double elapsed;
+    int argc, i, status, devnull, outfd[2];
+    ssize_t len, pos = 0;
+    pid_t child;
+
+    // Benchmark configuration from environment
+    if (!sngrep)
+        sngrep = "../src/sngrep";
+    if (!pcap)
+        pcap = "aaa.pcap";
+    if ((value = getenv("BENCH_REPEAT")))
+        repeat = strtol(value, NULL, 10);
+    if ((value = getenv("BENCH_MIN_PPS")))
+        min_pps = strtol(value, NULL, 10);
+    if ((value = getenv("BENCH_MAX_RSS")))
+        max_rss = strtol(value, NULL, 10);
+
+    if (repeat < 1 || repeat > BENCH_MAX_REPEAT) {
+        fprintf(stderr, "bench: BENCH_REPEAT must be between 1 and %d\n", BENCH_MAX_REPEAT);
+        return 1;
+    }
+
+    // Replay the corpus through the headless parse path
+    argc = 0;
+    argv[argc++] = (char *) sngrep;
+    argv[argc++] = "-N";
+    argv[argc++] = "-q";
+    argv[argc++] = "--perf-stats";
+    for (i = 0; i < repeat; i++) {
+        argv[argc++] = "-I";
+        argv[argc++] = (char *) pcap;
+    }
+    argv[argc] = NULL;
+
+    if (pipe(outfd) != 0) {
+        perror("bench: pipe");
+        return 1;
+    }
+
+    gettimeofday(&start, NULL);
+
+    if ((child = fork()) < 0) {
+        perror("bench: fork");
+        return 1;
+    }
+
+    if (child == 0) {
+        // Counters are printed to stderr, dialog output is discarded
+        devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(outfd[1], STDERR_FILENO);
+        close(outfd[0]);
+        close(outfd[1]);
+        execv(sngrep, argv);
+        perror("bench: exec");
+        _exit(127);
+    }
+
+    close(outfd[1]);
+    while ((len = read(outfd[0], output + pos, BENCH_OUTPUT_LEN - pos)) > 0)
+        pos += len;
+    output[pos] = '\0';
+    close(outfd[0]);
+
+    waitpid(child, &status, 0);
+    gettimeofday(&end, NULL);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "bench: %s failed\n%s", sngrep, output);
+        return 1;
+    }
+
+    // Parse the captured frames counter printed by --perf-stats
+    if ((value = strstr(output, "captured: ")))
+        captured = strtol(value + strlen("captured: "), NULL, 10);
+
+    if (captured <= 0) {
+        fprintf(stderr, "bench: no packets captured from %s\n", pcap);
+        return 1;
+    }
+
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    pps = (long) (captured / elapsed);
+
+    // Peak RSS of the replay, in kilobytes on Linux
+    getrusage(RUSAGE_CHILDREN, &usage);
+    rss = usage.ru_maxrss;
+
+    printf("bench: %s x%ld: %ld packets in %.3f s, %ld packets/s, peak RSS %ld KB\n",
+           pcap, repeat, captured, elapsed, pps, rss);
+
+    // Check the configured regression thresholds
+    if (min_pps && pps < min_pps) {
+        fprintf(stderr, "bench: FAIL: %ld packets/s below threshold %ld\n", pps, min_pps);
+        return 1;
+    }
+    if (max_rss && rss > max_rss) {
+        fprintf(stderr, "bench: FAIL: peak RSS %ld KB above threshold %ld\n", rss, max_rss);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,389 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file gen_001.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * SIP/RTP traffic generator for benchmarking.
+ *
+ * Synthesizes reproducible SIP dialogs (with SDP), optional RTP media
+ * and retransmissions, either into a pcap file the bench target can
+ * replay or as live UDP datagrams at a controlled packet rate, so the
+ * parse path can be driven at known packets/sec.
+ *
+ * Usage: gen-001 [options]
+ *   -o FILE   write an ethernet pcap file (default gen.pcap)
+ *   -u ADDR   send live UDP to ADDR (host:port) instead of a pcap
+ *   -c CALLS  number of calls to generate (default 100)
+ *   -r RATE   call setup rate in calls per second (default 10)
+ *   -m MSGS   SIP messages per dialog, 2 to 7 (default 7)
+ *   -R PKTS   RTP packets per call, 20ms cadence (default 0)
+ *   -x PCT    SIP retransmission ratio in percent (default 0)
+ *   -p PPS    live mode packet rate, 0 sends unpaced (default 1000)
+ *   -s SEED   random seed for reproducible runs (default 1)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+//! Maximum size of a generated frame
+#define GEN_MAX_FRAME 1500
+//! Microseconds between the SIP messages of a dialog
+#define GEN_SIP_SPACING 20000
+//! Microseconds between the RTP packets of a stream (20ms cadence)
+#define GEN_RTP_SPACING 20000
+
+//! One generated frame, timestamped for the pcap writer
+struct gen_frame {
+    //! Capture timestamp of the frame
+    uint64_t usecs;
+    //! Full frame length, ethernet headers included
+    uint32_t len;
+    //! Offset of the UDP payload inside data (for live mode)
+    uint32_t payload_off;
+    //! Frame contents
+    u_char data[GEN_MAX_FRAME];
+};
+
+//! Generated frames, sorted by timestamp before being written
+static struct gen_frame *frames = NULL;
+//! Number of generated frames
+static size_t frame_count = 0;
+//! Allocated frame slots
+static size_t frame_capacity = 0;
+
+/**
+ * @brief Fill the ethernet, IP and UDP headers of a frame
+ *
+ * Checksums are left zeroed: libpcap consumers do not validate them
+ * and the kernel fills them on live sockets.
+ */
+static u_char *
+gen_frame_headers(struct gen_frame *frame, uint32_t src, uint32_t dst,
+                  uint16_t sport, uint16_t dport, uint16_t paylen)
+{
+    u_char *data = frame->data;
+    uint16_t ip_len = htons(20 + 8 + paylen);
+    uint16_t udp_len = htons(8 + paylen);
+    uint16_t port;
+
+    memset(data, 0, 14);
+    data[12] = 0x08;
+
+    // IP header: version 4, header length 5, UDP, TTL 64
+    memset(data + 14, 0, 20);
+    data[14] = 0x45;
+    memcpy(data + 16, &ip_len, 2);
+    data[22] = 64;
+    data[23] = 17;
+    memcpy(data + 26, &src, 4);
+    memcpy(data + 30, &dst, 4);
+
+    // UDP header
+    port = htons(sport);
+    memcpy(data + 34, &port, 2);
+    port = htons(dport);
+    memcpy(data + 36, &port, 2);
+    memcpy(data + 38, &udp_len, 2);
+    memset(data + 40, 0, 2);
+
+    frame->payload_off = 42;
+    frame->len = 42 + paylen;
+    return data + 42;
+}
+
+/**
+ * @brief Append a generated frame with the given UDP payload
+ */
+static void
+gen_frame_add(uint64_t usecs, uint32_t src, uint32_t dst,
+              uint16_t sport, uint16_t dport, const u_char *payload, uint16_t paylen)
+{
+    struct gen_frame *frame;
+
+    if (42 + paylen > GEN_MAX_FRAME)
+        return;
+
+    if (frame_count == frame_capacity) {
+        frame_capacity = (frame_capacity) ? frame_capacity * 2 : 1024;
+        frames = realloc(frames, frame_capacity * sizeof(struct gen_frame));
+        if (!frames) {
+            fprintf(stderr, "Out of memory at %zu frames\n", frame_count);
+            exit(1);
+        }
+    }
+
+    frame = &frames[frame_count++];
+    frame->usecs = usecs;
+    memcpy(gen_frame_headers(frame, src, dst, sport, dport, paylen), payload, paylen);
+}
+
+/**
+ * @brief Sort helper ordering frames by capture timestamp
+ */
+static int
+gen_frame_cmp(const void *a, const void *b)
+{
+    const struct gen_frame *fa = a;
+    const struct gen_frame *fb = b;
+    if (fa->usecs == fb->usecs)
+        return 0;
+    return (fa->usecs < fb->usecs) ? -1 : 1;
+}
+
+/**
+ * @brief Generate the SIP dialog (and media) of a single call
+ *
+ * Messages follow a basic INVITE dialog, trimmed to the configured
+ * dialog length: INVITE, 100, 180, 200, ACK, BYE, 200. Each SIP
+ * message may be retransmitted according to the configured ratio and
+ * RTP flows between the SDP media ports after the answer.
+ */
+static void
+gen_call(int index, uint64_t start, int msgcnt, int rtpcnt, int retrans_pct)
+{
+    char payload[GEN_MAX_FRAME];
+    char from_ip[16], to_ip[16];
+    char sdp[256];
+    u_char rtp[172];
+    uint32_t from, to, ssrc, rtpts;
+    uint64_t usecs = start;
+    uint16_t seq;
+    int i, sdplen;
+
+    // A unique pair of endpoints per call
+    snprintf(from_ip, sizeof(from_ip), "10.1.%d.%d", (index >> 8) & 255, index & 255);
+    snprintf(to_ip, sizeof(to_ip), "10.2.%d.%d", (index >> 8) & 255, index & 255);
+    from = inet_addr(from_ip);
+    to = inet_addr(to_ip);
+
+    // SIP messages of the dialog: method, direction and SDP media port
+    static const struct {
+        const char *first;
+        const char *cseq;
+        int reverse;
+        int sdp_port;
+    } dialog[] = {
+        { "INVITE sip:callee@%s SIP/2.0", "1 INVITE", 0, 8000 },
+        { "SIP/2.0 100 Trying", "1 INVITE", 1, 0 },
+        { "SIP/2.0 180 Ringing", "1 INVITE", 1, 0 },
+        { "SIP/2.0 200 OK", "1 INVITE", 1, 9000 },
+        { "ACK sip:callee@%s SIP/2.0", "1 ACK", 0, 0 },
+        { "BYE sip:callee@%s SIP/2.0", "2 BYE", 0, 0 },
+        { "SIP/2.0 200 OK", "2 BYE", 1, 0 },
+    };
+
+    for (i = 0; i < msgcnt; i++) {
+        char first[128];
+        const char *src_ip = (dialog[i].reverse) ? to_ip : from_ip;
+        uint32_t src = (dialog[i].reverse) ? to : from;
+        uint32_t dst = (dialog[i].reverse) ? from : to;
+
+        snprintf(first, sizeof(first), dialog[i].first, to_ip);
+
+        // SDP body advertising the media port of this endpoint
+        sdplen = 0;
+        if (dialog[i].sdp_port) {
+            sdplen = snprintf(sdp, sizeof(sdp),
+                              "v=0\r\no=gen %d 1 IN IP4 %s\r\ns=-\r\n"
+                              "c=IN IP4 %s\r\nt=0 0\r\n"
+                              "m=audio %d RTP/AVP 0\r\na=rtpmap:0 PCMU/8000\r\n",
+                              index, src_ip, src_ip, dialog[i].sdp_port);
+        }
+
+        int len = snprintf(payload, sizeof(payload),
+                           "%s\r\n"
+                           "Via: SIP/2.0/UDP %s:5060;branch=z9hG4bKgen%d.%d\r\n"
+                           "From: <sip:caller@%s>;tag=gen%d\r\n"
+                           "To: <sip:callee@%s>%s\r\n"
+                           "Call-ID: gen-%d@%s\r\n"
+                           "CSeq: %s\r\n"
+                           "%s"
+                           "Content-Length: %d\r\n\r\n%s",
+                           first, from_ip, index, i,
+                           from_ip, index,
+                           to_ip, (i > 0) ? ";tag=genb" : "",
+                           index, from_ip,
+                           dialog[i].cseq,
+                           (sdplen) ? "Content-Type: application/sdp\r\n" : "",
+                           sdplen, (sdplen) ? sdp : "");
+
+        gen_frame_add(usecs, src, dst, 5060, 5060, (u_char *) payload, len);
+
+        // Retransmit this message according to the configured ratio
+        if (retrans_pct && (rand() % 100) < retrans_pct)
+            gen_frame_add(usecs + GEN_SIP_SPACING / 2, src, dst, 5060, 5060,
+                          (u_char *) payload, len);
+
+        usecs += GEN_SIP_SPACING;
+    }
+
+    // RTP media after the answer, caller media port to callee media port
+    ssrc = htonl(0x53470000 + index);
+    rtpts = 0;
+    for (seq = 0; seq < rtpcnt; seq++) {
+        uint16_t nseq = htons(seq);
+        uint32_t nts = htonl(rtpts);
+
+        memset(rtp, 0, sizeof(rtp));
+        rtp[0] = 0x80;
+        memcpy(rtp + 2, &nseq, 2);
+        memcpy(rtp + 4, &nts, 4);
+        memcpy(rtp + 8, &ssrc, 4);
+
+        gen_frame_add(usecs, from, to, 8000, 9000, rtp, sizeof(rtp));
+        usecs += GEN_RTP_SPACING;
+        rtpts += 160;
+    }
+}
+
+/**
+ * @brief Write the generated frames as a pcap capture file
+ */
+static int
+gen_write_pcap(const char *path)
+{
+    FILE *file;
+    uint32_t hdr[6] = { 0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1 };
+    uint32_t rec[4];
+    size_t i;
+
+    if (!(file = fopen(path, "w"))) {
+        perror(path);
+        return 1;
+    }
+
+    fwrite(hdr, sizeof(hdr), 1, file);
+    for (i = 0; i < frame_count; i++) {
+        rec[0] = frames[i].usecs / 1000000;
+        rec[1] = frames[i].usecs % 1000000;
+        rec[2] = frames[i].len;
+        rec[3] = frames[i].len;
+        fwrite(rec, sizeof(rec), 1, file);
+        fwrite(frames[i].data, frames[i].len, 1, file);
+    }
+    fclose(file);
+
+    printf("%zu frames written to %s\n", frame_count, path);
+    return 0;
+}
+
+/**
+ * @brief Send the generated UDP payloads live at the configured rate
+ *
+ * Only the UDP payload is sent: the target captures it with its own
+ * transport headers, so this exercises the live capture path end to
+ * end at a known packets/sec.
+ */
+static int
+gen_send_live(const char *addr, int pps)
+{
+    struct sockaddr_in to = { 0 };
+    char host[64];
+    const char *port;
+    size_t i;
+    int sock;
+
+    if (!(port = strchr(addr, ':')) || (size_t)(port - addr) >= sizeof(host)) {
+        fprintf(stderr, "Invalid target address %s, expected host:port\n", addr);
+        return 1;
+    }
+    memcpy(host, addr, port - addr);
+    host[port - addr] = '\0';
+
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = inet_addr(host);
+    to.sin_port = htons(atoi(port + 1));
+
+    if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    for (i = 0; i < frame_count; i++) {
+        sendto(sock, frames[i].data + frames[i].payload_off,
+               frames[i].len - frames[i].payload_off, 0,
+               (struct sockaddr *) &to, sizeof(to));
+        if (pps)
+            usleep(1000000 / pps);
+    }
+    close(sock);
+
+    printf("%zu datagrams sent to %s\n", frame_count, addr);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outfile = "gen.pcap";
+    const char *target = NULL;
+    int calls = 100, rate = 10, msgcnt = 7, rtpcnt = 0;
+    int retrans_pct = 0, pps = 1000, seed = 1;
+    int i, opt;
+
+    while ((opt = getopt(argc, argv, "o:u:c:r:m:R:x:p:s:h")) != -1) {
+        switch (opt) {
+            case 'o': outfile = optarg; break;
+            case 'u': target = optarg; break;
+            case 'c': calls = atoi(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 'm': msgcnt = atoi(optarg); break;
+            case 'R': rtpcnt = atoi(optarg); break;
+            case 'x': retrans_pct = atoi(optarg); break;
+            case 'p': pps = atoi(optarg); break;
+            case 's': seed = atoi(optarg); break;
+            case 'h':
+            default:
+                fprintf(stderr, "Usage: %s [-o pcap|-u host:port] [-c calls]"
+                        " [-r calls/sec] [-m msgs] [-R rtp] [-x retrans%%]"
+                        " [-p pps] [-s seed]\n", argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    // Clamp the dialog length to the scripted messages
+    if (msgcnt < 2)
+        msgcnt = 2;
+    if (msgcnt > 7)
+        msgcnt = 7;
+    if (calls < 1 || rate < 1) {
+        fprintf(stderr, "Calls and rate must be positive\n");
+        return 1;
+    }
+
+    srand(seed);
+
+    // Call setups spread evenly over time by the configured rate
+    for (i = 0; i < calls; i++)
+        gen_call(i, (uint64_t) i * 1000000 / rate, msgcnt, rtpcnt, retrans_pct);
+
+    // Deliver everything in capture order
+    qsort(frames, frame_count, sizeof(struct gen_frame), gen_frame_cmp);
+
+    return (target) ? gen_send_live(target, pps) : gen_write_pcap(outfile);
+}